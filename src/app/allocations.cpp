@@ -0,0 +1,25 @@
+#include <cstdlib>
+#include <new>
+
+#include "profiler.h"
+
+// Замена глобальных operator new/delete только для исполняемого файла приложения: каждая аллокация
+// учитывается в счётчике потока для оверлея производительности. Бенчмарки подменяют их сами, см. benchmark.cpp.
+
+namespace
+{
+    void *countedAlloc(std::size_t size)
+    {
+        Profiler::countAllocation();
+        if (void *ptr = std::malloc(size ? size : 1))
+            return ptr;
+        throw std::bad_alloc();
+    }
+}
+
+void *operator new(std::size_t size) { return countedAlloc(size); }
+void *operator new[](std::size_t size) { return countedAlloc(size); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
@@ -20,11 +20,14 @@
 #define GL_SILENCE_DEPRECATION
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstring>
 #include <ctime>
 #include <limits>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <GLFW/glfw3.h>
@@ -33,23 +36,37 @@
 #include "imgui_impl_opengl3.h"
 #include "implot.h"
 
+#include "../lib/trace/trace.h"
+#include "../lib/tsdb/aggregate.h"
+#include "../lib/tsdb/cache/cache.h"
+#include "../lib/tsdb/cache/coalescing.h"
+#include "../lib/tsdb/cache/disk_cache.h"
+#include "../lib/tsdb/downsample.h"
+#include "../lib/tsdb/metadata.h"
+#include "../lib/tsdb/prometheus/local_promql.h"
 #include "../lib/tsdb/prometheus/prometheus.h"
+#include "../lib/tsdb/prometheus/remote_read.h"
 #include "constants.h"
+#include "dashboard.h"
+#include "fetcher.h"
+#include "profiler.h"
 #include "utils.h"
 
-struct GraphSeries
-{
-    std::string name;
-    std::vector<double> x;
-    std::vector<double> y;
-};
-
 static bool autoRefresh = false;
 static double lastRefreshTime = 0.0;
 static int refreshIntervalSec = DEFAULT_REFRESH_INTERVAL;
 static char urlBuffer[255];
-static char queryBuffer[255];
-static std::unique_ptr<PrometheusClient> prometheusClient = nullptr;
+static std::shared_ptr<TSDBClient> prometheusClient = nullptr;
+static std::shared_ptr<CoalescingTSDBClient> requestCoalescer = nullptr; // prometheusClient без одинаковых одновременных запросов
+static std::shared_ptr<CachingTSDBClient> queryCache = nullptr; // Кэш поверх requestCoalescer, через него идут запросы данных
+static std::shared_ptr<LocalPromQLClient> localPromQL = nullptr; // prometheusClient в режиме локального PromQL
+static std::shared_ptr<MetadataIndex> metadataIndex = nullptr;   // Имена метрик и меток для подсказок в запросах
+static std::atomic<bool> metadataUpdated{false};                 // Индекс обновился, подсказки нужно пересчитать
+static PrometheusBackend connectedBackend = PrometheusBackend::QueryRange;
+static int currentBackendIndex = static_cast<int>(PrometheusBackend::QueryRange);
+static std::shared_ptr<DiskCache> diskCache; // Создаётся в main в каталоге кэша пользователя
+static bool useDiskCache = true;
+static std::string cacheSource; // Тип клиента и URL: ключ дискового кэша, у разных API разные точки
 static double leftTimeBound = static_cast<double>(std::time(nullptr)) - DEFAULT_PLOT_TIME_RANGE;
 static double rightTimeBound = static_cast<double>(std::time(nullptr));
 static std::string connectionMessage;
@@ -59,17 +76,153 @@ static std::string requestErrorMsg = "";
 static bool showRequestErrorMsg = false;
 
 static PlotType currentPlotType = PlotType::Line;
+static DownsampleMode currentDownsampleMode = DownsampleMode::Pyramid;
+static int currentDownsampleModeIndex = static_cast<int>(DownsampleMode::Pyramid);
 static YAxisUnit currentYAxisUnit = YAxisUnit::No;
 
-static std::vector<GraphSeries> seriesData;
+static std::vector<Panel> panels;
+static std::uint64_t nextPanelId = 1;
+static int dashboardColumns = DEFAULT_DASHBOARD_COLUMNS;
 static int selectedStep = DEFAULT_STEP;
+static FetchWorker fetchWorker;
+static Profiler profiler;
+static bool showProfiler = false;
+static double cpuSampleTime = 0.0;    // Начало текущего замера загрузки CPU, по glfwGetTime
+static double cpuSampleSeconds = 0.0; // Процессорное время процесса в начале замера
+static double cpuLoad = 0.0;          // Загрузка CPU за прошлый замер, 1 — одно ядро
+static bool renderOnDemand = true;
+static int settleFrames = IDLE_SETTLE_FRAMES; // Сколько кадров ещё рисовать подряд, прежде чем ждать событий
+static double queryEditTime = -1;             // Последняя правка запроса, ещё не отправленная на загрузку; -1 — нет
+
+/**
+ * @brief Подсказки для запроса панели, которую редактируют последней.
+ *
+ * @details Пересчитываются, только когда меняется текст до курсора или обновляется индекс метаданных,
+ *          а не на каждом кадре.
+ */
+struct QueryCompletion
+{
+    std::uint64_t panel = 0;              ///< Панель, для которой посчитаны подсказки
+    std::string text;                     ///< Текст запроса до курсора
+    CompletionContext context;
+    std::vector<std::string> suggestions;
+    bool hovered = false;                 ///< Список под курсором мыши: не скрывать, пока по нему кликают
+};
+
+static QueryCompletion queryCompletion;
+
+/**
+ * @brief Куда писать замеры фаз: nullptr, пока оверлей производительности скрыт.
+ */
+inline Profiler *activeProfiler()
+{
+    return showProfiler ? &profiler : nullptr;
+}
 
 inline bool needRefresh()
 {
     return autoRefresh && glfwGetTime() - lastRefreshTime >= refreshIntervalSec;
 }
 
-void fetchData()
+/**
+ * @brief Сколько ждать событий окна перед следующим кадром.
+ *
+ * @details Без ввода кадр нужен, только когда поток загрузки принёс данные (он будит цикл сам
+ *          через `glfwPostEmptyEvent`) или подошло время автообновления.
+ *
+ * @return Секунды: 0 — рисовать сразу, бесконечность — ждать события
+ */
+double frameWaitTimeout()
+{
+    if (!renderOnDemand || settleFrames > 0)
+        return 0;
+    double timeout = std::numeric_limits<double>::infinity();
+    // Во время загрузки обновление откладывается до её результата, который и так разбудит цикл
+    if (autoRefresh && prometheusClient && !fetchWorker.busy())
+        timeout = std::max(lastRefreshTime + refreshIntervalSec - glfwGetTime(), 0.0);
+    if (ImGui::GetIO().WantTextInput)
+        timeout = std::min(timeout, TEXT_CURSOR_BLINK_PERIOD);
+    if (queryEditTime >= 0)
+        timeout = std::min(timeout, std::max(queryEditTime + QUERY_EDIT_DEBOUNCE - glfwGetTime(), 0.0));
+    if (showProfiler)
+        timeout = std::min(timeout, CPU_LOAD_PERIOD);
+    return timeout;
+}
+
+/**
+ * @brief Идёт ли взаимодействие, при котором кадры рисуются подряд: перетаскивание, движение мыши, ввод.
+ */
+bool userInteracting()
+{
+    const ImGuiIO &io = ImGui::GetIO();
+    if (ImGui::IsAnyMouseDown() || io.MouseDelta.x != 0 || io.MouseDelta.y != 0 || io.MouseWheel != 0 ||
+        io.MouseWheelH != 0 || !io.InputQueueCharacters.empty())
+        return true;
+    for (int key = ImGuiKey_NamedKey_BEGIN; key < ImGuiKey_NamedKey_END; key++)
+    {
+        if (ImGui::IsKeyDown(static_cast<ImGuiKey>(key)))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Добавить на дашборд панель с запросом `query`.
+ */
+void addPanel(const char *query)
+{
+    Panel panel;
+    panel.id = nextPanelId++;
+    std::strncpy(panel.query, query, sizeof(panel.query) - 1);
+    panels.push_back(std::move(panel));
+}
+
+Panel *findPanel(std::uint64_t id)
+{
+    for (auto &panel : panels)
+    {
+        if (panel.id == id)
+            return &panel;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Подогнать ось значений панели под её ряды.
+ *
+ * @details Вызывается перед `ImPlot::BeginPlot` панели, если выставлен `Panel::fitValueAxis`.
+ */
+void fitValueAxis(Panel &panel)
+{
+    panel.fitValueAxis = false;
+    double minY = std::numeric_limits<double>::max();
+    double maxY = std::numeric_limits<double>::lowest();
+    for (const auto &s : panel.plotted())
+    {
+        for (double value : s.data.values)
+        {
+            if (value < minY)
+                minY = value;
+            if (value > maxY)
+                maxY = value;
+        }
+    }
+    if (panel.plotted().empty())
+        return;
+    double yMargin = std::max((maxY - minY) * 0.1, 1.0);
+    ImPlot::SetNextAxisLimits(ImAxis_Y1, minY - yMargin, maxY + yMargin, ImPlotCond_Always);
+}
+
+/**
+ * @brief Поставить в очередь запросы всех панелей за текущий видимый интервал.
+ *
+ * @details Запросы панелей выполняются в `fetchWorker` одним пакетом, результат применяется в `applyFetchResult`.
+ *          При `incremental` для панелей, уже загруженных с тем же запросом и шагом, запрашивается только
+ *          хвост после последней загруженной точки, который затем дописывается к имеющимся рядам.
+ *
+ * @param incremental Разрешить запрос только хвоста (режим автообновления)
+ */
+void fetchData(bool incremental = false)
 {
     showRequestErrorMsg = false;
     if (!prometheusClient)
@@ -79,116 +232,402 @@ void fetchData()
         return;
     }
 
+    // Длинные диапазоны PrometheusClient загружает параллельными частями с полным разрешением,
+    // шаг увеличивается только если ряды перестанут помещаться в память
     double interval = rightTimeBound - leftTimeBound;
     int step = selectedStep;
-    if (selectedStep * PROMETHEUS_MAX_POINTS_PER_REQUEST < interval)
-        step = std::ceil(interval / (double)PROMETHEUS_MAX_POINTS_PER_REQUEST);
+    if ((double)selectedStep * MAX_POINTS_PER_SERIES < interval)
+        step = std::ceil(interval / (double)MAX_POINTS_PER_SERIES);
+
+    // Кэш рассчитан на точки на сетке шага, сырые точки remote read запрашиваются напрямую
+    std::shared_ptr<TSDBClient> client = queryCache ? std::static_pointer_cast<TSDBClient>(queryCache) : requestCoalescer;
+    FetchJob job{client, {}, static_cast<std::time_t>(rightTimeBound), step};
+    job.profiler = activeProfiler();
+    if (useDiskCache)
+    {
+        job.disk_cache = diskCache;
+        job.cache_source = cacheSource;
+        job.raw_points = connectedBackend == PrometheusBackend::RemoteRead;
+    }
 
-    std::vector<Metric> metrics;
-    try
+    for (auto &panel : panels)
     {
-        metrics = prometheusClient->query(queryBuffer, leftTimeBound, rightTimeBound, step);
+        if (panel.query[0] == '\0')
+            continue;
+        PanelQuery query{panel.id, panel.query, static_cast<std::time_t>(leftTimeBound)};
+        // Сохранённые ряды поток загрузки читает сам и отдаёт до ответа TSDB, догружая только промежуток после них
+        query.from_disk_cache = useDiskCache && !panel.isLoaded(step);
+
+        double latest = latestTimestamp(panel.series);
+        if (incremental && panel.isLoaded(step) && latest >= leftTimeBound)
+        {
+            // Prometheus считает точки от start с шагом step, поэтому хвост остаётся на той же сетке.
+            // Сырые точки remote read на сетке не лежат: запрашиваем с последней секунды, повтор отбросит appendNewer
+            query.start = static_cast<std::time_t>(latest) + (connectedBackend == PrometheusBackend::RemoteRead ? 0 : step);
+            query.incremental = true;
+            if (query.start > job.end)
+                continue;
+        }
+        job.panels.push_back(std::move(query));
     }
-    catch (InvalidPrometheusRequest &error)
+
+    if (!job.panels.empty())
+        fetchWorker.submit(std::move(job));
+    lastRefreshTime = glfwGetTime();
+}
+
+/**
+ * @brief Забрать готовые результаты из `fetchWorker` и разложить их по панелям.
+ *
+ * @details Вызывается каждый кадр до отрисовки панелей. Пока результата нет, на графиках остаются старые данные.
+ *          Ошибка запроса одной панели не затрагивает остальные. Ряды из дискового кэша и догруженный к ним
+ *          хвост приходят двумя результатами и применяются по порядку.
+ */
+void applyFetchResult()
+{
+    FetchResult result;
+    while (fetchWorker.poll(result))
     {
-        showRequestErrorMsg = true;
-        requestErrorMsg = error.what();
-        return;
+        for (auto &loaded : result.panels)
+        {
+            // Панель могли удалить, пока шёл запрос
+            Panel *panel = findPanel(loaded.panel);
+            if (!panel)
+                continue;
+            if (!loaded.ok)
+            {
+                panel->error = std::move(loaded.error);
+                continue;
+            }
+
+            panel->error.clear();
+            if (loaded.incremental)
+            {
+                // Одна точка левее границы нужна, чтобы линия доходила до края графика
+                mergeSeriesTail(panel->series, loaded.series, leftTimeBound - result.step);
+            }
+            else
+            {
+                panel->series = std::move(loaded.series);
+            }
+            panel->loadedQuery = std::move(loaded.query);
+            panel->loadedStep = result.step;
+            panel->fitValueAxis = true;
+            panel->aggregationDirty = true;
+        }
     }
+}
 
-    seriesData.clear();
+/**
+ * @brief Непрерывный участок колонок ряда, который передаётся в ImPlot без копирования.
+ */
+struct PlotPoints
+{
+    const double *timestamps = nullptr;
+    const double *values = nullptr;
+    std::size_t count = 0;
+};
 
-    double minY = std::numeric_limits<double>::max();
-    double maxY = std::numeric_limits<double>::lowest();
+/**
+ * @brief Видимый участок ряда: бинарный поиск по упорядоченным меткам плюс по точке за краями графика.
+ */
+PlotPoints visiblePoints(const Series &series, double from, double to)
+{
+    auto [first, last] = visibleRange(series, from, to);
+    if (first >= last)
+        return {};
+    return {series.timestamps.data() + first, series.values.data() + first, last - first};
+}
 
-    for (const auto &m : metrics)
+/**
+ * @brief Получить точки ряда для отрисовки с учётом прореживания.
+ *
+ * @details Без прореживания, а в режиме пирамиды и на масштабе, где корзины нижнего уровня шире пикселя,
+ *          рисуется только видимый участок исходного ряда: стоимость кадра зависит от того, что на экране,
+ *          а не от объёма загруженных данных.
+ *
+ *          Прореженные точки кэшируются в `GraphSeries::view` и пересчитываются только при изменении
+ *          видимого интервала, ширины графика, алгоритма или самих данных. В режиме пирамиды точки берутся
+ *          из `GraphSeries::pyramid` без обхода исходного ряда.
+ *
+ * @param s Ряд
+ * @param from Левая граница графика
+ * @param to Правая граница графика
+ * @param width Ширина графика в пикселях
+ * @return Точки для передачи в ImPlot, действительны до изменения ряда
+ */
+PlotPoints pointsToPlot(GraphSeries &s, double from, double to, int width)
+{
+    int level = -1;
+    if (currentDownsampleMode == DownsampleMode::Pyramid && width > 0)
+        level = s.pyramid.levelFor(from, to, width);
+    if (currentDownsampleMode == DownsampleMode::Off || width <= 0 || (currentDownsampleMode == DownsampleMode::Pyramid && level < 0))
+        return visiblePoints(s.data, from, to);
+
+    SeriesView &view = s.view;
+    int mode = static_cast<int>(currentDownsampleMode);
+    if (!view.valid || view.from != from || view.to != to || view.width != width || view.mode != mode)
     {
-        for (const auto &p : m.values)
+        trace::Span span("downsample");
+        if (currentDownsampleMode == DownsampleMode::M4)
         {
-            if (p.value < minY)
-                minY = p.value;
-            if (p.value > maxY)
-                maxY = p.value;
+            view.points = downsampleM4(s.data, from, to, width);
         }
+        else if (currentDownsampleMode == DownsampleMode::Pyramid)
+        {
+            // Уровень с корзиной не шире пикселя: O(пикселей) вместо O(точек) при любом масштабе
+            view.points = s.pyramid.envelope(level, from, to);
+        }
+        else
+        {
+            auto [first, last] = visibleRange(s.data, from, to);
+            Series visible = first < last ? s.data.slice(s.data.timestamps[first], s.data.timestamps[last - 1]) : Series();
+            view.points = downsampleLTTB(visible, static_cast<std::size_t>(width) * LTTB_POINTS_PER_PIXEL);
+        }
+        view.from = from;
+        view.to = to;
+        view.width = width;
+        view.mode = mode;
+        view.valid = true;
     }
-    double yMargin = std::max((maxY - minY) * 0.1, 1.0);
-    minY -= yMargin;
-    maxY += yMargin;
-    if (metrics.size())
-        ImPlot::SetNextAxisLimits(ImAxis_Y1, minY, maxY, ImPlotCond_Always);
+    return {view.points.timestamps.data(), view.points.values.data(), view.points.size()};
+}
+
+/**
+ * @brief Сколько точек отдавать ImPlot за один вызов.
+ *
+ * @details При 16-битном `ImDrawIdx` вызов ограничен так, чтобы его вершины поместились в одну команду
+ *          отрисовки: отрезок линии занимает 4 вершины, маркер-окружность до 40, столбец с контуром 12.
+ *          При 32-битных индексах ряд отдаётся целиком.
+ */
+std::size_t plotBatchPoints(PlotType type)
+{
+    if (sizeof(ImDrawIdx) > 2)
+        return static_cast<std::size_t>(std::numeric_limits<int>::max());
+    std::size_t vertices = type == PlotType::Line ? 4 : type == PlotType::Scatter ? 40 : 12;
+    return (std::size_t(1) << 16) / vertices;
+}
 
-    for (auto &m : metrics)
+/**
+ * @brief Нарисовать ряд, при необходимости несколькими вызовами ImPlot.
+ *
+ * @details Вызовы с одной подписью ImPlot считает одним элементом: легенда и цвет общие. Соседние части линии
+ *          делят граничную точку, чтобы между ними не было разрыва.
+ */
+void plotSeries(const char *name, const PlotPoints &points)
+{
+    std::size_t batch = plotBatchPoints(currentPlotType);
+    std::size_t overlap = currentPlotType == PlotType::Line ? 1 : 0;
+    for (std::size_t offset = 0; offset < points.count;)
     {
-        GraphSeries s;
-        s.name = prometheusClient->format_line_name(m);
-        for (auto &p : m.values)
+        std::size_t count = std::min(batch, points.count - offset);
+        const double *xs = points.timestamps + offset;
+        const double *ys = points.values + offset;
+        if (currentPlotType == PlotType::Line)
+        {
+            ImPlot::PlotLine(name, xs, ys, static_cast<int>(count));
+        }
+        else if (currentPlotType == PlotType::Scatter)
+        {
+            ImPlot::PlotScatter(name, xs, ys, static_cast<int>(count));
+        }
+        else if (currentPlotType == PlotType::Bar)
         {
-            s.x.push_back(static_cast<double>(p.timestamp));
-            s.y.push_back(p.value);
+            double barWidth = 0.5;
+            ImPlot::PlotBars(name, xs, ys, static_cast<int>(count), barWidth);
         }
-        seriesData.push_back(s);
+        if (offset + count == points.count)
+            break;
+        offset += count - overlap;
     }
-    lastRefreshTime = glfwGetTime();
+}
+
+/**
+ * @brief Нарисовать график одной панели.
+ *
+ * @details Ось времени у панелей общая: после отрисовки видимый интервал графика становится
+ *          интервалом дашборда.
+ *
+ * @param panel Панель
+ * @param size Размер графика
+ * @param refresh Сдвинуть интервал к текущему времени
+ * @return Число переданных в ImPlot точек
+ */
+std::size_t renderPanel(Panel &panel, ImVec2 size, bool refresh)
+{
+    if (updateAggregation(panel))
+        panel.fitValueAxis = true;
+    if (panel.fitValueAxis)
+        fitValueAxis(panel);
+
+    std::string title = std::string(panel.query) + "##Panel" + std::to_string(panel.id);
+    ImPlotFlags flags = panels.size() == 1 ? ImPlotFlags_NoTitle : ImPlotFlags_None;
+    trace::Span span("plot");
+    if (!ImPlot::BeginPlot(title.c_str(), size, flags))
+        return 0;
+
+    ImPlot::SetupAxisLimits(ImAxis_Y1, DEFAULT_MIN_Y, DEFAULT_MAX_Y);
+    ImPlot::SetupAxisLimits(ImAxis_X1, leftTimeBound, rightTimeBound, refresh ? ImPlotCond_Always : ImPlotCond_Once);
+    ImPlot::SetupAxes(Strings::AXIS_TIME, Strings::AXIS_VALUE);
+    ImPlot::SetupAxisLimitsConstraints(ImAxis_X1, 0.0, HUGE_VAL);
+    ImPlot::SetupAxisScale(ImAxis_X1, ImPlotScale_Time);
+    ImPlot::GetStyle().UseLocalTime = true;
+    ImPlot::SetupAxisFormat(ImAxis_Y1, valueTickFormatter, &currentYAxisUnit);
+    ImPlot::SetupAxisZoomConstraints(ImAxis_X1, MIN_X_ZOOM, MAX_X_ZOOM);
+    ImPlot::SetupAxisZoomConstraints(ImAxis_Y1, MIN_Y_ZOOM, MAX_Y_ZOOM);
+
+    // Обновляем границы времени при изменении масштаба в графике
+    ImPlotRange range = ImPlot::GetPlotLimits().X;
+    leftTimeBound = range.Min;
+    if (range.Max != rightTimeBound)
+        autoRefresh = false;
+    rightTimeBound = range.Max;
+
+    int plotWidth = static_cast<int>(ImPlot::GetPlotSize().x);
+    std::size_t drawn = 0;
+    for (auto &s : panel.plotted())
+    {
+        PlotPoints points = pointsToPlot(s, range.Min, range.Max, plotWidth);
+        drawn += points.count;
+        plotSeries(s.name.c_str(), points);
+    }
+
+    if (!panel.error.empty())
+    {
+        ImPlotRect limits = ImPlot::GetPlotLimits();
+        ImPlot::PlotText(panel.error.c_str(), limits.X.Min, limits.Y.Max, ImVec2(0, 0), ImPlotTextFlags_None);
+    }
+    ImPlot::EndPlot();
+    return drawn;
 }
 
 void renderMetricsViewer()
 {
     ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
     ImGui::SetNextWindowSize(ImVec2(WINDOW_WIDTH - SETTINGS_WIDTH, WINDOW_HEIGHT), ImGuiCond_Always);
-    ImGui::Begin("Metrics Viewer", nullptr, ImGuiWindowFlags_NoDecoration);
+    ImGui::Begin(Strings::WINDOW_METRICS_VIEWER, nullptr, ImGuiWindowFlags_NoDecoration);
+
+    applyFetchResult();
+
+    bool refresh = needRefresh();
+    if (refresh)
+    {
+        double interval = rightTimeBound - leftTimeBound;
+        std::time_t now = std::time(nullptr);
+        leftTimeBound = now - interval;
+        rightTimeBound = now;
+    }
 
-    ImVec2 plotSize = ImVec2(ImGui::GetContentRegionAvail().x, ImGui::GetContentRegionAvail().y);
-    if (ImPlot::BeginPlot("Time Series", plotSize, ImPlotFlags_NoTitle))
+    Profiler::Scope drawScope(activeProfiler(), ProfilePhase::Draw);
+    ImVec2 available = ImGui::GetContentRegionAvail();
+    if (panels.size() == 1)
+    {
+        drawScope.addPoints(renderPanel(panels.front(), available, refresh));
+    }
+    else if (!panels.empty())
     {
-        ImPlot::SetupAxisLimits(ImAxis_Y1, DEFAULT_MIN_Y, DEFAULT_MAX_Y);
-        ImPlot::SetupAxisLimits(ImAxis_X1, leftTimeBound, rightTimeBound);
-        if (needRefresh())
+        // Сетка панелей со связанной осью времени: масштаб и сдвиг одной панели применяются ко всем
+        int count = static_cast<int>(panels.size());
+        int columns = std::clamp(dashboardColumns, 1, count);
+        int rows = (count + columns - 1) / columns;
+        ImVec2 size(available.x, std::max(available.y, rows * PANEL_MIN_HEIGHT));
+        if (ImPlot::BeginSubplots("##Dashboard", rows, columns, size, ImPlotSubplotFlags_NoTitle | ImPlotSubplotFlags_LinkAllX))
         {
-            double interval = rightTimeBound - leftTimeBound;
-            std::time_t now = std::time(nullptr);
-            ImPlot::SetupAxisLimits(ImAxis_X1, now - interval, now, ImPlotCond_Always);
-            leftTimeBound = now - interval;
-            rightTimeBound = now;
+            for (auto &panel : panels)
+                drawScope.addPoints(renderPanel(panel, ImVec2(-1, 0), refresh));
+            ImPlot::EndSubplots();
         }
-        ImPlot::SetupAxes("Time", "Value");
-        ImPlot::SetupAxisLimitsConstraints(ImAxis_X1, 0.0, HUGE_VAL);
-        ImPlot::SetupAxisScale(ImAxis_X1, ImPlotScale_Time);
-        ImPlot::GetStyle().UseLocalTime = true;
-        ImPlot::SetupAxisFormat(ImAxis_Y1, valueTickFormatter, &currentYAxisUnit);
-        ImPlot::SetupAxisZoomConstraints(ImAxis_X1, MIN_X_ZOOM, MAX_X_ZOOM);
-        ImPlot::SetupAxisZoomConstraints(ImAxis_Y1, MIN_Y_ZOOM, MAX_Y_ZOOM);
-
-        // Обновляем границы времени при изменении масштаба в графике
-        ImPlotRange range = ImPlot::GetPlotLimits().X;
-        leftTimeBound = range.Min;
-        if (range.Max != rightTimeBound)
-            autoRefresh = false;
-        rightTimeBound = range.Max;
-
-        for (auto &s : seriesData)
+    }
+
+    // Пока идёт предыдущий запрос, новый не отправляем: хвост считается от уже загруженных данных
+    if (needRefresh() && !fetchWorker.busy())
+        fetchData(true);
+    // Локально вычисляемый запрос обновляется, когда ввод затих, без нажатия Fetch Data
+    if (queryEditTime >= 0 && glfwGetTime() - queryEditTime >= QUERY_EDIT_DEBOUNCE && !fetchWorker.busy())
+    {
+        queryEditTime = -1;
+        fetchData();
+    }
+    ImGui::End();
+}
+
+/**
+ * @brief Обработчик поля запроса: пересчёт подсказок при вводе и подстановка первой по Tab.
+ */
+int queryInputCallback(ImGuiInputTextCallbackData *data)
+{
+    const Panel &panel = *static_cast<const Panel *>(data->UserData);
+    QueryCompletion &completion = queryCompletion;
+    if (data->EventFlag == ImGuiInputTextFlags_CallbackCompletion)
+    {
+        if (completion.panel == panel.id && !completion.suggestions.empty())
         {
-            if (s.x.empty())
-                continue;
-            if (currentPlotType == PlotType::Line)
-            {
-                ImPlot::PlotLine(s.name.c_str(), s.x.data(), s.y.data(), s.x.size());
-            }
-            else if (currentPlotType == PlotType::Scatter)
-            {
-                ImPlot::PlotScatter(s.name.c_str(), s.x.data(), s.y.data(), s.x.size());
-            }
-            else if (currentPlotType == PlotType::Bar)
-            {
-                double barWidth = 0.5;
-                ImPlot::PlotBars(s.name.c_str(), s.x.data(), s.y.data(), s.x.size(), barWidth);
-            }
+            int start = static_cast<int>(completion.context.start);
+            data->DeleteChars(start, data->CursorPos - start);
+            data->InsertChars(data->CursorPos, completion.suggestions.front().c_str());
         }
+        return 0;
+    }
 
-        ImPlot::EndPlot();
-        if (needRefresh())
-            fetchData();
+    std::string_view text(data->Buf, static_cast<std::size_t>(data->CursorPos));
+    if (completion.panel == panel.id && completion.text == text && !metadataUpdated.exchange(false))
+        return 0;
+    completion.panel = panel.id;
+    completion.text = text;
+    completion.context = completionContext(text);
+    completion.suggestions = metadataIndex ? metadataIndex->suggest(completion.context, MAX_QUERY_SUGGESTIONS) : std::vector<std::string>{};
+    return 0;
+}
+
+/**
+ * @brief Список подсказок под полем запроса; клик подставляет подсказку вместо введённого слова.
+ *
+ * @return true, если запрос изменён
+ */
+bool renderQuerySuggestions(Panel &panel)
+{
+    QueryCompletion &completion = queryCompletion;
+    bool hovered = false, applied = false;
+    for (const auto &suggestion : completion.suggestions)
+    {
+        if (ImGui::Selectable(suggestion.c_str()))
+        {
+            std::string query = completion.text.substr(0, completion.context.start) + suggestion +
+                                std::string(panel.query + std::min(completion.text.size(), std::strlen(panel.query)));
+            std::strncpy(panel.query, query.c_str(), sizeof(panel.query) - 1);
+            applied = true;
+        }
+        hovered |= ImGui::IsItemHovered();
     }
-    ImGui::End();
+    completion.hovered = hovered && !applied;
+    if (applied)
+        completion = QueryCompletion{};
+    return applied;
+}
+
+/**
+ * @brief Настройки агрегации панели: агрегат считается по уже загруженным рядам без нового запроса.
+ */
+void renderAggregationSettings(Panel &panel)
+{
+    bool changed = false;
+    ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6);
+    changed |= ImGui::Combo(Strings::LABEL_AGGREGATION, &panel.aggregation, AGGREGATION_LABELS, IM_ARRAYSIZE(AGGREGATION_LABELS));
+    if (panel.aggregation > 0)
+    {
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+        changed |= ImGui::InputTextWithHint("##GroupBy", Strings::LABEL_GROUP_BY, panel.groupBy, IM_ARRAYSIZE(panel.groupBy));
+        ImGui::SameLine();
+        changed |= ImGui::Checkbox(Strings::LABEL_GROUP_WITHOUT, &panel.groupWithout);
+        if (static_cast<Aggregation>(panel.aggregation - 1) == Aggregation::Quantile)
+        {
+            ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+            changed |= ImGui::SliderFloat(Strings::LABEL_QUANTILE, &panel.quantile, 0.0f, 1.0f, "%.2f");
+        }
+    }
+    if (changed)
+        panel.aggregationDirty = true;
 }
 
 void renderSettings()
@@ -201,13 +640,50 @@ void renderSettings()
     {
         ImGui::Text(Strings::LABEL_PROMETHEUS_URL);
         ImGui::InputText("##BaseURL", urlBuffer, IM_ARRAYSIZE(urlBuffer));
+        ImGui::Text(Strings::LABEL_BACKEND);
+        ImGui::Combo("##Backend", &currentBackendIndex, PROMETHEUS_BACKEND_LABELS, IM_ARRAYSIZE(PROMETHEUS_BACKEND_LABELS));
 
         if (ImGui::Button(Strings::BUTTON_CONNECT))
         {
-            prometheusClient = std::make_unique<PrometheusClient>(urlBuffer);
+            connectedBackend = (PrometheusBackend)currentBackendIndex;
+            cacheSource = std::string(PROMETHEUS_BACKEND_LABELS[currentBackendIndex]) + " " + urlBuffer;
+            for (auto &panel : panels)
+                panel.loadedQuery.clear(); // Данные другого источника не дополняются хвостом
+            localPromQL.reset();
+            if (connectedBackend == PrometheusBackend::RemoteRead)
+            {
+                prometheusClient = std::make_shared<PrometheusRemoteReadClient>(urlBuffer);
+            }
+            else
+            {
+                auto client = std::make_shared<PrometheusClient>(urlBuffer);
+                client->setStreamingResponses(true);
+                prometheusClient = client;
+                // Выражения из подмножества считаются по сырым точкам, остальные уходят в query_range
+                if (connectedBackend == PrometheusBackend::LocalPromQL)
+                {
+                    localPromQL = std::make_shared<LocalPromQLClient>(std::make_shared<PrometheusRemoteReadClient>(urlBuffer), client,
+                                                                      RAW_SERIES_MEMORY_LIMIT);
+                    prometheusClient = localPromQL;
+                }
+            }
+            // Автообновление и ручная загрузка одних и тех же панелей не дублируют запросы к Prometheus
+            requestCoalescer = std::make_shared<CoalescingTSDBClient>(prometheusClient);
+            queryCache.reset();
+            if (connectedBackend != PrometheusBackend::RemoteRead)
+                queryCache = std::make_shared<CachingTSDBClient>(requestCoalescer, QUERY_CACHE_MEMORY_LIMIT);
+            queryCompletion = QueryCompletion{};
+            metadataIndex = std::make_shared<MetadataIndex>(prometheusClient);
+            metadataIndex->setUpdateCallback([] {
+                metadataUpdated = true;
+                glfwPostEmptyEvent();
+            });
+            metadataIndex->start(METADATA_REFRESH_INTERVAL, METADATA_FULL_REFRESH_INTERVAL);
             if (prometheusClient->isAvailable())
             {
                 connectionMessage = Strings::MESSAGE_CONNECTION_SUCCESS;
+                if (useDiskCache)
+                    fetchData(); // Показать сохранённые ряды и догрузить только то, чего нет на диске
             }
             else
             {
@@ -219,6 +695,8 @@ void renderSettings()
         if (showConnectionMessage)
         {
             ImGui::TextWrapped("%s", connectionMessage.c_str());
+            if (!TSDBClient::compressionSupported())
+                ImGui::TextWrapped("%s", Strings::MESSAGE_NO_COMPRESSION);
         }
         ImGui::TreePop();
     }
@@ -227,16 +705,68 @@ void renderSettings()
     if (ImGui::TreeNodeEx(Strings::NODE_QUERY, ImGuiTreeNodeFlags_DefaultOpen))
     {
         ImGui::Text(Strings::LABEL_QUERY);
-        ImGui::InputTextMultiline("##QueryStr", queryBuffer, IM_ARRAYSIZE(queryBuffer), ImVec2(0, ImGui::GetTextLineHeight() * 5));
+        std::uint64_t removedPanel = 0;
+        for (std::size_t i = 0; i < panels.size(); i++)
+        {
+            Panel &panel = panels[i];
+            ImGui::PushID(static_cast<int>(panel.id));
+            ImGui::Text(Strings::LABEL_PANEL, static_cast<int>(i + 1));
+            if (panels.size() > 1)
+            {
+                ImGui::SameLine();
+                if (ImGui::SmallButton(Strings::BUTTON_REMOVE_PANEL))
+                    removedPanel = panel.id;
+            }
+            bool edited = ImGui::InputTextMultiline("##QueryStr", panel.query, IM_ARRAYSIZE(panel.query),
+                                                    ImVec2(0, ImGui::GetTextLineHeight() * 3),
+                                                    ImGuiInputTextFlags_CallbackAlways | ImGuiInputTextFlags_CallbackCompletion,
+                                                    queryInputCallback, &panel);
+            // Список не скрывается, пока по нему кликают: поле при этом уже теряет фокус
+            if ((ImGui::IsItemActive() || queryCompletion.hovered) && queryCompletion.panel == panel.id)
+                edited |= renderQuerySuggestions(panel);
+            if (edited && localPromQL)
+                queryEditTime = glfwGetTime();
+            renderAggregationSettings(panel);
+            if (!panel.error.empty())
+                ImGui::TextWrapped("%s", panel.error.c_str());
+            ImGui::PopID();
+        }
+        if (removedPanel)
+            panels.erase(std::remove_if(panels.begin(), panels.end(), [&](const Panel &p) { return p.id == removedPanel; }), panels.end());
+
+        if (panels.size() < static_cast<std::size_t>(MAX_PANELS) && ImGui::Button(Strings::BUTTON_ADD_PANEL))
+            addPanel("");
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6);
+        if (ImGui::InputInt(Strings::LABEL_COLUMNS, &dashboardColumns))
+            dashboardColumns = std::clamp(dashboardColumns, 1, 4);
 
         if (ImGui::Button(Strings::BUTTON_FETCH_DATA))
         {
             fetchData();
         }
+        ImGui::SameLine();
+        ImGui::Checkbox(Strings::LABEL_DISK_CACHE, &useDiskCache);
         if (showRequestErrorMsg)
         {
             ImGui::TextWrapped("%s", requestErrorMsg.c_str());
         }
+        if (queryCache)
+        {
+            CachingTSDBClient::Stats stats = queryCache->getStats();
+            ImGui::TextDisabled(Strings::LABEL_CACHE_STATS, stats.hits, stats.partial_hits, stats.misses, stats.memory_bytes / double(1 << 20));
+        }
+        if (requestCoalescer)
+        {
+            CoalescingTSDBClient::Stats stats = requestCoalescer->getStats();
+            ImGui::TextDisabled(Strings::LABEL_COALESCING_STATS, stats.requests, stats.coalesced);
+        }
+        if (localPromQL)
+        {
+            LocalPromQLClient::Stats stats = localPromQL->getStats();
+            ImGui::TextDisabled(Strings::LABEL_LOCAL_PROMQL_STATS, stats.local_queries, stats.fallback_queries,
+                                stats.memory_bytes / double(1 << 20));
+        }
         ImGui::TreePop();
     }
 
@@ -248,6 +778,11 @@ void renderSettings()
         {
             currentYAxisUnit = (YAxisUnit)currentYAxisUnitIndex;
         }
+        ImGui::Text(Strings::LABEL_DOWNSAMPLING);
+        if (ImGui::Combo("##Downsampling", &currentDownsampleModeIndex, DOWNSAMPLE_MODE_LABELS, IM_ARRAYSIZE(DOWNSAMPLE_MODE_LABELS)))
+        {
+            currentDownsampleMode = (DownsampleMode)currentDownsampleModeIndex;
+        }
         ImGui::Text(Strings::LABEL_PLOT_TYPE);
         if (ImGui::RadioButton(Strings::RADIO_BUTTON_LINE, currentPlotType == PlotType::Line))
         {
@@ -291,13 +826,96 @@ void renderSettings()
         ImGui::SameLine();
         ImGui::Text("sec");
         ImGui::PopItemWidth();
-        if (needRefresh())
+        if (fetchWorker.busy())
         {
             ImGui::Text("updating...");
         }
         ImGui::TreePop();
     }
 
+    ImGui::Separator();
+    ImGui::Checkbox(Strings::LABEL_RENDER_ON_DEMAND, &renderOnDemand);
+    ImGui::Checkbox(Strings::LABEL_PROFILER, &showProfiler);
+    bool recording = trace::enabled();
+    if (ImGui::Checkbox(Strings::LABEL_TRACE, &recording))
+    {
+        if (recording)
+            trace::start();
+        else
+            trace::stop();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button(Strings::BUTTON_SAVE_TRACE))
+        trace::write(TRACE_FILE);
+
+    ImGui::End();
+}
+
+/**
+ * @brief Оверлей производительности: задержки, объёмы и аллокации по фазам загрузки и отрисовки.
+ *
+ * @details Квантили оцениваются по корзинам гистограммы, см. `LatencyHistogram`.
+ */
+void renderProfiler()
+{
+    ImGui::SetNextWindowPos(ImVec2(WINDOW_WIDTH - SETTINGS_WIDTH - PROFILER_WIDTH, 0), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(PROFILER_WIDTH, 0), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    if (!ImGui::Begin(Strings::WINDOW_PROFILER, &showProfiler, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        ImGui::End();
+        return;
+    }
+
+    // При отрисовке по требованию оверлей перерисовывается раз в CPU_LOAD_PERIOD, и замер включает этот кадр
+    double now = glfwGetTime();
+    if (now - cpuSampleTime >= CPU_LOAD_PERIOD)
+    {
+        double cpuSeconds = Profiler::processCpuSeconds();
+        cpuLoad = (cpuSeconds - cpuSampleSeconds) / (now - cpuSampleTime);
+        cpuSampleTime = now;
+        cpuSampleSeconds = cpuSeconds;
+    }
+
+    ImGui::Text(Strings::LABEL_FRAME_RATE, ImGui::GetIO().Framerate);
+    ImGui::SameLine();
+    ImGui::Text(Strings::LABEL_CPU_LOAD, cpuLoad * 100);
+    ImGui::SameLine();
+    if (ImGui::SmallButton(Strings::BUTTON_RESET))
+        profiler.reset();
+
+    const char *columns[] = {"Phase", "Count", "p50, ms", "p95, ms", "p99, ms", "Max, ms", "Allocs/op", "KiB", "Points"};
+    if (ImGui::BeginTable("##Phases", IM_ARRAYSIZE(columns), ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+    {
+        for (const char *column : columns)
+            ImGui::TableSetupColumn(column);
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < static_cast<int>(ProfilePhase::Count); i++)
+        {
+            auto phase = static_cast<ProfilePhase>(i);
+            const Profiler::PhaseStats &stats = profiler.stats(phase);
+            std::uint64_t count = stats.latency.count();
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(Profiler::phaseName(phase));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(count));
+            for (double q : {0.5, 0.95, 0.99})
+            {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", stats.latency.quantileSeconds(q) * 1e3);
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", stats.latency.maxSeconds() * 1e3);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", count ? static_cast<double>(stats.allocations.load()) / count : 0.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", stats.bytes.load() / 1024.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(stats.points.load()));
+        }
+        ImGui::EndTable();
+    }
     ImGui::End();
 }
 
@@ -305,12 +923,15 @@ void renderUI()
 {
     renderMetricsViewer();
     renderSettings();
+    if (showProfiler)
+        renderProfiler();
 }
 
 int main(int, char **)
 {
     std::strncpy(urlBuffer, DEFAULT_PROMETHEUS_URL, sizeof(urlBuffer));
-    std::strncpy(queryBuffer, DEFAULT_QUERY, sizeof(queryBuffer));
+    addPanel(DEFAULT_QUERY);
+    diskCache = std::make_shared<DiskCache>(userCacheDirectory(DISK_CACHE_DIRECTORY), DISK_CACHE_RETENTION);
 
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
@@ -338,23 +959,54 @@ int main(int, char **)
 
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init(GLSL_VERSION);
+    trace::setThreadName("main");
+    fetchWorker.setReadyCallback([] { glfwPostEmptyEvent(); });
 
     while (!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-        renderUI();
-
-        ImGui::Render();
-        glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            trace::Span span("wait events");
+            double timeout = frameWaitTimeout();
+            if (timeout <= 0)
+                glfwPollEvents();
+            else if (std::isinf(timeout))
+                glfwWaitEvents();
+            else
+                glfwWaitEventsTimeout(timeout);
+            // Проснулись от события, данных или таймера: ImGui нужно несколько кадров, чтобы применить ввод
+            if (timeout > 0)
+                settleFrames = IDLE_SETTLE_FRAMES;
+        }
+        {
+            // Кадр без ожидания vsync в glfwSwapBuffers
+            Profiler::Scope frameScope(activeProfiler(), ProfilePhase::Frame);
+            trace::Span span("frame");
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+
+            renderUI();
+
+            ImGui::Render();
+            glClear(GL_COLOR_BUFFER_BIT);
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            settleFrames = userInteracting() ? IDLE_SETTLE_FRAMES : settleFrames - 1;
+        }
 
-        glfwSwapBuffers(window);
+        {
+            trace::Span span("swap");
+            glfwSwapBuffers(window);
+        }
     }
 
+    fetchWorker.stop();
+    metadataIndex.reset();
+    // Запись, не сохранённая вручную, не теряется при выходе
+    if (trace::enabled())
+        trace::write(TRACE_FILE);
+    queryCache.reset();
+    requestCoalescer.reset();
+    localPromQL.reset();
     prometheusClient.reset();
     ImPlot::DestroyContext();
     ImGui::DestroyContext();
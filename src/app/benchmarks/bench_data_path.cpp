@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "../constants.h"
+#include "../fetcher.h"
+#include "../utils.h"
+
+/**
+ * Метрики в том виде, в каком их возвращает клиент TSDB: `series` рядов по `points` точек, по 4 метки.
+ */
+static std::vector<Metric> makeMetrics(int series, int points)
+{
+    std::vector<Metric> metrics(series);
+    for (int s = 0; s < series; s++)
+    {
+        metrics[s].name = "node_cpu_seconds_total";
+        metrics[s].labels = LabelSet{{"cpu", std::to_string(s % 16)}, {"instance", "host-" + std::to_string(s) + ":9100"}, {"job", "node"}, {"mode", "user"}};
+        metrics[s].series.reserve(points);
+        for (int p = 0; p < points; p++)
+            metrics[s].series.push_back(1700000000.0 + p * 15, p * 0.25);
+    }
+    return metrics;
+}
+
+int main(int argc, char **argv)
+{
+    benchmark::Options options = benchmark::parseOptions(argc, argv);
+
+    // Преобразование ответа клиента в ряды графика (выполняется в FetchWorker после каждого запроса)
+    benchmark::Suite convert("toGraphSeries", options);
+    const std::pair<int, int> shapes[] = {{1, 1}, {10, 1000}, {100, 1000}, {100, 11000}};
+    for (auto [series, points] : shapes)
+    {
+        std::string shape = std::to_string(series) + "x" + std::to_string(points);
+        if (!convert.enabled(shape))
+            continue;
+        std::vector<Metric> source = makeMetrics(series, points);
+        std::vector<Metric> metrics;
+        // toGraphSeries забирает точки из входа, поэтому вход копируется на каждой итерации.
+        // Время копирования замеряется отдельно, чтобы его можно было вычесть
+        convert.run("copy input " + shape, static_cast<std::size_t>(series) * points, [&] { metrics = source; });
+        convert.run(shape, static_cast<std::size_t>(series) * points, [&] {
+            metrics = source;
+            benchmark::doNotOptimize(toGraphSeries(metrics, 15));
+        });
+    }
+    convert.print();
+
+    // Подписи оси значений: ImPlot вызывает форматтер для каждого тика каждый кадр
+    benchmark::Suite ticks("valueTickFormatter", options);
+    const std::pair<YAxisUnit, const char *> units[] = {
+        {YAxisUnit::No, "count"}, {YAxisUnit::Seconds, "seconds"}, {YAxisUnit::Bytes, "bytes"}, {YAxisUnit::Percents, "percent"}};
+    std::vector<double> values;
+    for (int i = 0; i < 1000; i++)
+        values.push_back((i - 500) * 12345.678);
+    for (auto [unit, unit_name] : units)
+    {
+        YAxisUnit current = unit;
+        ticks.run(unit_name, values.size(), [&] {
+            char buffer[32];
+            for (double value : values)
+            {
+                valueTickFormatter(value, buffer, sizeof(buffer), &current);
+                benchmark::doNotOptimize(buffer);
+            }
+        });
+    }
+    ticks.print();
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "imgui.h"
+#include "implot.h"
+
+#include "benchmark.h"
+#include "../../lib/tsdb/downsample.h"
+#include "../../lib/tsdb/pyramid.h"
+
+const float PLOT_WIDTH = 900, PLOT_HEIGHT = 600;
+const double START = 1700000000, STEP = 15;
+
+/// Способ подготовки точек перед отрисовкой.
+enum class Mode
+{
+    Raw,      ///< Все точки, как было до прореживания
+    Culled,   ///< Видимый участок исходного ряда, найденный бинарным поиском
+    M4,       ///< M4, пересчёт на каждом кадре (масштаб меняется постоянно)
+    M4Cached, ///< M4, пересчёт только при смене масштаба
+    LTTB,     ///< LTTB, пересчёт на каждом кадре
+    Pyramid   ///< Огибающая из пирамиды агрегатов, пересчёт на каждом кадре
+};
+
+/**
+ * Синтетические ряды: шум, синусоида и редкие выбросы, которые прореживание обязано сохранить.
+ */
+static std::vector<Series> makeSeries(int count, int points)
+{
+    std::vector<Series> result(count);
+    unsigned state = 12345;
+    for (int s = 0; s < count; s++)
+    {
+        result[s].reserve(points);
+        for (int p = 0; p < points; p++)
+        {
+            state = state * 1103515245u + 12345u;
+            double noise = static_cast<double>((state >> 16) & 0x7FFF) / 0x7FFF;
+            double spike = p % 997 == 0 ? 50 : 0;
+            result[s].push_back(START + p * STEP, 100 + s + 10 * std::sin(p / 200.0) + noise + spike);
+        }
+    }
+    return result;
+}
+
+/**
+ * Один кадр ImGui без бэкенда: вершины строятся полностью, не хватает только отправки на GPU.
+ */
+static void renderFrame(const std::vector<Series> &series, const std::vector<SeriesPyramid> &pyramids, std::vector<Series> &views, Mode mode,
+                        double from, double to)
+{
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(0, 0));
+    ImGui::SetNextWindowSize(ImVec2(PLOT_WIDTH, PLOT_HEIGHT));
+    ImGui::Begin("bench", nullptr, ImGuiWindowFlags_NoDecoration);
+    if (ImPlot::BeginPlot("##plot", ImVec2(-1, -1), ImPlotFlags_NoLegend))
+    {
+        ImPlot::SetupAxisLimits(ImAxis_X1, from, to, ImPlotCond_Always);
+        ImPlot::SetupAxisLimits(ImAxis_Y1, 90, 200, ImPlotCond_Always);
+        int width = static_cast<int>(ImPlot::GetPlotSize().x);
+        for (std::size_t i = 0; i < series.size(); i++)
+        {
+            const Series *points = &series[i];
+            std::string name = "series " + std::to_string(i);
+            if (mode == Mode::Culled)
+            {
+                auto [first, last] = visibleRange(series[i], from, to);
+                if (first < last)
+                    ImPlot::PlotLine(name.c_str(), points->timestamps.data() + first, points->values.data() + first,
+                                     static_cast<int>(last - first));
+                continue;
+            }
+            if (mode == Mode::M4 || (mode == Mode::M4Cached && views[i].empty()))
+            {
+                views[i] = downsampleM4(series[i], from, to, width);
+                points = &views[i];
+            }
+            else if (mode == Mode::M4Cached)
+            {
+                points = &views[i];
+            }
+            else if (mode == Mode::Pyramid)
+            {
+                int level = pyramids[i].levelFor(from, to, width);
+                if (level >= 0)
+                {
+                    views[i] = pyramids[i].envelope(level, from, to);
+                    points = &views[i];
+                }
+            }
+            else if (mode == Mode::LTTB)
+            {
+                views[i] = downsampleLTTB(series[i], static_cast<std::size_t>(width) * 2);
+                points = &views[i];
+            }
+            ImPlot::PlotLine(name.c_str(), points->timestamps.data(), points->values.data(), static_cast<int>(points->size()));
+        }
+        ImPlot::EndPlot();
+    }
+    ImGui::End();
+    ImGui::Render();
+}
+
+int main(int argc, char **argv)
+{
+    ImGui::CreateContext();
+    ImPlot::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(PLOT_WIDTH, PLOT_HEIGHT);
+    io.DeltaTime = 1.0f / 60;
+    io.IniFilename = nullptr;
+    unsigned char *pixels;
+    int tex_width, tex_height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &tex_width, &tex_height);
+
+    benchmark::Suite suite("frame", benchmark::parseOptions(argc, argv));
+    const std::pair<int, int> shapes[] = {{1, 11000}, {10, 11000}, {50, 11000}};
+    const std::pair<Mode, const char *> modes[] = {
+        {Mode::Raw, "raw"}, {Mode::Culled, "culled"}, {Mode::M4, "m4"}, {Mode::M4Cached, "m4 cached"}, {Mode::LTTB, "lttb"}, {Mode::Pyramid, "pyramid"}};
+    for (auto [count, points] : shapes)
+    {
+        std::vector<Series> series = makeSeries(count, points);
+        std::vector<SeriesPyramid> pyramids(series.size());
+        for (std::size_t i = 0; i < series.size(); i++)
+            pyramids[i].build(series[i], STEP * 4);
+        double from = START, to = START + (points - 1) * STEP;
+        std::string shape = std::to_string(count) + "x" + std::to_string(points);
+        for (auto [mode, mode_name] : modes)
+        {
+            std::vector<Series> views(series.size());
+            std::string case_name = std::string(mode_name) + " " + shape;
+            // items = 1: в колонке items/s получается число кадров в секунду
+            if (!suite.run(case_name, 1, [&] { renderFrame(series, pyramids, views, mode, from, to); }))
+                continue;
+            std::printf("%-20s %d vertices per frame\n", case_name.c_str(), ImGui::GetDrawData()->TotalVtxCount);
+        }
+    }
+
+    // Пять минут в конце недельного ряда: без отсечения ImPlot обходит все точки ради пары десятков видимых
+    const int WEEK_POINTS = 7 * 24 * 3600 / static_cast<int>(STEP);
+    std::vector<Series> week = makeSeries(10, WEEK_POINTS);
+    std::vector<SeriesPyramid> week_pyramids(week.size());
+    double to = START + (WEEK_POINTS - 1) * STEP, from = to - 300;
+    for (Mode mode : {Mode::Raw, Mode::Culled})
+    {
+        std::vector<Series> views(week.size());
+        std::string case_name = std::string(mode == Mode::Raw ? "raw" : "culled") + " 10x" + std::to_string(WEEK_POINTS) + " 5m";
+        if (!suite.run(case_name, 1, [&] { renderFrame(week, week_pyramids, views, mode, from, to); }))
+            continue;
+        std::printf("%-20s %d vertices per frame\n", case_name.c_str(), ImGui::GetDrawData()->TotalVtxCount);
+    }
+    suite.print();
+
+    ImPlot::DestroyContext();
+    ImGui::DestroyContext();
+    return 0;
+}
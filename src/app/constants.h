@@ -21,10 +21,14 @@
 #ifndef APP_CONSTANTS_H
 #define APP_CONSTANTS_H
 
+#include <cstddef>
+#include <ctime>
+
 // Оконные параметры
 constexpr int WINDOW_WIDTH = 1280;
 constexpr int WINDOW_HEIGHT = 720;
 constexpr int SETTINGS_WIDTH = 400;
+constexpr int PROFILER_WIDTH = 520; // Оверлей производительности слева от настроек
 
 // OpenGL параметры
 constexpr const char *GLSL_VERSION = "#version 410";
@@ -42,7 +46,27 @@ constexpr double MIN_Y_ZOOM = 1e-6, MAX_Y_ZOOM = 1e12;
 constexpr double DEFAULT_MIN_Y = 0, DEFAULT_MAX_Y = 1;
 constexpr int AUTO_REFRESH_INTERVAL_STEP = 5, AUTO_REFRESH_INTERVAL_MIN = 5;
 constexpr int DEFAULT_STEP = 15;
-constexpr int PROMETHEUS_MAX_POINTS_PER_REQUEST = 11'000;
+constexpr int MAX_POINTS_PER_SERIES = 1'000'000;                // Предел точек ряда, выше которого шаг загрузки увеличивается
+constexpr std::size_t QUERY_CACHE_MEMORY_LIMIT = 256 << 20; // Лимит кэша запросов (256 МиБ)
+constexpr std::size_t RAW_SERIES_MEMORY_LIMIT = 512 << 20;  // Лимит кэша сырых точек локального PromQL (512 МиБ)
+constexpr int LTTB_POINTS_PER_PIXEL = 2;                      // Точек на пиксель ширины графика после LTTB
+constexpr int PYRAMID_BASE_POINTS = 4;                        // Шагов запроса в корзине нижнего уровня пирамиды
+constexpr std::size_t QUERY_BUFFER_SIZE = 255;                 // Длина текста запроса панели
+constexpr std::size_t GROUP_BY_BUFFER_SIZE = 128;              // Длина списка меток группировки панели
+constexpr float DEFAULT_QUANTILE = 0.9f;                      // Уровень квантиля при агрегации на панели
+constexpr int MAX_PANELS = 32;                                // Панелей на дашборде
+constexpr int DEFAULT_DASHBOARD_COLUMNS = 2;                  // Колонок в сетке панелей
+constexpr float PANEL_MIN_HEIGHT = 160;                       // Высота панели, ниже которой сетка прокручивается
+constexpr const char *DISK_CACHE_DIRECTORY = "low-budget-grafana"; // Каталог дискового кэша рядов в пользовательском каталоге кэша
+constexpr std::time_t DISK_CACHE_RETENTION = 7 * 24 * 3600;   // Сколько истории хранить в дисковом кэше (7д)
+constexpr const char *TRACE_FILE = "trace.json";              // Файл трассы для chrome://tracing и Perfetto
+constexpr int IDLE_SETTLE_FRAMES = 3;                         // Кадров после события, пока ImGui пересчитывает наведение и раскладку
+constexpr double TEXT_CURSOR_BLINK_PERIOD = 0.4;              // Перерисовка при вводе текста, чтобы мигал курсор
+constexpr double QUERY_EDIT_DEBOUNCE = 0.3;                   // Пауза ввода запроса, после которой он вычисляется локально
+constexpr std::time_t METADATA_REFRESH_INTERVAL = 60;         // Догрузка имён метрик и меток рядов, появившихся за интервал (1м)
+constexpr std::time_t METADATA_FULL_REFRESH_INTERVAL = 15 * 60; // Полная перезагрузка имён, убирающая пропавшие ряды (15м)
+constexpr std::size_t MAX_QUERY_SUGGESTIONS = 8;              // Подсказок под полем запроса
+constexpr double CPU_LOAD_PERIOD = 1.0;                       // Период замера загрузки CPU в оверлее производительности
 
 namespace Strings
 {
@@ -53,18 +77,40 @@ namespace Strings
     constexpr const char *AXIS_VALUE = "Value";
 
     constexpr const char *WINDOW_SETTINGS = "Settings";
+    constexpr const char *WINDOW_PROFILER = "Performance";
     constexpr const char *NODE_CONNECTION = "Connection";
     constexpr const char *NODE_QUERY = "Query";
     constexpr const char *NODE_PLOT_SETTINGS = "Plot settings";
     constexpr const char *NODE_TIME_INTERVALS = "Time intervals";
 
     constexpr const char *LABEL_PROMETHEUS_URL = "Prometheus Base URL:";
-    constexpr const char *LABEL_QUERY = "PromQL Query:";
+    constexpr const char *LABEL_BACKEND = "Read API:";
+    constexpr const char *LABEL_QUERY = "PromQL Queries:";
     constexpr const char *LABEL_PLOT_TYPE = "Plot Type:";
+    constexpr const char *LABEL_DOWNSAMPLING = "Downsampling:";
     constexpr const char *LABEL_AUTO_REFRESH = "Auto Refresh";
+    constexpr const char *LABEL_DISK_CACHE = "Disk cache";
+    constexpr const char *LABEL_PANEL = "Panel %d:";
+    constexpr const char *LABEL_COLUMNS = "Columns:";
+    constexpr const char *LABEL_AGGREGATION = "Aggregate";
+    constexpr const char *LABEL_GROUP_BY = "by";
+    constexpr const char *LABEL_GROUP_WITHOUT = "without";
+    constexpr const char *LABEL_QUANTILE = "q";
+    constexpr const char *LABEL_CACHE_STATS = "Cache: %zu hits, %zu partial, %zu misses, %.1f MiB";
+    constexpr const char *LABEL_COALESCING_STATS = "Requests: %zu sent, %zu coalesced";
+    constexpr const char *LABEL_LOCAL_PROMQL_STATS = "Local PromQL: %zu local, %zu server, raw %.1f MiB";
+    constexpr const char *LABEL_PROFILER = "Performance overlay";
+    constexpr const char *LABEL_FRAME_RATE = "%.1f FPS";
+    constexpr const char *LABEL_CPU_LOAD = "CPU %.1f%%";
+    constexpr const char *LABEL_RENDER_ON_DEMAND = "Render on demand";
+    constexpr const char *LABEL_TRACE = "Record trace";
 
     constexpr const char *BUTTON_CONNECT = "Connect";
     constexpr const char *BUTTON_FETCH_DATA = "Fetch Data";
+    constexpr const char *BUTTON_ADD_PANEL = "Add panel";
+    constexpr const char *BUTTON_REMOVE_PANEL = "Remove";
+    constexpr const char *BUTTON_RESET = "Reset";
+    constexpr const char *BUTTON_SAVE_TRACE = "Save trace";
 
     constexpr const char *RADIO_BUTTON_LINE = "Line";
     constexpr const char *RADIO_BUTTON_SCATTER = "Scatter";
@@ -72,7 +118,9 @@ namespace Strings
 
     constexpr const char *MESSAGE_CONNECTION_SUCCESS = "Connection successful!";
     constexpr const char *MESSAGE_CONNECTION_FAILED = "Failed to connect to Prometheus.";
+    constexpr const char *MESSAGE_NO_COMPRESSION = "libcurl is built without zlib: responses are transferred uncompressed.";
     constexpr const char *MESSAGE_CLIENT_NOT_SET_UP = "Prometheus client is not set up.";
+    constexpr const char *MESSAGE_UNKNOWN_ERROR = "Unknown error.";
 }
 
 /**
@@ -98,6 +146,34 @@ enum class YAxisUnit
 
 constexpr const char *Y_AXIS_UNIT_LABELS[] = {"Count", "Seconds", "Bytes", "Percent"};
 
+/**
+ * @brief Алгоритм прореживания рядов перед отрисовкой.
+ */
+enum class DownsampleMode
+{
+    Off,    ///< Рисовать все точки
+    M4,     ///< M4: первая, последняя, минимум и максимум на пиксель
+    LTTB,   ///< Largest-Triangle-Three-Buckets
+    Pyramid ///< Минимум и максимум из заранее посчитанной пирамиды агрегатов
+};
+
+constexpr const char *DOWNSAMPLE_MODE_LABELS[] = {"Off", "M4", "LTTB", "Min/Max pyramid"};
+
+/// Агрегаты панели: нулевой — ряды как есть, остальные по порядку `Aggregation`
+constexpr const char *AGGREGATION_LABELS[] = {"none", "sum", "avg", "min", "max", "count", "quantile"};
+
+/**
+ * @brief Способ чтения данных из Prometheus.
+ */
+enum class PrometheusBackend
+{
+    QueryRange, ///< JSON `query_range`: любое выражение PromQL с шагом
+    RemoteRead, ///< Remote read: сырые точки рядов по селектору
+    LocalPromQL ///< Подмножество PromQL вычисляется по сырым точкам remote read, остальное — через `query_range`
+};
+
+constexpr const char *PROMETHEUS_BACKEND_LABELS[] = {"HTTP API (query_range)", "Remote read (raw samples)", "Local PromQL (raw samples)"};
+
 #endif // APP_CONSTANTS_H
 
 /** @} */
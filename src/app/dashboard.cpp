@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <unordered_map>
+
+#include "../lib/trace/trace.h"
+#include "../lib/tsdb/aggregate.h"
+#include "dashboard.h"
+
+namespace
+{
+    /**
+     * @brief Разобрать список меток через запятую или пробел.
+     */
+    std::vector<std::string> parseLabelList(const char *text)
+    {
+        std::vector<std::string> labels;
+        std::string label;
+        for (const char *c = text;; c++)
+        {
+            if (*c == '\0' || *c == ',' || std::isspace(static_cast<unsigned char>(*c)))
+            {
+                if (!label.empty())
+                    labels.push_back(std::move(label));
+                label.clear();
+                if (*c == '\0')
+                    break;
+            }
+            else
+            {
+                label += *c;
+            }
+        }
+        return labels;
+    }
+}
+
+double latestTimestamp(const std::vector<GraphSeries> &series)
+{
+    double latest = std::numeric_limits<double>::lowest();
+    for (const auto &s : series)
+    {
+        if (!s.data.empty())
+            latest = std::max(latest, s.data.timestamps.back());
+    }
+    return latest;
+}
+
+bool updateAggregation(Panel &panel)
+{
+    if (!panel.aggregationDirty)
+        return false;
+    panel.aggregationDirty = false;
+    panel.aggregated.clear();
+    if (panel.aggregation <= 0 || panel.loadedStep <= 0)
+        return true;
+
+    trace::Span span("aggregate");
+    std::vector<SeriesRef> refs;
+    refs.reserve(panel.series.size());
+    for (const auto &s : panel.series)
+        refs.push_back({&s.labels, &s.data});
+    Grouping grouping{parseLabelList(panel.groupBy), panel.groupWithout};
+    std::vector<Metric> metrics =
+        aggregateSeries(refs, static_cast<Aggregation>(panel.aggregation - 1), panel.loadedStep, grouping, panel.quantile);
+    // Имя агрегата отличает его ряды в легенде, у ряда без группировки других подписей нет
+    for (auto &m : metrics)
+        m.name = AGGREGATION_LABELS[panel.aggregation];
+    panel.aggregated = toGraphSeries(metrics, panel.loadedStep);
+    return true;
+}
+
+void mergeSeriesTail(std::vector<GraphSeries> &series, std::vector<GraphSeries> &tail, double keepFrom)
+{
+    std::unordered_map<SeriesKey, std::size_t, SeriesKeyHash> index;
+    for (std::size_t i = 0; i < series.size(); i++)
+        index.emplace(series[i].key(), i);
+
+    for (auto &s : tail)
+    {
+        auto it = index.find(s.key());
+        if (it == index.end())
+            series.push_back(std::move(s));
+        else
+        {
+            series[it->second].data.appendNewer(s.data);
+            series[it->second].pyramid.append(s.data);
+            series[it->second].view.valid = false;
+        }
+    }
+
+    for (auto &s : series)
+    {
+        s.data.dropBefore(keepFrom);
+        s.pyramid.dropBefore(keepFrom);
+        s.view.valid = false;
+    }
+    series.erase(std::remove_if(series.begin(), series.end(), [](const GraphSeries &s) { return s.data.empty(); }), series.end());
+}
@@ -0,0 +1,91 @@
+/**
+ * @file dashboard.h
+ * @brief Модель дашборда из нескольких панелей.
+ *
+ * @details Содержит `Panel` — панель со своим запросом и загруженными рядами — и операции над рядами панели,
+ *          которые не зависят от отрисовки.
+ */
+
+/**
+ * @defgroup dashboard Dashboard
+ * @ingroup app
+ * @brief Панели дашборда и их данные.
+ */
+/** @{ */
+
+#ifndef APP_DASHBOARD_H
+#define APP_DASHBOARD_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+#include "fetcher.h"
+
+/**
+ * @brief Панель дашборда: запрос и загруженные по нему ряды.
+ *
+ * @details Все панели показывают один и тот же интервал времени и загружаются одним пакетом запросов,
+ *          см. `FetchJob`.
+ */
+struct Panel
+{
+    std::uint64_t id = 0;                ///< Постоянный номер панели, по нему результаты загрузки находят панель
+    char query[QUERY_BUFFER_SIZE] = {};  ///< Редактируемый текст запроса
+    std::vector<GraphSeries> series;     ///< Загруженные ряды
+    std::string loadedQuery;             ///< Запрос, с которым загружены `series`
+    int loadedStep = 0;                  ///< Шаг, с которым загружены `series`
+    std::string error;                   ///< Ошибка последней загрузки панели
+    bool fitValueAxis = false;           ///< Подогнать ось значений под ряды при следующей отрисовке
+
+    int aggregation = 0;                     ///< Индекс в `AGGREGATION_LABELS`, 0 — рисовать ряды как есть
+    char groupBy[GROUP_BY_BUFFER_SIZE] = {}; ///< Метки группировки через запятую
+    bool groupWithout = false;               ///< Группировать по всем меткам, кроме `groupBy`
+    float quantile = DEFAULT_QUANTILE;       ///< Уровень для агрегата quantile
+    std::vector<GraphSeries> aggregated;     ///< Агрегированные ряды, пересчитываются из `series` без запроса к TSDB
+    bool aggregationDirty = false;           ///< Ряды или настройки агрегации изменились после расчёта `aggregated`
+
+    /**
+     * @brief Загружены ли ряды для текущего текста запроса и шага `step`.
+     */
+    bool isLoaded(int step) const { return loadedQuery == query && loadedStep == step; }
+
+    /**
+     * @brief Ряды, которые рисует панель: агрегированные или загруженные.
+     */
+    std::vector<GraphSeries> &plotted() { return aggregation ? aggregated : series; }
+};
+
+/**
+ * @brief Последняя временная метка среди рядов.
+ *
+ * @return Метка или `std::numeric_limits<double>::lowest()`, если точек нет
+ */
+double latestTimestamp(const std::vector<GraphSeries> &series);
+
+/**
+ * @brief Пересчитать `Panel::aggregated`, если ряды или настройки агрегации изменились.
+ *
+ * @details Ряды выравниваются по сетке шага загрузки и агрегируются на клиенте (см. `aggregateSeries`),
+ *          поэтому смена агрегата или группировки не требует нового запроса.
+ *
+ * @return true, если ряды пересчитаны
+ */
+bool updateAggregation(Panel &panel);
+
+/**
+ * @brief Дописать хвосты рядов к загруженным данным и отрезать точки левее `keepFrom`.
+ *
+ * @details Ряды сопоставляются по `GraphSeries::key`: имени метрики и меткам. Новые ряды добавляются целиком,
+ *          опустевшие после обрезки удаляются.
+ *
+ * @param series Загруженные ряды
+ * @param tail Хвосты рядов из инкрементального запроса
+ * @param keepFrom Левая граница хранимых точек
+ */
+void mergeSeriesTail(std::vector<GraphSeries> &series, std::vector<GraphSeries> &tail, double keepFrom);
+
+#endif // APP_DASHBOARD_H
+
+/** @} */
@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <utility>
+
+#include "../lib/trace/trace.h"
+#include "constants.h"
+#include "dashboard.h"
+#include "fetcher.h"
+
+namespace
+{
+    /**
+     * @brief Записать замеры пакета запросов.
+     *
+     * @details Время в парсере берётся из счётчиков клиента и вычитается из времени пакета: остаток —
+     *          сеть и ожидание сервера. Аллокации пакета относятся к разбору, в основном они там.
+     */
+    void recordBatch(Profiler &profiler, const TSDBClient::TransferStats &before, const TSDBClient::TransferStats &after,
+                     std::chrono::nanoseconds elapsed, std::uint64_t allocations, const std::vector<RangeQueryResult> &responses)
+    {
+        auto parse = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(after.sink_seconds - before.sink_seconds));
+        parse = std::min(parse, elapsed);
+        profiler.record(ProfilePhase::Request, elapsed - parse);
+        profiler.addBytes(ProfilePhase::Request, after.bytes - before.bytes);
+        profiler.record(ProfilePhase::Parse, parse, allocations);
+
+        std::size_t points = 0;
+        for (const auto &response : responses)
+        {
+            if (!response.metrics)
+                continue;
+            for (const auto &metric : *response.metrics)
+                points += metric.series.size();
+        }
+        profiler.addPoints(ProfilePhase::Parse, points);
+    }
+}
+
+FetchWorker::FetchWorker() = default;
+
+FetchWorker::~FetchWorker()
+{
+    stop();
+}
+
+std::uint64_t FetchWorker::submit(FetchJob job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // Поток запускается здесь, а не в конструкторе: рабочий объект бывает статическим, и поток,
+    // стартовавший во время статической инициализации, обращался бы к ещё не созданным глобальным объектам
+    if (!thread.joinable() && !stopping)
+        thread = std::thread([this] { run(); });
+    if (!pending)
+        pending_jobs++;
+    pending = std::move(job);
+    pending_id = ++last_id;
+    wakeup.notify_one();
+    return pending_id;
+}
+
+void FetchWorker::setReadyCallback(std::function<void()> callback)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ready_callback = std::move(callback);
+}
+
+bool FetchWorker::poll(FetchResult &result)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ready.empty())
+        return false;
+    result = std::move(ready.front());
+    ready.pop_front();
+    return true;
+}
+
+void FetchWorker::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping)
+            return;
+        stopping = true;
+        if (pending)
+        {
+            pending.reset();
+            pending_jobs--;
+        }
+    }
+    wakeup.notify_one();
+    if (thread.joinable())
+        thread.join();
+}
+
+void FetchWorker::run()
+{
+    trace::setThreadName("fetch");
+    while (true)
+    {
+        FetchJob job;
+        std::uint64_t id;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this] { return stopping || pending; });
+            if (stopping)
+                return;
+            job = std::move(*pending);
+            pending.reset();
+            id = pending_id;
+        }
+
+        // Чтение кэша тоже идёт здесь: разбор файлов на UI-потоке задерживал бы кадр
+        FetchResult preview = loadCached(job);
+        if (!preview.panels.empty())
+            publish(id, std::move(preview), false);
+
+        FetchResult result;
+        result.step = job.step;
+        if (!job.panels.empty())
+            result = execute(job);
+        publish(id, std::move(result), true);
+    }
+}
+
+void FetchWorker::publish(std::uint64_t id, FetchResult result, bool last)
+{
+    result.id = id;
+    std::function<void()> callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (id == last_id)
+        {
+            // Незабранные результаты прежних задач устарели
+            if (!ready.empty() && ready.front().id != id)
+                ready.clear();
+            ready.push_back(std::move(result));
+            callback = ready_callback;
+        }
+        if (last)
+            pending_jobs--;
+    }
+    if (callback)
+        callback();
+}
+
+FetchResult FetchWorker::loadCached(FetchJob &job)
+{
+    FetchResult preview;
+    preview.step = job.step;
+    preview.preview = true;
+    if (!job.disk_cache)
+        return preview;
+
+    Profiler::Scope scope(job.profiler, ProfilePhase::DiskCache);
+    trace::Span span("disk cache load");
+    std::vector<PanelQuery> queries;
+    queries.reserve(job.panels.size());
+    for (auto &query : job.panels)
+    {
+        // `load` не бросает исключений: отсутствующий или повреждённый файл читается как пустой снимок
+        DiskCache::Snapshot snapshot;
+        if (query.from_disk_cache)
+            snapshot = job.disk_cache->load(job.cache_source, query.query, job.step);
+        if (snapshot.empty() || snapshot.end < query.start)
+        {
+            queries.push_back(std::move(query));
+            continue;
+        }
+
+        for (auto &m : snapshot.metrics)
+            m.series = m.series.slice(query.start - job.step, job.end);
+        snapshot.metrics.erase(std::remove_if(snapshot.metrics.begin(), snapshot.metrics.end(), [](const Metric &m) { return m.series.empty(); }),
+                               snapshot.metrics.end());
+        PanelResult panel;
+        panel.panel = query.panel;
+        panel.ok = true;
+        panel.query = query.query;
+        panel.series = toGraphSeries(snapshot.metrics, job.step);
+
+        // Если сохранённый интервал доходит до левой границы, из TSDB нужен только хвост после него.
+        // Prometheus считает точки от start с шагом step, поэтому хвост остаётся на той же сетке.
+        // Сырые точки remote read на сетке не лежат: запрашиваем с последней секунды, повтор отбросит appendNewer
+        double latest = latestTimestamp(panel.series);
+        if (snapshot.start <= query.start + job.step && latest >= query.start)
+        {
+            query.start = static_cast<std::time_t>(latest) + (job.raw_points ? 0 : job.step);
+            query.incremental = true;
+        }
+        preview.panels.push_back(std::move(panel));
+        if (query.start <= job.end)
+            queries.push_back(std::move(query));
+    }
+    job.panels = std::move(queries);
+    return preview;
+}
+
+FetchResult FetchWorker::execute(const FetchJob &job)
+{
+    FetchResult result;
+    result.step = job.step;
+
+    std::vector<RangeQuery> queries;
+    queries.reserve(job.panels.size());
+    for (const auto &panel : job.panels)
+        queries.push_back({panel.query, panel.start, job.end, job.step});
+
+    std::vector<RangeQueryResult> responses;
+    std::string batch_error;
+    TSDBClient::TransferStats transfer_before;
+    if (job.profiler)
+        transfer_before = job.client->getTransferStats();
+    auto started = std::chrono::steady_clock::now();
+    std::uint64_t allocations_before = Profiler::threadAllocations();
+    try
+    {
+        responses = job.client->queryBatch(queries);
+    }
+    catch (const std::exception &error)
+    {
+        batch_error = error.what();
+        responses.resize(queries.size());
+    }
+    catch (...)
+    {
+        // Исключение, вышедшее из потока, завершило бы процесс, а UI так и ждал бы результата задачи
+        batch_error = Strings::MESSAGE_UNKNOWN_ERROR;
+        responses.resize(queries.size());
+    }
+    if (job.profiler)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started);
+        recordBatch(*job.profiler, transfer_before, job.client->getTransferStats(), elapsed,
+                    Profiler::threadAllocations() - allocations_before, responses);
+    }
+
+    for (std::size_t i = 0; i < job.panels.size(); i++)
+    {
+        const PanelQuery &query = job.panels[i];
+        PanelResult panel;
+        panel.panel = query.panel;
+        panel.query = query.query;
+        panel.incremental = query.incremental;
+        RangeQueryResult &response = responses[i];
+        if (!batch_error.empty() || response.error)
+        {
+            panel.error = batch_error;
+            try
+            {
+                if (response.error)
+                    std::rethrow_exception(response.error);
+            }
+            catch (const std::exception &error)
+            {
+                panel.error = error.what();
+            }
+            catch (...)
+            {
+                panel.error = Strings::MESSAGE_UNKNOWN_ERROR;
+            }
+            result.panels.push_back(std::move(panel));
+            continue;
+        }
+
+        if (job.disk_cache)
+        {
+            // Кэш на диске необязателен: ошибка записи не должна мешать показать загруженные данные
+            Profiler::Scope scope(job.profiler, ProfilePhase::DiskCache);
+            trace::Span span("disk cache");
+            try
+            {
+                job.disk_cache->append(job.cache_source, query.query, job.step, *response.metrics, query.start, job.end);
+            }
+            catch (...)
+            {
+            }
+        }
+
+        {
+            Profiler::Scope scope(job.profiler, ProfilePhase::Convert);
+            trace::Span span("convert");
+            panel.series = toGraphSeries(*response.metrics, job.step);
+            for (const auto &s : panel.series)
+                scope.addPoints(s.data.size());
+        }
+        panel.ok = true;
+        result.panels.push_back(std::move(panel));
+    }
+    return result;
+}
+
+std::vector<GraphSeries> toGraphSeries(std::vector<Metric> &metrics, int step)
+{
+    std::vector<GraphSeries> series;
+    series.reserve(metrics.size());
+    for (auto &m : metrics)
+    {
+        GraphSeries s;
+        s.name = TSDBClient::format_line_name(m);
+        s.metric = m.name;
+        s.labels = std::move(m.labels);
+        s.data = std::move(m.series);
+        if (step > 0)
+            s.pyramid.build(s.data, static_cast<double>(step) * PYRAMID_BASE_POINTS);
+        series.push_back(std::move(s));
+    }
+    return series;
+}
+
+std::vector<GraphSeries> toGraphSeries(const std::vector<Metric> &metrics, int step)
+{
+    // Ряды ответа могут разделять кэш и другие запросы, поэтому здесь, где панель забирает их себе, они копируются
+    std::vector<Metric> owned = metrics;
+    return toGraphSeries(owned, step);
+}
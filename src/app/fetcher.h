@@ -0,0 +1,224 @@
+/**
+ * @file fetcher.h
+ * @brief Фоновая загрузка данных из TSDB.
+ *
+ * @details Содержит `FetchWorker` — рабочий поток, который выполняет запросы к TSDB и подготавливает
+ *          ряды для отрисовки, не блокируя цикл рендеринга.
+ */
+
+/**
+ * @defgroup fetcher Fetcher
+ * @ingroup app
+ * @brief Асинхронная загрузка рядов для графика.
+ */
+/** @{ */
+
+#ifndef APP_FETCHER_H
+#define APP_FETCHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../lib/tsdb/cache/disk_cache.h"
+#include "../lib/tsdb/pyramid.h"
+#include "../lib/tsdb/tsdb.h"
+#include "profiler.h"
+
+/**
+ * @brief Прореженное представление ряда для текущего масштаба графика.
+ */
+struct SeriesView
+{
+    Series points;        ///< Точки для отрисовки
+    double from = 0;      ///< Левая граница графика, для которой посчитаны точки
+    double to = 0;        ///< Правая граница графика
+    int width = 0;        ///< Ширина графика в пикселях
+    int mode = 0;         ///< Алгоритм прореживания
+    bool valid = false;   ///< false, если данные ряда изменились после расчёта
+};
+
+/**
+ * @brief Ряд, готовый к отрисовке.
+ */
+struct GraphSeries
+{
+    std::string name;      ///< Подпись в легенде, по ней ряды не различаются: метки в ней не экранируются
+    Symbol metric;         ///< Имя метрики
+    LabelSet labels;       ///< Метки ряда, по ним группирует агрегация на панели
+    Series data;           ///< Колонки передаются в ImPlot как есть
+    SeriesPyramid pyramid; ///< Агрегаты ряда для отрисовки крупного масштаба, строятся в потоке загрузки
+    SeriesView view;       ///< Кэш прореженных точек, пересчитывается только при смене масштаба или данных
+
+    /**
+     * @brief Идентичность ряда для сопоставления рядов из разных ответов.
+     */
+    SeriesKey key() const { return {metric, labels}; }
+};
+
+/**
+ * @brief Запрос одной панели в составе `FetchJob`.
+ */
+struct PanelQuery
+{
+    std::uint64_t panel = 0;  ///< Номер панели, см. `Panel::id`
+    std::string query;
+    std::time_t start = 0;
+    bool incremental = false; ///< Запрашивается только хвост к уже загруженным рядам панели
+    bool from_disk_cache = false; ///< Сначала показать ряды из `FetchJob::disk_cache`, из TSDB догрузить хвост после них
+};
+
+/**
+ * @brief Параметры загрузки: запросы всех панелей за один интервал с одним шагом.
+ *
+ * @details Запросы панелей уходят в TSDB одним пакетом (`TSDBClient::queryBatch`), поэтому обновление
+ *          дашборда длится столько, сколько самый долгий запрос, а не сумму всех.
+ */
+struct FetchJob
+{
+    std::shared_ptr<TSDBClient> client;
+    std::vector<PanelQuery> panels;
+    std::time_t end;
+    int step;
+    std::shared_ptr<DiskCache> disk_cache = nullptr; ///< Откуда читать и куда сохранить ряды, nullptr — не использовать
+    std::string cache_source = {};                   ///< Источник данных для ключа `disk_cache`
+    bool raw_points = false;                         ///< Точки не на сетке шага (remote read): хвост запрашивается с последней точки
+    Profiler *profiler = nullptr;                    ///< Куда записать замеры фаз, nullptr — не замерять
+};
+
+/**
+ * @brief Результат запроса одной панели.
+ */
+struct PanelResult
+{
+    std::uint64_t panel = 0;         ///< Номер панели
+    bool ok = false;                 ///< false, если запрос завершился ошибкой
+    std::string error;               ///< Текст ошибки при `ok == false`
+    std::vector<GraphSeries> series; ///< Загруженные ряды
+    std::string query;               ///< Запрос, которым получены ряды
+    bool incremental = false;        ///< `series` содержит только хвост, см. `PanelQuery::incremental`
+};
+
+/**
+ * @brief Результат выполнения `FetchJob`.
+ */
+struct FetchResult
+{
+    std::uint64_t id = 0;             ///< Номер задачи, выданный `FetchWorker::submit`
+    std::vector<PanelResult> panels;  ///< Результаты в порядке `FetchJob::panels`
+    int step = 0;                     ///< Шаг, с которым получены ряды
+    bool preview = false;             ///< Ряды из дискового кэша; результат TSDB той же задачи придёт следом
+};
+
+/**
+ * @brief Преобразовать метрики из ответа TSDB в ряды для графика.
+ *
+ * @details Колонки точек перемещаются без копирования, для каждого ряда строится пирамида агрегатов.
+ *
+ * @param metrics Метрики, после вызова остаются без точек и меток
+ * @param step Шаг запроса в секундах, 0 — пирамиды не строятся
+ * @return Ряды в порядке метрик
+ */
+std::vector<GraphSeries> toGraphSeries(std::vector<Metric> &metrics, int step);
+
+/**
+ * @brief Преобразовать общие неизменяемые метрики в ряды для графика.
+ *
+ * @details Колонки точек копируются: это единственная копия ответа на пути от TSDB до панели.
+ *
+ * @param metrics Метрики, например `RangeQueryResult::metrics`
+ * @param step Шаг запроса в секундах, 0 — пирамиды не строятся
+ * @return Ряды в порядке метрик
+ */
+std::vector<GraphSeries> toGraphSeries(const std::vector<Metric> &metrics, int step);
+
+/**
+ * @brief Рабочий поток для запросов к TSDB.
+ *
+ * @details UI-поток кладёт задачи через `submit` и каждый кадр забирает готовый результат через `poll`.
+ *          Одновременно хранится не больше одной ожидающей задачи: новая задача вытесняет ещё не начатую.
+ *          Результат задачи, для которой уже отправлена более новая, отбрасывается, чтобы на график
+ *          не попали устаревшие данные.
+ *
+ *          Панели с `PanelQuery::from_disk_cache` поток сначала читает из дискового кэша и отдаёт отдельным
+ *          результатом с `FetchResult::preview`, а из TSDB запрашивает только недостающий хвост. Оба
+ *          результата забираются через `poll` по порядку.
+ *
+ *          Поток запускается первым `submit`, поэтому объект можно делать статическим.
+ */
+class FetchWorker
+{
+public:
+    FetchWorker();
+    ~FetchWorker();
+
+    FetchWorker(const FetchWorker &) = delete;
+    FetchWorker &operator=(const FetchWorker &) = delete;
+
+    /**
+     * @brief Поставить задачу в очередь.
+     *
+     * @param job Параметры запроса
+     * @return Номер задачи
+     */
+    std::uint64_t submit(FetchJob job);
+
+    /**
+     * @brief Забрать самый ранний готовый результат, если он есть. Не блокирует.
+     *
+     * @param result Сюда перемещается результат
+     * @return true, если результат был получен
+     */
+    bool poll(FetchResult &result);
+
+    /**
+     * @brief Есть ли незавершённые задачи.
+     */
+    bool busy() const { return pending_jobs.load() > 0; }
+
+    /**
+     * @brief Задать функцию, которую поток загрузки вызывает, когда результат готов к `poll`.
+     *
+     * @details Цикл отрисовки по требованию спит в ожидании событий окна, и функция его будит.
+     *          Вызывается без блокировки очереди.
+     *
+     * @param callback Функция, пустая — не уведомлять
+     */
+    void setReadyCallback(std::function<void()> callback);
+
+    /**
+     * @brief Остановить поток. Текущий запрос дорабатывает до конца, ожидающий отбрасывается.
+     */
+    void stop();
+
+private:
+    void run();
+    /// Отдать результат задачи `id` в `poll`, если новее задач не отправлено
+    void publish(std::uint64_t id, FetchResult result, bool last);
+    /// Прочитать ряды панелей из дискового кэша; запросы покрытых кэшем панелей сокращаются до хвоста
+    static FetchResult loadCached(FetchJob &job);
+    static FetchResult execute(const FetchJob &job);
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::optional<FetchJob> pending;
+    std::deque<FetchResult> ready;
+    std::uint64_t last_id = 0;
+    std::uint64_t pending_id = 0;
+    std::atomic<int> pending_jobs{0};
+    std::function<void()> ready_callback;
+    bool stopping = false;
+    std::thread thread;
+};
+
+#endif // APP_FETCHER_H
+
+/** @} */
@@ -0,0 +1,167 @@
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "profiler.h"
+
+namespace
+{
+    thread_local std::uint64_t thread_allocations = 0;
+
+    int bucketIndex(std::uint64_t microseconds)
+    {
+        int index = 0;
+        while (microseconds > 1 && index < LatencyHistogram::BUCKETS - 1)
+        {
+            microseconds >>= 1;
+            index++;
+        }
+        return index;
+    }
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration)
+{
+    auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(duration.count(), 0));
+    buckets[bucketIndex(ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    total_ns.fetch_add(ns, std::memory_order_relaxed);
+    std::uint64_t previous = max_ns.load(std::memory_order_relaxed);
+    while (previous < ns && !max_ns.compare_exchange_weak(previous, ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    total_ns.store(0, std::memory_order_relaxed);
+    max_ns.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::meanSeconds() const
+{
+    std::uint64_t n = count();
+    return n ? total_ns.load(std::memory_order_relaxed) * 1e-9 / n : 0;
+}
+
+double LatencyHistogram::quantileSeconds(double q) const
+{
+    std::uint64_t n = count();
+    if (n == 0)
+        return 0;
+    auto rank = static_cast<std::uint64_t>(std::clamp(q, 0.0, 1.0) * (n - 1)) + 1;
+    std::uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS - 1; i++)
+    {
+        seen += bucket(i);
+        if (seen >= rank)
+            return std::min(static_cast<double>(2ull << i) * 1e-6, maxSeconds());
+    }
+    return maxSeconds();
+}
+
+Profiler::Scope::Scope(Profiler *profiler, ProfilePhase phase) : profiler(profiler), phase(phase)
+{
+    if (!profiler)
+        return;
+    allocations_before = threadAllocations();
+    started = std::chrono::steady_clock::now();
+}
+
+Profiler::Scope::~Scope()
+{
+    if (!profiler)
+        return;
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started);
+    profiler->record(phase, elapsed, threadAllocations() - allocations_before);
+}
+
+void Profiler::Scope::addBytes(std::size_t bytes)
+{
+    if (profiler)
+        profiler->addBytes(phase, bytes);
+}
+
+void Profiler::Scope::addPoints(std::size_t points)
+{
+    if (profiler)
+        profiler->addPoints(phase, points);
+}
+
+void Profiler::record(ProfilePhase phase, std::chrono::nanoseconds duration, std::uint64_t allocations)
+{
+    PhaseStats &phase_stats = phaseStats(phase);
+    phase_stats.latency.record(duration);
+    phase_stats.allocations.fetch_add(allocations, std::memory_order_relaxed);
+}
+
+void Profiler::reset()
+{
+    for (auto &phase : phases)
+    {
+        phase.latency.reset();
+        phase.allocations.store(0, std::memory_order_relaxed);
+        phase.bytes.store(0, std::memory_order_relaxed);
+        phase.points.store(0, std::memory_order_relaxed);
+    }
+}
+
+const char *Profiler::phaseName(ProfilePhase phase)
+{
+    switch (phase)
+    {
+    case ProfilePhase::Request:
+        return "HTTP";
+    case ProfilePhase::Parse:
+        return "Parse";
+    case ProfilePhase::Convert:
+        return "Convert";
+    case ProfilePhase::DiskCache:
+        return "Disk cache";
+    case ProfilePhase::Draw:
+        return "Draw";
+    case ProfilePhase::Frame:
+        return "Frame";
+    case ProfilePhase::Count:
+        break;
+    }
+    return "";
+}
+
+void Profiler::countAllocation() noexcept
+{
+    thread_allocations++;
+}
+
+std::uint64_t Profiler::threadAllocations() noexcept
+{
+    return thread_allocations;
+}
+
+double Profiler::processCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0;
+    // FILETIME считает интервалы по 100 нс
+    auto ticks = [](const FILETIME &time) {
+        return (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return (ticks(kernel) + ticks(user)) * 1e-7;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
@@ -0,0 +1,180 @@
+/**
+ * @file profiler.h
+ * @brief Замеры фаз загрузки и отрисовки данных.
+ *
+ * @details Содержит `Profiler` — гистограммы длительностей и счётчики байт, точек и аллокаций по фазам
+ *          (HTTP-запрос, разбор ответа, подготовка рядов, отрисовка), которые показывает оверлей
+ *          производительности. Запись из потока загрузки и из потока отрисовки идёт без блокировок.
+ */
+
+/**
+ * @defgroup profiler Profiler
+ * @ingroup app
+ * @brief Инструментирование фаз загрузки и отрисовки.
+ */
+/** @{ */
+
+#ifndef APP_PROFILER_H
+#define APP_PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Фаза, для которой ведутся замеры.
+ */
+enum class ProfilePhase
+{
+    Request,   ///< HTTP-запросы пакета без времени разбора: сеть и ожидание сервера
+    Parse,     ///< Разбор ответов; при потоковой передаче идёт одновременно с запросом
+    Convert,   ///< Преобразование `Metric` в `GraphSeries` с построением пирамид
+    DiskCache, ///< Чтение рядов из кэша на диске и запись в него ответа
+    Draw,      ///< Отрисовка панелей в ImPlot
+    Frame,     ///< Кадр целиком, от начала до `glfwSwapBuffers`
+    Count
+};
+
+/**
+ * @brief Гистограмма длительностей с корзинами по степеням двойки.
+ *
+ * @details Корзина `k` считает длительности из `[2^k, 2^(k+1))` микросекунд, последняя — всё, что длиннее.
+ *          Квантили оцениваются верхней границей корзины, то есть не более чем вдвое сверху.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr int BUCKETS = 24; ///< Последняя корзина начинается с ~8 секунд
+
+    void record(std::chrono::nanoseconds duration);
+    void reset();
+
+    std::uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    double meanSeconds() const;
+    double maxSeconds() const { return max_ns.load(std::memory_order_relaxed) * 1e-9; }
+
+    /**
+     * @brief Оценка квантиля.
+     *
+     * @param q Уровень квантиля из `[0, 1]`
+     * @return Верхняя граница корзины с квантилем в секундах, 0 — если замеров нет
+     */
+    double quantileSeconds(double q) const;
+
+    std::uint64_t bucket(int index) const { return buckets[index].load(std::memory_order_relaxed); }
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKETS> buckets{};
+    std::atomic<std::uint64_t> total{0};
+    std::atomic<std::uint64_t> total_ns{0};
+    std::atomic<std::uint64_t> max_ns{0};
+};
+
+/**
+ * @brief Замеры всех фаз.
+ *
+ * @details Код загрузки и отрисовки получает указатель на `Profiler` и при nullptr ничего не замеряет,
+ *          поэтому выключенные замеры стоят одной проверки указателя на фазу.
+ *
+ *          Аллокации считаются по потоку: в сборке приложения глобальный `operator new` вызывает
+ *          `countAllocation`, и фаза записывает, сколько аллокаций её поток сделал за время фазы.
+ *          Без замены `operator new` (в бенчмарках) счётчик аллокаций остаётся нулевым.
+ */
+class Profiler
+{
+public:
+    /**
+     * @brief Накопленные замеры одной фазы.
+     */
+    struct PhaseStats
+    {
+        LatencyHistogram latency;
+        std::atomic<std::uint64_t> allocations{0};
+        std::atomic<std::uint64_t> bytes{0};
+        std::atomic<std::uint64_t> points{0};
+    };
+
+    /**
+     * @brief Замер фазы от создания до разрушения объекта.
+     *
+     * @code
+     * {
+     *     Profiler::Scope scope(profiler, ProfilePhase::Convert);
+     *     series = toGraphSeries(metrics, step);
+     *     scope.addPoints(points);
+     * }
+     * @endcode
+     */
+    class Scope
+    {
+    public:
+        /**
+         * @param profiler Куда записать замер, nullptr — не замерять
+         * @param phase Фаза
+         */
+        Scope(Profiler *profiler, ProfilePhase phase);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        void addBytes(std::size_t bytes);
+        void addPoints(std::size_t points);
+
+    private:
+        Profiler *profiler;
+        ProfilePhase phase;
+        std::chrono::steady_clock::time_point started;
+        std::uint64_t allocations_before = 0;
+    };
+
+    /**
+     * @brief Записать замер фазы.
+     *
+     * @param phase Фаза
+     * @param duration Длительность
+     * @param allocations Число аллокаций за время фазы
+     */
+    void record(ProfilePhase phase, std::chrono::nanoseconds duration, std::uint64_t allocations = 0);
+
+    void addBytes(ProfilePhase phase, std::size_t bytes) { phaseStats(phase).bytes.fetch_add(bytes, std::memory_order_relaxed); }
+    void addPoints(ProfilePhase phase, std::size_t points) { phaseStats(phase).points.fetch_add(points, std::memory_order_relaxed); }
+
+    const PhaseStats &stats(ProfilePhase phase) const { return phases[static_cast<std::size_t>(phase)]; }
+
+    /**
+     * @brief Сбросить все замеры.
+     */
+    void reset();
+
+    /**
+     * @brief Отображаемое имя фазы.
+     */
+    static const char *phaseName(ProfilePhase phase);
+
+    /**
+     * @brief Учесть аллокацию в текущем потоке. Вызывается из `operator new`.
+     */
+    static void countAllocation() noexcept;
+
+    /**
+     * @brief Число аллокаций текущего потока с его запуска.
+     */
+    static std::uint64_t threadAllocations() noexcept;
+
+    /**
+     * @brief Процессорное время процесса во всех потоках, пользовательское и системное, в секундах.
+     */
+    static double processCpuSeconds();
+
+private:
+    PhaseStats &phaseStats(ProfilePhase phase) { return phases[static_cast<std::size_t>(phase)]; }
+
+    std::array<PhaseStats, static_cast<std::size_t>(ProfilePhase::Count)> phases;
+};
+
+#endif // APP_PROFILER_H
+
+/** @} */
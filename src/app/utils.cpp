@@ -2,8 +2,10 @@
 #include <iomanip>
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <filesystem>
 #include <sstream>
 #include <vector>
 
@@ -75,3 +77,28 @@ int valueTickFormatter(double value, char *buff, int size, void *user_data)
     value_format += "%s";
     return ImFormatString(buff, 15, value_format.c_str(), value, unit.c_str());
 }
+
+std::string userCacheDirectory(const std::string &name)
+{
+    auto fromEnv = [](const char *variable) {
+        const char *value = std::getenv(variable);
+        return value && *value ? std::filesystem::path(value) : std::filesystem::path();
+    };
+
+#if defined(_WIN32)
+    std::filesystem::path base = fromEnv("LOCALAPPDATA");
+#elif defined(__APPLE__)
+    std::filesystem::path base = fromEnv("HOME");
+    if (!base.empty())
+        base = base / "Library" / "Caches";
+#else
+    std::filesystem::path base = fromEnv("XDG_CACHE_HOME");
+    if (base.empty() || base.is_relative()) // По спецификации XDG относительный путь игнорируется
+    {
+        base = fromEnv("HOME");
+        if (!base.empty())
+            base /= ".cache";
+    }
+#endif
+    return (base / name).string();
+}
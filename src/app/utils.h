@@ -1,6 +1,6 @@
 /**
  * @file utils.h
- * @brief Вспомогательные функции для форматирования временных меток и значений осей.
+ * @brief Вспомогательные функции для форматирования временных меток и значений осей и путь к кэшу.
  */
 
 /**
@@ -14,6 +14,7 @@
 #define APP_UTILS_H
 
 #include <ctime>
+#include <string>
 #include <vector>
 
 /**
@@ -35,6 +36,16 @@ std::string formatTimestamp(std::time_t timestamp);
  */
 int valueTickFormatter(double value, char *buff, int size, void *user_data);
 
+/**
+ * @brief Каталог для кэша приложения в пользовательском каталоге кэша.
+ * @details `%LOCALAPPDATA%` в Windows, `~/Library/Caches` в macOS, `$XDG_CACHE_HOME` или `~/.cache`
+ *          в остальных системах. Если каталог пользователя неизвестен, путь остаётся относительным.
+ *          Сам каталог не создаётся.
+ * @param name Имя подкаталога приложения.
+ * @return Путь к каталогу.
+ */
+std::string userCacheDirectory(const std::string &name);
+
 #endif // APP_UTILS_H
 
 /** @} */
@@ -0,0 +1,160 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "benchmark.h"
+
+namespace
+{
+    std::atomic<std::size_t> allocations{0};
+    std::atomic<std::size_t> allocated_bytes{0};
+    std::atomic<std::size_t> current_bytes{0};
+    std::atomic<std::size_t> peak_bytes{0};
+
+    // Перед блоком храним его размер, чтобы учитывать освобождение
+    constexpr std::size_t HEADER = alignof(std::max_align_t);
+
+    void *trackedAlloc(std::size_t size)
+    {
+        void *raw = std::malloc(size + HEADER);
+        if (!raw)
+            throw std::bad_alloc();
+        *static_cast<std::size_t *>(raw) = size;
+
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        std::size_t current = current_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+        std::size_t peak = peak_bytes.load(std::memory_order_relaxed);
+        while (current > peak && !peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+            ;
+        return static_cast<char *>(raw) + HEADER;
+    }
+
+    void trackedFree(void *ptr)
+    {
+        if (!ptr)
+            return;
+        void *raw = static_cast<char *>(ptr) - HEADER;
+        current_bytes.fetch_sub(*static_cast<std::size_t *>(raw), std::memory_order_relaxed);
+        std::free(raw);
+    }
+}
+
+void *operator new(std::size_t size) { return trackedAlloc(size); }
+void *operator new[](std::size_t size) { return trackedAlloc(size); }
+void operator delete(void *ptr) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr) noexcept { trackedFree(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { trackedFree(ptr); }
+
+namespace benchmark
+{
+    HeapStats heapStats()
+    {
+        return {allocations.load(), allocated_bytes.load(), current_bytes.load(), peak_bytes.load()};
+    }
+
+    void resetPeak()
+    {
+        peak_bytes.store(current_bytes.load());
+    }
+
+    std::size_t peakRssBytes()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return 0;
+        return counters.PeakWorkingSetSize;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+#ifdef __APPLE__
+        return static_cast<std::size_t>(usage.ru_maxrss); // macOS отдаёт байты
+#else
+        return static_cast<std::size_t>(usage.ru_maxrss) * 1024; // Linux отдаёт КиБ
+#endif
+#endif
+    }
+
+    Options parseOptions(int argc, char **argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; i++)
+        {
+            const char *arg = argv[i];
+            if (std::strncmp(arg, "--filter=", 9) == 0)
+                options.filter = arg + 9;
+            else if (std::strncmp(arg, "--json=", 7) == 0)
+                options.json_path = arg + 7;
+            else if (std::strncmp(arg, "--min-time=", 11) == 0)
+                options.min_time = std::atof(arg + 11);
+            else
+                std::fprintf(stderr, "Unknown argument: %s\n", arg);
+        }
+        return options;
+    }
+
+    namespace
+    {
+        /// Экранировать строку для JSON: имена случаев содержат только печатные символы.
+        std::string jsonString(const std::string &value)
+        {
+            std::string result = "\"";
+            for (char c : value)
+            {
+                if (c == '"' || c == '\\')
+                    result += '\\';
+                if (static_cast<unsigned char>(c) >= 0x20)
+                    result += c;
+            }
+            return result + '"';
+        }
+
+        bool json_started = false;
+    }
+
+    bool Suite::writeJson(const std::string &path) const
+    {
+        std::FILE *file = std::fopen(path.c_str(), json_started ? "a" : "w");
+        if (!file)
+            return false;
+        json_started = true;
+        for (const auto &r : results)
+        {
+            std::fprintf(file,
+                         "{\"suite\":%s,\"case\":%s,\"iterations\":%zu,\"ns_per_iteration\":%.1f,\"items_per_second\":%.6g,"
+                         "\"allocations_per_iteration\":%.2f,\"peak_heap_bytes\":%zu,\"peak_rss_bytes\":%zu}\n",
+                         jsonString(name).c_str(), jsonString(r.name).c_str(), r.iterations, r.seconds_per_iteration * 1e9,
+                         r.items_per_second, r.allocations_per_iteration, r.peak_heap_bytes, r.peak_rss_bytes);
+        }
+        std::fclose(file);
+        return true;
+    }
+
+    void Suite::print() const
+    {
+        std::printf("%s\n", name.c_str());
+        std::printf("%-44s %12s %14s %14s %12s %14s %14s\n", "case", "iterations", "time/iter, ms", "items/s", "allocs/iter",
+                    "peak heap, KiB", "peak RSS, MiB");
+        for (const auto &r : results)
+        {
+            std::printf("%-44s %12zu %14.3f %14.4g %12.1f %14.1f %14.1f\n",
+                        r.name.c_str(), r.iterations, r.seconds_per_iteration * 1e3, r.items_per_second,
+                        r.allocations_per_iteration, r.peak_heap_bytes / 1024.0, r.peak_rss_bytes / 1048576.0);
+        }
+        std::printf("\n");
+        if (!options.json_path.empty() && !writeJson(options.json_path))
+            std::fprintf(stderr, "Cannot write %s\n", options.json_path.c_str());
+    }
+}
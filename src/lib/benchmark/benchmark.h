@@ -0,0 +1,207 @@
+/**
+ * @file benchmark.h
+ * @brief Минимальный каркас для микробенчмарков.
+ *
+ * @details Замеряет время выполнения, число аллокаций, пиковый объём кучи и пиковый RSS процесса для
+ *          произвольной функции. Учёт аллокаций реализован заменой глобальных `operator new`/`operator delete`
+ *          в `benchmark.cpp`, поэтому каркас подключается только к исполняемым файлам бенчмарков.
+ *
+ *          Все бенчмарки понимают общие аргументы командной строки:
+ *          - `--filter=<подстрока>` — запускать только случаи, в имени которых (`набор/случай`) есть подстрока;
+ *          - `--min-time=<секунды>` — минимальное время замера одного случая;
+ *          - `--json=<файл>` — дописать результаты в файл в формате JSON Lines, по объекту на случай.
+ */
+
+/**
+ * @defgroup benchmark Бенчмарки
+ * @ingroup lib
+ * @brief Каркас для замеров производительности горячих участков кода.
+ */
+/** @{ */
+
+#ifndef LIB_BENCHMARK_H
+#define LIB_BENCHMARK_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace benchmark
+{
+    /**
+     * @brief Счётчики аллокаций кучи.
+     */
+    struct HeapStats
+    {
+        std::size_t allocations;     ///< Число вызовов `operator new`
+        std::size_t allocated_bytes; ///< Суммарно выделено байт
+        std::size_t current_bytes;   ///< Занято байт в данный момент
+        std::size_t peak_bytes;      ///< Максимум `current_bytes` с последнего `resetPeak`
+    };
+
+    /**
+     * @brief Получить текущие счётчики аллокаций.
+     */
+    HeapStats heapStats();
+
+    /**
+     * @brief Сбросить пиковое значение занятой памяти до текущего.
+     */
+    void resetPeak();
+
+    /**
+     * @brief Пиковый размер резидентной памяти процесса с момента запуска.
+     *
+     * @return Байты или 0, если платформа не поддерживается
+     */
+    std::size_t peakRssBytes();
+
+    /**
+     * @brief Параметры запуска, общие для всех бенчмарков.
+     */
+    struct Options
+    {
+        std::string filter;    ///< Подстрока имени `набор/случай`, пустая — все случаи
+        std::string json_path; ///< Файл для результатов в формате JSON Lines, пустой — не писать
+        double min_time = 0.5; ///< Минимальное суммарное время замера одного случая, секунд
+    };
+
+    /**
+     * @brief Разобрать аргументы командной строки.
+     *
+     * @details Неизвестные аргументы выводятся в stderr и игнорируются.
+     */
+    Options parseOptions(int argc, char **argv);
+
+    /**
+     * @brief Результат одного замера.
+     */
+    struct Result
+    {
+        std::string name;
+        std::size_t iterations;
+        double seconds_per_iteration;
+        double items_per_second;
+        double allocations_per_iteration;
+        std::size_t peak_heap_bytes; ///< Пик кучи сверх уровня до начала замера
+        std::size_t peak_rss_bytes;  ///< Пиковый RSS процесса после замера
+    };
+
+    /**
+     * @brief Не дать компилятору выбросить вычисление результата.
+     */
+    template <class T>
+    inline void doNotOptimize(const T &value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const void *sink;
+        sink = &value;
+#endif
+    }
+
+    /**
+     * @brief Набор замеров с общим выводом результатов.
+     */
+    class Suite
+    {
+    public:
+        /**
+         * @param name Имя набора
+         * @param min_time Минимальное суммарное время замера одного случая, секунд
+         */
+        explicit Suite(std::string name, double min_time = 0.5) : name(std::move(name))
+        {
+            options.min_time = min_time;
+        }
+
+        /**
+         * @param name Имя набора
+         * @param options Параметры запуска из `parseOptions`
+         */
+        Suite(std::string name, Options options) : name(std::move(name)), options(std::move(options)) {}
+
+        /**
+         * @brief Проверить, будет ли запущен случай с учётом фильтра.
+         *
+         * @details Позволяет не готовить входные данные для пропускаемых случаев.
+         */
+        bool enabled(const std::string &case_name) const
+        {
+            return options.filter.empty() || (name + "/" + case_name).find(options.filter) != std::string::npos;
+        }
+
+        /**
+         * @brief Замерить функцию.
+         *
+         * @details Функция вызывается один раз для прогрева, затем повторяется, пока суммарное время
+         *          не превысит `min_time`.
+         *
+         * @param case_name Имя случая
+         * @param items Количество обработанных элементов за один вызов (для расчёта пропускной способности)
+         * @param fn Замеряемая функция
+         * @return Результат или nullptr, если случай отключён фильтром
+         */
+        template <class F>
+        const Result *run(const std::string &case_name, std::size_t items, F &&fn)
+        {
+            using Clock = std::chrono::steady_clock;
+            if (!enabled(case_name))
+                return nullptr;
+            fn();
+
+            HeapStats before = heapStats();
+            resetPeak();
+            std::size_t iterations = 0;
+            double elapsed = 0;
+            auto start = Clock::now();
+            do
+            {
+                fn();
+                iterations++;
+                elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            } while (elapsed < options.min_time || iterations < 3);
+            HeapStats after = heapStats();
+
+            Result result;
+            result.name = case_name;
+            result.iterations = iterations;
+            result.seconds_per_iteration = elapsed / iterations;
+            result.items_per_second = items / result.seconds_per_iteration;
+            result.allocations_per_iteration = static_cast<double>(after.allocations - before.allocations) / iterations;
+            result.peak_heap_bytes = after.peak_bytes > before.current_bytes ? after.peak_bytes - before.current_bytes : 0;
+            result.peak_rss_bytes = peakRssBytes();
+            results.push_back(result);
+            return &results.back();
+        }
+
+        /**
+         * @brief Вывести таблицу результатов в stdout и, если задан `Options::json_path`, дописать их в файл.
+         */
+        void print() const;
+
+        /**
+         * @brief Дописать результаты в файл в формате JSON Lines.
+         *
+         * @details Первая запись в процессе перезаписывает файл, следующие наборы дописываются в конец.
+         *
+         * @param path Путь к файлу
+         * @return false, если файл не удалось открыть
+         */
+        bool writeJson(const std::string &path) const;
+
+        const std::vector<Result> &getResults() const { return results; }
+        const Options &getOptions() const { return options; }
+
+    private:
+        std::string name;
+        Options options;
+        std::vector<Result> results;
+    };
+}
+
+/** @} */
+
+#endif // LIB_BENCHMARK_H
@@ -0,0 +1,108 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+#include "../trace.h"
+
+/**
+ * Сохранить трассу во временный файл и вернуть его содержимое.
+ */
+static std::string writeTrace()
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "test_trace.json";
+    bool written = trace::write(path.string());
+    CHECK(written);
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    file.close();
+    std::filesystem::remove(path);
+    return content.str();
+}
+
+static std::size_t countOf(const std::string &text, const std::string &pattern)
+{
+    std::size_t count = 0;
+    for (std::size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+        count++;
+    return count;
+}
+
+TEST_CASE("Test trace")
+{
+    SUBCASE("Без записи события не сохраняются")
+    {
+        trace::start();
+        trace::stop();
+        {
+            trace::Span span("ignored");
+        }
+        std::string json = writeTrace();
+        CHECK(json.find("ignored") == std::string::npos);
+        CHECK(json.find("\"traceEvents\":[") != std::string::npos);
+    }
+
+    SUBCASE("События нескольких потоков")
+    {
+        const int THREADS = 4, SPANS = 10000;
+        trace::start();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; t++)
+        {
+            threads.emplace_back([t] {
+                trace::setThreadName("worker \"" + std::to_string(t) + "\"");
+                for (int i = 0; i < SPANS; i++)
+                {
+                    trace::Span outer("outer", "test");
+                    trace::Span inner("inner", "test");
+                }
+            });
+        }
+        // Сохранение во время записи не мешает потокам
+        writeTrace();
+        for (auto &thread : threads)
+            thread.join();
+        trace::stop();
+
+        std::string json = writeTrace();
+        CHECK(countOf(json, "\"name\":\"outer\"") == THREADS * SPANS);
+        CHECK(countOf(json, "\"name\":\"inner\"") == THREADS * SPANS);
+        CHECK(countOf(json, "\"ph\":\"X\"") == 2 * THREADS * SPANS);
+        CHECK(json.find("\"name\":\"worker \\\"0\\\"\"") != std::string::npos);
+        CHECK(trace::dropped() == 0);
+    }
+
+    SUBCASE("Новый сеанс отбрасывает старые события")
+    {
+        trace::start();
+        {
+            trace::Span span("first session");
+        }
+        trace::start();
+        {
+            trace::Span span("second session");
+        }
+        trace::stop();
+        std::string json = writeTrace();
+        CHECK(json.find("first session") == std::string::npos);
+        CHECK(json.find("second session") != std::string::npos);
+    }
+
+    SUBCASE("Лимит событий потока")
+    {
+        trace::start();
+        std::thread([] {
+            for (std::size_t i = 0; i < trace::MAX_EVENTS_PER_THREAD + 10; i++)
+                trace::Span span("spam");
+        }).join();
+        trace::stop();
+        CHECK(trace::dropped() == 10);
+    }
+}
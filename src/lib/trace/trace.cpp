@@ -0,0 +1,258 @@
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "trace.h"
+
+namespace
+{
+    struct Event
+    {
+        const char *name;
+        const char *category;
+        std::int64_t start;
+        std::int64_t end;
+    };
+
+    /**
+     * @brief Блок событий потока.
+     *
+     * @details Пишет в блок только поток-владелец; `size` публикует записанные события для `write`.
+     */
+    struct Block
+    {
+        static constexpr std::size_t CAPACITY = 4096;
+
+        Event events[CAPACITY];
+        std::atomic<std::size_t> size{0};
+        std::atomic<Block *> next{nullptr};
+    };
+
+    /**
+     * @brief Список блоков одного потока.
+     *
+     * @details Поток-владелец дописывает в `tail` и при заполнении подвешивает новый блок. Управляющие вызовы
+     *          под `control_mutex` читают список от `head` и освобождают заполненные блоки перед `tail`:
+     *          владелец к ним уже не обращается.
+     */
+    struct ThreadBuffer
+    {
+        std::atomic<Block *> head;
+        std::atomic<Block *> tail;
+        std::atomic<std::size_t> events{0};  ///< События сеанса, включая отброшенные
+        std::atomic<std::size_t> dropped{0};
+        std::uint32_t id;
+        std::string name;
+
+        explicit ThreadBuffer(std::uint32_t id) : id(id)
+        {
+            Block *block = new Block;
+            head.store(block);
+            tail.store(block);
+        }
+
+        ~ThreadBuffer()
+        {
+            for (Block *block = head.load(); block;)
+            {
+                Block *next = block->next.load();
+                delete block;
+                block = next;
+            }
+        }
+
+        void append(const Event &event)
+        {
+            if (events.fetch_add(1, std::memory_order_relaxed) >= trace::MAX_EVENTS_PER_THREAD)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            Block *block = tail.load(std::memory_order_relaxed);
+            std::size_t size = block->size.load(std::memory_order_relaxed);
+            if (size == Block::CAPACITY)
+            {
+                Block *next = new Block;
+                block->next.store(next, std::memory_order_release);
+                tail.store(next, std::memory_order_release);
+                block = next;
+                size = 0;
+            }
+            block->events[size] = event;
+            block->size.store(size + 1, std::memory_order_release);
+        }
+    };
+
+    // Запись можно вызывать из потоков, запущенных до `main` конструкторами статических объектов, поэтому
+    // состояние без константной инициализации создаётся при первом обращении, а не динамической
+    // инициализацией этой единицы трансляции, порядок которой не определён.
+    std::mutex control_mutex;       ///< Сериализует start/stop/write/dropped; конструктор `constexpr`
+    std::int64_t session_start = 0;
+
+    std::chrono::steady_clock::time_point processStart()
+    {
+        static const auto start = std::chrono::steady_clock::now();
+        return start;
+    }
+
+    /**
+     * @brief Буферы всех потоков.
+     *
+     * @details Не разрушается: буферы живут до конца процесса, даже после выхода потока и разрушения
+     *          статических объектов.
+     */
+    struct Registry
+    {
+        std::mutex mutex; ///< Защищает `buffers` при регистрации потоков
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    };
+
+    Registry &registry()
+    {
+        static Registry *instance = new Registry;
+        return *instance;
+    }
+
+    ThreadBuffer &threadBuffer()
+    {
+        thread_local ThreadBuffer *buffer = nullptr;
+        if (!buffer)
+        {
+            Registry &threads = registry();
+            std::lock_guard<std::mutex> lock(threads.mutex);
+            threads.buffers.push_back(std::make_unique<ThreadBuffer>(static_cast<std::uint32_t>(threads.buffers.size() + 1)));
+            buffer = threads.buffers.back().get();
+        }
+        return *buffer;
+    }
+
+    std::vector<ThreadBuffer *> snapshotBuffers()
+    {
+        Registry &threads = registry();
+        std::lock_guard<std::mutex> lock(threads.mutex);
+        std::vector<ThreadBuffer *> result;
+        for (const auto &buffer : threads.buffers)
+            result.push_back(buffer.get());
+        return result;
+    }
+
+    void writeJsonString(std::ostream &out, const char *text)
+    {
+        out << '"';
+        for (const char *c = text; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                out << '\\' << *c;
+            else if (static_cast<unsigned char>(*c) < 0x20)
+                out << ' ';
+            else
+                out << *c;
+        }
+        out << '"';
+    }
+}
+
+namespace trace
+{
+    namespace detail
+    {
+        std::atomic<bool> recording{false};
+
+        std::int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - processStart()).count();
+        }
+
+        void record(const char *name, const char *category, std::int64_t start, std::int64_t end)
+        {
+            if (enabled())
+                threadBuffer().append({name, category, start, end});
+        }
+    }
+
+    void start()
+    {
+        std::lock_guard<std::mutex> lock(control_mutex);
+        for (ThreadBuffer *buffer : snapshotBuffers())
+        {
+            // События в оставшемся блоке `tail` отсекаются по `session_start` при записи
+            Block *tail = buffer->tail.load(std::memory_order_acquire);
+            for (Block *block = buffer->head.load(); block != tail;)
+            {
+                Block *next = block->next.load(std::memory_order_acquire);
+                delete block;
+                block = next;
+            }
+            buffer->head.store(tail);
+            buffer->events.store(0, std::memory_order_relaxed);
+            buffer->dropped.store(0, std::memory_order_relaxed);
+        }
+        session_start = detail::now();
+        detail::recording.store(true);
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(control_mutex);
+        detail::recording.store(false);
+    }
+
+    bool write(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(control_mutex);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        // Единицы формата — микросекунды
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        for (ThreadBuffer *buffer : snapshotBuffers())
+        {
+            if (!buffer->name.empty())
+            {
+                out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->id
+                    << ",\"args\":{\"name\":";
+                writeJsonString(out, buffer->name.c_str());
+                out << "}}";
+                first = false;
+            }
+            for (Block *block = buffer->head.load(); block; block = block->next.load(std::memory_order_acquire))
+            {
+                std::size_t size = block->size.load(std::memory_order_acquire);
+                for (std::size_t i = 0; i < size; i++)
+                {
+                    const Event &event = block->events[i];
+                    if (event.start < session_start)
+                        continue;
+                    out << (first ? "" : ",\n") << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"name\":";
+                    writeJsonString(out, event.name);
+                    out << ",\"cat\":";
+                    writeJsonString(out, event.category);
+                    out << ",\"ts\":" << event.start / 1000 << '.' << event.start % 1000 / 100
+                        << ",\"dur\":" << (event.end - event.start) / 1000 << '.' << (event.end - event.start) % 1000 / 100 << '}';
+                    first = false;
+                }
+            }
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out.flush());
+    }
+
+    std::size_t dropped()
+    {
+        std::lock_guard<std::mutex> lock(control_mutex);
+        std::size_t total = 0;
+        for (ThreadBuffer *buffer : snapshotBuffers())
+            total += buffer->dropped.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    void setThreadName(const std::string &name)
+    {
+        // Имя читает только `write` под `control_mutex`
+        std::lock_guard<std::mutex> lock(control_mutex);
+        threadBuffer().name = name;
+    }
+}
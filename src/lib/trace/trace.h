@@ -0,0 +1,124 @@
+/**
+ * @file trace.h
+ * @brief Запись трассы выполнения в формате Chrome trace events.
+ *
+ * @details Интервалы (`trace::Span`) пишутся в буфер своего потока без блокировок и по запросу сохраняются
+ *          в JSON, который открывают `chrome://tracing` и Perfetto UI. Библиотека не зависит ни от TSDB,
+ *          ни от приложения: её подключают и `tsdb`, и `app`, а трасса получается общей.
+ *
+ * @code
+ * trace::start();
+ * {
+ *     trace::Span span("parse", "tsdb");
+ *     parse(response);
+ * }
+ * trace::write("trace.json");
+ * @endcode
+ */
+
+/**
+ * @defgroup trace Трассировка
+ * @ingroup lib
+ * @brief Запись интервалов выполнения для разбора задержек после сеанса.
+ */
+/** @{ */
+
+#ifndef LIB_TRACE_H
+#define LIB_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace trace
+{
+    /// Предел событий одного потока в сеансе; остальные отбрасываются и учитываются в `dropped`
+    constexpr std::size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+    namespace detail
+    {
+        extern std::atomic<bool> recording;
+
+        std::int64_t now();
+        void record(const char *name, const char *category, std::int64_t start, std::int64_t end);
+    }
+
+    /**
+     * @brief Идёт ли запись.
+     */
+    inline bool enabled()
+    {
+        return detail::recording.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Начать новый сеанс записи.
+     *
+     * @details События прошлого сеанса отбрасываются. Вызовы `start`, `stop`, `write` и `dropped`
+     *          сериализуются между собой, запись интервалов при этом не блокируется.
+     */
+    void start();
+
+    /**
+     * @brief Остановить запись. Записанные события остаются до следующего `start`.
+     */
+    void stop();
+
+    /**
+     * @brief Сохранить события сеанса в JSON-файл формата Chrome trace events.
+     *
+     * @details Можно вызывать во время записи: сохраняются события, завершённые к моменту вызова.
+     *
+     * @param path Путь к файлу
+     * @return false, если файл не удалось записать
+     */
+    bool write(const std::string &path);
+
+    /**
+     * @brief Число событий сеанса, отброшенных из-за `MAX_EVENTS_PER_THREAD`.
+     */
+    std::size_t dropped();
+
+    /**
+     * @brief Задать имя текущего потока в трассе.
+     *
+     * @param name Имя потока
+     */
+    void setThreadName(const std::string &name);
+
+    /**
+     * @brief Интервал от создания до разрушения объекта.
+     *
+     * @details Когда запись выключена, конструктор и деструктор сводятся к чтению одного флага.
+     *          Строки имени и категории не копируются и должны жить до `write`, обычно это литералы.
+     */
+    class Span
+    {
+    public:
+        explicit Span(const char *name, const char *category = "app") : name(name), category(category)
+        {
+            if (enabled())
+                start_time = detail::now();
+        }
+
+        ~Span()
+        {
+            if (start_time >= 0)
+                detail::record(name, category, start_time, detail::now());
+        }
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+    private:
+        const char *name;
+        const char *category;
+        std::int64_t start_time = -1; ///< Начало в наносекундах от старта процесса, -1 — запись была выключена
+    };
+}
+
+/** @} */
+
+#endif // LIB_TRACE_H
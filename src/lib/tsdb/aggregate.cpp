@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include "aggregate.h"
+
+namespace
+{
+    constexpr double MISSING = std::numeric_limits<double>::quiet_NaN();
+
+    struct LabelSetHash
+    {
+        std::size_t operator()(const LabelSet &labels) const { return labels.hash(); }
+    };
+
+    /**
+     * @brief Если точки ряда занимают подряд идущие шаги сетки, вернуть шаг первой точки.
+     *
+     * @details Так лежат ответы `query_range` без пропусков: тогда колонку значений можно агрегировать
+     *          напрямую, без раскладки по сетке.
+     *
+     * @return Номер шага или -1, если между точками есть пропуски
+     */
+    std::ptrdiff_t contiguousOffset(const Series &series, double start, double step, std::size_t steps)
+    {
+        if (series.empty())
+            return -1;
+        double first = std::round((series.timestamps.front() - start) / step);
+        double last = std::round((series.timestamps.back() - start) / step);
+        if (first < 0 || last >= static_cast<double>(steps) || last - first != static_cast<double>(series.size() - 1))
+            return -1;
+        return static_cast<std::ptrdiff_t>(first);
+    }
+
+    /**
+     * @brief Разложить точки ряда по шагам сетки `[start, start + steps * step)`, пустые шаги — NaN.
+     */
+    void alignRow(const Series &series, double start, double step, std::size_t steps, double *row)
+    {
+        std::fill(row, row + steps, MISSING);
+        if (steps == 0)
+            return;
+        std::ptrdiff_t offset = contiguousOffset(series, start, step, steps);
+        if (offset >= 0)
+        {
+            std::memcpy(row + offset, series.values.data(), series.size() * sizeof(double));
+            return;
+        }
+        for (std::size_t i = 0; i < series.size(); i++)
+        {
+            double index = std::round((series.timestamps[i] - start) / step);
+            if (index < 0 || index >= static_cast<double>(steps))
+                continue;
+            row[static_cast<std::size_t>(index)] = series.values[i];
+        }
+    }
+
+    // Ядра агрегации по строке сетки. Отсутствующая точка (NaN) не даёт ветвления: выбор через условный
+    // оператор компилируется в blend, и циклы векторизуются.
+
+    void accumulateSum(const double *row, double *sum, double *count, std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            double value = row[i];
+            bool present = value == value;
+            sum[i] += present ? value : 0.0;
+            count[i] += present ? 1.0 : 0.0;
+        }
+    }
+
+    void accumulateMin(const double *row, double *min, double *count, std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            double value = row[i];
+            // Сравнение с NaN ложно, поэтому отсутствующая точка минимум не меняет
+            min[i] = value < min[i] ? value : min[i];
+            count[i] += value == value ? 1.0 : 0.0;
+        }
+    }
+
+    void accumulateMax(const double *row, double *max, double *count, std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            double value = row[i];
+            max[i] = value > max[i] ? value : max[i];
+            count[i] += value == value ? 1.0 : 0.0;
+        }
+    }
+
+    LabelSet groupLabels(const LabelSet &labels, const Grouping &grouping)
+    {
+        std::vector<LabelSet::Label> result;
+        for (const auto &label : labels)
+        {
+            bool listed = std::find(grouping.labels.begin(), grouping.labels.end(), label.first.str()) != grouping.labels.end();
+            if (listed != grouping.without)
+                result.push_back(label);
+        }
+        return LabelSet(std::move(result));
+    }
+
+    /**
+     * @brief Агрегат группы по строкам `rows` на сетке `grid` (значения `grid.values` не используются).
+     */
+    Series aggregateGroup(const std::vector<SeriesRef> &series, const std::vector<std::size_t> &rows, const SeriesGrid &grid,
+                          Aggregation op, double quantile)
+    {
+        std::size_t n = grid.steps;
+        Series result;
+        if (op == Aggregation::Quantile)
+        {
+            // Квантилю нужны все значения шага сразу: строки группы выравниваются в общий массив
+            std::vector<double> values(rows.size() * n);
+            for (std::size_t r = 0; r < rows.size(); r++)
+                alignRow(*series[rows[r]].series, grid.start, grid.step, n, values.data() + r * n);
+            std::vector<double> column;
+            column.reserve(rows.size());
+            for (std::size_t i = 0; i < n; i++)
+            {
+                column.clear();
+                for (std::size_t r = 0; r < rows.size(); r++)
+                {
+                    double value = values[r * n + i];
+                    if (value == value)
+                        column.push_back(value);
+                }
+                if (!column.empty())
+                    result.push_back(grid.timestamp(i), quantileOf(column, quantile));
+            }
+            return result;
+        }
+
+        double initial = op == Aggregation::Min ? std::numeric_limits<double>::infinity()
+                         : op == Aggregation::Max ? -std::numeric_limits<double>::infinity()
+                                                  : 0.0;
+        std::vector<double> accumulator(n, initial);
+        std::vector<double> count(n, 0.0);
+        std::vector<double> row(n);
+        for (std::size_t r : rows)
+        {
+            // Ряд без пропусков агрегируется прямо из своей колонки, остальные — через раскладку по сетке
+            const Series &s = *series[r].series;
+            std::ptrdiff_t offset = contiguousOffset(s, grid.start, grid.step, n);
+            const double *values = s.values.data();
+            std::size_t size = s.size();
+            if (offset < 0)
+            {
+                alignRow(s, grid.start, grid.step, n, row.data());
+                values = row.data();
+                size = n;
+                offset = 0;
+            }
+            double *acc = accumulator.data() + offset;
+            double *cnt = count.data() + offset;
+            if (op == Aggregation::Min)
+                accumulateMin(values, acc, cnt, size);
+            else if (op == Aggregation::Max)
+                accumulateMax(values, acc, cnt, size);
+            else
+                accumulateSum(values, acc, cnt, size);
+        }
+
+        for (std::size_t i = 0; i < n; i++)
+        {
+            if (count[i] == 0)
+                continue;
+            double value = accumulator[i];
+            if (op == Aggregation::Avg)
+                value /= count[i];
+            else if (op == Aggregation::Count)
+                value = count[i];
+            result.push_back(grid.timestamp(i), value);
+        }
+        return result;
+    }
+
+    /**
+     * @brief Начало и число шагов сетки, покрывающей все ряды.
+     */
+    SeriesGrid gridBounds(const std::vector<SeriesRef> &series, double step)
+    {
+        SeriesGrid grid;
+        grid.step = step;
+        double first = std::numeric_limits<double>::infinity();
+        double last = -std::numeric_limits<double>::infinity();
+        for (const auto &ref : series)
+        {
+            if (ref.series->empty())
+                continue;
+            first = std::min(first, ref.series->timestamps.front());
+            last = std::max(last, ref.series->timestamps.back());
+        }
+        if (!(step > 0) || first > last)
+            return grid;
+        grid.start = first;
+        grid.steps = static_cast<std::size_t>(std::round((last - first) / step)) + 1;
+        return grid;
+    }
+}
+
+SeriesGrid alignSeries(const std::vector<SeriesRef> &series, double step)
+{
+    SeriesGrid grid = gridBounds(series, step);
+    if (grid.steps == 0)
+        return grid;
+    grid.rows = series.size();
+    grid.values.resize(grid.rows * grid.steps);
+    for (std::size_t r = 0; r < grid.rows; r++)
+        alignRow(*series[r].series, grid.start, grid.step, grid.steps, grid.row(r));
+    return grid;
+}
+
+std::vector<Metric> aggregateSeries(const std::vector<SeriesRef> &series, Aggregation op, double step, const Grouping &grouping,
+                                    double quantile)
+{
+    // Сетка общая для всех групп, сами ряды выравниваются по одному в буфер группы: память O(групп * шагов)
+    SeriesGrid grid = gridBounds(series, step);
+    std::vector<Metric> result;
+    if (grid.steps == 0)
+        return result;
+
+    std::unordered_map<LabelSet, std::size_t, LabelSetHash> groups;
+    std::vector<std::vector<std::size_t>> members;
+    for (std::size_t i = 0; i < series.size(); i++)
+    {
+        LabelSet labels = groupLabels(*series[i].labels, grouping);
+        auto [it, inserted] = groups.try_emplace(labels, result.size());
+        if (inserted)
+        {
+            Metric metric;
+            metric.labels = std::move(labels);
+            result.push_back(std::move(metric));
+            members.emplace_back();
+        }
+        members[it->second].push_back(i);
+    }
+
+    for (std::size_t g = 0; g < result.size(); g++)
+        result[g].series = aggregateGroup(series, members[g], grid, op, quantile);
+    return result;
+}
+
+std::vector<Metric> aggregateSeries(const std::vector<Metric> &metrics, Aggregation op, double step, const Grouping &grouping, double quantile)
+{
+    std::vector<SeriesRef> series;
+    series.reserve(metrics.size());
+    for (const auto &metric : metrics)
+        series.push_back({&metric.labels, &metric.series});
+    return aggregateSeries(series, op, step, grouping, quantile);
+}
+
+Series aggregateOverTime(const Series &series, Aggregation op, double window, double quantile)
+{
+    Series result;
+    std::size_t n = series.size();
+    if (n == 0 || !(window > 0))
+        return result;
+    result.reserve(n);
+    const double *ts = series.timestamps.data();
+    const double *vs = series.values.data();
+
+    if (op == Aggregation::Min || op == Aggregation::Max)
+    {
+        // Монотонная очередь индексов: в голове — экстремум окна, каждый индекс входит и выходит один раз
+        std::vector<std::size_t> queue;
+        queue.reserve(n);
+        std::size_t head = 0;
+        bool min = op == Aggregation::Min;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            while (queue.size() > head && (min ? vs[queue.back()] >= vs[i] : vs[queue.back()] <= vs[i]))
+                queue.pop_back();
+            queue.push_back(i);
+            while (ts[queue[head]] <= ts[i] - window)
+                head++;
+            result.push_back(ts[i], vs[queue[head]]);
+        }
+        return result;
+    }
+
+    std::size_t first = 0;
+    if (op == Aggregation::Quantile)
+    {
+        std::vector<double> values;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            while (ts[first] <= ts[i] - window)
+                first++;
+            values.assign(vs + first, vs + i + 1);
+            result.push_back(ts[i], quantileOf(values, quantile));
+        }
+        return result;
+    }
+
+    // Сумма окна — разность префиксных сумм
+    std::vector<double> prefix(n + 1, 0.0);
+    for (std::size_t i = 0; i < n; i++)
+        prefix[i + 1] = prefix[i] + vs[i];
+    for (std::size_t i = 0; i < n; i++)
+    {
+        while (ts[first] <= ts[i] - window)
+            first++;
+        double count = static_cast<double>(i + 1 - first);
+        double sum = prefix[i + 1] - prefix[first];
+        double value = op == Aggregation::Sum ? sum : op == Aggregation::Avg ? sum / count : count;
+        result.push_back(ts[i], value);
+    }
+    return result;
+}
+
+double quantileOf(std::vector<double> &values, double q)
+{
+    if (values.empty() || std::isnan(q))
+        return MISSING;
+    if (q < 0)
+        return -std::numeric_limits<double>::infinity();
+    if (q > 1)
+        return std::numeric_limits<double>::infinity();
+    double rank = q * static_cast<double>(values.size() - 1);
+    auto lower = static_cast<std::size_t>(rank);
+    double weight = rank - static_cast<double>(lower);
+    std::nth_element(values.begin(), values.begin() + lower, values.end());
+    double low = values[lower];
+    if (weight == 0 || lower + 1 >= values.size())
+        return low;
+    // После nth_element правее `lower` лежат значения не меньше: следующее по порядку — их минимум
+    double high = *std::min_element(values.begin() + lower + 1, values.end());
+    return low + (high - low) * weight;
+}
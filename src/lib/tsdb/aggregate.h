@@ -0,0 +1,137 @@
+/**
+ * @file aggregate.h
+ * @brief Агрегация загруженных рядов на стороне клиента.
+ *
+ * @details Содержит агрегаты sum, avg, min, max, count и quantile по рядам результата (с группировкой по меткам,
+ *          как `sum by (...)` в PromQL) и по скользящему окну времени внутри ряда (как `*_over_time`).
+ *          Переключение агрегата не требует нового запроса к TSDB: ряды выравниваются по сетке шага в
+ *          колоночный массив, по которому агрегаты считаются простыми циклами без ветвлений, которые
+ *          компилятор векторизует.
+ */
+
+/**
+ * @addtogroup tsdb
+ * @{
+ */
+
+#ifndef TSDB_AGGREGATE_H
+#define TSDB_AGGREGATE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "labels.h"
+#include "tsdb.h"
+
+/**
+ * @brief Агрегатная функция.
+ */
+enum class Aggregation
+{
+    Sum,
+    Avg,
+    Min,
+    Max,
+    Count,
+    Quantile
+};
+
+/**
+ * @brief Ряд-аргумент агрегации: метки и точки без копирования.
+ */
+struct SeriesRef
+{
+    const LabelSet *labels;
+    const Series *series;
+};
+
+/**
+ * @brief Ряды, выровненные по общей сетке шага.
+ *
+ * @details Значения хранятся построчно: у каждого ряда непрерывный массив из `steps` значений, NaN — на шаге
+ *          нет точки. Метка шага `i` равна `start + i * step`.
+ */
+struct SeriesGrid
+{
+    double start = 0;
+    double step = 0;
+    std::size_t steps = 0;
+    std::size_t rows = 0;
+    std::vector<double> values; ///< `rows * steps` значений
+
+    double timestamp(std::size_t i) const { return start + static_cast<double>(i) * step; }
+    const double *row(std::size_t r) const { return values.data() + r * steps; }
+    double *row(std::size_t r) { return values.data() + r * steps; }
+};
+
+/**
+ * @brief Выровнять ряды по сетке шага.
+ *
+ * @details Сетка начинается с самой ранней метки среди рядов. Точка попадает на ближайший шаг, при совпадении
+ *          шага остаётся более поздняя точка. Ответы `query_range` уже лежат на сетке и переносятся без
+ *          изменений, сырые точки remote read округляются до шага.
+ *
+ * @param series Ряды, упорядоченные по времени
+ * @param step Шаг сетки в секундах, больше нуля
+ * @return Сетка; пустая, если точек нет
+ */
+SeriesGrid alignSeries(const std::vector<SeriesRef> &series, double step);
+
+/**
+ * @brief Группировка рядов при агрегации.
+ */
+struct Grouping
+{
+    std::vector<std::string> labels; ///< Метки группировки
+    bool without = false;            ///< false — группы по `labels` (`by`), true — по всем меткам, кроме `labels`
+};
+
+/**
+ * @brief Агрегировать ряды по группам на каждом шаге сетки.
+ *
+ * @details Как и в PromQL, у результата нет имени метрики, а метки — метки группы. Отсутствующие точки не
+ *          участвуют в агрегате; шаг, на котором у группы нет ни одной точки, в результат не попадает.
+ *          Квантиль считается с линейной интерполяцией между соседними значениями, уровень вне `[0, 1]`
+ *          даёт ±бесконечность, как `quantile` в PromQL.
+ *
+ * @param series Ряды, упорядоченные по времени
+ * @param op Агрегат
+ * @param step Шаг сетки в секундах, больше нуля
+ * @param grouping Группировка; по умолчанию все ряды в одной группе
+ * @param quantile Уровень квантиля для `Aggregation::Quantile`
+ * @return Ряд на каждую группу в порядке первого появления группы
+ */
+std::vector<Metric> aggregateSeries(const std::vector<SeriesRef> &series, Aggregation op, double step, const Grouping &grouping = {},
+                                    double quantile = 0.5);
+
+std::vector<Metric> aggregateSeries(const std::vector<Metric> &metrics, Aggregation op, double step, const Grouping &grouping = {},
+                                    double quantile = 0.5);
+
+/**
+ * @brief Агрегировать ряд по скользящему окну времени.
+ *
+ * @details Точка результата в момент каждой точки ряда `t` — агрегат точек из полуинтервала `(t - window, t]`,
+ *          как `sum_over_time(x[window])` в PromQL. Сумма, среднее и число точек считаются за O(n),
+ *          минимум и максимум — монотонной очередью за O(n), квантиль — выбором внутри каждого окна.
+ *
+ * @param series Ряд, упорядоченный по времени
+ * @param op Агрегат
+ * @param window Ширина окна в секундах, больше нуля
+ * @param quantile Уровень квантиля для `Aggregation::Quantile`
+ * @return Ряд с теми же метками времени
+ */
+Series aggregateOverTime(const Series &series, Aggregation op, double window, double quantile = 0.5);
+
+/**
+ * @brief Квантиль значений с линейной интерполяцией, как `quantile` в PromQL.
+ *
+ * @param values Значения, порядок после вызова не определён
+ * @param q Уровень квантиля
+ * @return NaN для пустого набора, ±бесконечность для уровня вне `[0, 1]`
+ */
+double quantileOf(std::vector<double> &values, double q);
+
+/** @} */
+
+#endif // TSDB_AGGREGATE_H
@@ -0,0 +1,129 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "../aggregate.h"
+#include "../downsample.h"
+#include "../prefix_index.h"
+#include "../pyramid.h"
+#include "../tsdb.h"
+
+static Metric makeMetric(int labels)
+{
+    Metric metric;
+    metric.name = "http_request_duration_seconds_bucket";
+    std::vector<LabelSet::Label> items;
+    for (int i = 0; i < labels; i++)
+        items.emplace_back("label_" + std::to_string(i), "value-" + std::to_string(i * 7919));
+    metric.labels = LabelSet(std::move(items));
+    return metric;
+}
+
+static Series makeSeries(std::size_t points)
+{
+    Series series;
+    series.reserve(points);
+    for (std::size_t i = 0; i < points; i++)
+        series.push_back(1700000000.0 + i * 15, std::sin(i * 0.01) + (i % 997 == 0 ? 50 : 0));
+    return series;
+}
+
+int main(int argc, char **argv)
+{
+    benchmark::Options options = benchmark::parseOptions(argc, argv);
+
+    // Имя ряда считается для каждого ряда каждого ответа и служит ключом в кэше и при склейке частей
+    benchmark::Suite names("format_line_name", options);
+    for (int labels : {0, 3, 10})
+    {
+        Metric metric = makeMetric(labels);
+        names.run(std::to_string(labels) + " labels", 1, [&] { benchmark::doNotOptimize(TSDBClient::format_line_name(metric)); });
+    }
+    names.print();
+
+    // Сопоставление рядов в кэше и при склейке частей ответа
+    benchmark::Suite keys("SeriesKey", options);
+    for (int labels : {3, 10})
+    {
+        Metric metric = makeMetric(labels);
+        Metric other = makeMetric(labels);
+        SeriesKeyHash hash;
+        keys.run("hash " + std::to_string(labels) + " labels", 1, [&] { benchmark::doNotOptimize(hash(metric.key())); });
+        keys.run("equal " + std::to_string(labels) + " labels", 1, [&] { benchmark::doNotOptimize(metric.key() == other.key()); });
+        keys.run("build LabelSet " + std::to_string(labels) + " labels", 1, [&] { benchmark::doNotOptimize(makeMetric(labels)); });
+    }
+    keys.print();
+
+    benchmark::Suite series("Series", options);
+    for (std::size_t points : {1000, 100000})
+    {
+        std::string size = std::to_string(points);
+        Series base = makeSeries(points);
+        Series tail = base.slice(base.timestamps[points / 2], base.timestamps.back());
+        Series left = base.slice(base.timestamps.front(), base.timestamps[points / 2]);
+        series.run("merge half-overlapping " + size, points, [&] {
+            Series merged = left;
+            merged.merge(tail);
+            benchmark::doNotOptimize(merged);
+        });
+        series.run("downsampleM4 " + size + " -> 900px", points, [&] {
+            benchmark::doNotOptimize(downsampleM4(base, base.timestamps.front(), base.timestamps.back(), 900));
+        });
+        series.run("downsampleLTTB " + size + " -> 1800", points, [&] { benchmark::doNotOptimize(downsampleLTTB(base, 1800)); });
+        series.run("pyramid build " + size, points, [&] {
+            SeriesPyramid pyramid;
+            pyramid.build(base, 60);
+            benchmark::doNotOptimize(pyramid);
+        });
+    }
+    series.print();
+
+    // Переключение агрегата в интерфейсе пересчитывает его по уже загруженным рядам
+    benchmark::Suite aggregation("Aggregation", options);
+    for (auto [count, points] : {std::pair<int, std::size_t>{10, 240}, {100, 1440}, {1000, 1440}})
+    {
+        std::vector<Metric> metrics;
+        for (int i = 0; i < count; i++)
+        {
+            Metric metric = makeMetric(3);
+            metric.labels = LabelSet({{"instance", std::to_string(i)}, {"job", "job-" + std::to_string(i % 10)}});
+            metric.series = makeSeries(points);
+            metrics.push_back(std::move(metric));
+        }
+        std::string shape = std::to_string(count) + "x" + std::to_string(points);
+        std::size_t items = count * points;
+        aggregation.run("sum " + shape, items, [&] { benchmark::doNotOptimize(aggregateSeries(metrics, Aggregation::Sum, 15)); });
+        aggregation.run("max by (job) " + shape, items,
+                        [&] { benchmark::doNotOptimize(aggregateSeries(metrics, Aggregation::Max, 15, {{"job"}, false})); });
+        aggregation.run("quantile 0.9 " + shape, items,
+                        [&] { benchmark::doNotOptimize(aggregateSeries(metrics, Aggregation::Quantile, 15, {}, 0.9)); });
+        aggregation.run("avg_over_time 5m " + shape, items, [&] {
+            for (const auto &metric : metrics)
+                benchmark::doNotOptimize(aggregateOverTime(metric.series, Aggregation::Avg, 300));
+        });
+    }
+    aggregation.print();
+
+    // Подсказки пересчитываются на каждое нажатие клавиши в поле запроса
+    benchmark::Suite completion("Completion", options);
+    for (int count : {10'000, 100'000})
+    {
+        std::vector<std::string> names;
+        const char *subsystems[] = {"node", "http", "process", "go", "prometheus", "container", "kube"};
+        for (int i = 0; i < count; i++)
+            names.push_back(std::string(subsystems[i % 7]) + "_metric_" + std::to_string(i * 7919 % count) + "_total");
+        PrefixIndex index(names);
+        std::string size = std::to_string(count) + " names";
+        completion.run("build " + size, count, [&] { benchmark::doNotOptimize(PrefixIndex(names)); });
+        completion.run("prefix " + size, 1, [&] { benchmark::doNotOptimize(index.findPrefix("http_metric_12", 8)); });
+        completion.run("fuzzy " + size, 1, [&] { benchmark::doNotOptimize(index.findFuzzy("htmet12", 8)); });
+        completion.run("merge 100 into " + size, count, [&] {
+            std::vector<std::string> added(names.begin(), names.begin() + 100);
+            added.push_back("new_metric_total");
+            benchmark::doNotOptimize(index.merged(std::move(added)));
+        });
+    }
+    completion.print();
+    return 0;
+}
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <exception>
+
+#include "cache.h"
+
+namespace
+{
+    /**
+     * @brief Отдать свободный резерв колонок ряда.
+     *
+     * @details Ответ TSDB и склейка оставляют в колонках запас под будущие точки. В кэше ряд живёт долго,
+     *          и запас занимал бы лимит памяти, вытесняя полезные ключи раньше времени.
+     */
+    void compact(Series &series)
+    {
+        if (series.size() * 4 < series.timestamps.capacity() * 3)
+        {
+            series.timestamps.shrink_to_fit();
+            series.values.shrink_to_fit();
+        }
+    }
+
+    /// Округление вниз до кратного `step`, корректное и для отрицательных значений
+    std::time_t alignDown(std::time_t value, int step)
+    {
+        std::time_t rem = value % step;
+        return rem < 0 ? value - rem - step : value - rem;
+    }
+}
+
+CachingTSDBClient::CachingTSDBClient(std::shared_ptr<TSDBClient> backend, std::size_t memory_limit)
+    : backend(std::move(backend)), memory_limit(memory_limit) {}
+
+std::vector<Metric> CachingTSDBClient::query(const std::string &query_str, std::time_t start, std::time_t end)
+{
+    return query(query_str, start, end, DEFAULT_STEP);
+}
+
+std::vector<Metric> CachingTSDBClient::query(const std::string &query_str, std::time_t start, std::time_t end, int step)
+{
+    if (step <= 0)
+        return backend->query(query_str, start, end, step);
+
+    Extent range{alignDown(start, step), alignDown(end, step)};
+    if (range.second < range.first)
+        return {};
+
+    std::string key = makeKey(query_str, step);
+    for (const auto &extent : lookup(key, range, step))
+    {
+        std::vector<Metric> fetched = backend->query(query_str, extent.first, extent.second, step);
+        store(key, std::move(fetched), extent, step);
+    }
+
+    std::vector<Metric> result;
+    if (!collect(key, range, result))
+    {
+        // Ключ успели вытеснить параллельные запросы — отдаём данные напрямую
+        return backend->query(query_str, range.first, range.second, step);
+    }
+    return result;
+}
+
+std::vector<RangeQueryResult> CachingTSDBClient::queryBatch(const std::vector<RangeQuery> &queries)
+{
+    std::vector<RangeQueryResult> results(queries.size());
+    std::vector<std::string> keys(queries.size());
+    std::vector<Extent> ranges(queries.size());
+    std::vector<RangeQuery> fetches; // Непокрытые интервалы всех запросов уходят в TSDB одним пакетом
+    std::vector<std::size_t> owners;
+    std::vector<bool> whole(queries.size(), false); // Запрос загружается целиком одним интервалом
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        const RangeQuery &query = queries[i];
+        if (query.step <= 0)
+        {
+            fetches.push_back(query);
+            owners.push_back(i);
+            continue;
+        }
+        ranges[i] = {alignDown(query.start, query.step), alignDown(query.end, query.step)};
+        if (ranges[i].second < ranges[i].first)
+            continue;
+        keys[i] = makeKey(query.query, query.step);
+        std::vector<Extent> missing = lookup(keys[i], ranges[i], query.step);
+        whole[i] = missing.size() == 1 && missing[0] == ranges[i];
+        for (const auto &extent : missing)
+        {
+            fetches.push_back({query.query, extent.first, extent.second, query.step});
+            owners.push_back(i);
+        }
+    }
+
+    std::vector<RangeQueryResult> fetched = backend->queryBatch(fetches);
+    for (std::size_t k = 0; k < fetches.size(); k++)
+    {
+        RangeQueryResult &result = results[owners[k]];
+        if (fetched[k].error)
+        {
+            result.error = fetched[k].error;
+            continue;
+        }
+        if (fetches[k].step > 0)
+            store(keys[owners[k]], *fetched[k].metrics, {fetches[k].start, fetches[k].end}, fetches[k].step);
+        // Ответ на весь запрос совпадает с тем, что собрал бы из кэша `collect`: отдаём его без копии
+        if (fetches[k].step <= 0 || whole[owners[k]])
+            result.metrics = std::move(fetched[k].metrics);
+    }
+
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        if (results[i].error || results[i].metrics)
+            continue;
+        std::vector<Metric> collected;
+        if (keys[i].empty() || collect(keys[i], ranges[i], collected))
+        {
+            results[i].metrics = std::make_shared<const std::vector<Metric>>(std::move(collected));
+            continue;
+        }
+        try
+        {
+            results[i].metrics =
+                std::make_shared<const std::vector<Metric>>(backend->query(queries[i].query, ranges[i].first, ranges[i].second, queries[i].step));
+        }
+        catch (...)
+        {
+            results[i].error = std::current_exception();
+        }
+    }
+    return results;
+}
+
+std::string CachingTSDBClient::makeKey(const std::string &query_str, int step)
+{
+    return query_str + '\n' + std::to_string(step);
+}
+
+std::vector<CachingTSDBClient::Extent> CachingTSDBClient::lookup(const std::string &key, Extent range, int step)
+{
+    std::vector<Extent> missing;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end())
+    {
+        missing.push_back(range);
+    }
+    else
+    {
+        lru.splice(lru.begin(), lru, it->second.lru);
+        missing = missingExtents(it->second.extents, range, step);
+    }
+
+    if (missing.empty())
+        stats.hits++;
+    else if (missing.size() == 1 && missing[0] == range)
+        stats.misses++;
+    else
+        stats.partial_hits++;
+    stats.fetches += missing.size();
+    return missing;
+}
+
+bool CachingTSDBClient::collect(const std::string &key, Extent range, std::vector<Metric> &result) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return false;
+
+    for (const auto &metric : it->second.metrics)
+    {
+        Series points = metric.series.slice(static_cast<double>(range.first), static_cast<double>(range.second));
+        if (points.empty())
+            continue;
+        result.push_back({metric.name, metric.labels, std::move(points)});
+    }
+    return true;
+}
+
+bool CachingTSDBClient::isAvailable() noexcept
+{
+    return backend->isAvailable();
+}
+
+CachingTSDBClient::Stats CachingTSDBClient::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void CachingTSDBClient::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    lru.clear();
+    stats.memory_bytes = 0;
+}
+
+std::vector<CachingTSDBClient::Extent> CachingTSDBClient::missingExtents(const std::vector<Extent> &extents, Extent range, int step)
+{
+    std::vector<Extent> missing;
+    std::time_t cursor = range.first;
+    for (const auto &extent : extents)
+    {
+        if (extent.second < cursor)
+            continue;
+        if (extent.first > range.second)
+            break;
+        if (extent.first > cursor)
+            missing.emplace_back(cursor, extent.first - step);
+        cursor = std::max(cursor, extent.second + step);
+    }
+    if (cursor <= range.second)
+        missing.emplace_back(cursor, range.second);
+    return missing;
+}
+
+void CachingTSDBClient::addExtent(std::vector<Extent> &extents, Extent extent, int step)
+{
+    auto pos = std::lower_bound(extents.begin(), extents.end(), extent);
+    extents.insert(pos, extent);
+
+    // Склеиваем пересекающиеся и соседние по сетке интервалы
+    std::vector<Extent> merged;
+    merged.reserve(extents.size());
+    for (const auto &e : extents)
+    {
+        if (!merged.empty() && e.first <= merged.back().second + step)
+            merged.back().second = std::max(merged.back().second, e.second);
+        else
+            merged.push_back(e);
+    }
+    extents = std::move(merged);
+}
+
+std::size_t CachingTSDBClient::estimateBytes(const Metric &metric)
+{
+    // Строки меток интернированы и общие для всех рядов, поэтому учитываются только ссылки на них.
+    // Колонки считаются по ёмкости — это реально занятая память; `store` ужимает их перед подсчётом
+    std::size_t bytes = sizeof(Metric) + metric.labels.size() * sizeof(LabelSet::Label);
+    bytes += (metric.series.timestamps.capacity() + metric.series.values.capacity()) * sizeof(double);
+    return bytes;
+}
+
+void CachingTSDBClient::store(const std::string &key, std::vector<Metric> fetched, Extent extent, int step)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end())
+    {
+        it = entries.emplace(key, Entry{}).first;
+        lru.push_front(key);
+        it->second.lru = lru.begin();
+    }
+    Entry &entry = it->second;
+
+    for (auto &metric : fetched)
+    {
+        SeriesKey id = metric.key();
+        auto found = entry.index.find(id);
+        if (found == entry.index.end())
+        {
+            entry.index.emplace(std::move(id), entry.metrics.size());
+            compact(metric.series);
+            std::size_t bytes = estimateBytes(metric);
+            entry.bytes += bytes;
+            stats.memory_bytes += bytes;
+            entry.metrics.push_back(std::move(metric));
+            continue;
+        }
+
+        Metric &cached = entry.metrics[found->second];
+        std::size_t before = estimateBytes(cached);
+        cached.series.merge(metric.series);
+        compact(cached.series);
+        std::size_t after = estimateBytes(cached);
+        entry.bytes += after - before;
+        stats.memory_bytes += after - before;
+    }
+
+    // Самые свежие точки TSDB может ещё дописать — такой участок не считаем загруженным
+    std::time_t horizon = alignDown(now() - FRESHNESS_LAG, step);
+    extent.second = std::min(extent.second, horizon);
+    if (extent.first <= extent.second)
+        addExtent(entry.extents, extent, step);
+
+    evict(key);
+}
+
+void CachingTSDBClient::evict(const std::string &keep)
+{
+    while (stats.memory_bytes > memory_limit && !lru.empty())
+    {
+        const std::string &victim = lru.back();
+        if (victim == keep)
+            break;
+        auto it = entries.find(victim);
+        stats.memory_bytes -= it->second.bytes;
+        stats.evictions++;
+        entries.erase(it);
+        lru.pop_back();
+    }
+}
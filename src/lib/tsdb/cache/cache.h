@@ -0,0 +1,184 @@
+/**
+ * @file cache.h
+ * @brief Кэширующая обёртка над клиентом TSDB.
+ *
+ * @details Содержит класс `CachingTSDBClient`, который запоминает результаты запросов и при повторных
+ *          запросах того же выражения с тем же шагом догружает из TSDB только недостающие участки диапазона.
+ */
+
+/**
+ * @defgroup cache Кэш запросов
+ * @ingroup tsdb
+ * @brief Кэширование результатов запросов к TSDB.
+ *
+ * @details Модуль включает `CachingTSDBClient` — декоратор над любым `TSDBClient`.
+ */
+/** @{ */
+
+#ifndef TSDB_CACHE_H
+#define TSDB_CACHE_H
+
+#include <cstddef>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../tsdb.h"
+
+/**
+ * @brief Клиент TSDB с кэшем результатов, выровненных по шагу.
+ *
+ * @details Ключ кэша — строка запроса и шаг. Границы запроса выравниваются по сетке шага
+ *          (`start` вниз, `end` вниз до последней точки сетки), поэтому точки из разных запросов
+ *          совпадают и их можно склеивать. Для каждого ключа хранятся загруженные интервалы и ряды;
+ *          новый запрос отправляет в TSDB только непокрытые интервалы и вшивает полученные точки в кэш.
+ *
+ *          Последние `FRESHNESS_LAG` секунд до текущего момента не считаются загруженными: точки,
+ *          которые TSDB ещё не успела записать, будут запрошены снова.
+ *
+ *          Объём кэша ограничен: при превышении лимита вытесняются давно не использованные ключи.
+ *          Методы потокобезопасны; запросы к TSDB выполняются без удержания блокировки.
+ */
+class CachingTSDBClient : public TSDBClient
+{
+public:
+    /// Шаг по умолчанию для запроса без шага, секунд
+    static constexpr int DEFAULT_STEP = 15;
+    /// Интервал до текущего момента, который не считается окончательно загруженным, секунд
+    static constexpr std::time_t FRESHNESS_LAG = 60;
+
+    /**
+     * @brief Счётчики работы кэша.
+     */
+    struct Stats
+    {
+        std::size_t hits = 0;         ///< Запросы, полностью обслуженные из кэша
+        std::size_t partial_hits = 0; ///< Запросы, для которых догружалась только часть диапазона
+        std::size_t misses = 0;       ///< Запросы, для которых диапазон загружался целиком
+        std::size_t fetches = 0;      ///< Запросы, отправленные в TSDB
+        std::size_t evictions = 0;    ///< Вытесненные ключи
+        std::size_t memory_bytes = 0; ///< Текущий оценочный объём кэша
+    };
+
+    /**
+     * @brief Конструктор кэширующего клиента.
+     *
+     * @param backend Клиент, к которому уходят непокрытые запросы
+     * @param memory_limit Ограничение объёма кэша в байтах
+     */
+    CachingTSDBClient(std::shared_ptr<TSDBClient> backend, std::size_t memory_limit);
+    ~CachingTSDBClient() override = default;
+
+    /**
+     * @brief Выполнить запрос с шагом `DEFAULT_STEP`.
+     */
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end) override;
+
+    /**
+     * @brief Выполнить запрос, используя кэш.
+     *
+     * @param query_str Строка запроса
+     * @param start Начало временного диапазона
+     * @param end Конец временного диапазона
+     * @param step Интервал между точками в секундах
+     * @return Точки рядов на сетке шага внутри `[start, end]`
+     * @throws InvalidTSDBRequest Если TSDB вернула ошибку при догрузке
+     */
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end, int step) override;
+
+    /**
+     * @brief Выполнить несколько запросов, используя кэш.
+     *
+     * @details Непокрытые интервалы всех запросов отправляются в TSDB одним пакетом через
+     *          `queryBatch` клиента, поэтому догрузка не выстраивается в очередь по запросам.
+     *          Запрос, загруженный целиком одним интервалом, получает ряды клиента без копии;
+     *          в кэш кладётся их копия.
+     */
+    std::vector<RangeQueryResult> queryBatch(const std::vector<RangeQuery> &queries) override;
+
+    /**
+     * @brief Проверить доступность TSDB.
+     */
+    bool isAvailable() noexcept override;
+
+    /**
+     * @brief Получить имена меток у клиента, которому делегируются запросы. Не кэшируется.
+     */
+    std::vector<std::string> labelNames(std::time_t start, std::time_t end) override { return backend->labelNames(start, end); }
+
+    /**
+     * @brief Получить значения метки у клиента, которому делегируются запросы. Не кэшируется.
+     */
+    std::vector<std::string> labelValues(const std::string &label, std::time_t start, std::time_t end) override
+    {
+        return backend->labelValues(label, start, end);
+    }
+
+    /**
+     * @brief Счётчики HTTP-запросов клиента, которому делегируются запросы.
+     */
+    TransferStats getTransferStats() const override { return backend->getTransferStats(); }
+
+    /**
+     * @brief Получить счётчики кэша.
+     */
+    Stats getStats() const;
+
+    /**
+     * @brief Очистить кэш. Счётчики попаданий не сбрасываются.
+     */
+    void clear();
+
+    /**
+     * @brief Клиент, которому делегируются запросы.
+     */
+    const std::shared_ptr<TSDBClient> &getBackend() const { return backend; }
+
+protected:
+    /**
+     * @brief Текущее время. Выделено для подмены в тестах.
+     */
+    virtual std::time_t now() const { return std::time(nullptr); }
+
+private:
+    /// Закрытый интервал точек сетки `[first, last]`
+    using Extent = std::pair<std::time_t, std::time_t>;
+
+    struct Entry
+    {
+        std::vector<Extent> extents; ///< Загруженные интервалы, упорядочены и не пересекаются
+        std::vector<Metric> metrics;
+        std::unordered_map<SeriesKey, std::size_t, SeriesKeyHash> index; ///< Ряд -> индекс в `metrics`
+        std::size_t bytes = 0;
+        std::list<std::string>::iterator lru;
+    };
+
+    static std::string makeKey(const std::string &query_str, int step);
+    static std::vector<Extent> missingExtents(const std::vector<Extent> &extents, Extent range, int step);
+    static void addExtent(std::vector<Extent> &extents, Extent extent, int step);
+    static std::size_t estimateBytes(const Metric &metric);
+
+    /// Непокрытые интервалы `range` для ключа; обновляет счётчики и порядок вытеснения
+    std::vector<Extent> lookup(const std::string &key, Extent range, int step);
+    /// Дописать в `result` точки ключа внутри `range`; false, если ключа нет в кэше
+    bool collect(const std::string &key, Extent range, std::vector<Metric> &result) const;
+    void store(const std::string &key, std::vector<Metric> fetched, Extent extent, int step);
+    void evict(const std::string &keep);
+
+    std::shared_ptr<TSDBClient> backend;
+    std::size_t memory_limit;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru; ///< Ключи от недавно использованных к давно не использованным
+    Stats stats;
+};
+
+/** @} */
+
+#endif // TSDB_CACHE_H
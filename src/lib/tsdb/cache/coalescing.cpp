@@ -0,0 +1,165 @@
+#include <exception>
+
+#include "coalescing.h"
+
+CoalescingTSDBClient::CoalescingTSDBClient(std::shared_ptr<TSDBClient> backend) : backend(std::move(backend)) {}
+
+std::vector<Metric> CoalescingTSDBClient::query(const std::string &query_str, std::time_t start, std::time_t end)
+{
+    return coalesce(makeKey(query_str, start, end, "-"), [&] { return backend->query(query_str, start, end); });
+}
+
+std::vector<Metric> CoalescingTSDBClient::query(const std::string &query_str, std::time_t start, std::time_t end, int step)
+{
+    return coalesce(makeKey(query_str, start, end, std::to_string(step)), [&] { return backend->query(query_str, start, end, step); });
+}
+
+SharedMetrics CoalescingTSDBClient::queryShared(const std::string &query_str, std::time_t start, std::time_t end, int step)
+{
+    std::string key = makeKey(query_str, start, end, std::to_string(step));
+    auto [flight, leader] = join(key);
+    if (!leader)
+        return flight->result.get();
+
+    SharedMetrics metrics;
+    try
+    {
+        metrics = std::make_shared<const std::vector<Metric>>(backend->query(query_str, start, end, step));
+    }
+    catch (...)
+    {
+        fail(key, *flight, std::current_exception());
+        throw;
+    }
+    publish(key, *flight, metrics);
+    return metrics;
+}
+
+std::vector<RangeQueryResult> CoalescingTSDBClient::queryBatch(const std::vector<RangeQuery> &queries)
+{
+    std::vector<RangeQueryResult> results(queries.size());
+    std::vector<std::string> keys(queries.size());
+    std::vector<std::shared_ptr<Flight>> joined(queries.size());
+    std::vector<std::size_t> led; // Запросы, которые выполняет этот пакет
+    std::vector<RangeQuery> requests;
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        keys[i] = makeKey(queries[i].query, queries[i].start, queries[i].end, std::to_string(queries[i].step));
+        auto [flight, leader] = join(keys[i]);
+        joined[i] = std::move(flight);
+        if (leader)
+        {
+            led.push_back(i);
+            requests.push_back(queries[i]);
+        }
+    }
+
+    std::vector<RangeQueryResult> fetched;
+    try
+    {
+        fetched = backend->queryBatch(requests);
+    }
+    catch (...)
+    {
+        // Ожидающие не должны зависнуть: ошибка пакета достаётся всем
+        for (std::size_t i : led)
+            fail(keys[i], *joined[i], std::current_exception());
+        throw;
+    }
+
+    // Сначала результаты этого пакета, иначе его же повторы ждали бы их вечно
+    for (std::size_t j = 0; j < led.size(); j++)
+    {
+        std::size_t i = led[j];
+        if (fetched[j].error)
+            fail(keys[i], *joined[i], fetched[j].error);
+        else
+            publish(keys[i], *joined[i], fetched[j].metrics);
+        results[i] = std::move(fetched[j]);
+        joined[i].reset();
+    }
+
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        if (!joined[i] || results[i].error)
+            continue;
+        try
+        {
+            results[i].metrics = joined[i]->result.get();
+        }
+        catch (...)
+        {
+            results[i].error = std::current_exception();
+        }
+    }
+    return results;
+}
+
+CoalescingTSDBClient::Stats CoalescingTSDBClient::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+std::string CoalescingTSDBClient::makeKey(const std::string &query_str, std::time_t start, std::time_t end, const std::string &step)
+{
+    return query_str + '\n' + std::to_string(start) + '\n' + std::to_string(end) + '\n' + step;
+}
+
+std::pair<std::shared_ptr<CoalescingTSDBClient::Flight>, bool> CoalescingTSDBClient::join(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, inserted] = flights.try_emplace(key);
+    if (inserted)
+    {
+        it->second = std::make_shared<Flight>();
+        stats.requests++;
+        return {it->second, true};
+    }
+    it->second->waiters++;
+    stats.coalesced++;
+    return {it->second, false};
+}
+
+std::size_t CoalescingTSDBClient::land(const std::string &key, const Flight &flight)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    flights.erase(key);
+    return flight.waiters;
+}
+
+void CoalescingTSDBClient::fail(const std::string &key, Flight &flight, std::exception_ptr error)
+{
+    land(key, flight);
+    flight.promise.set_exception(std::move(error));
+}
+
+void CoalescingTSDBClient::publish(const std::string &key, Flight &flight, const SharedMetrics &metrics)
+{
+    land(key, flight);
+    flight.promise.set_value(metrics);
+}
+
+std::vector<Metric> CoalescingTSDBClient::coalesce(const std::string &key, const Fetch &fetch)
+{
+    auto [flight, leader] = join(key);
+    if (!leader)
+        return *flight->result.get();
+
+    std::vector<Metric> fetched;
+    try
+    {
+        fetched = fetch();
+    }
+    catch (...)
+    {
+        fail(key, *flight, std::current_exception());
+        throw;
+    }
+    // Результат больше никто не получит: ряды отдаются без обёртки и копии
+    if (land(key, *flight) == 0)
+        return fetched;
+    auto metrics = std::make_shared<const std::vector<Metric>>(std::move(fetched));
+    flight->promise.set_value(metrics);
+    return *metrics;
+}
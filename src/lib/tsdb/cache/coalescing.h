@@ -0,0 +1,145 @@
+/**
+ * @file coalescing.h
+ * @brief Объединение одинаковых одновременных запросов к TSDB.
+ *
+ * @details Содержит класс `CoalescingTSDBClient`: пока запрос выполняется, такие же запросы из других потоков
+ *          не уходят в TSDB, а дожидаются его результата.
+ */
+
+/**
+ * @addtogroup cache
+ * @{
+ */
+
+#ifndef TSDB_CACHE_COALESCING_H
+#define TSDB_CACHE_COALESCING_H
+
+#include <cstddef>
+#include <ctime>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../tsdb.h"
+
+/**
+ * @brief Клиент TSDB, который выполняет одинаковые одновременные запросы один раз.
+ *
+ * @details Запросы с одинаковыми строкой, интервалом и шагом, пришедшие, пока первый из них выполняется,
+ *          присоединяются к нему: в TSDB уходит один HTTP-запрос, ответ разбирается один раз, и результат
+ *          получают все ожидающие. Ошибка запроса тоже достаётся всем. Завершённые запросы не запоминаются —
+ *          для этого есть `CachingTSDBClient`, которому этот клиент служит бэкендом.
+ *
+ *          Результат разделяется как `SharedMetrics`: `queryBatch` и `queryShared` отдают один и тот же
+ *          разобранный ответ всем дождавшимся его запросам без копирования. `query` возвращает ряды
+ *          по значению и поэтому копирует общий результат, если к запросу кто-то присоединился.
+ *
+ *          Одинаковые запросы внутри одного `queryBatch` тоже объединяются. Методы потокобезопасны.
+ */
+class CoalescingTSDBClient : public TSDBClient
+{
+public:
+    /**
+     * @brief Счётчики объединения.
+     */
+    struct Stats
+    {
+        std::size_t requests = 0;  ///< Запросы, отправленные в TSDB
+        std::size_t coalesced = 0; ///< Запросы, дождавшиеся чужого результата
+    };
+
+    /**
+     * @brief Конструктор клиента.
+     *
+     * @param backend Клиент, которому уходят запросы
+     */
+    explicit CoalescingTSDBClient(std::shared_ptr<TSDBClient> backend);
+    ~CoalescingTSDBClient() override = default;
+
+    /**
+     * @brief Выполнить запрос без шага или дождаться такого же выполняющегося.
+     */
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end) override;
+
+    /**
+     * @brief Выполнить запрос с шагом или дождаться такого же выполняющегося.
+     */
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end, int step) override;
+
+    /**
+     * @brief Выполнить запрос с шагом, получив общий результат без копирования.
+     *
+     * @return Ряды ответа, общие для всех дождавшихся их запросов
+     * @throws InvalidTSDBRequest В случае неуспешного статуса ответа от TSDB
+     */
+    SharedMetrics queryShared(const std::string &query_str, std::time_t start, std::time_t end, int step);
+
+    /**
+     * @brief Выполнить несколько запросов.
+     *
+     * @details Запросы, которые уже выполняются, и повторы внутри пакета дожидаются результата; остальные
+     *          уходят клиенту одним пакетом. Ряды клиента раздаются ожидающим без копирования.
+     */
+    std::vector<RangeQueryResult> queryBatch(const std::vector<RangeQuery> &queries) override;
+
+    /**
+     * @brief Проверить доступность TSDB.
+     */
+    bool isAvailable() noexcept override { return backend->isAvailable(); }
+
+    std::vector<std::string> labelNames(std::time_t start, std::time_t end) override { return backend->labelNames(start, end); }
+
+    std::vector<std::string> labelValues(const std::string &label, std::time_t start, std::time_t end) override
+    {
+        return backend->labelValues(label, start, end);
+    }
+
+    /**
+     * @brief Счётчики HTTP-запросов клиента, которому делегируются запросы.
+     */
+    TransferStats getTransferStats() const override { return backend->getTransferStats(); }
+
+    /**
+     * @brief Получить счётчики объединения.
+     */
+    Stats getStats() const;
+
+private:
+    using Fetch = std::function<std::vector<Metric>()>;
+
+    /// Выполняющийся запрос
+    struct Flight
+    {
+        std::promise<SharedMetrics> promise;
+        std::shared_future<SharedMetrics> result = promise.get_future().share();
+        std::size_t waiters = 0; ///< Сколько запросов ждут `result`
+    };
+
+    static std::string makeKey(const std::string &query_str, std::time_t start, std::time_t end, const std::string &step);
+
+    /// Выполняющийся запрос `key` и true, если его нужно выполнить вызывающему
+    std::pair<std::shared_ptr<Flight>, bool> join(const std::string &key);
+    /// Снять запрос `key` с учёта; возвращает число ожидающих, после вызова оно не растёт
+    std::size_t land(const std::string &key, const Flight &flight);
+    /// Снять запрос `key` с учёта и передать ожидающим его ошибку
+    void fail(const std::string &key, Flight &flight, std::exception_ptr error);
+    /// Снять запрос `key` с учёта и передать ожидающим результат
+    void publish(const std::string &key, Flight &flight, const SharedMetrics &metrics);
+    /// Выполнить запрос `key` или дождаться такого же
+    std::vector<Metric> coalesce(const std::string &key, const Fetch &fetch);
+
+    std::shared_ptr<TSDBClient> backend;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+    Stats stats;
+};
+
+/** @} */
+
+#endif // TSDB_CACHE_COALESCING_H
@@ -0,0 +1,528 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "disk_cache.h"
+
+namespace
+{
+    constexpr char FILE_MAGIC[8] = {'L', 'B', 'G', 'C', 'A', 'C', 'H', 'E'};
+    constexpr std::uint32_t FILE_VERSION = 1;
+    constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+    constexpr std::uint32_t SEGMENT_MAGIC = 0x4d474553; // "SEGM"
+
+    struct FileHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::int32_t step;
+        std::uint32_t key_size; ///< За заголовком следует ключ, дополненный нулями до кратного 8 размера
+    };
+
+    struct SegmentHeader
+    {
+        std::uint32_t magic;
+        std::uint32_t series_count;
+        std::int64_t start;
+        std::int64_t end;
+        std::uint64_t payload_size; ///< Индекс, метки и колонки; кратен 8
+        std::uint64_t checksum;
+    };
+
+    /// Запись индекса сегмента; смещения отсчитываются от начала данных сегмента.
+    struct IndexEntry
+    {
+        std::uint64_t labels_offset;
+        std::uint64_t labels_size;
+        std::uint64_t points_offset; ///< `point_count` меток времени, затем `point_count` значений
+        std::uint64_t point_count;
+    };
+
+    static_assert(sizeof(FileHeader) == 24 && sizeof(SegmentHeader) == 40 && sizeof(IndexEntry) == 32,
+                  "Disk cache structures must have no padding");
+
+    inline std::size_t padTo8(std::size_t size)
+    {
+        return (size + 7) & ~std::size_t(7);
+    }
+
+    std::uint64_t checksum(const std::uint8_t *data, std::size_t size)
+    {
+        // FNV-1a по 64-битным словам: на порядок быстрее побайтового, размер кратен 8
+        std::uint64_t hash = 0xcbf29ce484222325ULL;
+        for (std::size_t i = 0; i + 8 <= size; i += 8)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            hash = (hash ^ word) * 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    std::string makeKey(const std::string &source, const std::string &query, int step)
+    {
+        return source + '\n' + query + '\n' + std::to_string(step);
+    }
+
+    /**
+     * Файл, отображённый в память только для чтения. Отсутствующий или пустой файл даёт `size() == 0`.
+     */
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string &path)
+        {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return;
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+                return;
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping)
+                return;
+            void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (!view)
+                return;
+            bytes = static_cast<const std::uint8_t *>(view);
+            length = static_cast<std::size_t>(file_size.QuadPart);
+#else
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                void *view = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (view != MAP_FAILED)
+                {
+                    bytes = static_cast<const std::uint8_t *>(view);
+                    length = static_cast<std::size_t>(info.st_size);
+                }
+            }
+            close(fd); // Отображение остаётся действительным и после закрытия дескриптора
+#endif
+        }
+
+        ~MappedFile()
+        {
+#ifdef _WIN32
+            if (bytes)
+                UnmapViewOfFile(bytes);
+            if (mapping)
+                CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+#else
+            if (bytes)
+                munmap(const_cast<std::uint8_t *>(bytes), length);
+#endif
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const std::uint8_t *data() const { return bytes; }
+        std::size_t size() const { return length; }
+
+    private:
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#endif
+        const std::uint8_t *bytes = nullptr;
+        std::size_t length = 0;
+    };
+
+    struct SegmentView
+    {
+        std::int64_t start;
+        std::int64_t end;
+        std::uint32_t series_count;
+        const std::uint8_t *payload;
+        std::size_t payload_size;
+    };
+
+    /// Результат проверки файла: корректные сегменты и длина корректного начала файла.
+    struct ParsedFile
+    {
+        bool header_ok = false;
+        std::size_t valid_size = 0;
+        std::vector<SegmentView> segments;
+    };
+
+    ParsedFile parseFile(const MappedFile &file, const std::string &key, int step)
+    {
+        ParsedFile parsed;
+        const std::uint8_t *data = file.data();
+        std::size_t size = file.size();
+        if (size < sizeof(FileHeader))
+            return parsed;
+
+        FileHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        std::size_t offset = sizeof(FileHeader) + padTo8(header.key_size);
+        if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != FILE_VERSION ||
+            header.byte_order != BYTE_ORDER_MARK || header.step != step || header.key_size != key.size() || offset > size ||
+            std::memcmp(data + sizeof(FileHeader), key.data(), key.size()) != 0)
+            return parsed;
+        parsed.header_ok = true;
+
+        while (size - offset >= sizeof(SegmentHeader))
+        {
+            SegmentHeader segment;
+            std::memcpy(&segment, data + offset, sizeof(segment));
+            const std::uint8_t *payload = data + offset + sizeof(SegmentHeader);
+            std::size_t available = size - offset - sizeof(SegmentHeader);
+            if (segment.magic != SEGMENT_MAGIC || segment.payload_size > available || segment.payload_size % 8 != 0 ||
+                segment.series_count > segment.payload_size / sizeof(IndexEntry) ||
+                checksum(payload, static_cast<std::size_t>(segment.payload_size)) != segment.checksum)
+                break; // Оборванная или испорченная запись: всё после неё не читается
+            parsed.segments.push_back({segment.start, segment.end, segment.series_count, payload, static_cast<std::size_t>(segment.payload_size)});
+            offset += sizeof(SegmentHeader) + static_cast<std::size_t>(segment.payload_size);
+        }
+        parsed.valid_size = offset;
+        return parsed;
+    }
+
+    /// Чтение блока меток ряда с проверкой границ.
+    class LabelsReader
+    {
+    public:
+        LabelsReader(const std::uint8_t *data, std::size_t size) : position(data), end(data + size) {}
+
+        std::uint32_t count()
+        {
+            std::uint32_t value;
+            take(&value, sizeof(value));
+            return value;
+        }
+
+        std::string_view string()
+        {
+            std::uint32_t length = count();
+            if (length > static_cast<std::size_t>(end - position))
+                throw std::runtime_error("Corrupted disk cache labels");
+            std::string_view result(reinterpret_cast<const char *>(position), length);
+            position += length;
+            return result;
+        }
+
+    private:
+        void take(void *out, std::size_t size)
+        {
+            if (size > static_cast<std::size_t>(end - position))
+                throw std::runtime_error("Corrupted disk cache labels");
+            std::memcpy(out, position, size);
+            position += size;
+        }
+
+        const std::uint8_t *position;
+        const std::uint8_t *end;
+    };
+
+    /// Разложить сегменты по рядам, склеивая точки одного ряда из разных сегментов.
+    std::vector<Metric> decodeSegments(const std::vector<SegmentView> &segments)
+    {
+        std::vector<Metric> metrics;
+        std::unordered_map<SeriesKey, std::size_t, SeriesKeyHash> index;
+        std::vector<LabelSet::Label> labels;
+        for (const auto &segment : segments)
+        {
+            for (std::uint32_t i = 0; i < segment.series_count; i++)
+            {
+                IndexEntry entry;
+                std::memcpy(&entry, segment.payload + i * sizeof(IndexEntry), sizeof(entry));
+                if (entry.labels_offset > segment.payload_size || entry.labels_size > segment.payload_size - entry.labels_offset ||
+                    entry.points_offset > segment.payload_size ||
+                    entry.point_count > (segment.payload_size - entry.points_offset) / (2 * sizeof(double)))
+                    throw std::runtime_error("Corrupted disk cache index");
+
+                LabelsReader reader(segment.payload + entry.labels_offset, static_cast<std::size_t>(entry.labels_size));
+                Symbol name(reader.string());
+                labels.clear();
+                for (std::uint32_t count = reader.count(); count > 0; count--)
+                {
+                    Symbol label_name(reader.string());
+                    labels.emplace_back(label_name, Symbol(reader.string()));
+                }
+
+                Series series;
+                auto n = static_cast<std::size_t>(entry.point_count);
+                series.timestamps.resize(n);
+                series.values.resize(n);
+                const std::uint8_t *columns = segment.payload + entry.points_offset;
+                std::memcpy(series.timestamps.data(), columns, n * sizeof(double));
+                std::memcpy(series.values.data(), columns + n * sizeof(double), n * sizeof(double));
+
+                SeriesKey key{name, LabelSet(labels)};
+                auto [it, inserted] = index.emplace(key, metrics.size());
+                if (inserted)
+                    metrics.push_back(Metric{key.name, key.labels, std::move(series)});
+                else
+                    metrics[it->second].series.merge(series);
+            }
+        }
+        return metrics;
+    }
+
+    /// Непрерывный интервал, покрытый сегментами и содержащий самый поздний конец.
+    std::pair<std::int64_t, std::int64_t> latestExtent(std::vector<std::pair<std::int64_t, std::int64_t>> extents, int step)
+    {
+        std::sort(extents.begin(), extents.end());
+        std::pair<std::int64_t, std::int64_t> best = extents.front(), current = extents.front();
+        for (const auto &extent : extents)
+        {
+            if (extent.first <= current.second + std::max(step, 1))
+                current.second = std::max(current.second, extent.second);
+            else
+                current = extent;
+            if (current.second >= best.second)
+                best = current;
+        }
+        return best;
+    }
+
+    void putLabelString(std::string &out, std::string_view value)
+    {
+        auto length = static_cast<std::uint32_t>(value.size());
+        out.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        out.append(value.data(), value.size());
+    }
+
+    /**
+     * Сериализовать точки рядов внутри `[start, end]` в сегмент вместе с заголовком.
+     */
+    std::string encodeSegment(const std::vector<Metric> &metrics, std::int64_t start, std::int64_t end)
+    {
+        struct Part
+        {
+            const Metric *metric;
+            std::size_t first, count;
+        };
+        std::vector<Part> parts;
+        for (const auto &metric : metrics)
+        {
+            const auto &timestamps = metric.series.timestamps;
+            auto first = std::lower_bound(timestamps.begin(), timestamps.end(), static_cast<double>(start));
+            auto last = std::upper_bound(first, timestamps.end(), static_cast<double>(end));
+            if (first != last)
+                parts.push_back({&metric, static_cast<std::size_t>(first - timestamps.begin()), static_cast<std::size_t>(last - first)});
+        }
+
+        std::string labels;
+        std::vector<IndexEntry> entries(parts.size());
+        for (std::size_t i = 0; i < parts.size(); i++)
+        {
+            const Metric &metric = *parts[i].metric;
+            entries[i].labels_offset = labels.size();
+            putLabelString(labels, metric.name.str());
+            auto count = static_cast<std::uint32_t>(metric.labels.size());
+            labels.append(reinterpret_cast<const char *>(&count), sizeof(count));
+            for (const auto &label : metric.labels)
+            {
+                putLabelString(labels, label.first.str());
+                putLabelString(labels, label.second.str());
+            }
+            entries[i].labels_size = labels.size() - entries[i].labels_offset;
+        }
+        std::size_t labels_base = parts.size() * sizeof(IndexEntry);
+        std::size_t columns_base = labels_base + padTo8(labels.size());
+        std::size_t payload_size = columns_base;
+        for (std::size_t i = 0; i < parts.size(); i++)
+        {
+            entries[i].labels_offset += labels_base;
+            entries[i].points_offset = payload_size;
+            entries[i].point_count = parts[i].count;
+            payload_size += parts[i].count * 2 * sizeof(double);
+        }
+
+        std::string segment(sizeof(SegmentHeader) + payload_size, '\0');
+        char *payload = &segment[sizeof(SegmentHeader)];
+        if (!entries.empty())
+            std::memcpy(payload, entries.data(), labels_base);
+        std::memcpy(payload + labels_base, labels.data(), labels.size());
+        for (std::size_t i = 0; i < parts.size(); i++)
+        {
+            const Series &series = parts[i].metric->series;
+            char *columns = payload + entries[i].points_offset;
+            std::memcpy(columns, series.timestamps.data() + parts[i].first, parts[i].count * sizeof(double));
+            std::memcpy(columns + parts[i].count * sizeof(double), series.values.data() + parts[i].first, parts[i].count * sizeof(double));
+        }
+
+        SegmentHeader header{SEGMENT_MAGIC, static_cast<std::uint32_t>(parts.size()), start, end, payload_size,
+                             checksum(reinterpret_cast<const std::uint8_t *>(payload), payload_size)};
+        std::memcpy(&segment[0], &header, sizeof(header));
+        return segment;
+    }
+
+    std::string encodeFileHeader(const std::string &key, int step)
+    {
+        FileHeader header;
+        std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+        header.version = FILE_VERSION;
+        header.byte_order = BYTE_ORDER_MARK;
+        header.step = step;
+        header.key_size = static_cast<std::uint32_t>(key.size());
+
+        std::string result(reinterpret_cast<const char *>(&header), sizeof(header));
+        result += key;
+        result.resize(sizeof(header) + padTo8(key.size()), '\0');
+        return result;
+    }
+
+    /// Записать файл целиком через временный файл, чтобы читатель не увидел его наполовину.
+    void writeWhole(const std::string &path, const std::string &header, const std::string &segment)
+    {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out.write(header.data(), static_cast<std::streamsize>(header.size()));
+            out.write(segment.data(), static_cast<std::streamsize>(segment.size()));
+            if (!out)
+                throw std::runtime_error("Failed to write disk cache file " + temporary);
+        }
+        std::filesystem::rename(temporary, path);
+    }
+}
+
+DiskCache::DiskCache(std::string directory, std::time_t retention, std::size_t max_segments)
+    : directory(std::move(directory)), retention(retention), max_segments(std::max<std::size_t>(max_segments, 1)) {}
+
+std::string DiskCache::pathFor(const std::string &source, const std::string &query, int step) const
+{
+    // Имя файла — FNV-1a от ключа; сам ключ хранится в заголовке и сверяется при чтении
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : makeKey(source, query, step))
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    char name[24];
+    std::snprintf(name, sizeof(name), "%016llx.lbgc", static_cast<unsigned long long>(hash));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+DiskCache::Snapshot DiskCache::load(const std::string &source, const std::string &query, int step) const
+{
+    Snapshot snapshot;
+    std::lock_guard<std::mutex> lock(mutex);
+    try
+    {
+        MappedFile file(pathFor(source, query, step));
+        ParsedFile parsed = parseFile(file, makeKey(source, query, step), step);
+        if (parsed.segments.empty())
+            return snapshot;
+
+        std::vector<std::pair<std::int64_t, std::int64_t>> extents;
+        for (const auto &segment : parsed.segments)
+            extents.emplace_back(segment.start, segment.end);
+        auto extent = latestExtent(extents, step);
+        snapshot.metrics = decodeSegments(parsed.segments);
+        snapshot.start = static_cast<std::time_t>(extent.first);
+        snapshot.end = static_cast<std::time_t>(extent.second);
+        snapshot.segments = parsed.segments.size();
+    }
+    catch (const std::exception &)
+    {
+        return Snapshot{};
+    }
+    return snapshot;
+}
+
+void DiskCache::append(const std::string &source, const std::string &query, int step, const std::vector<Metric> &metrics,
+                       std::time_t start, std::time_t end)
+{
+    if (end < start)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string path = pathFor(source, query, step);
+    std::string key = makeKey(source, query, step);
+    std::filesystem::create_directories(directory);
+
+    std::size_t valid_size = 0, file_size = 0;
+    std::vector<Metric> compacted;
+    std::pair<std::int64_t, std::int64_t> compacted_extent{start, end};
+    bool rewrite = true;
+    {
+        MappedFile file(path);
+        file_size = file.size();
+        ParsedFile parsed = parseFile(file, key, step);
+        valid_size = parsed.valid_size;
+
+        bool covers_all = true;
+        for (const auto &segment : parsed.segments)
+            covers_all = covers_all && start <= segment.start && segment.end <= end;
+
+        if (parsed.header_ok && !covers_all)
+        {
+            rewrite = parsed.segments.size() + 1 > max_segments;
+            if (rewrite)
+            {
+                // Перезапись одним сегментом: остаётся только интервал, который вернёт load
+                std::vector<std::pair<std::int64_t, std::int64_t>> extents{{start, end}};
+                for (const auto &segment : parsed.segments)
+                    extents.emplace_back(segment.start, segment.end);
+                compacted_extent = latestExtent(extents, step);
+                compacted = decodeSegments(parsed.segments);
+            }
+        }
+    } // Отображение снимается до записи: иначе Windows не даст заменить файл
+
+    if (!rewrite)
+    {
+        if (file_size > valid_size)
+            std::filesystem::resize_file(path, valid_size); // Отбросить оборванный хвост
+        std::string segment = encodeSegment(metrics, start, end);
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out.write(segment.data(), static_cast<std::streamsize>(segment.size()));
+        if (!out)
+            throw std::runtime_error("Failed to append to disk cache file " + path);
+        return;
+    }
+
+    if (compacted.empty())
+    {
+        writeWhole(path, encodeFileHeader(key, step), encodeSegment(metrics, start, end));
+        return;
+    }
+
+    std::unordered_map<SeriesKey, std::size_t, SeriesKeyHash> index;
+    for (std::size_t i = 0; i < compacted.size(); i++)
+        index.emplace(compacted[i].key(), i);
+    for (const auto &metric : metrics)
+    {
+        auto it = index.find(metric.key());
+        if (it == index.end())
+            compacted.push_back(metric);
+        else
+            compacted[it->second].series.merge(metric.series);
+    }
+    if (retention > 0)
+        compacted_extent.first = std::max<std::int64_t>(compacted_extent.first, compacted_extent.second - retention);
+    writeWhole(path, encodeFileHeader(key, step), encodeSegment(compacted, compacted_extent.first, compacted_extent.second));
+}
+
+void DiskCache::remove(const std::string &source, const std::string &query, int step)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::error_code error;
+    std::filesystem::remove(pathFor(source, query, step), error);
+}
@@ -0,0 +1,113 @@
+/**
+ * @file disk_cache.h
+ * @brief Дисковый кэш загруженных рядов.
+ *
+ * @details Содержит класс `DiskCache`, который сохраняет результаты запросов в файлы и отображает их
+ *          в память при следующем запуске, чтобы график можно было показать до ответа TSDB.
+ */
+
+/**
+ * @addtogroup cache
+ * @{
+ */
+
+#ifndef TSDB_DISK_CACHE_H
+#define TSDB_DISK_CACHE_H
+
+#include <cstddef>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../tsdb.h"
+
+/**
+ * @brief Дисковый кэш рядов: по файлу на источник, запрос и шаг.
+ *
+ * @details Файл дописывается только в конец и состоит из заголовка с ключом и сегментов. Каждый сегмент —
+ *          результат одного запроса: интервал `[start, end]`, который он покрывает, таблица-индекс рядов
+ *          (метки и смещения колонок) и колонки временных меток и значений, выровненные на 8 байт.
+ *          Сегмент защищён контрольной суммой, поэтому оборванная при аварии запись просто отбрасывается
+ *          при чтении и затирается следующей записью.
+ *
+ *          При чтении файл отображается в память (`mmap`), колонки копируются в ряды без разбора.
+ *          Когда сегментов становится больше `max_segments` или новый сегмент покрывает все прежние,
+ *          файл переписывается одним сегментом; при этом отбрасываются точки старше `retention`.
+ *
+ *          Числа хранятся в порядке байтов машины, файл не переносим между архитектурами с разным
+ *          порядком байтов (такой файл отвергается по сигнатуре). Методы потокобезопасны.
+ */
+class DiskCache
+{
+public:
+    static constexpr std::size_t DEFAULT_MAX_SEGMENTS = 64; ///< Сегментов в файле до перезаписи одним сегментом
+
+    /**
+     * @brief Содержимое файла кэша.
+     */
+    struct Snapshot
+    {
+        std::time_t start = 0;       ///< Начало непрерывно покрытого интервала, заканчивающегося последним сегментом
+        std::time_t end = 0;         ///< Конец этого интервала
+        std::vector<Metric> metrics; ///< Все сохранённые точки рядов, упорядоченные по времени
+        std::size_t segments = 0;    ///< Число прочитанных сегментов
+
+        bool empty() const { return segments == 0; }
+    };
+
+    /**
+     * @brief Конструктор кэша.
+     *
+     * @param directory Каталог с файлами кэша, создаётся при первой записи
+     * @param retention Сколько секунд истории хранить до последней точки, 0 — без ограничения
+     * @param max_segments Сколько сегментов накапливать до перезаписи файла
+     */
+    explicit DiskCache(std::string directory, std::time_t retention = 0, std::size_t max_segments = DEFAULT_MAX_SEGMENTS);
+
+    /**
+     * @brief Прочитать сохранённые ряды.
+     *
+     * @details Не бросает исключений: отсутствующий, чужой или повреждённый файл читается как пустой кэш.
+     *
+     * @param source Источник данных (например, тип клиента и URL)
+     * @param query Строка запроса
+     * @param step Шаг запроса в секундах
+     * @return Сохранённые ряды или пустой `Snapshot`
+     */
+    Snapshot load(const std::string &source, const std::string &query, int step) const;
+
+    /**
+     * @brief Сохранить результат запроса.
+     *
+     * @param source Источник данных
+     * @param query Строка запроса
+     * @param step Шаг запроса в секундах
+     * @param metrics Ряды, полученные запросом
+     * @param start Начало запрошенного интервала
+     * @param end Конец запрошенного интервала
+     * @throws std::runtime_error Если файл не удалось записать
+     */
+    void append(const std::string &source, const std::string &query, int step, const std::vector<Metric> &metrics,
+                std::time_t start, std::time_t end);
+
+    /**
+     * @brief Удалить файл кэша для ключа.
+     */
+    void remove(const std::string &source, const std::string &query, int step);
+
+    /**
+     * @brief Путь к файлу кэша для ключа.
+     */
+    std::string pathFor(const std::string &source, const std::string &query, int step) const;
+
+private:
+    std::string directory;
+    std::time_t retention;
+    std::size_t max_segments;
+    mutable std::mutex mutex;
+};
+
+/** @} */
+
+#endif // TSDB_DISK_CACHE_H
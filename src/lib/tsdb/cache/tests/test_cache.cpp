@@ -0,0 +1,220 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <ctime>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "doctest.h"
+#include "../cache.h"
+#include "../../prometheus/prometheus.h"
+
+const std::time_t TEST_START = 1732448700, TEST_END = 1732449600;
+const int TEST_STEP = 15;
+
+/**
+ * Мок Prometheus, который отвечает на любой `query_range` синтетическим рядом `value = timestamp`
+ * на сетке шага и запоминает запрошенные интервалы.
+ */
+class MockPrometheusClient : public PrometheusClient
+{
+public:
+    MockPrometheusClient(const std::string &base_url) : PrometheusClient(base_url) {};
+
+    std::vector<std::pair<std::time_t, std::time_t>> requests;
+
+protected:
+    std::string performHttpRequest(const std::string &url, int timeout) override
+    {
+        if (url.find(base_url + "/api/v1/query_range") != 0)
+            throw std::runtime_error("Попытка запроса по незарегистрированному url: " + url);
+        std::time_t start = param(url, "start"), end = param(url, "end"), step = param(url, "step");
+        requests.emplace_back(start, end);
+
+        std::string values;
+        for (std::time_t t = start; t <= end; t += step)
+            values += (values.empty() ? "" : ",") + std::string("[") + std::to_string(t) + ",\"" + std::to_string(t) + "\"]";
+        return R"({"status":"success","data":{"result":[{"metric":{"__name__":"m","job":"a"},"values":[)" + values + "]}]}}";
+    }
+
+private:
+    static std::time_t param(const std::string &url, const std::string &name)
+    {
+        std::size_t pos = url.find("&" + name + "=");
+        return std::stoll(url.substr(pos + name.size() + 2));
+    }
+};
+
+/**
+ * Кэш с зафиксированным «текущим» временем.
+ */
+class TestCachingClient : public CachingTSDBClient
+{
+public:
+    using CachingTSDBClient::CachingTSDBClient;
+    std::time_t current_time = TEST_END + 3600;
+
+protected:
+    std::time_t now() const override { return current_time; }
+};
+
+static void checkGrid(const std::vector<Metric> &result, std::time_t first, std::time_t last)
+{
+    REQUIRE(result.size() == 1);
+    const Series &series = result[0].series;
+    REQUIRE(series.size() == static_cast<std::size_t>((last - first) / TEST_STEP + 1));
+    for (std::size_t i = 0; i < series.size(); i++)
+    {
+        CHECK(series.timestamps[i] == first + static_cast<std::time_t>(i) * TEST_STEP);
+        CHECK(series.values[i] == series.timestamps[i]);
+    }
+}
+
+/**
+ * Клиент, который отвечает одним рядом из одной точки с колонками, зарезервированными под `reserved` точек.
+ */
+class OverReservingClient : public TSDBClient
+{
+public:
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end) override { return query(query_str, start, end, 15); }
+
+    std::vector<Metric> query(const std::string &, std::time_t start, std::time_t, int) override
+    {
+        Metric metric{"m", {{"job", "a"}}, {}};
+        metric.series.reserve(reserved);
+        metric.series.push_back(static_cast<double>(start), 1);
+        return {metric};
+    }
+
+    bool isAvailable() noexcept override { return true; }
+
+    std::size_t reserved = 100000;
+};
+
+TEST_SUITE("Test CachingTSDBClient")
+{
+    TEST_CASE("Test query")
+    {
+        auto backend = std::make_shared<MockPrometheusClient>("http://test.host");
+        TestCachingClient cache(backend, 1 << 20);
+
+        SUBCASE("Промах и попадание")
+        {
+            std::vector<Metric> first = cache.query("m", TEST_START, TEST_END, TEST_STEP);
+            checkGrid(first, TEST_START, TEST_END);
+            CHECK(first[0].name == "m");
+            CHECK(first[0].labels.at("job") == "a");
+
+            std::vector<Metric> second = cache.query("m", TEST_START, TEST_END, TEST_STEP);
+            checkGrid(second, TEST_START, TEST_END);
+            CHECK(backend->requests.size() == 1);
+
+            auto stats = cache.getStats();
+            CHECK(stats.misses == 1);
+            CHECK(stats.hits == 1);
+            CHECK(stats.memory_bytes > 0);
+        }
+
+        SUBCASE("Выравнивание по шагу")
+        {
+            cache.query("m", TEST_START + 7, TEST_END + 7, TEST_STEP);
+            REQUIRE(backend->requests.size() == 1);
+            CHECK(backend->requests[0].first == TEST_START);
+            CHECK(backend->requests[0].second == TEST_END);
+        }
+
+        SUBCASE("Догрузка только недостающих участков")
+        {
+            cache.query("m", TEST_START, TEST_END, TEST_STEP);
+            cache.query("m", TEST_END + 600, TEST_END + 900, TEST_STEP);
+
+            // Запрос накрывает оба загруженных интервала и дыру между ними, а также участки по краям
+            std::vector<Metric> result = cache.query("m", TEST_START - 300, TEST_END + 1200, TEST_STEP);
+            checkGrid(result, TEST_START - 300, TEST_END + 1200);
+
+            REQUIRE(backend->requests.size() == 5);
+            CHECK(backend->requests[2] == std::make_pair(TEST_START - 300, TEST_START - TEST_STEP));
+            CHECK(backend->requests[3] == std::make_pair(TEST_END + TEST_STEP, TEST_END + 600 - TEST_STEP));
+            CHECK(backend->requests[4] == std::make_pair(TEST_END + 900 + TEST_STEP, TEST_END + 1200));
+            CHECK(cache.getStats().partial_hits == 1);
+        }
+
+        SUBCASE("Разные шаги и запросы не смешиваются")
+        {
+            cache.query("m", TEST_START, TEST_END, TEST_STEP);
+            cache.query("m", TEST_START, TEST_END, TEST_STEP * 2);
+            cache.query("other", TEST_START, TEST_END, TEST_STEP);
+            CHECK(backend->requests.size() == 3);
+            CHECK(cache.getStats().misses == 3);
+        }
+
+        SUBCASE("Свежие точки перезапрашиваются")
+        {
+            cache.current_time = TEST_END;
+            cache.query("m", TEST_START, TEST_END, TEST_STEP);
+            cache.query("m", TEST_START, TEST_END, TEST_STEP);
+            REQUIRE(backend->requests.size() == 2);
+            CHECK(backend->requests[1].first > TEST_END - CachingTSDBClient::FRESHNESS_LAG - TEST_STEP);
+            CHECK(backend->requests[1].second == TEST_END);
+        }
+    }
+
+    TEST_CASE("Test queryBatch")
+    {
+        auto backend = std::make_shared<MockPrometheusClient>("http://test.host");
+        TestCachingClient cache(backend, 1 << 20);
+
+        cache.query("m", TEST_START, TEST_END, TEST_STEP);
+        std::vector<RangeQueryResult> results = cache.queryBatch({
+            {"m", TEST_START, TEST_END + 300, TEST_STEP}, // Догружается только хвост
+            {"other", TEST_START, TEST_END, TEST_STEP},
+        });
+        REQUIRE(results.size() == 2);
+        for (const auto &result : results)
+            CHECK_FALSE(result.error);
+        checkGrid(*results[0].metrics, TEST_START, TEST_END + 300);
+        checkGrid(*results[1].metrics, TEST_START, TEST_END);
+        REQUIRE(backend->requests.size() == 3);
+        CHECK(backend->requests[1] == std::make_pair(TEST_END + TEST_STEP, TEST_END + 300));
+        CHECK(backend->requests[2] == std::make_pair(TEST_START, TEST_END));
+        CHECK(cache.getStats().partial_hits == 1);
+
+        // Повторный пакет целиком из кэша
+        results = cache.queryBatch({{"m", TEST_START, TEST_END + 300, TEST_STEP}, {"other", TEST_START, TEST_END, TEST_STEP}});
+        checkGrid(*results[0].metrics, TEST_START, TEST_END + 300);
+        checkGrid(*results[1].metrics, TEST_START, TEST_END);
+        CHECK(backend->requests.size() == 3);
+    }
+
+    TEST_CASE("Test memory limit")
+    {
+        auto backend = std::make_shared<MockPrometheusClient>("http://test.host");
+        TestCachingClient cache(backend, 2048);
+
+        cache.query("a", TEST_START, TEST_END, TEST_STEP);
+        cache.query("b", TEST_START, TEST_END, TEST_STEP);
+        cache.query("c", TEST_START, TEST_END, TEST_STEP);
+
+        auto stats = cache.getStats();
+        CHECK(stats.evictions >= 1);
+        CHECK(stats.memory_bytes <= 2048);
+
+        // Последний ключ вытесняется последним
+        cache.query("c", TEST_START, TEST_END, TEST_STEP);
+        CHECK(backend->requests.size() == 3);
+        cache.query("a", TEST_START, TEST_END, TEST_STEP);
+        CHECK(backend->requests.size() == 4);
+    }
+
+    TEST_CASE("Test column reserve is not counted")
+    {
+        auto backend = std::make_shared<OverReservingClient>();
+        TestCachingClient cache(backend, 1 << 20);
+        cache.query("a", TEST_START, TEST_END, TEST_STEP);
+        cache.query("a", TEST_START - 3600, TEST_START - TEST_STEP, TEST_STEP); // Склейка с уже закэшированным рядом
+        CHECK(cache.getStats().memory_bytes < 1024);
+        CHECK(cache.getStats().evictions == 0);
+    }
+}
@@ -0,0 +1,214 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+#include "../cache.h"
+#include "../coalescing.h"
+
+/**
+ * Клиент, запросы которого ждут `release`. Отвечает одним рядом `name = query`, `value = start`;
+ * запрос `error` завершается исключением.
+ */
+class GatedClient : public TSDBClient
+{
+public:
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end) override
+    {
+        return query(query_str, start, end, 0);
+    }
+
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end, int step) override
+    {
+        calls++;
+        std::unique_lock<std::mutex> lock(mutex);
+        gate.wait(lock, [this] { return released; });
+        if (query_str == "error")
+            throw std::runtime_error("query failed");
+        Metric metric;
+        metric.name = query_str;
+        metric.series.push_back(static_cast<double>(start), static_cast<double>(start));
+        return {metric};
+    }
+
+    bool isAvailable() noexcept override { return true; }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        released = true;
+        gate.notify_all();
+    }
+
+    std::atomic<int> calls{0};
+
+private:
+    std::mutex mutex;
+    std::condition_variable gate;
+    bool released = false;
+};
+
+/// Дождаться, пока `count` запросов присоединятся к выполняющимся
+static void waitCoalesced(const CoalescingTSDBClient &client, std::size_t count)
+{
+    while (client.getStats().coalesced < count)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+TEST_SUITE("Test CoalescingTSDBClient")
+{
+    TEST_CASE("Test concurrent identical queries")
+    {
+        auto backend = std::make_shared<GatedClient>();
+        CoalescingTSDBClient client(backend);
+
+        SUBCASE("Один запрос и общий результат")
+        {
+            constexpr int THREADS = 8;
+            std::vector<SharedMetrics> results(THREADS);
+            std::vector<std::thread> threads;
+            for (int i = 0; i < THREADS; i++)
+                threads.emplace_back([&, i] { results[i] = client.queryShared("up", 100, 200, 15); });
+            waitCoalesced(client, THREADS - 1);
+            backend->release();
+            for (auto &thread : threads)
+                thread.join();
+
+            CHECK(backend->calls == 1);
+            CHECK(client.getStats().requests == 1);
+            REQUIRE(results[0]);
+            CHECK(results[0]->size() == 1);
+            for (const auto &result : results)
+                CHECK(result.get() == results[0].get()); // Ряды не копируются
+        }
+
+        SUBCASE("Ошибка достаётся всем ожидающим")
+        {
+            std::atomic<int> failed{0};
+            std::vector<std::thread> threads;
+            for (int i = 0; i < 3; i++)
+                threads.emplace_back([&] {
+                    try
+                    {
+                        client.query("error", 100, 200, 15);
+                    }
+                    catch (const std::runtime_error &)
+                    {
+                        failed++;
+                    }
+                });
+            waitCoalesced(client, 2);
+            backend->release();
+            for (auto &thread : threads)
+                thread.join();
+            CHECK(backend->calls == 1);
+            CHECK(failed == 3);
+        }
+
+        SUBCASE("Разные интервалы и шаги не объединяются")
+        {
+            backend->release();
+            client.query("up", 100, 200, 15);
+            client.query("up", 100, 200, 30);
+            client.query("up", 100, 300, 15);
+            client.query("up", 100, 200);
+            CHECK(backend->calls == 4);
+            CHECK(client.getStats().coalesced == 0);
+        }
+
+        SUBCASE("Завершённый запрос выполняется заново")
+        {
+            backend->release();
+            auto first = client.query("up", 100, 200, 15);
+            auto second = client.query("up", 100, 200, 15);
+            CHECK(backend->calls == 2);
+            CHECK(first.size() == 1);
+            CHECK(second.size() == 1);
+        }
+    }
+
+    TEST_CASE("Test queryBatch")
+    {
+        auto backend = std::make_shared<GatedClient>();
+        CoalescingTSDBClient client(backend);
+
+        SUBCASE("Повторы внутри пакета")
+        {
+            backend->release();
+            auto results = client.queryBatch({{"up", 100, 200, 15}, {"up", 100, 200, 15}, {"error", 100, 200, 15}, {"up", 0, 200, 15}});
+            CHECK(backend->calls == 3);
+            REQUIRE(results.size() == 4);
+            CHECK(results[0].metrics.get() == results[1].metrics.get());
+            CHECK(results[0].metrics->size() == 1);
+            CHECK(results[1].metrics->size() == 1);
+            CHECK(results[2].error != nullptr);
+            CHECK((*results[3].metrics)[0].series.values[0] == 0);
+        }
+
+        SUBCASE("Пакет присоединяется к выполняющемуся запросу")
+        {
+            std::thread single([&] { client.query("up", 100, 200, 15); });
+            while (backend->calls < 1)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::vector<RangeQueryResult> results;
+            std::thread batch([&] { results = client.queryBatch({{"up", 100, 200, 15}, {"node", 100, 200, 15}}); });
+            waitCoalesced(client, 1);
+            backend->release();
+            single.join();
+            batch.join();
+
+            CHECK(backend->calls == 2);
+            REQUIRE(results.size() == 2);
+            CHECK(results[0].metrics->size() == 1);
+            CHECK((*results[1].metrics)[0].name == "node");
+        }
+
+        SUBCASE("Одновременные пакеты получают один результат")
+        {
+            std::vector<RangeQueryResult> first, second;
+            std::thread leader([&] { first = client.queryBatch({{"up", 100, 200, 15}}); });
+            std::thread waiter([&] { second = client.queryBatch({{"up", 100, 200, 15}}); });
+            waitCoalesced(client, 1);
+            backend->release();
+            leader.join();
+            waiter.join();
+
+            REQUIRE(first[0].metrics);
+            CHECK(first[0].metrics.get() == second[0].metrics.get());
+        }
+    }
+
+    TEST_CASE("Test CachingTSDBClient over CoalescingTSDBClient")
+    {
+        // Приложение ставит кэш перед объединением: запрос, загруженный целиком, проходит кэш без копии
+        auto backend = std::make_shared<GatedClient>();
+        auto coalescer = std::make_shared<CoalescingTSDBClient>(backend);
+        CachingTSDBClient cache(coalescer, 1 << 20);
+
+        std::vector<RangeQueryResult> first, second;
+        std::thread leader([&] { first = cache.queryBatch({{"up", 90, 195, 15}}); });
+        std::thread waiter([&] { second = cache.queryBatch({{"up", 90, 195, 15}}); });
+        waitCoalesced(*coalescer, 1);
+        backend->release();
+        leader.join();
+        waiter.join();
+
+        CHECK(backend->calls == 1);
+        REQUIRE(first[0].metrics);
+        CHECK(first[0].metrics.get() == second[0].metrics.get());
+
+        // Повтор собирается из кэша
+        auto cached = cache.queryBatch({{"up", 90, 195, 15}});
+        CHECK(backend->calls == 1);
+        REQUIRE(cached[0].metrics);
+        CHECK(cached[0].metrics->size() == 1);
+    }
+}
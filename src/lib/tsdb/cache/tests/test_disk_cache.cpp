@@ -0,0 +1,190 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "doctest.h"
+#include "../disk_cache.h"
+
+const std::string TEST_SOURCE = "prometheus http://localhost:9090", TEST_QUERY = "node_load1";
+const int TEST_STEP = 15;
+
+/**
+ * Временный каталог кэша, удаляемый вместе с содержимым в деструкторе.
+ */
+struct TemporaryDirectory
+{
+    std::filesystem::path path;
+
+    TemporaryDirectory()
+        : path(std::filesystem::temp_directory_path() / ("disk_cache_test_" + std::to_string(std::rand()) + "_" + std::to_string(std::time(nullptr)))) {}
+    ~TemporaryDirectory()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(path, error);
+    }
+};
+
+/**
+ * Ряды `job=a` и `job=b` на сетке шага: `value = timestamp + offset`.
+ */
+std::vector<Metric> makeMetrics(std::time_t start, std::time_t end, double offset = 0)
+{
+    std::vector<Metric> metrics;
+    for (const char *job : {"a", "b"})
+    {
+        Metric metric{"node_load1", {{"job", job}, {"instance", "host:9100"}}, {}};
+        for (std::time_t t = start; t <= end; t += TEST_STEP)
+            metric.series.push_back(static_cast<double>(t), static_cast<double>(t) + offset);
+        metrics.push_back(metric);
+    }
+    return metrics;
+}
+
+TEST_CASE("Test disk cache round trip")
+{
+    TemporaryDirectory directory;
+    DiskCache cache(directory.path.string());
+
+    CHECK(cache.load(TEST_SOURCE, TEST_QUERY, TEST_STEP).empty());
+
+    auto metrics = makeMetrics(1000, 1900);
+    cache.append(TEST_SOURCE, TEST_QUERY, TEST_STEP, metrics, 1000, 1900);
+
+    auto snapshot = cache.load(TEST_SOURCE, TEST_QUERY, TEST_STEP);
+    REQUIRE(snapshot.segments == 1);
+    CHECK(snapshot.start == 1000);
+    CHECK(snapshot.end == 1900);
+    REQUIRE(snapshot.metrics.size() == 2);
+    for (std::size_t i = 0; i < metrics.size(); i++)
+    {
+        CHECK(snapshot.metrics[i].key() == metrics[i].key());
+        CHECK(snapshot.metrics[i].series.timestamps == metrics[i].series.timestamps);
+        CHECK(snapshot.metrics[i].series.values == metrics[i].series.values);
+    }
+
+    // Ключ включает источник, запрос и шаг
+    CHECK(cache.load("remote-read http://localhost:9090", TEST_QUERY, TEST_STEP).empty());
+    CHECK(cache.load(TEST_SOURCE, "up", TEST_STEP).empty());
+    CHECK(cache.load(TEST_SOURCE, TEST_QUERY, 30).empty());
+
+    cache.remove(TEST_SOURCE, TEST_QUERY, TEST_STEP);
+    CHECK(cache.load(TEST_SOURCE, TEST_QUERY, TEST_STEP).empty());
+}
+
+TEST_CASE("Test disk cache appends segments")
+{
+    TemporaryDirectory directory;
+    DiskCache cache(directory.path.string());
+
+    cache.append(TEST_SOURCE, TEST_QUERY, TEST_STEP, makeMetrics(1000, 1900), 1000, 1900);
+    // Перекрывающийся хвост: новые значения перекрывают старые
+    cache.append(TEST_SOURCE, TEST_QUERY, TEST_STEP, makeMetrics(1900, 2500, 1), 1900, 2500);
+
+    auto snapshot = cache.load(TEST_SOURCE, TEST_QUERY, TEST_STEP);
+    CHECK(snapshot.segments == 2);
+    CHECK(snapshot.start == 1000);
+    CHECK(snapshot.end == 2500);
+    REQUIRE(snapshot.metrics.size() == 2);
+    const Series &series = snapshot.metrics[0].series;
+    REQUIRE(series.size() == 101);
+    CHECK(series.timestamps.front() == 1000);
+    CHECK(series.values.front() == 1000);
+    CHECK(series.timestamps[60] == 1900);
+    CHECK(series.values[60] == 1901);
+    CHECK(series.timestamps.back() == 2500);
+
+    // Интервал с разрывом не продолжает покрытие: снимок описывает последний непрерывный интервал
+    cache.append(TEST_SOURCE, TEST_QUERY, TEST_STEP, makeMetrics(5000, 5300), 5000, 5300);
+    snapshot = cache.load(TEST_SOURCE, TEST_QUERY, TEST_STEP);
+    CHECK(snapshot.start == 5000);
+    CHECK(snapshot.end == 5300);
+    CHECK(snapshot.metrics[0].series.size() == 101 + 21);
+
+    // Новый сегмент, покрывающий все прежние, заменяет файл
+    cache.append(TEST_SOURCE, TEST_QUERY, TEST_STEP, makeMetrics(0, 6000), 0, 6000);
+    snapshot = cache.load(TEST_SOURCE, TEST_QUERY, TEST_STEP);
+    CHECK(snapshot.segments == 1);
+    CHECK(snapshot.start == 0);
+    CHECK(snapshot.end == 6000);
+    CHECK(snapshot.metrics[0].series.values[2000 / TEST_STEP] == doctest::Approx(1995));
+}
+
+TEST_CASE("Test disk cache recovers from a torn write")
+{
+    TemporaryDirectory directory;
+    DiskCache cache(directory.path.string());
+    std::string path = cache.pathFor(TEST_SOURCE, TEST_QUERY, TEST_STEP);
+
+    cache.append(TEST_SOURCE, TEST_QUERY, TEST_STEP, makeMetrics(1000, 1900), 1000, 1900);
+    auto first_size = std::filesystem::file_size(path);
+    cache.append(TEST_SOURCE, TEST_QUERY, TEST_STEP, makeMetrics(1915, 2500), 1915, 2500);
+
+    SUBCASE("Truncated tail")
+    {
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) - 100);
+    }
+    SUBCASE("Corrupted tail")
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(static_cast<std::streamoff>(std::filesystem::file_size(path) - 8));
+        file.write("garbage!", 8);
+    }
+
+    auto snapshot = cache.load(TEST_SOURCE, TEST_QUERY, TEST_STEP);
+    CHECK(snapshot.segments == 1);
+    CHECK(snapshot.end == 1900);
+    REQUIRE(snapshot.metrics.size() == 2);
+    CHECK(snapshot.metrics[0].series.size() == 61);
+
+    // Следующая запись затирает испорченный хвост
+    cache.append(TEST_SOURCE, TEST_QUERY, TEST_STEP, makeMetrics(1915, 2500), 1915, 2500);
+    CHECK(std::filesystem::file_size(path) > first_size);
+    snapshot = cache.load(TEST_SOURCE, TEST_QUERY, TEST_STEP);
+    CHECK(snapshot.segments == 2);
+    CHECK(snapshot.end == 2500);
+    CHECK(snapshot.metrics[0].series.size() == 101);
+}
+
+TEST_CASE("Test disk cache rejects foreign files")
+{
+    TemporaryDirectory directory;
+    DiskCache cache(directory.path.string());
+    std::string path = cache.pathFor(TEST_SOURCE, TEST_QUERY, TEST_STEP);
+
+    std::filesystem::create_directories(directory.path);
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "not a cache file at all, but long enough to have a header";
+    }
+    CHECK(cache.load(TEST_SOURCE, TEST_QUERY, TEST_STEP).empty());
+
+    // Чужой файл перезаписывается
+    cache.append(TEST_SOURCE, TEST_QUERY, TEST_STEP, makeMetrics(1000, 1900), 1000, 1900);
+    CHECK(cache.load(TEST_SOURCE, TEST_QUERY, TEST_STEP).segments == 1);
+}
+
+TEST_CASE("Test disk cache compaction and retention")
+{
+    TemporaryDirectory directory;
+    DiskCache cache(directory.path.string(), 600, 4);
+
+    for (std::time_t start = 1000; start < 3000; start += 300)
+        cache.append(TEST_SOURCE, TEST_QUERY, TEST_STEP, makeMetrics(start, start + 300), start, start + 300);
+
+    auto snapshot = cache.load(TEST_SOURCE, TEST_QUERY, TEST_STEP);
+    CHECK(snapshot.segments <= 4);
+    CHECK(snapshot.end == 3100);
+    REQUIRE(snapshot.metrics.size() == 2);
+    const Series &series = snapshot.metrics[1].series;
+    CHECK(series.timestamps.back() == 3100);
+    // Пятая запись переписала файл и отбросила точки старше retention от конца интервала [1000, 2500]
+    CHECK(snapshot.start == 1900);
+    CHECK(series.timestamps.front() == 1900);
+    for (std::size_t i = 1; i < series.size(); i++)
+        CHECK(series.timestamps[i] - series.timestamps[i - 1] == TEST_STEP);
+}
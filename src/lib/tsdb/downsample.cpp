@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cmath>
+
+#include "downsample.h"
+
+std::pair<std::size_t, std::size_t> visibleRange(const Series &series, double from, double to)
+{
+    const auto &ts = series.timestamps;
+    std::size_t first = std::lower_bound(ts.begin(), ts.end(), from) - ts.begin();
+    std::size_t last = std::upper_bound(ts.begin() + first, ts.end(), to) - ts.begin();
+    if (first > 0)
+        first--;
+    if (last < ts.size())
+        last++;
+    return {first, last};
+}
+
+Series downsampleM4(const Series &series, double from, double to, std::size_t buckets)
+{
+    auto [first, last] = visibleRange(series, from, to);
+    Series result;
+    if (first >= last || buckets == 0 || to <= from)
+        return result;
+    if (last - first <= 4 * buckets)
+        return series.slice(series.timestamps[first], series.timestamps[last - 1]);
+
+    const double *ts = series.timestamps.data();
+    const double *vs = series.values.data();
+    result.reserve(4 * buckets + 2);
+    const double width = (to - from) / buckets;
+
+    std::size_t i = first;
+    // Точка слева от интервала попадает в результат как есть
+    if (ts[i] < from)
+    {
+        result.push_back(ts[i], vs[i]);
+        i++;
+    }
+    while (i < last && ts[i] <= to)
+    {
+        std::size_t bucket = static_cast<std::size_t>((ts[i] - from) / width);
+        if (bucket >= buckets)
+            bucket = buckets - 1;
+        double bucket_end = from + (bucket + 1) * width;
+
+        // Первая точка корзины забирается всегда, даже если из-за округления она оказалась на границе
+        std::size_t start = i, min_i = i, max_i = i;
+        for (i++; i < last && (ts[i] < bucket_end || bucket == buckets - 1) && ts[i] <= to; i++)
+        {
+            if (vs[i] < vs[min_i])
+                min_i = i;
+            if (vs[i] > vs[max_i])
+                max_i = i;
+        }
+        std::size_t end = i - 1;
+
+        // Выводим не более четырёх различных точек корзины в порядке времени
+        std::size_t picked[4] = {start, std::min(min_i, max_i), std::max(min_i, max_i), end};
+        std::size_t previous = last;
+        for (std::size_t index : picked)
+        {
+            if (index == previous)
+                continue;
+            result.push_back(ts[index], vs[index]);
+            previous = index;
+        }
+    }
+    if (i < last)
+        result.push_back(ts[i], vs[i]);
+    return result;
+}
+
+Series downsampleLTTB(const Series &series, std::size_t threshold)
+{
+    std::size_t n = series.size();
+    if (threshold >= n || threshold < 3)
+        return series;
+
+    const double *ts = series.timestamps.data();
+    const double *vs = series.values.data();
+    Series result;
+    result.reserve(threshold);
+    result.push_back(ts[0], vs[0]);
+
+    // Первая и последняя точки фиксированы, остальные делятся на threshold - 2 корзины
+    const double every = static_cast<double>(n - 2) / (threshold - 2);
+    std::size_t a = 0;
+    for (std::size_t bucket = 0; bucket < threshold - 2; bucket++)
+    {
+        std::size_t range_start = static_cast<std::size_t>(std::floor(bucket * every)) + 1;
+        std::size_t range_end = std::min(static_cast<std::size_t>(std::floor((bucket + 1) * every)) + 1, n - 1);
+
+        std::size_t next_start = range_end;
+        std::size_t next_end = std::min(static_cast<std::size_t>(std::floor((bucket + 2) * every)) + 1, n);
+        double avg_t = 0, avg_v = 0;
+        for (std::size_t j = next_start; j < next_end; j++)
+        {
+            avg_t += ts[j];
+            avg_v += vs[j];
+        }
+        std::size_t next_count = next_end - next_start;
+        avg_t /= next_count;
+        avg_v /= next_count;
+
+        double max_area = -1;
+        std::size_t chosen = range_start;
+        for (std::size_t j = range_start; j < range_end; j++)
+        {
+            double area = std::fabs((ts[a] - avg_t) * (vs[j] - vs[a]) - (ts[a] - ts[j]) * (avg_v - vs[a]));
+            if (area > max_area)
+            {
+                max_area = area;
+                chosen = j;
+            }
+        }
+        result.push_back(ts[chosen], vs[chosen]);
+        a = chosen;
+    }
+
+    result.push_back(ts[n - 1], vs[n - 1]);
+    return result;
+}
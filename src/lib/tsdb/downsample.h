@@ -0,0 +1,65 @@
+/**
+ * @file downsample.h
+ * @brief Прореживание временных рядов перед отрисовкой.
+ *
+ * @details Содержит алгоритмы M4 и LTTB, которые уменьшают число точек ряда до нескольких на пиксель
+ *          ширины графика, сохраняя визуально значимые экстремумы.
+ */
+
+/**
+ * @addtogroup tsdb
+ * @{
+ */
+
+#ifndef TSDB_DOWNSAMPLE_H
+#define TSDB_DOWNSAMPLE_H
+
+#include <cstddef>
+#include <utility>
+
+#include "tsdb.h"
+
+/**
+ * @brief Найти точки ряда, попадающие в интервал `[from, to]`.
+ *
+ * @details Использует упорядоченность временных меток (бинарный поиск). В диапазон дополнительно
+ *          включается по одной точке слева и справа от интервала, чтобы линия доходила до краёв графика.
+ *
+ * @param series Ряд
+ * @param from Левая граница
+ * @param to Правая граница
+ * @return Полуинтервал индексов `[first, last)`
+ */
+std::pair<std::size_t, std::size_t> visibleRange(const Series &series, double from, double to);
+
+/**
+ * @brief Проредить ряд алгоритмом M4.
+ *
+ * @details Интервал `[from, to]` делится на `buckets` равных по времени корзин (обычно по одной на пиксель).
+ *          В каждой корзине остаются первая, последняя, минимальная и максимальная точки, поэтому
+ *          линейный график по результату попиксельно совпадает с графиком по исходным данным.
+ *          Точки вне интервала, кроме соседних с ним, отбрасываются.
+ *
+ * @param series Упорядоченный по времени ряд
+ * @param from Левая граница видимого интервала
+ * @param to Правая граница видимого интервала
+ * @param buckets Число корзин
+ * @return Прореженный ряд (не более `4 * buckets + 2` точек)
+ */
+Series downsampleM4(const Series &series, double from, double to, std::size_t buckets);
+
+/**
+ * @brief Проредить ряд алгоритмом LTTB (Largest-Triangle-Three-Buckets).
+ *
+ * @details Из каждой корзины выбирается точка, образующая треугольник наибольшей площади с точкой,
+ *          выбранной в предыдущей корзине, и средним следующей корзины. Первая и последняя точки сохраняются.
+ *
+ * @param series Упорядоченный по времени ряд
+ * @param threshold Целевое число точек (не меньше 3)
+ * @return Прореженный ряд из `min(threshold, series.size())` точек
+ */
+Series downsampleLTTB(const Series &series, std::size_t threshold);
+
+/** @} */
+
+#endif // TSDB_DOWNSAMPLE_H
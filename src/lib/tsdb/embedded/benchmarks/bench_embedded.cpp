@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "../embedded.h"
+
+const std::time_t START = 1700000000;
+const int INTERVAL = 15;
+
+/**
+ * Ряды node exporter: равномерный шаг, значения — счётчик, медленный синус и шум с двумя знаками после запятой.
+ */
+static std::vector<Metric> makeMetrics(int series_count, std::size_t points)
+{
+    std::vector<Metric> metrics;
+    for (int s = 0; s < series_count; s++)
+    {
+        Metric metric{"node_cpu_seconds_total", {{"cpu", std::to_string(s)}, {"mode", "idle"}, {"instance", "host:9100"}}, {}};
+        metric.series.reserve(points);
+        double counter = 0;
+        for (std::size_t i = 0; i < points; i++)
+        {
+            counter += 14.9 + std::round(std::sin(i * 0.37 + s) * 100) / 1000;
+            metric.series.push_back(static_cast<double>(START + i * INTERVAL), counter);
+        }
+        metrics.push_back(std::move(metric));
+    }
+    return metrics;
+}
+
+int main(int argc, char **argv)
+{
+    benchmark::Options options = benchmark::parseOptions(argc, argv);
+    const int series_count = 100;
+    const std::size_t points = 10000;
+    const std::size_t samples = series_count * points;
+    std::vector<Metric> metrics = makeMetrics(series_count, points);
+
+    // Запись: сжатие в XOR-чанки против дописывания в вектор точек
+    benchmark::Suite ingest("ingest", options);
+    ingest.run("embedded " + std::to_string(samples), samples, [&] {
+        EmbeddedTSDBClient db;
+        for (const auto &metric : metrics)
+            for (std::size_t i = 0; i < points; i++)
+                db.append(metric.name, metric.labels, metric.series.timestamps[i], metric.series.values[i]);
+        benchmark::doNotOptimize(db);
+    });
+    ingest.run("vector<Point> " + std::to_string(samples), samples, [&] {
+        std::vector<std::vector<Point>> db(metrics.size());
+        for (std::size_t s = 0; s < metrics.size(); s++)
+            for (std::size_t i = 0; i < points; i++)
+                db[s].push_back({metrics[s].series.values[i], static_cast<std::time_t>(metrics[s].series.timestamps[i])});
+        benchmark::doNotOptimize(db);
+    });
+    ingest.print();
+
+    EmbeddedTSDBClient db;
+    db.append(metrics);
+    std::vector<std::vector<Point>> plain(metrics.size());
+    for (std::size_t s = 0; s < metrics.size(); s++)
+        for (std::size_t i = 0; i < points; i++)
+            plain[s].push_back({metrics[s].series.values[i], static_cast<std::time_t>(metrics[s].series.timestamps[i])});
+
+    EmbeddedTSDBClient::Stats stats = db.getStats();
+    std::printf("%-20s %.2f bytes per sample (%zu chunks)\n", "embedded", static_cast<double>(stats.chunk_bytes) / stats.samples,
+                stats.chunks);
+    std::printf("%-20s %.2f bytes per sample\n", "vector<Point>", static_cast<double>(sizeof(Point)));
+
+    // Чтение: распаковка четверти диапазона всех рядов против копирования отрезка вектора
+    benchmark::Suite scan("range scan", options);
+    std::time_t from = START + points / 2 * INTERVAL, to = from + points / 4 * INTERVAL;
+    std::size_t scanned = series_count * (points / 4 + 1);
+    scan.run("embedded raw", scanned, [&] { benchmark::doNotOptimize(db.query("node_cpu_seconds_total", from, to)); });
+    scan.run("embedded step 60s", scanned, [&] { benchmark::doNotOptimize(db.query("node_cpu_seconds_total", from, to, 60)); });
+    scan.run("embedded one series", points / 4 + 1, [&] { benchmark::doNotOptimize(db.query("{cpu=\"7\"}", from, to)); });
+    scan.run("vector<Point> raw", scanned, [&] {
+        std::vector<Metric> result;
+        for (std::size_t s = 0; s < plain.size(); s++)
+        {
+            Metric metric{metrics[s].name, metrics[s].labels, {}};
+            auto first = std::lower_bound(plain[s].begin(), plain[s].end(), from, [](const Point &p, std::time_t t) { return p.timestamp < t; });
+            for (auto it = first; it != plain[s].end() && it->timestamp <= to; ++it)
+                metric.series.push_back(*it);
+            result.push_back(std::move(metric));
+        }
+        benchmark::doNotOptimize(result);
+    });
+    scan.print();
+    return 0;
+}
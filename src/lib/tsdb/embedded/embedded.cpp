@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <mutex>
+#include <regex>
+
+#include "embedded.h"
+#include "../prometheus/selector.h"
+
+namespace
+{
+    const Symbol NAME_LABEL("__name__");
+
+    std::int64_t toMilliseconds(double timestamp) { return std::llround(timestamp * 1000); }
+
+    /// Условие селектора, готовое к проверке: регулярное выражение скомпилировано заранее
+    struct CompiledMatcher
+    {
+        LabelMatcher matcher;
+        std::regex regex;
+
+        explicit CompiledMatcher(LabelMatcher matcher) : matcher(std::move(matcher))
+        {
+            if (this->matcher.type == LabelMatcher::Type::RegexMatch || this->matcher.type == LabelMatcher::Type::RegexNoMatch)
+                regex = std::regex(this->matcher.value);
+        }
+
+        bool matches(const SeriesKey &key) const
+        {
+            // Отсутствующая метка равна пустой строке, как в Prometheus
+            const std::string &value = matcher.name == NAME_LABEL.str() ? key.name.str() : key.labels[matcher.name];
+            switch (matcher.type)
+            {
+            case LabelMatcher::Type::Equal:
+                return value == matcher.value;
+            case LabelMatcher::Type::NotEqual:
+                return value != matcher.value;
+            case LabelMatcher::Type::RegexMatch:
+                return std::regex_match(value, regex);
+            case LabelMatcher::Type::RegexNoMatch:
+                return !std::regex_match(value, regex);
+            }
+            return false;
+        }
+    };
+}
+
+bool EmbeddedTSDBClient::append(const Symbol &name, const LabelSet &labels, double timestamp, double value)
+{
+    std::unique_lock lock(mutex);
+    return appendLocked(getOrCreate(name, labels), toMilliseconds(timestamp), value);
+}
+
+std::size_t EmbeddedTSDBClient::append(const Metric &metric)
+{
+    std::unique_lock lock(mutex);
+    StoredSeries &stored = getOrCreate(metric.name, metric.labels);
+    std::size_t appended = 0;
+    for (std::size_t i = 0; i < metric.series.size(); i++)
+        appended += appendLocked(stored, toMilliseconds(metric.series.timestamps[i]), metric.series.values[i]);
+    return appended;
+}
+
+std::size_t EmbeddedTSDBClient::append(const std::vector<Metric> &metrics)
+{
+    std::size_t appended = 0;
+    for (const auto &metric : metrics)
+        appended += append(metric);
+    return appended;
+}
+
+std::vector<Metric> EmbeddedTSDBClient::query(const std::string &query_str, std::time_t start, std::time_t end)
+{
+    return query(query_str, start, end, 0);
+}
+
+std::vector<Metric> EmbeddedTSDBClient::query(const std::string &query_str, std::time_t start, std::time_t end, int step)
+{
+    std::vector<Metric> result;
+    if (end < start)
+        return result;
+
+    std::shared_lock lock(mutex);
+    std::vector<std::size_t> selected = select(query_str);
+    if (step <= 0)
+    {
+        for (std::size_t id : selected)
+        {
+            Metric metric{series[id].key.name, series[id].key.labels, {}};
+            readRange(series[id], static_cast<std::int64_t>(start) * 1000, static_cast<std::int64_t>(end) * 1000, metric.series);
+            if (!metric.series.empty())
+                result.push_back(std::move(metric));
+        }
+        return result;
+    }
+
+    Series raw;
+    std::size_t points = static_cast<std::size_t>((end - start) / step + 1);
+    for (std::size_t id : selected)
+    {
+        raw.clear();
+        readRange(series[id], static_cast<std::int64_t>(start - LOOKBACK_DELTA) * 1000, static_cast<std::int64_t>(end) * 1000, raw);
+        if (raw.empty())
+            continue;
+
+        // В точке сетки t берётся последняя точка из (t - LOOKBACK_DELTA, t]
+        Metric metric{series[id].key.name, series[id].key.labels, {}};
+        metric.series.reserve(std::min(points, raw.size()));
+        std::size_t next = 0;
+        for (std::time_t t = start; t <= end; t += step)
+        {
+            double at = static_cast<double>(t);
+            while (next < raw.size() && raw.timestamps[next] <= at)
+                next++;
+            if (next > 0 && raw.timestamps[next - 1] > at - LOOKBACK_DELTA)
+                metric.series.push_back(at, raw.values[next - 1]);
+        }
+        if (!metric.series.empty())
+            result.push_back(std::move(metric));
+    }
+    return result;
+}
+
+std::vector<std::string> EmbeddedTSDBClient::labelNames(std::time_t start, std::time_t end)
+{
+    std::shared_lock lock(mutex);
+    std::vector<std::string> names;
+    for (const auto &[posting, ids] : postings)
+    {
+        if (anyInRange(ids, start, end))
+            names.push_back(posting.first.str());
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    return names;
+}
+
+std::vector<std::string> EmbeddedTSDBClient::labelValues(const std::string &label, std::time_t start, std::time_t end)
+{
+    std::shared_lock lock(mutex);
+    std::vector<std::string> values;
+    for (const auto &[posting, ids] : postings)
+    {
+        if (posting.first == label && anyInRange(ids, start, end))
+            values.push_back(posting.second.str());
+    }
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+EmbeddedTSDBClient::Stats EmbeddedTSDBClient::getStats() const
+{
+    std::shared_lock lock(mutex);
+    Stats stats;
+    stats.series = series.size();
+    for (const auto &stored : series)
+    {
+        stats.samples += stored.samples;
+        stats.chunks += stored.chunks.size() + (stored.head.size() > 0);
+        stats.chunk_bytes += stored.head.bytes().size();
+        for (const auto &chunk : stored.chunks)
+            stats.chunk_bytes += chunk.bytes.size();
+    }
+    return stats;
+}
+
+EmbeddedTSDBClient::StoredSeries &EmbeddedTSDBClient::getOrCreate(const Symbol &name, const LabelSet &labels)
+{
+    std::size_t hash = name.hash() * 31 + labels.hash();
+    auto [first, last] = index.equal_range(hash);
+    for (auto it = first; it != last; ++it)
+    {
+        const SeriesKey &key = series[it->second].key;
+        if (key.name == name && key.labels == labels)
+            return series[it->second];
+    }
+
+    std::size_t id = series.size();
+    series.emplace_back();
+    series.back().key = {name, labels};
+    index.emplace(hash, id);
+    postings[{NAME_LABEL, name}].push_back(id);
+    for (const auto &label : labels)
+        postings[label].push_back(id);
+    return series.back();
+}
+
+bool EmbeddedTSDBClient::appendLocked(StoredSeries &stored, std::int64_t timestamp, double value)
+{
+    if (stored.samples > 0 && timestamp <= stored.max_time)
+        return false;
+
+    if (stored.head.size() == SAMPLES_PER_CHUNK)
+    {
+        stored.chunks.push_back({stored.head.bytes(), stored.head_min_time, stored.max_time});
+        stored.head = XorChunkEncoder();
+    }
+    if (stored.head.size() == 0)
+        stored.head_min_time = timestamp;
+    stored.head.append(timestamp, value);
+    stored.max_time = timestamp;
+    stored.samples++;
+    return true;
+}
+
+std::vector<std::size_t> EmbeddedTSDBClient::select(const std::string &query_str) const
+{
+    std::vector<CompiledMatcher> matchers;
+    for (auto &matcher : parseSeriesSelector(query_str))
+        matchers.emplace_back(std::move(matcher));
+
+    // Кандидаты — пересечение списков индекса по условиям "метка=непустое значение"
+    std::vector<std::size_t> candidates;
+    bool indexed = false;
+    for (const auto &compiled : matchers)
+    {
+        const LabelMatcher &matcher = compiled.matcher;
+        if (matcher.type != LabelMatcher::Type::Equal || matcher.value.empty())
+            continue;
+        auto it = postings.find({Symbol(matcher.name), Symbol(matcher.value)});
+        if (it == postings.end())
+            return {};
+        if (!indexed)
+        {
+            candidates = it->second;
+            indexed = true;
+        }
+        else
+        {
+            std::vector<std::size_t> intersection;
+            std::set_intersection(candidates.begin(), candidates.end(), it->second.begin(), it->second.end(),
+                                  std::back_inserter(intersection));
+            candidates = std::move(intersection);
+        }
+    }
+    if (!indexed)
+    {
+        candidates.resize(series.size());
+        for (std::size_t i = 0; i < candidates.size(); i++)
+            candidates[i] = i;
+    }
+
+    std::vector<std::size_t> selected;
+    for (std::size_t id : candidates)
+    {
+        if (std::all_of(matchers.begin(), matchers.end(), [&](const CompiledMatcher &m) { return m.matches(series[id].key); }))
+            selected.push_back(id);
+    }
+    return selected;
+}
+
+void EmbeddedTSDBClient::readRange(const StoredSeries &stored, std::int64_t start_ms, std::int64_t end_ms, Series &out) const
+{
+    if (stored.samples == 0 || stored.max_time < start_ms)
+        return;
+
+    auto read = [&](const std::vector<std::uint8_t> &bytes) {
+        XorChunkIterator it(bytes.data(), bytes.size());
+        while (it.next())
+        {
+            if (it.timestamp() > end_ms)
+                return false;
+            if (it.timestamp() >= start_ms)
+                out.push_back(static_cast<double>(it.timestamp()) / 1000, it.value());
+        }
+        return true;
+    };
+
+    // Чанки упорядочены по времени: первый нужный — первый, чья последняя точка не раньше start_ms
+    auto first = std::partition_point(stored.chunks.begin(), stored.chunks.end(),
+                                      [&](const Chunk &chunk) { return chunk.max_time < start_ms; });
+    for (auto it = first; it != stored.chunks.end(); ++it)
+    {
+        if (it->min_time > end_ms || !read(it->bytes))
+            return;
+    }
+    if (stored.head.size() > 0 && stored.head_min_time <= end_ms)
+        read(stored.head.bytes());
+}
+
+bool EmbeddedTSDBClient::anyInRange(const std::vector<std::size_t> &ids, std::time_t start, std::time_t end) const
+{
+    bool unbounded = start == 0 && end == 0;
+    std::int64_t start_ms = static_cast<std::int64_t>(start) * 1000, end_ms = static_cast<std::int64_t>(end) * 1000;
+    for (std::size_t id : ids)
+    {
+        const StoredSeries &stored = series[id];
+        if (stored.samples == 0)
+            continue;
+        std::int64_t first = stored.chunks.empty() ? stored.head_min_time : stored.chunks.front().min_time;
+        if (unbounded || (first <= end_ms && stored.max_time >= start_ms))
+            return true;
+    }
+    return false;
+}
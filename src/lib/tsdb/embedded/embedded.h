@@ -0,0 +1,192 @@
+/**
+ * @file embedded.h
+ * @brief Встроенная TSDB в памяти процесса.
+ *
+ * @details Содержит класс `EmbeddedTSDBClient` — реализацию `TSDBClient`, которая хранит ряды у себя
+ *          в XOR-чанках (сжатие Gorilla, см. `xor_chunk.h`) и отвечает на запросы селекторами рядов
+ *          без обращения к серверу.
+ */
+
+/**
+ * @defgroup embedded Встроенная TSDB
+ * @ingroup tsdb
+ * @brief Хранилище рядов в памяти процесса.
+ *
+ * @details Модуль включает `EmbeddedTSDBClient` — автономную замену Prometheus для тестов и демонстраций.
+ */
+/** @{ */
+
+#ifndef TSDB_EMBEDDED_H
+#define TSDB_EMBEDDED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../tsdb.h"
+#include "../xor_chunk.h"
+
+/**
+ * @brief Клиент TSDB, хранящий ряды в памяти процесса.
+ *
+ * @details Точки каждого ряда лежат в XOR-чанках по `SAMPLES_PER_CHUNK` точек: временные метки
+ *          в миллисекундах кодируются разностью второго порядка, значения — XOR с предыдущим. При равномерном
+ *          шаге и медленно меняющихся значениях точка занимает 1–2 байта вместо 16 у пары `double`.
+ *          Последний чанк ряда открыт для записи, остальные неизменяемы.
+ *
+ *          Запрос — селектор рядов, как у `PrometheusRemoteReadClient`. Запрос без шага возвращает
+ *          сырые точки из `[start, end]`. Запрос с шагом отвечает как `query_range` Prometheus: в каждой точке
+ *          сетки `start + k * step` берётся последняя точка ряда не старше `LOOKBACK_DELTA`.
+ *
+ *          Поиск рядов по условию `метка="значение"` идёт по инвертированному индексу, остальные условия
+ *          проверяются у найденных рядов. Методы потокобезопасны: запросы выполняются параллельно, запись —
+ *          под исключительной блокировкой.
+ */
+class EmbeddedTSDBClient : public TSDBClient
+{
+public:
+    static constexpr std::size_t SAMPLES_PER_CHUNK = 120; ///< Точек в чанке, как в головном блоке Prometheus
+    static constexpr std::time_t LOOKBACK_DELTA = 300;    ///< Насколько старой может быть точка для шага сетки, секунд
+
+    /**
+     * @brief Объём хранилища.
+     */
+    struct Stats
+    {
+        std::size_t series = 0;      ///< Число рядов
+        std::size_t samples = 0;     ///< Число точек
+        std::size_t chunks = 0;      ///< Число чанков, включая открытые
+        std::size_t chunk_bytes = 0; ///< Суммарный размер чанков в байтах
+    };
+
+    EmbeddedTSDBClient() = default;
+    ~EmbeddedTSDBClient() override = default;
+
+    /**
+     * @brief Записать точку.
+     *
+     * @details Точки ряда принимаются только в порядке возрастания времени: точка не новее последней
+     *          записанной отбрасывается. Временная метка хранится с точностью до миллисекунды.
+     *
+     * @param name Имя метрики
+     * @param labels Метки ряда
+     * @param timestamp Временная метка в секундах Unix time
+     * @param value Значение
+     * @return false, если точка отброшена
+     */
+    bool append(const Symbol &name, const LabelSet &labels, double timestamp, double value);
+
+    /**
+     * @brief Записать точки ряда.
+     *
+     * @details Точки, не новее последней записанной точки ряда, отбрасываются.
+     *
+     * @param metric Ряд с упорядоченными по времени точками
+     * @return Число записанных точек
+     */
+    std::size_t append(const Metric &metric);
+
+    /**
+     * @brief Записать точки нескольких рядов.
+     *
+     * @return Число записанных точек
+     */
+    std::size_t append(const std::vector<Metric> &metrics);
+
+    /**
+     * @brief Получить сырые точки рядов.
+     *
+     * @param query_str Селектор рядов
+     * @param start Начало временного диапазона
+     * @param end Конец временного диапазона
+     * @return Ряды с точками в `[start, end]` в порядке создания рядов
+     * @throws std::invalid_argument Если запрос не является селектором рядов
+     */
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end) override;
+
+    /**
+     * @brief Получить точки рядов на сетке шага.
+     *
+     * @param query_str Селектор рядов
+     * @param start Начало временного диапазона
+     * @param end Конец временного диапазона
+     * @param step Интервал между точками в секундах, `step <= 0` — сырые точки
+     * @return Ряды, у которых нашлась хотя бы одна точка, в порядке создания рядов
+     * @throws std::invalid_argument Если запрос не является селектором рядов
+     */
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end, int step) override;
+
+    /**
+     * @brief Хранилище всегда доступно.
+     */
+    bool isAvailable() noexcept override { return true; }
+
+    /**
+     * @brief Получить имена меток по инвертированному индексу, включая `__name__`.
+     */
+    std::vector<std::string> labelNames(std::time_t start, std::time_t end) override;
+
+    /**
+     * @brief Получить значения метки по инвертированному индексу.
+     */
+    std::vector<std::string> labelValues(const std::string &label, std::time_t start, std::time_t end) override;
+
+    /**
+     * @brief Получить текущий объём хранилища.
+     */
+    Stats getStats() const;
+
+private:
+    /**
+     * @brief Заполненный чанк с границами его временных меток.
+     */
+    struct Chunk
+    {
+        std::vector<std::uint8_t> bytes;
+        std::int64_t min_time;
+        std::int64_t max_time;
+    };
+
+    struct StoredSeries
+    {
+        SeriesKey key;
+        std::vector<Chunk> chunks;   ///< Закрытые чанки по возрастанию времени
+        XorChunkEncoder head;        ///< Открытый чанк
+        std::int64_t head_min_time = 0;
+        std::int64_t max_time = 0;   ///< Метка последней точки, если `samples > 0`
+        std::size_t samples = 0;
+    };
+
+    /// Пара "имя метки — значение"; имя метрики индексируется как метка `__name__`
+    using Posting = std::pair<Symbol, Symbol>;
+
+    struct PostingHash
+    {
+        std::size_t operator()(const Posting &posting) const { return posting.first.hash() * 31 + posting.second.hash(); }
+    };
+
+    StoredSeries &getOrCreate(const Symbol &name, const LabelSet &labels);
+    bool appendLocked(StoredSeries &series, std::int64_t timestamp, double value);
+    std::vector<std::size_t> select(const std::string &query_str) const;
+    /// Есть ли у одного из рядов точки в `[start, end]`; нулевой интервал — любой непустой ряд
+    bool anyInRange(const std::vector<std::size_t> &ids, std::time_t start, std::time_t end) const;
+
+    /**
+     * @brief Распаковать точки ряда из `[start_ms, end_ms]`.
+     */
+    void readRange(const StoredSeries &series, std::int64_t start_ms, std::int64_t end_ms, Series &out) const;
+
+    mutable std::shared_mutex mutex;
+    std::vector<StoredSeries> series;
+    std::unordered_multimap<std::size_t, std::size_t> index; ///< Номера рядов по хэшу `SeriesKey`: поиск без копирования меток
+    std::unordered_map<Posting, std::vector<std::size_t>, PostingHash> postings; ///< Номера рядов по возрастанию
+};
+
+/** @} */
+
+#endif // TSDB_EMBEDDED_H
@@ -0,0 +1,187 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "doctest.h"
+#include "../embedded.h"
+
+const std::time_t TEST_START = 1700000000;
+const int TEST_INTERVAL = 15;
+
+/**
+ * Хранилище с рядами `node_load1{job=a|b, instance=host:9100}` и `up{job=a}`:
+ * `count` точек с интервалом `TEST_INTERVAL`, `value = номер точки + offset`.
+ */
+void fill(EmbeddedTSDBClient &db, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        double t = static_cast<double>(TEST_START + i * TEST_INTERVAL);
+        db.append("node_load1", {{"job", "a"}, {"instance", "host:9100"}}, t, i);
+        db.append("node_load1", {{"job", "b"}, {"instance", "host:9100"}}, t, i + 1000.5);
+        db.append("up", {{"job", "a"}}, t, 1);
+    }
+}
+
+TEST_CASE("Test embedded raw query")
+{
+    EmbeddedTSDBClient db;
+    fill(db, 1000);
+
+    SUBCASE("Все точки ряда переживают сжатие")
+    {
+        auto result = db.query("node_load1{job=\"b\"}", TEST_START, TEST_START + 1000 * TEST_INTERVAL);
+        REQUIRE(result.size() == 1);
+        CHECK(result[0].name == "node_load1");
+        CHECK(result[0].labels["instance"] == "host:9100");
+        REQUIRE(result[0].series.size() == 1000);
+        for (int i = 0; i < 1000; i++)
+        {
+            CHECK(result[0].series.timestamps[i] == static_cast<double>(TEST_START + i * TEST_INTERVAL));
+            CHECK(result[0].series.values[i] == i + 1000.5);
+        }
+    }
+
+    SUBCASE("Диапазон внутри нескольких чанков")
+    {
+        std::time_t start = TEST_START + 100 * TEST_INTERVAL, end = TEST_START + 500 * TEST_INTERVAL;
+        auto result = db.query("node_load1{job=\"a\"}", start, end);
+        REQUIRE(result.size() == 1);
+        REQUIRE(result[0].series.size() == 401);
+        CHECK(result[0].series.timestamps.front() == static_cast<double>(start));
+        CHECK(result[0].series.timestamps.back() == static_cast<double>(end));
+        CHECK(result[0].series.values.front() == 100);
+    }
+
+    SUBCASE("Диапазон без точек")
+    {
+        CHECK(db.query("node_load1", TEST_START - 1000, TEST_START - 1).empty());
+        CHECK(db.query("node_load1", TEST_START + 100, TEST_START).empty());
+    }
+
+    SUBCASE("Объём хранилища")
+    {
+        EmbeddedTSDBClient::Stats stats = db.getStats();
+        CHECK(stats.series == 3);
+        CHECK(stats.samples == 3000);
+        CHECK(stats.chunks == 3 * 9);
+        // Равномерный шаг и медленно меняющиеся значения сжимаются сильнее, чем пара double на точку
+        CHECK(stats.chunk_bytes < stats.samples * 4);
+    }
+}
+
+TEST_CASE("Test embedded selectors")
+{
+    EmbeddedTSDBClient db;
+    fill(db, 10);
+    std::time_t end = TEST_START + 10 * TEST_INTERVAL;
+
+    auto names = [&](const std::string &selector) {
+        std::vector<std::string> result;
+        for (const auto &metric : db.query(selector, TEST_START, end))
+            result.push_back(TSDBClient::format_line_name(metric));
+        return result;
+    };
+
+    CHECK(names("node_load1").size() == 2);
+    CHECK(names("{job=\"a\"}").size() == 2);
+    CHECK(names("node_load1{job!=\"a\"}") == std::vector<std::string>{TSDBClient::format_line_name("node_load1", {{"job", "b"}, {"instance", "host:9100"}})});
+    CHECK(names("{__name__=~\"node_.*\", job=~\"a|b\"}").size() == 2);
+    CHECK(names("{__name__=~\"node\"}").empty()); // Регулярное выражение должно совпасть целиком
+    CHECK(names("{job!~\"a\"}").size() == 1);
+    CHECK(names("{instance=\"\"}") == std::vector<std::string>{TSDBClient::format_line_name("up", {{"job", "a"}})});
+    CHECK(names("missing_metric").empty());
+    CHECK_THROWS_AS(db.query("rate(node_load1[5m])", TEST_START, end), std::invalid_argument);
+}
+
+TEST_CASE("Test embedded step query")
+{
+    EmbeddedTSDBClient db;
+    fill(db, 100);
+
+    SUBCASE("Точки сетки берут последнюю точку ряда")
+    {
+        auto result = db.query("node_load1{job=\"a\"}", TEST_START + 10, TEST_START + 10 + 60 * 4, 60);
+        REQUIRE(result.size() == 1);
+        const Series &series = result[0].series;
+        REQUIRE(series.size() == 5);
+        for (std::size_t i = 0; i < series.size(); i++)
+        {
+            CHECK(series.timestamps[i] == static_cast<double>(TEST_START + 10 + 60 * i));
+            CHECK(series.values[i] == static_cast<double>((10 + 60 * i) / TEST_INTERVAL));
+        }
+    }
+
+    SUBCASE("Точки старше окна не используются")
+    {
+        std::time_t last = TEST_START + 99 * TEST_INTERVAL;
+        auto result = db.query("up", last, last + 2 * EmbeddedTSDBClient::LOOKBACK_DELTA, 60);
+        REQUIRE(result.size() == 1);
+        CHECK(result[0].series.timestamps.back() < static_cast<double>(last + EmbeddedTSDBClient::LOOKBACK_DELTA));
+        CHECK(result[0].series.size() == EmbeddedTSDBClient::LOOKBACK_DELTA / 60);
+        CHECK(db.query("up", last + EmbeddedTSDBClient::LOOKBACK_DELTA, last + 3600, 60).empty());
+    }
+
+    SUBCASE("Запрос без шага возвращает сырые точки")
+    {
+        auto result = db.query("up", TEST_START, TEST_START + 99 * TEST_INTERVAL, 0);
+        REQUIRE(result.size() == 1);
+        CHECK(result[0].series.size() == 100);
+    }
+}
+
+TEST_CASE("Test embedded append")
+{
+    EmbeddedTSDBClient db;
+
+    SUBCASE("Точки не новее последней отбрасываются")
+    {
+        CHECK(db.append("m", {}, 100, 1));
+        CHECK_FALSE(db.append("m", {}, 100, 2));
+        CHECK_FALSE(db.append("m", {}, 99, 3));
+        CHECK(db.append("m", {}, 100.5, 4));
+        auto result = db.query("m", 0, 200);
+        REQUIRE(result.size() == 1);
+        CHECK(result[0].series.values == std::vector<double>{1, 4});
+        CHECK(result[0].series.timestamps == std::vector<double>{100, 100.5});
+    }
+
+    SUBCASE("Запись рядов из ответа TSDB")
+    {
+        Metric metric{"node_load1", {{"job", "a"}}, {}};
+        for (int i = 0; i < 300; i++)
+            metric.series.push_back(static_cast<double>(TEST_START + i), i * 0.25);
+        CHECK(db.append(std::vector<Metric>{metric}) == 300);
+        CHECK(db.append(metric) == 0); // Повторная запись того же ряда ничего не добавляет
+
+        auto result = db.query("node_load1", TEST_START, TEST_START + 300);
+        REQUIRE(result.size() == 1);
+        CHECK(result[0].series.timestamps == metric.series.timestamps);
+        CHECK(result[0].series.values == metric.series.values);
+    }
+}
+
+TEST_CASE("Test embedded metadata")
+{
+    EmbeddedTSDBClient db;
+    fill(db, 10);
+    db.append("late", {{"zone", "z1"}}, static_cast<double>(TEST_START + 1000), 1);
+
+    SUBCASE("Без ограничения интервала")
+    {
+        CHECK(db.labelNames(0, 0) == std::vector<std::string>{"__name__", "instance", "job", "zone"});
+        CHECK(db.labelValues("__name__", 0, 0) == std::vector<std::string>{"late", "node_load1", "up"});
+        CHECK(db.labelValues("job", 0, 0) == std::vector<std::string>{"a", "b"});
+        CHECK(db.labelValues("missing", 0, 0).empty());
+    }
+
+    SUBCASE("Только ряды с точками в интервале")
+    {
+        std::time_t start = TEST_START + 500, end = TEST_START + 2000;
+        CHECK(db.labelNames(start, end) == std::vector<std::string>{"__name__", "zone"});
+        CHECK(db.labelValues("__name__", start, end) == std::vector<std::string>{"late"});
+        CHECK(db.labelValues("job", start, end).empty());
+    }
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "labels.h"
+
+namespace
+{
+    /**
+     * Таблица интернирования. Строки лежат в `std::deque`, чтобы ссылки на них не менялись при росте,
+     * ключи индекса ссылаются на эти же строки.
+     */
+    class SymbolTable
+    {
+    public:
+        SymbolTable() { strings.emplace_back(); }
+
+        const std::string *intern(std::string_view text)
+        {
+            if (text.empty())
+                return &strings.front();
+            {
+                std::shared_lock<std::shared_mutex> lock(mutex);
+                auto it = index.find(text);
+                if (it != index.end())
+                    return it->second;
+            }
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            auto it = index.find(text);
+            if (it != index.end())
+                return it->second;
+            const std::string *stored = &strings.emplace_back(text);
+            index.emplace(*stored, stored);
+            return stored;
+        }
+
+        const std::string *emptyString() const { return &strings.front(); }
+
+        std::size_t size()
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            return strings.size();
+        }
+
+    private:
+        std::shared_mutex mutex;
+        std::deque<std::string> strings;
+        std::unordered_map<std::string_view, const std::string *> index;
+    };
+
+    SymbolTable &table()
+    {
+        // Не разрушается при выходе, чтобы Symbol в статических объектах оставались валидны
+        static SymbolTable *instance = new SymbolTable();
+        return *instance;
+    }
+
+    const std::string EMPTY_VALUE;
+}
+
+Symbol::Symbol() : text(table().emptyString()) {}
+
+Symbol::Symbol(std::string_view text) : text(table().intern(text)) {}
+
+std::size_t Symbol::tableSize()
+{
+    return table().size();
+}
+
+LabelSet::LabelSet(std::vector<Label> labels) : labels(std::move(labels))
+{
+    auto &items = this->labels;
+    std::stable_sort(items.begin(), items.end(), [](const Label &a, const Label &b) { return a.first.str() < b.first.str(); });
+    // При повторе имени оставляем последнее значение
+    std::size_t unique = 0;
+    for (std::size_t i = 0; i < items.size(); i++)
+    {
+        if (unique > 0 && items[unique - 1].first == items[i].first)
+            items[unique - 1] = items[i];
+        else
+            items[unique++] = items[i];
+    }
+    items.erase(items.begin() + unique, items.end());
+
+    std::size_t hash = items.size();
+    for (const auto &label : items)
+        hash = (hash * 31 + label.first.hash()) * 31 + label.second.hash();
+    hash_value = hash;
+}
+
+LabelSet::LabelSet(std::initializer_list<std::pair<std::string_view, std::string_view>> labels)
+    : LabelSet([&]
+               {
+                   std::vector<Label> items;
+                   items.reserve(labels.size());
+                   for (const auto &label : labels)
+                       items.emplace_back(label.first, label.second);
+                   return items;
+               }())
+{
+}
+
+LabelSet::const_iterator LabelSet::find(std::string_view name) const
+{
+    auto it = std::lower_bound(labels.begin(), labels.end(), name, [](const Label &label, std::string_view key) { return label.first.str() < key; });
+    if (it != labels.end() && it->first.str() == name)
+        return it;
+    return labels.end();
+}
+
+const std::string &LabelSet::operator[](std::string_view name) const
+{
+    auto it = find(name);
+    return it == labels.end() ? EMPTY_VALUE : it->second.str();
+}
+
+const std::string &LabelSet::at(std::string_view name) const
+{
+    auto it = find(name);
+    if (it == labels.end())
+        throw std::out_of_range("No label " + std::string(name));
+    return it->second.str();
+}
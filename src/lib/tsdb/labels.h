@@ -0,0 +1,138 @@
+/**
+ * @file labels.h
+ * @brief Интернированные строки и компактный набор меток метрики.
+ *
+ * @details Содержит `Symbol` — ссылку на строку из общей для процесса таблицы интернирования, `LabelSet` —
+ *          отсортированный неизменяемый набор пар `Symbol` и `SeriesKey` — идентичность ряда для хэш-таблиц.
+ *          Одинаковые имена и значения меток тысяч рядов хранятся в памяти один раз, а сравнение и хэширование
+ *          сводятся к сравнению указателей.
+ */
+
+/**
+ * @addtogroup tsdb
+ * @{
+ */
+
+#ifndef TSDB_LABELS_H
+#define TSDB_LABELS_H
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Интернированная строка.
+ *
+ * @details Указывает на строку из таблицы интернирования процесса: равные строки всегда дают один и тот же
+ *          `Symbol`, поэтому сравнение на равенство и хэш не читают символы. Строки из таблицы не удаляются
+ *          до завершения процесса, их объём растёт с числом различных меток. Интернирование потокобезопасно.
+ */
+class Symbol
+{
+public:
+    /// Пустая строка.
+    Symbol();
+    Symbol(std::string_view text);
+    Symbol(const char *text) : Symbol(std::string_view(text)) {}
+    Symbol(const std::string &text) : Symbol(std::string_view(text)) {}
+
+    const std::string &str() const { return *text; }
+    operator const std::string &() const { return *text; }
+    bool empty() const { return text->empty(); }
+    std::size_t hash() const { return std::hash<const void *>()(text); }
+
+    friend bool operator==(const Symbol &a, const Symbol &b) { return a.text == b.text; }
+    friend bool operator!=(const Symbol &a, const Symbol &b) { return a.text != b.text; }
+    friend bool operator==(const Symbol &a, const char *b) { return *a.text == b; }
+    friend bool operator!=(const Symbol &a, const char *b) { return *a.text != b; }
+    friend bool operator==(const Symbol &a, const std::string &b) { return *a.text == b; }
+    friend bool operator!=(const Symbol &a, const std::string &b) { return *a.text != b; }
+
+    /**
+     * @brief Число различных строк в таблице интернирования.
+     */
+    static std::size_t tableSize();
+
+private:
+    const std::string *text;
+};
+
+/**
+ * @brief Неизменяемый набор меток, отсортированный по имени метки.
+ *
+ * @details Хранится плоским массивом пар `Symbol`: 16 байт на метку без отдельных узлов и строк.
+ *          Хэш считается один раз при создании.
+ */
+class LabelSet
+{
+public:
+    using Label = std::pair<Symbol, Symbol>;
+    using const_iterator = std::vector<Label>::const_iterator;
+
+    LabelSet() = default;
+
+    /**
+     * @brief Создать набор из пар "имя — значение" в любом порядке.
+     *
+     * @details При повторе имени остаётся последнее значение.
+     */
+    explicit LabelSet(std::vector<Label> labels);
+    LabelSet(std::initializer_list<std::pair<std::string_view, std::string_view>> labels);
+
+    bool empty() const { return labels.empty(); }
+    std::size_t size() const { return labels.size(); }
+    const_iterator begin() const { return labels.begin(); }
+    const_iterator end() const { return labels.end(); }
+
+    /**
+     * @brief Значение метки или пустая строка, если метки нет.
+     */
+    const std::string &operator[](std::string_view name) const;
+
+    /**
+     * @brief Значение метки.
+     *
+     * @throws std::out_of_range Если метки нет
+     */
+    const std::string &at(std::string_view name) const;
+
+    bool contains(std::string_view name) const { return find(name) != labels.end(); }
+    std::size_t hash() const { return hash_value; }
+
+    friend bool operator==(const LabelSet &a, const LabelSet &b) { return a.hash_value == b.hash_value && a.labels == b.labels; }
+    friend bool operator!=(const LabelSet &a, const LabelSet &b) { return !(a == b); }
+
+private:
+    const_iterator find(std::string_view name) const;
+
+    std::vector<Label> labels;
+    std::size_t hash_value = 0;
+};
+
+/**
+ * @brief Идентичность ряда: имя метрики и набор меток.
+ */
+struct SeriesKey
+{
+    Symbol name;
+    LabelSet labels;
+
+    friend bool operator==(const SeriesKey &a, const SeriesKey &b) { return a.name == b.name && a.labels == b.labels; }
+    friend bool operator!=(const SeriesKey &a, const SeriesKey &b) { return !(a == b); }
+};
+
+/**
+ * @brief Хэш `SeriesKey` для `std::unordered_map`.
+ */
+struct SeriesKeyHash
+{
+    std::size_t operator()(const SeriesKey &key) const { return key.name.hash() * 31 + key.labels.hash(); }
+};
+
+/** @} */
+
+#endif // TSDB_LABELS_H
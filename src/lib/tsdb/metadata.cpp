@@ -0,0 +1,371 @@
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <utility>
+
+#include "../trace/trace.h"
+#include "metadata.h"
+
+namespace
+{
+    const std::string METRIC_NAME_LABEL = "__name__";
+
+    inline bool isWordChar(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == ':';
+    }
+
+    /// Слово перед позицией `end`, пробелы между ними пропускаются
+    std::string_view wordBefore(std::string_view text, std::size_t end)
+    {
+        while (end > 0 && std::isspace(static_cast<unsigned char>(text[end - 1])))
+            end--;
+        std::size_t start = end;
+        while (start > 0 && isWordChar(text[start - 1]))
+            start--;
+        return text.substr(start, end - start);
+    }
+
+    /// Первый непробельный символ перед позицией `end`, 0 — нет такого
+    char charBefore(std::string_view text, std::size_t end)
+    {
+        while (end > 0 && std::isspace(static_cast<unsigned char>(text[end - 1])))
+            end--;
+        return end > 0 ? text[end - 1] : 0;
+    }
+}
+
+CompletionContext completionContext(std::string_view text)
+{
+    CompletionContext context;
+    bool braces = false, brackets = false;
+    char quote = 0;
+    std::size_t quote_start = 0;
+    std::string_view label;
+    std::vector<bool> parens; ///< Для каждой открытой скобки: true — список меток `by (...)`, `without (...)`
+    for (std::size_t i = 0; i < text.size(); i++)
+    {
+        char c = text[i];
+        if (quote)
+        {
+            if (c == '\\')
+                i++;
+            else if (c == quote)
+                quote = 0;
+            continue;
+        }
+        switch (c)
+        {
+        case '"':
+        case '\'':
+        case '`':
+            quote = c;
+            quote_start = i + 1;
+            break;
+        case '{':
+            braces = true;
+            break;
+        case '}':
+            braces = false;
+            break;
+        case '[':
+            brackets = true;
+            break;
+        case ']':
+            brackets = false;
+            break;
+        case '(':
+        {
+            std::string_view word = wordBefore(text, i);
+            parens.push_back(word == "by" || word == "without");
+            break;
+        }
+        case ')':
+            if (!parens.empty())
+                parens.pop_back();
+            break;
+        case '=':
+        case '!':
+            // Для `!=` и `=~` метка запоминается на первом символе оператора
+            if (braces && !wordBefore(text, i).empty())
+                label = wordBefore(text, i);
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (quote)
+    {
+        if (braces && !label.empty())
+        {
+            context.kind = CompletionContext::Kind::LabelValue;
+            context.label = label;
+            context.start = quote_start;
+            context.prefix = text.substr(quote_start);
+        }
+        return context;
+    }
+    if (brackets)
+        return context;
+
+    std::size_t start = text.size();
+    while (start > 0 && isWordChar(text[start - 1]))
+        start--;
+    context.start = start;
+    context.prefix = text.substr(start);
+    char before = charBefore(text, start);
+    if (braces)
+    {
+        if (before == '{' || before == ',')
+            context.kind = CompletionContext::Kind::LabelName;
+    }
+    else if (!parens.empty() && parens.back())
+    {
+        if (before == '(' || before == ',')
+            context.kind = CompletionContext::Kind::LabelName;
+    }
+    else if (!context.prefix.empty() && !std::isdigit(static_cast<unsigned char>(context.prefix[0])))
+    {
+        context.kind = CompletionContext::Kind::MetricName;
+    }
+    return context;
+}
+
+MetadataIndex::MetadataIndex(std::shared_ptr<TSDBClient> client)
+    : client(std::move(client)), metrics(std::make_shared<const PrefixIndex>()), labels(std::make_shared<const PrefixIndex>())
+{
+}
+
+MetadataIndex::~MetadataIndex()
+{
+    stop();
+}
+
+void MetadataIndex::start(std::time_t interval, std::time_t full_interval)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (thread.joinable())
+        return;
+    stopping = false;
+    thread = std::thread([this, interval, full_interval] { run(interval, full_interval); });
+}
+
+void MetadataIndex::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    if (thread.joinable())
+        thread.join();
+}
+
+void MetadataIndex::setUpdateCallback(std::function<void()> callback)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    update_callback = std::move(callback);
+}
+
+void MetadataIndex::run(std::time_t interval, std::time_t full_interval)
+{
+    trace::setThreadName("metadata");
+    auto next = std::chrono::steady_clock::now();
+    auto next_full = next;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait_until(lock, next, [this] { return stopping || !requested.empty(); });
+            if (stopping)
+                return;
+        }
+
+        auto current = std::chrono::steady_clock::now();
+        if (current < next)
+        {
+            // Разбудил запрос значений метки: загружаются только они
+            bool loaded;
+            {
+                std::lock_guard<std::mutex> serial(refresh_mutex);
+                loaded = loadRequested();
+            }
+            if (loaded)
+                notify();
+            continue;
+        }
+
+        bool full = current >= next_full;
+        refresh(full);
+        next = current + std::chrono::seconds(interval);
+        if (full)
+            next_full = current + std::chrono::seconds(full_interval);
+    }
+}
+
+void MetadataIndex::refresh(bool full)
+{
+    trace::Span span("metadata_refresh", "tsdb");
+    std::lock_guard<std::mutex> serial(refresh_mutex);
+    bool changed = loadRequested();
+
+    std::time_t current = now();
+    Index old_metrics, old_labels;
+    std::vector<std::pair<std::string, Index>> old_values;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        full = full || refreshed == 0;
+        old_metrics = metrics;
+        old_labels = labels;
+        old_values.assign(values.begin(), values.end());
+    }
+    std::time_t start = full ? 0 : refreshed - REFRESH_OVERLAP;
+    std::time_t end = full ? 0 : current;
+
+    auto update = [full](const Index &old, std::vector<std::string> fetched) -> Index {
+        if (full)
+            return std::make_shared<const PrefixIndex>(std::move(fetched));
+        PrefixIndex merged = old->merged(std::move(fetched));
+        if (merged.size() == old->size())
+            return old;
+        return std::make_shared<const PrefixIndex>(std::move(merged));
+    };
+
+    try
+    {
+        Index new_metrics = update(old_metrics, client->labelValues(METRIC_NAME_LABEL, start, end));
+        Index new_labels = update(old_labels, client->labelNames(start, end));
+        std::vector<std::pair<std::string, Index>> new_values;
+        new_values.reserve(old_values.size());
+        for (const auto &[label, index] : old_values)
+            new_values.emplace_back(label, update(index, client->labelValues(label, start, end)));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        metrics = std::move(new_metrics);
+        labels = std::move(new_labels);
+        for (auto &[label, index] : new_values)
+            values[label] = std::move(index);
+        refreshed = current;
+        if (full)
+            stats.full_refreshes++;
+        else
+            stats.incremental_refreshes++;
+        changed = true;
+    }
+    catch (const std::exception &)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.errors++;
+    }
+    if (changed)
+        notify();
+}
+
+bool MetadataIndex::loadRequested()
+{
+    std::set<std::string> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.swap(requested);
+    }
+    for (const auto &label : pending)
+    {
+        Index index;
+        try
+        {
+            index = std::make_shared<const PrefixIndex>(client->labelValues(label, 0, 0));
+        }
+        catch (const std::exception &)
+        {
+            // Пустой индекс вместо повторных запросов на каждый кадр; значения появятся при следующем обновлении
+            index = std::make_shared<const PrefixIndex>();
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.errors++;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        values[label] = std::move(index);
+    }
+    return !pending.empty();
+}
+
+void MetadataIndex::notify()
+{
+    std::function<void()> callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        callback = update_callback;
+    }
+    if (callback)
+        callback();
+}
+
+std::shared_ptr<const PrefixIndex> MetadataIndex::metricNames() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return metrics;
+}
+
+std::shared_ptr<const PrefixIndex> MetadataIndex::labelNames() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return labels;
+}
+
+std::shared_ptr<const PrefixIndex> MetadataIndex::labelValues(const std::string &label)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = values.find(label);
+    if (it != values.end())
+        return it->second;
+    if (requested.insert(label).second)
+        wakeup.notify_one();
+    return nullptr;
+}
+
+std::vector<std::string> MetadataIndex::suggest(const CompletionContext &context, std::size_t limit)
+{
+    Index index;
+    switch (context.kind)
+    {
+    case CompletionContext::Kind::MetricName:
+        index = metricNames();
+        break;
+    case CompletionContext::Kind::LabelName:
+        index = labelNames();
+        break;
+    case CompletionContext::Kind::LabelValue:
+        index = labelValues(context.label);
+        break;
+    case CompletionContext::Kind::None:
+        break;
+    }
+    std::vector<std::string> result;
+    if (!index)
+        return result;
+
+    for (auto value : index->findPrefix(context.prefix, limit))
+        result.emplace_back(value);
+    if (result.size() >= limit || context.prefix.empty())
+        return result;
+    // Все строки с префиксом уже в результате, нечёткий поиск добавляет только остальные
+    for (auto value : index->findFuzzy(context.prefix, limit))
+    {
+        if (result.size() >= limit)
+            break;
+        if (value.substr(0, context.prefix.size()) != context.prefix)
+            result.emplace_back(value);
+    }
+    return result;
+}
+
+MetadataIndex::Stats MetadataIndex::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    result.metric_names = metrics->size();
+    result.memory_bytes = metrics->memoryBytes() + labels->memoryBytes();
+    for (const auto &[label, index] : values)
+        result.memory_bytes += index->memoryBytes();
+    return result;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file metadata.h
+ * @brief Индекс имён метрик и меток для автодополнения запросов.
+ *
+ * @details Содержит разбор позиции курсора в запросе PromQL (`completionContext`) и класс `MetadataIndex`,
+ *          который держит имена метрик, имена и значения меток в `PrefixIndex` и обновляет их в фоне.
+ *          Подсказки на каждое нажатие клавиши считаются по локальному индексу без обращения к TSDB.
+ */
+
+/**
+ * @addtogroup tsdb
+ * @{
+ */
+
+#ifndef TSDB_METADATA_H
+#define TSDB_METADATA_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "prefix_index.h"
+#include "tsdb.h"
+
+/**
+ * @brief Что дописывается в позиции курсора.
+ */
+struct CompletionContext
+{
+    enum class Kind
+    {
+        None,       ///< Подсказки не нужны: число, длительность, оператор
+        MetricName, ///< Имя метрики
+        LabelName,  ///< Имя метки в `{...}` или в `by (...)`, `without (...)`
+        LabelValue  ///< Значение метки в кавычках внутри `{...}`
+    };
+
+    Kind kind = Kind::None;
+    std::string label;     ///< Метка, значение которой вводится, для `LabelValue`
+    std::size_t start = 0; ///< Начало дописываемого слова в тексте
+    std::string prefix;    ///< Уже введённая часть слова, от `start` до курсора
+};
+
+/**
+ * @brief Определить, что вводится в конце текста.
+ *
+ * @param text Текст запроса до курсора
+ */
+CompletionContext completionContext(std::string_view text);
+
+/**
+ * @brief Имена метрик, имена и значения меток TSDB с фоновым обновлением.
+ *
+ * @details Полное обновление загружает все имена метрик и меток и заменяет индексы, так что удалённые ряды
+ *          пропадают из подсказок. Между полными обновлениями выполняются инкрементальные: запрашиваются только
+ *          ряды с точками за последний интервал (`start`/`end` в API меток Prometheus), и новые имена
+ *          сливаются с индексом. Значения метки загружаются при первом обращении к ней и дальше обновляются
+ *          вместе с остальными.
+ *
+ *          Индексы неизменяемы и выдаются как `std::shared_ptr<const PrefixIndex>`: обновление подменяет
+ *          указатель, не мешая читающему UI-потоку. Запросы к TSDB выполняются без удержания блокировки.
+ */
+class MetadataIndex
+{
+public:
+    /// Перекрытие интервалов инкрементальных обновлений, секунд: ряды без новых точек за это время не ищутся
+    static constexpr std::time_t REFRESH_OVERLAP = 300;
+
+    /**
+     * @brief Счётчики работы индекса.
+     */
+    struct Stats
+    {
+        std::size_t full_refreshes = 0;        ///< Полные обновления
+        std::size_t incremental_refreshes = 0; ///< Инкрементальные обновления
+        std::size_t errors = 0;                ///< Неудачные запросы к TSDB
+        std::size_t metric_names = 0;          ///< Имена метрик в индексе
+        std::size_t memory_bytes = 0;          ///< Оценочный объём всех индексов
+    };
+
+    /**
+     * @brief Конструктор индекса. Данные не загружаются до `refresh` или `start`.
+     *
+     * @param client Клиент TSDB, из которого берутся метаданные
+     */
+    explicit MetadataIndex(std::shared_ptr<TSDBClient> client);
+    virtual ~MetadataIndex();
+
+    MetadataIndex(const MetadataIndex &) = delete;
+    MetadataIndex &operator=(const MetadataIndex &) = delete;
+
+    /**
+     * @brief Запустить фоновое обновление. Первое обновление полное и начинается сразу.
+     *
+     * @param interval Интервал инкрементальных обновлений, секунд
+     * @param full_interval Интервал полных обновлений, секунд
+     */
+    void start(std::time_t interval, std::time_t full_interval);
+
+    /**
+     * @brief Остановить фоновое обновление. Текущий запрос дорабатывает до конца.
+     */
+    void stop();
+
+    /**
+     * @brief Задать функцию, которую вызывает фоновый поток после изменения индексов.
+     *
+     * @param callback Функция, пустая — не уведомлять
+     */
+    void setUpdateCallback(std::function<void()> callback);
+
+    /**
+     * @brief Обновить индексы синхронно.
+     *
+     * @details Сначала загружаются значения меток, запрошенные через `labelValues`. Обновление без
+     *          предыдущего успешного полного выполняется как полное. Ошибки запросов учитываются в
+     *          `Stats::errors`, индексы при этом не меняются.
+     *
+     * @param full true — полное обновление, false — только ряды с точками за время с прошлого обновления
+     */
+    void refresh(bool full);
+
+    std::shared_ptr<const PrefixIndex> metricNames() const;
+    std::shared_ptr<const PrefixIndex> labelNames() const;
+
+    /**
+     * @brief Значения метки.
+     *
+     * @return Индекс значений или nullptr, если они ещё не загружены; загрузка ставится в очередь
+     */
+    std::shared_ptr<const PrefixIndex> labelValues(const std::string &label);
+
+    /**
+     * @brief Подсказки для позиции курсора.
+     *
+     * @details Сначала строки с введённым префиксом, затем нечёткие совпадения, без повторов.
+     *
+     * @param context Результат `completionContext`
+     * @param limit Наибольшее число подсказок
+     */
+    std::vector<std::string> suggest(const CompletionContext &context, std::size_t limit);
+
+    /**
+     * @brief Получить счётчики индекса.
+     */
+    Stats getStats() const;
+
+protected:
+    /**
+     * @brief Текущее время. Выделено для подмены в тестах.
+     */
+    virtual std::time_t now() const { return std::time(nullptr); }
+
+private:
+    using Index = std::shared_ptr<const PrefixIndex>;
+
+    void run(std::time_t interval, std::time_t full_interval);
+    /// Загрузить значения запрошенных меток; true, если что-то загружено
+    bool loadRequested();
+    void notify();
+
+    std::shared_ptr<TSDBClient> client;
+
+    std::mutex refresh_mutex; ///< Обновления выполняются по одному
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeup;
+    Index metrics;
+    Index labels;
+    std::map<std::string, Index, std::less<>> values;
+    std::set<std::string> requested; ///< Метки, значения которых ждут загрузки
+    std::time_t refreshed = 0;       ///< Время последнего успешного обновления, 0 — не было полного
+    Stats stats;
+    std::function<void()> update_callback;
+    bool stopping = false;
+    std::thread thread;
+};
+
+/** @} */
+
+#endif // TSDB_METADATA_H
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "prefix_index.h"
+
+namespace
+{
+    inline char toLower(char c)
+    {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    /// Бит символа в маске: буквы без учёта регистра, цифры и разделители имён — свои биты
+    inline std::uint64_t charBit(char c)
+    {
+        c = toLower(c);
+        unsigned bit;
+        if (c >= 'a' && c <= 'z')
+            bit = static_cast<unsigned>(c - 'a');
+        else if (c >= '0' && c <= '9')
+            bit = 26 + static_cast<unsigned>(c - '0');
+        else if (c == '_')
+            bit = 36;
+        else if (c == ':')
+            bit = 37;
+        else if (c == '.')
+            bit = 38;
+        else if (c == '-')
+            bit = 39;
+        else
+            bit = 40 + static_cast<unsigned char>(c) % 24;
+        return std::uint64_t(1) << bit;
+    }
+
+    std::uint64_t charMask(std::string_view text)
+    {
+        std::uint64_t mask = 0;
+        for (char c : text)
+            mask |= charBit(c);
+        return mask;
+    }
+
+    inline bool isWordStart(std::string_view text, std::size_t i)
+    {
+        if (i == 0)
+            return true;
+        char previous = text[i - 1];
+        return previous == '_' || previous == ':' || previous == '.' || previous == '-' ||
+               (previous >= 'a' && previous <= 'z' && text[i] >= 'A' && text[i] <= 'Z');
+    }
+
+    /**
+     * @brief Оценка совпадения `pattern` как подпоследовательности `text`, -1 — не совпадает.
+     *
+     * @details Символы шаблона сопоставляются жадно слева направо. Оценка растёт за совпадения подряд и
+     *          в начале слов, так что `http_req` выше оценивает `http_requests_total`, чем `http_server_errors`.
+     */
+    int fuzzyScore(std::string_view text, std::string_view pattern)
+    {
+        int score = 0;
+        std::size_t j = 0;
+        std::size_t previous = std::string_view::npos;
+        for (std::size_t i = 0; i < text.size() && j < pattern.size(); i++)
+        {
+            if (toLower(text[i]) != toLower(pattern[j]))
+                continue;
+            score += 1;
+            if (previous != std::string_view::npos && previous + 1 == i)
+                score += 4;
+            if (isWordStart(text, i))
+                score += 6;
+            previous = i;
+            j++;
+        }
+        return j == pattern.size() ? score : -1;
+    }
+}
+
+PrefixIndex::PrefixIndex(std::vector<std::string> strings)
+{
+    std::sort(strings.begin(), strings.end());
+    strings.erase(std::unique(strings.begin(), strings.end()), strings.end());
+    std::vector<std::string_view> views(strings.begin(), strings.end());
+    *this = fromSorted(views);
+}
+
+PrefixIndex PrefixIndex::fromSorted(const std::vector<std::string_view> &sorted)
+{
+    PrefixIndex index;
+    std::size_t total = 0;
+    for (auto value : sorted)
+        total += value.size();
+    index.chars.reserve(total);
+    index.offsets.reserve(sorted.size() + 1);
+    index.masks.reserve(sorted.size());
+    index.offsets.push_back(0);
+    for (auto value : sorted)
+    {
+        index.chars.append(value);
+        index.offsets.push_back(static_cast<std::uint32_t>(index.chars.size()));
+        index.masks.push_back(charMask(value));
+    }
+    return index;
+}
+
+std::size_t PrefixIndex::lowerBound(std::string_view value) const
+{
+    std::size_t low = 0, high = size();
+    while (low < high)
+    {
+        std::size_t middle = low + (high - low) / 2;
+        if ((*this)[middle] < value)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+bool PrefixIndex::contains(std::string_view value) const
+{
+    std::size_t i = lowerBound(value);
+    return i < size() && (*this)[i] == value;
+}
+
+std::vector<std::string_view> PrefixIndex::findPrefix(std::string_view prefix, std::size_t limit) const
+{
+    std::vector<std::string_view> result;
+    for (std::size_t i = lowerBound(prefix); i < size() && result.size() < limit; i++)
+    {
+        std::string_view value = (*this)[i];
+        // Строки с префиксом идут подряд: первая без него завершает диапазон
+        if (value.substr(0, prefix.size()) != prefix)
+            break;
+        result.push_back(value);
+    }
+    return result;
+}
+
+std::vector<std::string_view> PrefixIndex::findFuzzy(std::string_view pattern, std::size_t limit) const
+{
+    std::vector<std::string_view> result;
+    if (pattern.empty() || limit == 0)
+        return result;
+    std::uint64_t required = charMask(pattern);
+
+    struct Candidate
+    {
+        int score;
+        std::uint32_t index;
+    };
+    std::vector<Candidate> candidates;
+    for (std::size_t i = 0; i < masks.size(); i++)
+    {
+        // Строка без какого-либо символа шаблона отбрасывается одной операцией
+        if ((masks[i] & required) != required)
+            continue;
+        int score = fuzzyScore((*this)[i], pattern);
+        if (score >= 0)
+            candidates.push_back({score, static_cast<std::uint32_t>(i)});
+    }
+
+    auto better = [this](const Candidate &a, const Candidate &b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        std::size_t length_a = offsets[a.index + 1] - offsets[a.index], length_b = offsets[b.index + 1] - offsets[b.index];
+        if (length_a != length_b)
+            return length_a < length_b;
+        return a.index < b.index;
+    };
+    std::size_t count = std::min(limit, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), better);
+    result.reserve(count);
+    for (std::size_t i = 0; i < count; i++)
+        result.push_back((*this)[candidates[i].index]);
+    return result;
+}
+
+PrefixIndex PrefixIndex::merged(std::vector<std::string> added) const
+{
+    std::sort(added.begin(), added.end());
+    added.erase(std::unique(added.begin(), added.end()), added.end());
+    added.erase(std::remove_if(added.begin(), added.end(), [this](const std::string &value) { return contains(value); }), added.end());
+    if (added.empty())
+        return *this;
+
+    std::vector<std::string_view> current;
+    current.reserve(size());
+    for (std::size_t i = 0; i < size(); i++)
+        current.push_back((*this)[i]);
+    std::vector<std::string_view> all;
+    all.reserve(current.size() + added.size());
+    std::merge(current.begin(), current.end(), added.begin(), added.end(), std::back_inserter(all));
+    return fromSorted(all);
+}
+
+std::size_t PrefixIndex::memoryBytes() const
+{
+    return chars.capacity() + offsets.capacity() * sizeof(std::uint32_t) + masks.capacity() * sizeof(std::uint64_t);
+}
@@ -0,0 +1,105 @@
+/**
+ * @file prefix_index.h
+ * @brief Компактный индекс строк для подсказок при вводе.
+ *
+ * @details Содержит класс `PrefixIndex`: отсортированный набор строк в одном буфере с поиском по префиксу
+ *          и нечётким поиском по подпоследовательности. Рассчитан на сотни тысяч имён метрик: поиск по
+ *          префиксу — двоичный, нечёткий поиск отбрасывает большинство строк по битовой маске символов,
+ *          не сравнивая их посимвольно.
+ */
+
+/**
+ * @addtogroup tsdb
+ * @{
+ */
+
+#ifndef TSDB_PREFIX_INDEX_H
+#define TSDB_PREFIX_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Неизменяемый индекс строк для поиска по префиксу и нечёткого поиска.
+ *
+ * @details Строки хранятся отсортированными и без повторов в общем буфере символов со смещениями, без
+ *          отдельной аллокации на строку. Все строки с общим префиксом занимают непрерывный диапазон, как
+ *          поддерево в префиксном дереве, и находятся двумя двоичными поисками. Для нечёткого поиска у
+ *          каждой строки хранится 64-битная маска встречающихся в ней символов.
+ *
+ *          Индекс не меняется после построения: обновлённый индекс строится `merged` и подменяет старый,
+ *          поэтому читать его можно из любых потоков без блокировок.
+ */
+class PrefixIndex
+{
+public:
+    PrefixIndex() = default;
+
+    /**
+     * @brief Построить индекс.
+     *
+     * @param strings Строки в любом порядке, повторы отбрасываются
+     */
+    explicit PrefixIndex(std::vector<std::string> strings);
+
+    std::size_t size() const { return masks.size(); }
+    bool empty() const { return masks.empty(); }
+
+    /**
+     * @brief Строка с номером `i` в порядке сортировки.
+     */
+    std::string_view operator[](std::size_t i) const { return {chars.data() + offsets[i], offsets[i + 1] - offsets[i]}; }
+
+    bool contains(std::string_view value) const;
+
+    /**
+     * @brief Строки, начинающиеся с `prefix`, в порядке сортировки.
+     *
+     * @param prefix Префикс, с учётом регистра
+     * @param limit Наибольшее число результатов
+     */
+    std::vector<std::string_view> findPrefix(std::string_view prefix, std::size_t limit) const;
+
+    /**
+     * @brief Строки, содержащие символы `pattern` по порядку, от лучших совпадений к худшим.
+     *
+     * @details Регистр не учитывается. Выше оцениваются совпадения подряд идущих символов и совпадения
+     *          в начале слов (после `_`, `:`, `.`, `-`), при равной оценке — более короткие строки.
+     *
+     * @param pattern Искомые символы; пустой шаблон ничего не находит
+     * @param limit Наибольшее число результатов
+     */
+    std::vector<std::string_view> findFuzzy(std::string_view pattern, std::size_t limit) const;
+
+    /**
+     * @brief Индекс с добавленными строками.
+     *
+     * @details Слияние двух отсортированных последовательностей: O(n + k log k) без повторной сортировки
+     *          всех строк.
+     *
+     * @param added Новые строки в любом порядке, уже известные отбрасываются
+     */
+    PrefixIndex merged(std::vector<std::string> added) const;
+
+    /**
+     * @brief Оценка занимаемой памяти в байтах.
+     */
+    std::size_t memoryBytes() const;
+
+private:
+    /// Построение из отсортированных строк без повторов
+    static PrefixIndex fromSorted(const std::vector<std::string_view> &sorted);
+
+    std::size_t lowerBound(std::string_view value) const;
+
+    std::string chars;                  ///< Строки подряд, без разделителей
+    std::vector<std::uint32_t> offsets; ///< Начало строки `i` — `offsets[i]`, конец — `offsets[i + 1]`
+    std::vector<std::uint64_t> masks;   ///< Символы строки `i` (без учёта регистра)
+};
+
+/** @} */
+
+#endif // TSDB_PREFIX_INDEX_H
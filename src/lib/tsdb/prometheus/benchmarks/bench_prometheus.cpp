@@ -0,0 +1,145 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "benchmark.h"
+#include "../remote_read_codec.h"
+#include "../response_parser.h"
+#include "../sample_decoder.h"
+
+/**
+ * Синтетический ответ `query_range`: `series` рядов по `points` точек с шагом 15 секунд.
+ */
+static std::string makeResponse(int series, int points)
+{
+    std::string response = R"({"status":"success","data":{"resultType":"matrix","result":[)";
+    for (int s = 0; s < series; s++)
+    {
+        if (s)
+            response += ',';
+        response += R"({"metric":{"__name__":"process_resident_memory_bytes","instance":"host-)" + std::to_string(s) +
+                    R"(:9100","job":"node"},"values":[)";
+        for (int p = 0; p < points; p++)
+        {
+            if (p)
+                response += ',';
+            response += '[' + std::to_string(1700000000 + p * 15) + ",\"" + std::to_string(123456.789 + p) + "\"]";
+        }
+        response += "]}";
+    }
+    response += "]}}";
+    return response;
+}
+
+/**
+ * Прежняя реализация `PrometheusClient::parse_response` через DOM nlohmann::json — для сравнения.
+ */
+static std::vector<Metric> parseWithDom(const std::string &response)
+{
+    std::vector<Metric> metrics;
+    auto parsed_json = nlohmann::json::parse(response);
+    for (const auto &result : parsed_json["data"]["result"])
+    {
+        Metric metric;
+        std::vector<LabelSet::Label> labels;
+        auto metric_info = result["metric"];
+        for (auto it = metric_info.begin(); it != metric_info.end(); ++it)
+        {
+            if (it.key() == "__name__")
+                metric.name = it.value().get<std::string>();
+            else
+                labels.emplace_back(it.key(), it.value().get<std::string>());
+        }
+        metric.labels = LabelSet(std::move(labels));
+        for (const auto &value_pair : result["values"])
+        {
+            Point point;
+            point.timestamp = value_pair[0];
+            point.value = std::stod((std::string)value_pair[1]);
+            metric.series.push_back(point);
+        }
+        metrics.push_back(metric);
+    }
+    return metrics;
+}
+
+static std::vector<Metric> parseStreaming(const std::string &response)
+{
+    PrometheusResponseParser parser;
+    parser.feed(response);
+    return parser.finish();
+}
+
+int main(int argc, char **argv)
+{
+    benchmark::Suite suite("parse_response", benchmark::parseOptions(argc, argv));
+    // От одной точки до 10^6 точек в ответе
+    const std::pair<int, int> shapes[] = {{1, 1}, {1, 1000}, {10, 1000}, {100, 1000}, {300, 2880}, {100, 10000}};
+    for (auto [series, points] : shapes)
+    {
+        std::string response = makeResponse(series, points);
+        std::size_t total = static_cast<std::size_t>(series) * points;
+        std::string shape = std::to_string(series) + "x" + std::to_string(points) + " (" + std::to_string(response.size() / 1024) + " KiB)";
+
+        suite.run("dom " + shape, total, [&] { benchmark::doNotOptimize(parseWithDom(response)); });
+        suite.run("streaming " + shape, total, [&] { benchmark::doNotOptimize(parseStreaming(response)); });
+    }
+    suite.print();
+
+    // Разбор значений точек: прежний путь через временную строку и std::stod против decodeSampleValue
+    benchmark::Suite samples("sample values", suite.getOptions());
+    std::vector<std::string> values;
+    for (int i = 0; i < 100000; i++)
+        values.push_back(i % 100 == 0 ? "NaN" : std::to_string(123456.789 + i * 0.001));
+    samples.run("std::stod", values.size(), [&] {
+        double sum = 0;
+        for (const auto &value : values)
+            sum += std::stod(std::string(value.data(), value.size()));
+        benchmark::doNotOptimize(sum);
+    });
+    samples.run("decodeSampleValue", values.size(), [&] {
+        double sum = 0, sample;
+        for (const auto &value : values)
+        {
+            decodeSampleValue(value.data(), value.data() + value.size(), sample);
+            sum += sample;
+        }
+        benchmark::doNotOptimize(sum);
+    });
+    samples.run("parseDecimal", values.size(), [&] {
+        double sum = 0, sample;
+        for (const auto &value : values)
+        {
+            parseDecimal(value.data(), value.data() + value.size(), sample);
+            sum += sample;
+        }
+        benchmark::doNotOptimize(sum);
+    });
+    samples.print();
+
+    // Одни и те же ряды через JSON query_range и через поток XOR-чанков remote read
+    benchmark::Suite remote_read("remote read", suite.getOptions());
+    const std::pair<int, int> remote_shapes[] = {{10, 1000}, {100, 1000}, {100, 10000}};
+    for (auto [series, points] : remote_shapes)
+    {
+        std::string json = makeResponse(series, points);
+        std::string frames;
+        for (const auto &metric : parseStreaming(json))
+            frames += encodeChunkedSeriesFrame(metric);
+        std::size_t total = static_cast<std::size_t>(series) * points;
+        std::string shape = std::to_string(series) + "x" + std::to_string(points);
+        std::int64_t end_ms = (1700000000LL + points * 15LL) * 1000;
+
+        remote_read.run("json " + shape + " (" + std::to_string(json.size() / 1024) + " KiB)", total,
+                        [&] { benchmark::doNotOptimize(parseStreaming(json)); });
+        remote_read.run("xor chunks " + shape + " (" + std::to_string(frames.size() / 1024) + " KiB)", total, [&] {
+            RemoteReadResponseDecoder decoder(0, end_ms);
+            decoder.feed(frames);
+            benchmark::doNotOptimize(decoder.finish());
+        });
+    }
+    remote_read.print();
+    return 0;
+}
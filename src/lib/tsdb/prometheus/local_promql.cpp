@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <exception>
+#include <unordered_map>
+#include <utility>
+
+#include "local_promql.h"
+#include "promql.h"
+
+LocalPromQLClient::LocalPromQLClient(std::shared_ptr<TSDBClient> raw, std::shared_ptr<TSDBClient> fallback, std::size_t memory_limit)
+    : raw(std::move(raw)), fallback(std::move(fallback)), memory_limit(memory_limit)
+{
+}
+
+std::vector<Metric> LocalPromQLClient::query(const std::string &query_str, std::time_t start, std::time_t end)
+{
+    return fallback->query(query_str, start, end);
+}
+
+std::vector<Metric> LocalPromQLClient::query(const std::string &query_str, std::time_t start, std::time_t end, int step)
+{
+    try
+    {
+        auto expression = parsePromQL(query_str);
+        auto loaded = prefetch(rawQueriesOf(*expression, start, end));
+        std::vector<Metric> result = evaluatePromQL(*expression, loader(loaded), start, end, step);
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.local_queries++;
+        return result;
+    }
+    catch (const std::exception &)
+    {
+        // Выражение вне подмножества или сырые точки недоступны — запрос выполняет сервер
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.fallback_queries++;
+    }
+    return fallback->query(query_str, start, end, step);
+}
+
+std::vector<RangeQueryResult> LocalPromQLClient::queryBatch(const std::vector<RangeQuery> &queries)
+{
+    std::vector<std::unique_ptr<PromQLExpression>> expressions(queries.size());
+    std::vector<RangeQuery> raw_queries;
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        try
+        {
+            expressions[i] = parsePromQL(queries[i].query);
+            for (auto &raw_query : rawQueriesOf(*expressions[i], queries[i].start, queries[i].end))
+                raw_queries.push_back(std::move(raw_query));
+        }
+        catch (const std::invalid_argument &)
+        {
+        }
+    }
+    std::unordered_map<std::string, RawMetrics> loaded;
+    try
+    {
+        loaded = prefetch(raw_queries);
+    }
+    catch (const std::exception &)
+    {
+        // Загрузчик повторит загрузку по селекторам, и не загрузившиеся запросы уйдут запасному клиенту
+    }
+    RawSeriesLoader load = loader(loaded);
+
+    std::vector<RangeQueryResult> results(queries.size());
+    std::vector<std::size_t> remote;
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        if (!expressions[i])
+        {
+            remote.push_back(i);
+            continue;
+        }
+        try
+        {
+            results[i].metrics =
+                std::make_shared<const std::vector<Metric>>(evaluatePromQL(*expressions[i], load, queries[i].start, queries[i].end, queries[i].step));
+        }
+        catch (const std::exception &)
+        {
+            remote.push_back(i);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.local_queries += queries.size() - remote.size();
+        stats.fallback_queries += remote.size();
+    }
+    if (remote.empty())
+        return results;
+
+    std::vector<RangeQuery> forwarded;
+    forwarded.reserve(remote.size());
+    for (std::size_t i : remote)
+        forwarded.push_back(queries[i]);
+    std::vector<RangeQueryResult> answered = fallback->queryBatch(forwarded);
+    for (std::size_t j = 0; j < remote.size(); j++)
+        results[remote[j]] = std::move(answered[j]);
+    return results;
+}
+
+bool LocalPromQLClient::isAvailable() noexcept
+{
+    return fallback->isAvailable();
+}
+
+TSDBClient::TransferStats LocalPromQLClient::getTransferStats() const
+{
+    TransferStats total = raw->getTransferStats();
+    TransferStats other = fallback->getTransferStats();
+    total.requests += other.requests;
+    total.bytes += other.bytes;
+    total.sink_seconds += other.sink_seconds;
+    return total;
+}
+
+LocalPromQLClient::Stats LocalPromQLClient::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void LocalPromQLClient::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    lru.clear();
+    stats.memory_bytes = 0;
+}
+
+std::size_t LocalPromQLClient::estimateBytes(const std::vector<Metric> &metrics)
+{
+    // Строки меток интернированы и общие для всех рядов, поэтому учитываются только ссылки на них
+    std::size_t bytes = 0;
+    for (const auto &metric : metrics)
+    {
+        bytes += sizeof(Metric) + metric.labels.size() * sizeof(LabelSet::Label);
+        bytes += (metric.series.timestamps.capacity() + metric.series.values.capacity()) * sizeof(double);
+    }
+    return bytes;
+}
+
+std::vector<LocalPromQLClient::Fetch> LocalPromQLClient::plan(const std::vector<RangeQuery> &raw_queries)
+{
+    // Один селектор в нескольких местах выражения загружается один раз на объединённый интервал
+    std::vector<Fetch> fetches;
+    std::unordered_map<std::string, std::size_t> index;
+    for (const auto &query : raw_queries)
+    {
+        auto [it, inserted] = index.try_emplace(query.query, fetches.size());
+        if (inserted)
+        {
+            Fetch fetch;
+            fetch.selector = query.query;
+            fetch.start = fetch.from = query.start;
+            fetch.end = query.end;
+            fetches.push_back(std::move(fetch));
+            continue;
+        }
+        Fetch &fetch = fetches[it->second];
+        fetch.start = std::min(fetch.start, query.start);
+        fetch.end = std::max(fetch.end, query.end);
+        fetch.from = fetch.start;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Fetch> planned;
+    for (auto &fetch : fetches)
+    {
+        auto it = entries.find(fetch.selector);
+        if (it == entries.end() || it->second.start > fetch.start || it->second.end < fetch.start)
+        {
+            stats.raw_misses++;
+            planned.push_back(std::move(fetch));
+            continue;
+        }
+        Entry &entry = it->second;
+        lru.splice(lru.begin(), lru, entry.lru);
+        if (entry.end >= fetch.end)
+        {
+            stats.raw_hits++;
+            fetch.metrics = entry.metrics;
+            planned.push_back(std::move(fetch));
+            continue;
+        }
+        stats.raw_partial_hits++;
+        fetch.from = entry.end;
+        fetch.tail = true;
+        planned.push_back(std::move(fetch));
+    }
+    return planned;
+}
+
+std::unordered_map<std::string, LocalPromQLClient::RawMetrics> LocalPromQLClient::prefetch(const std::vector<RangeQuery> &raw_queries)
+{
+    std::unordered_map<std::string, RawMetrics> loaded;
+    std::vector<Fetch> fetches = plan(raw_queries);
+    std::vector<std::size_t> missing;
+    std::vector<RangeQuery> requests;
+    for (std::size_t i = 0; i < fetches.size(); i++)
+    {
+        if (fetches[i].metrics)
+        {
+            loaded.emplace(fetches[i].selector, fetches[i].metrics);
+            continue;
+        }
+        missing.push_back(i);
+        requests.push_back({fetches[i].selector, fetches[i].from, fetches[i].end, 0});
+    }
+    if (requests.empty())
+        return loaded;
+
+    std::vector<RangeQueryResult> results = raw->queryBatch(requests);
+    for (std::size_t j = 0; j < missing.size(); j++)
+    {
+        // Неудачная загрузка повторится в загрузчике, и её ошибка переведёт запрос на запасной клиент
+        if (!results[j].error)
+            loaded.emplace(fetches[missing[j]].selector, store(fetches[missing[j]], results[j].metrics));
+    }
+    return loaded;
+}
+
+RawSeriesLoader LocalPromQLClient::loader(const std::unordered_map<std::string, RawMetrics> &loaded)
+{
+    return [this, &loaded](const std::string &selector, std::time_t start, std::time_t end) -> RawMetrics {
+        // Загруженные заранее точки покрывают интервалы всех селекторов выражения
+        auto it = loaded.find(selector);
+        if (it != loaded.end())
+            return it->second;
+        Fetch fetch = plan({{selector, start, end, 0}}).front();
+        if (fetch.metrics)
+            return fetch.metrics;
+        return store(fetch, std::make_shared<const std::vector<Metric>>(raw->query(selector, fetch.from, fetch.end, 0)));
+    };
+}
+
+LocalPromQLClient::RawMetrics LocalPromQLClient::store(const Fetch &fetch, RawMetrics fetched)
+{
+    std::time_t loaded_until = std::min(fetch.end, now() - FRESHNESS_LAG);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(fetch.selector);
+    bool append = fetch.tail && it != entries.end() && it->second.start <= fetch.start && it->second.end >= fetch.from;
+    if (append)
+    {
+        // Записи кэша неизменяемы и разделяются с идущими вычислениями: хвост дописывается в копию
+        std::vector<Metric> merged = *it->second.metrics;
+        std::unordered_map<SeriesKey, std::size_t, SeriesKeyHash> index;
+        for (std::size_t i = 0; i < merged.size(); i++)
+            index.emplace(merged[i].key(), i);
+        for (const auto &metric : *fetched)
+        {
+            auto found = index.find(metric.key());
+            if (found == index.end())
+                merged.push_back(metric);
+            else
+                merged[found->second].series.appendNewer(metric.series);
+        }
+        fetched = std::make_shared<const std::vector<Metric>>(std::move(merged));
+    }
+
+    // Загруженные целиком ряды хранятся в кэше без копии
+    RawMetrics metrics = std::move(fetched);
+    if (it == entries.end())
+    {
+        it = entries.try_emplace(fetch.selector).first;
+        lru.push_front(fetch.selector);
+        it->second.lru = lru.begin();
+    }
+    Entry &entry = it->second;
+    stats.memory_bytes -= entry.bytes;
+    entry.start = append ? entry.start : fetch.from;
+    entry.end = std::max(append ? entry.end : fetch.from, loaded_until);
+    entry.metrics = metrics;
+    entry.bytes = estimateBytes(*metrics);
+    stats.memory_bytes += entry.bytes;
+    lru.splice(lru.begin(), lru, entry.lru);
+    evict(fetch.selector);
+    return metrics;
+}
+
+void LocalPromQLClient::evict(const std::string &keep)
+{
+    while (stats.memory_bytes > memory_limit && !lru.empty())
+    {
+        const std::string &victim = lru.back();
+        if (victim == keep)
+            break;
+        auto it = entries.find(victim);
+        stats.memory_bytes -= it->second.bytes;
+        stats.evictions++;
+        entries.erase(it);
+        lru.pop_back();
+    }
+}
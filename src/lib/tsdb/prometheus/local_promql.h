@@ -0,0 +1,176 @@
+/**
+ * @file local_promql.h
+ * @brief Клиент, вычисляющий подмножество PromQL на стороне клиента.
+ *
+ * @details Содержит класс `LocalPromQLClient`: выражения из подмножества `promql.h` вычисляются по сырым точкам,
+ *          загруженным через remote read и закэшированным по селекторам, остальные запросы выполняет сервер.
+ *          Смена функции, окна или группировки над теми же рядами не требует обращения к Prometheus.
+ */
+
+/**
+ * @addtogroup prometheus
+ * @{
+ */
+
+#ifndef TSDB_PROMETHEUS_LOCAL_PROMQL_H
+#define TSDB_PROMETHEUS_LOCAL_PROMQL_H
+
+#include <cstddef>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../tsdb.h"
+#include "promql.h"
+
+/**
+ * @brief Клиент с локальным вычислением PromQL и запасным сервером.
+ *
+ * @details Запрос разбирается `parsePromQL`; селекторы выражения загружаются из `raw` одним пакетом и
+ *          вычисляются локально. Если выражение выходит за подмножество или загрузка сырых точек не удалась
+ *          (например, remote read на сервере выключен), запрос уходит в `fallback` без изменений.
+ *
+ *          Сырые точки кэшируются по тексту селектора вместе с загруженным интервалом. Запрос, интервал
+ *          которого начинается внутри загруженного, догружает только хвост. Последние `FRESHNESS_LAG` секунд
+ *          до текущего момента не считаются загруженными. Объём кэша ограничен, при превышении вытесняются
+ *          давно не использованные селекторы. Методы потокобезопасны; запросы выполняются без удержания
+ *          блокировки.
+ */
+class LocalPromQLClient : public TSDBClient
+{
+public:
+    /// Интервал до текущего момента, который не считается окончательно загруженным, секунд
+    static constexpr std::time_t FRESHNESS_LAG = 60;
+
+    /**
+     * @brief Счётчики работы клиента.
+     */
+    struct Stats
+    {
+        std::size_t local_queries = 0;    ///< Запросы, вычисленные локально
+        std::size_t fallback_queries = 0; ///< Запросы, отправленные запасному клиенту
+        std::size_t raw_hits = 0;         ///< Селекторы, полностью взятые из кэша сырых точек
+        std::size_t raw_partial_hits = 0; ///< Селекторы, для которых догружался только хвост
+        std::size_t raw_misses = 0;       ///< Селекторы, загруженные целиком
+        std::size_t evictions = 0;        ///< Вытесненные селекторы
+        std::size_t memory_bytes = 0;     ///< Текущий оценочный объём кэша сырых точек
+    };
+
+    /**
+     * @brief Конструктор клиента.
+     *
+     * @param raw Клиент сырых точек, принимающий селекторы, например `PrometheusRemoteReadClient`
+     * @param fallback Клиент для выражений вне подмножества, например `PrometheusClient`
+     * @param memory_limit Ограничение объёма кэша сырых точек в байтах
+     */
+    LocalPromQLClient(std::shared_ptr<TSDBClient> raw, std::shared_ptr<TSDBClient> fallback, std::size_t memory_limit);
+    ~LocalPromQLClient() override = default;
+
+    /**
+     * @brief Выполнить запрос без шага через запасной клиент.
+     */
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end) override;
+
+    /**
+     * @brief Выполнить range query локально или через запасной клиент.
+     */
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end, int step) override;
+
+    /**
+     * @brief Выполнить несколько запросов.
+     *
+     * @details Сырые точки всех локальных запросов загружаются одним пакетом, запросы вне подмножества
+     *          уходят запасному клиенту тоже одним пакетом.
+     */
+    std::vector<RangeQueryResult> queryBatch(const std::vector<RangeQuery> &queries) override;
+
+    /**
+     * @brief Проверить доступность запасного клиента.
+     */
+    bool isAvailable() noexcept override;
+
+    /**
+     * @brief Получить имена меток у запасного клиента.
+     */
+    std::vector<std::string> labelNames(std::time_t start, std::time_t end) override { return fallback->labelNames(start, end); }
+
+    /**
+     * @brief Получить значения метки у запасного клиента.
+     */
+    std::vector<std::string> labelValues(const std::string &label, std::time_t start, std::time_t end) override
+    {
+        return fallback->labelValues(label, start, end);
+    }
+
+    /**
+     * @brief Суммарные счётчики HTTP-запросов обоих клиентов.
+     */
+    TransferStats getTransferStats() const override;
+
+    /**
+     * @brief Получить счётчики клиента.
+     */
+    Stats getStats() const;
+
+    /**
+     * @brief Очистить кэш сырых точек. Счётчики не сбрасываются.
+     */
+    void clear();
+
+protected:
+    /**
+     * @brief Текущее время. Выделено для подмены в тестах.
+     */
+    virtual std::time_t now() const { return std::time(nullptr); }
+
+private:
+    using RawMetrics = SharedMetrics;
+
+    struct Entry
+    {
+        std::time_t start = 0; ///< Начало загруженного интервала
+        std::time_t end = 0;   ///< Конец интервала, который считается загруженным
+        RawMetrics metrics;
+        std::size_t bytes = 0;
+        std::list<std::string>::iterator lru;
+    };
+
+    /// Сырые точки селектора: из кэша, с догрузкой хвоста или целиком
+    struct Fetch
+    {
+        std::string selector;
+        std::time_t start;  ///< Запрошенный интервал
+        std::time_t end;
+        std::time_t from;   ///< Начало интервала, который нужно загрузить
+        bool tail = false;  ///< Загрузка дописывается к записи кэша
+        RawMetrics metrics; ///< Точки из кэша, если загрузка не нужна
+    };
+
+    static std::size_t estimateBytes(const std::vector<Metric> &metrics);
+
+    /// Загрузки селекторов запросов; обновляет счётчики и порядок вытеснения
+    std::vector<Fetch> plan(const std::vector<RangeQuery> &raw_queries);
+    /// Сырые точки селекторов, недостающие загружаются одним пакетом; селекторы с ошибкой загрузки пропускаются
+    std::unordered_map<std::string, RawMetrics> prefetch(const std::vector<RangeQuery> &raw_queries);
+    /// Загрузчик для вычисления: точки из `loaded`, иначе загрузка селектора отдельным запросом
+    RawSeriesLoader loader(const std::unordered_map<std::string, RawMetrics> &loaded);
+    RawMetrics store(const Fetch &fetch, RawMetrics fetched);
+    void evict(const std::string &keep);
+
+    std::shared_ptr<TSDBClient> raw;
+    std::shared_ptr<TSDBClient> fallback;
+    std::size_t memory_limit;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru; ///< Селекторы от недавно использованных к давно не использованным
+    Stats stats;
+};
+
+/** @} */
+
+#endif // TSDB_PROMETHEUS_LOCAL_PROMQL_H
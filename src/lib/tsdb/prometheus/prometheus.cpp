@@ -1,7 +1,51 @@
+#include <algorithm>
+#include <atomic>
 #include <ctime>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <curl/curl.h>
 #include "prometheus.h"
-#include <nlohmann/json.hpp>
+#include "response_parser.h"
+#include "../../trace/trace.h"
+
+namespace
+{
+    using Extent = std::pair<std::time_t, std::time_t>;
+
+    /// Части `[start + k * span, start + k * span + (max_points - 1) * step]`: обе границы включаются Prometheus
+    std::vector<Extent> splitRange(std::time_t start, std::time_t end, int step, std::size_t max_points)
+    {
+        if (step <= 0 || end < start || max_points == 0)
+            return {{start, end}};
+        const std::time_t span = static_cast<std::time_t>(max_points) * step;
+        const std::size_t chunks = static_cast<std::size_t>((end - start) / span) + 1;
+        std::vector<Extent> parts;
+        parts.reserve(chunks);
+        for (std::size_t chunk = 0; chunk < chunks; chunk++)
+        {
+            std::time_t chunk_start = start + static_cast<std::time_t>(chunk) * span;
+            parts.emplace_back(chunk_start, std::min(end, chunk_start + span - step));
+        }
+        return parts;
+    }
+
+    /// Дописать ряды очередной по времени части к уже склеенным рядам.
+    void appendChunk(std::vector<Metric> &merged, std::unordered_map<SeriesKey, std::size_t, SeriesKeyHash> &index,
+                     std::vector<Metric> &chunk)
+    {
+        for (auto &metric : chunk)
+        {
+            auto [it, inserted] = index.emplace(metric.key(), merged.size());
+            if (inserted)
+                merged.push_back(std::move(metric));
+            else
+                merged[it->second].series.appendNewer(metric.series);
+        }
+    }
+}
 
 PrometheusClient::PrometheusClient(const std::string &base_url) : base_url(base_url) {}
 
@@ -12,12 +56,147 @@ std::vector<Metric> PrometheusClient::query(const std::string &query_str, std::t
 
 std::vector<Metric> PrometheusClient::query(const std::string &query_str, std::time_t start, std::time_t end, int step)
 {
-    std::string url = base_url + "/api/v1/query_range" + "?query=" + curl_escape(query_str.c_str(), query_str.length());
+    if (step > 0 && end >= start && static_cast<std::size_t>((end - start) / step) >= MAX_POINTS_PER_REQUEST)
+        return queryChunked(query_str, start, end, step);
+    return queryRange(query_str, start, end, step);
+}
+
+std::vector<Metric> PrometheusClient::queryChunked(const std::string &query_str, std::time_t start, std::time_t end, int step,
+                                                   int max_parallel, std::size_t max_points)
+{
+    if (step <= 0 || end < start || max_points == 0)
+        return queryRange(query_str, start, end, step);
+
+    std::vector<Extent> parts = splitRange(start, end, step, max_points);
+    const std::size_t chunks = parts.size();
+    if (chunks == 1)
+        return queryRange(query_str, start, end, step);
+
+    std::vector<std::vector<Metric>> results(chunks);
+    std::atomic<std::size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]
+    {
+        for (std::size_t chunk = next++; chunk < chunks; chunk = next++)
+        {
+            try
+            {
+                results[chunk] = queryRange(query_str, parts[chunk].first, parts[chunk].second, step);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+                next = chunks; // Остальные части уже не нужны
+            }
+        }
+    };
+
+    std::size_t threads_count = std::min<std::size_t>(chunks, max_parallel > 0 ? max_parallel : 1);
+    std::vector<std::thread> threads;
+    threads.reserve(threads_count - 1);
+    for (std::size_t i = 1; i < threads_count; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+        thread.join();
+    if (error)
+        std::rethrow_exception(error);
+
+    // Части упорядочены по времени, поэтому ряды достаточно дописывать в конец
+    std::vector<Metric> merged;
+    std::unordered_map<SeriesKey, std::size_t, SeriesKeyHash> index;
+    for (auto &chunk : results)
+        appendChunk(merged, index, chunk);
+    return merged;
+}
+
+std::vector<RangeQueryResult> PrometheusClient::queryBatch(const std::vector<RangeQuery> &queries)
+{
+    // Без потокового разбора ответы собирает performHttpRequest, который подменяют тесты
+    if (!streaming_responses)
+        return TSDBClient::queryBatch(queries);
+
+    // Каждая часть каждого запроса — отдельная передача, все идут одновременно
+    std::vector<std::unique_ptr<PrometheusResponseParser>> parsers;
+    std::vector<std::size_t> owners; // Номер запроса для каждой передачи
+    std::vector<HttpStream> streams;
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        const RangeQuery &query = queries[i];
+        for (const auto &part : splitRange(query.start, query.end, query.step, MAX_POINTS_PER_REQUEST))
+        {
+            parsers.push_back(std::make_unique<PrometheusResponseParser>(pointsHint(part.first, part.second, query.step)));
+            PrometheusResponseParser *parser = parsers.back().get();
+            owners.push_back(i);
+            HttpStream stream;
+            stream.url = queryRangeUrl(query.query, part.first, part.second, query.step);
+            stream.sink = [parser](const char *data, std::size_t size) { parser->feed(data, size); };
+            streams.push_back(std::move(stream));
+        }
+    }
+
+    std::vector<std::exception_ptr> errors = streamHttpRequests(streams);
+    std::vector<RangeQueryResult> results(queries.size());
+    std::vector<std::vector<Metric>> merged(queries.size());
+    std::vector<std::unordered_map<SeriesKey, std::size_t, SeriesKeyHash>> indexes(queries.size());
+    for (std::size_t k = 0; k < streams.size(); k++)
+    {
+        std::size_t i = owners[k];
+        if (results[i].error)
+            continue;
+        try
+        {
+            if (errors[k])
+                std::rethrow_exception(errors[k]);
+            std::vector<Metric> chunk = parsers[k]->finish();
+            appendChunk(merged[i], indexes[i], chunk);
+        }
+        catch (...)
+        {
+            results[i].error = std::current_exception();
+            merged[i].clear();
+        }
+    }
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        if (!results[i].error)
+            results[i].metrics = std::make_shared<const std::vector<Metric>>(std::move(merged[i]));
+    }
+    return results;
+}
+
+std::string PrometheusClient::queryRangeUrl(const std::string &query_str, std::time_t start, std::time_t end, int step) const
+{
+    char *escaped = curl_escape(query_str.c_str(), static_cast<int>(query_str.length()));
+    std::string url = base_url + "/api/v1/query_range" + "?query=" + escaped;
+    curl_free(escaped);
     url += "&start=" + std::to_string(start);
     url += "&end=" + std::to_string(end);
     url += "&step=" + std::to_string(step);
+    return url;
+}
+
+std::size_t PrometheusClient::pointsHint(std::time_t start, std::time_t end, int step)
+{
+    return step > 0 && end >= start ? static_cast<std::size_t>((end - start) / step + 1) : 0;
+}
+
+std::vector<Metric> PrometheusClient::queryRange(const std::string &query_str, std::time_t start, std::time_t end, int step)
+{
+    trace::Span span("query_range", "tsdb");
+    std::string url = queryRangeUrl(query_str, start, end, step);
+    std::size_t points_hint = pointsHint(start, end, step);
+    if (streaming_responses)
+    {
+        PrometheusResponseParser parser(points_hint);
+        streamHttpRequest(url, [&parser](const char *data, std::size_t size) { parser.feed(data, size); });
+        return parser.finish();
+    }
     std::string response = performHttpRequest(url);
-    return parse_response(response);
+    return parse_response(response, points_hint);
 }
 
 bool PrometheusClient::isAvailable() noexcept
@@ -34,49 +213,38 @@ bool PrometheusClient::isAvailable() noexcept
     }
 }
 
-std::vector<Metric> PrometheusClient::parse_response(const std::string &response)
+std::vector<std::string> PrometheusClient::labelNames(std::time_t start, std::time_t end)
 {
-    std::vector<Metric> metrics;
+    trace::Span span("label_names", "tsdb");
+    return parseLabelValuesResponse(performHttpRequest(prometheusMetadataUrl(base_url, "", start, end)));
+}
 
-    auto parsed_json = nlohmann::json::parse(response);
+std::vector<std::string> PrometheusClient::labelValues(const std::string &label, std::time_t start, std::time_t end)
+{
+    trace::Span span("label_values", "tsdb");
+    return parseLabelValuesResponse(performHttpRequest(prometheusMetadataUrl(base_url, label, start, end)));
+}
 
-    if (parsed_json["status"] == "error")
-    {
-        throw InvalidPrometheusRequest(parsed_json["error"], parsed_json["errorType"]);
-    }
-    else if (parsed_json["status"] != "success")
-    {
-        throw std::runtime_error("Unexpexted prometheus request error");
-    }
+std::vector<Metric> PrometheusClient::parse_response(const std::string &response, std::size_t points_hint)
+{
+    trace::Span span("parse_response", "tsdb");
+    PrometheusResponseParser parser(points_hint);
+    parser.feed(response);
+    return parser.finish();
+}
 
-    for (const auto &result : parsed_json["data"]["result"])
+std::string prometheusMetadataUrl(const std::string &base_url, const std::string &label, std::time_t start, std::time_t end)
+{
+    std::string url = base_url + "/api/v1/labels";
+    if (!label.empty())
     {
-        Metric metric;
-
-        auto metric_info = result["metric"];
-        for (auto it = metric_info.begin(); it != metric_info.end(); ++it)
-        {
-            if (it.key() == "__name__")
-            {
-                metric.name = it.value();
-            }
-            else
-            {
-                metric.labels[it.key()] = it.value();
-            }
-        }
-
-        for (const auto &value_pair : result["values"])
-        {
-            Point point;
-            point.timestamp = value_pair[0];
-            point.value = std::stod((std::string)value_pair[1]);
-            metric.values.push_back(point);
-        }
-
-        metrics.push_back(metric);
+        char *escaped = curl_escape(label.c_str(), static_cast<int>(label.length()));
+        url = base_url + "/api/v1/label/" + escaped + "/values";
+        curl_free(escaped);
     }
-    return metrics;
+    if (start != 0 || end != 0)
+        url += "?start=" + std::to_string(start) + "&end=" + std::to_string(end);
+    return url;
 }
 
 InvalidPrometheusRequest::InvalidPrometheusRequest(const std::string &errorMsg, const std::string &errorType)
@@ -22,6 +22,7 @@
 #ifndef TSDB_PROMETHEUS_H
 #define TSDB_PROMETHEUS_H
 
+#include <cstddef>
 #include <ctime>
 
 #include "../tsdb.h"
@@ -47,6 +48,9 @@ public:
 class PrometheusClient : public TSDBClient
 {
 public:
+    static constexpr std::size_t MAX_POINTS_PER_REQUEST = 11'000; ///< Лимит Prometheus на число точек ряда в одном ответе
+    static constexpr int DEFAULT_PARALLEL_REQUESTS = 4;           ///< Число одновременных запросов при разбиении диапазона
+
     /**
      * @brief Конструктор клиента Prometheus.
      *
@@ -75,8 +79,52 @@ public:
      * @param step Интервал между точками в секундах, по умолчанию 15
      * @return Массив метрик типа Metric
      * @throws InvalidPrometheusRequest В случае неуспешного статуса ответа от Prometheus
+     *
+     * @details Если диапазон содержит больше `MAX_POINTS_PER_REQUEST` точек, он загружается по частям
+     *          через `queryChunked` с `DEFAULT_PARALLEL_REQUESTS` одновременными запросами.
+     */
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end, int step) override;
+
+    /**
+     * @brief Выполнить запрос, разбив диапазон на части.
+     *
+     * @details Диапазон `[start, end]` делится на поддиапазоны не более чем по `max_points` точек.
+     *          Начало каждого поддиапазона лежит на сетке `start + k * step`, поэтому точки частей
+     *          не пересекаются и совпадают с точками одного большого запроса. Части загружаются параллельно,
+     *          не более `max_parallel` одновременно, затем ряды склеиваются по метрике и меткам в порядке времени.
+     *
+     * @param query_str Строка запроса в формате PromQL
+     * @param start Начало временного диапазона
+     * @param end Конец временного диапазона
+     * @param step Интервал между точками в секундах
+     * @param max_parallel Максимальное число одновременных запросов
+     * @param max_points Максимальное число точек в одной части
+     * @return Массив метрик типа Metric в порядке первого появления ряда
+     * @throws InvalidPrometheusRequest Если хотя бы одна часть завершилась ошибкой
      */
-    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end, int step);
+    std::vector<Metric> queryChunked(const std::string &query_str, std::time_t start, std::time_t end, int step,
+                                     int max_parallel = DEFAULT_PARALLEL_REQUESTS, std::size_t max_points = MAX_POINTS_PER_REQUEST);
+
+    /**
+     * @brief Выполнить несколько запросов одновременно.
+     *
+     * @details При включённом потоковом разборе все запросы (и части длинных диапазонов, см. `queryChunked`)
+     *          отправляются разом через `streamHttpRequests`, ответы разбираются по мере получения.
+     *          Время пакета определяется самым долгим запросом, а не суммой. Без потокового разбора
+     *          запросы выполняются по очереди.
+     */
+    std::vector<RangeQueryResult> queryBatch(const std::vector<RangeQuery> &queries) override;
+
+    /**
+     * @brief Включить потоковый разбор ответов.
+     *
+     * @details Тело ответа `query_range` передаётся в парсер по частям прямо из сети (через
+     *          `streamHttpRequest`) и целиком в памяти не собирается. По умолчанию выключено:
+     *          ответ собирается через `performHttpRequest`, который подменяют тесты.
+     *
+     * @param enabled true — разбирать ответ по мере получения
+     */
+    void setStreamingResponses(bool enabled) { streaming_responses = enabled; }
 
     /**
      * @brief Проверить доступность Prometheus.
@@ -85,18 +133,57 @@ public:
      */
     bool isAvailable() noexcept override;
 
+    /**
+     * @brief Получить имена меток через `/api/v1/labels`.
+     */
+    std::vector<std::string> labelNames(std::time_t start, std::time_t end) override;
+
+    /**
+     * @brief Получить значения метки через `/api/v1/label/<label>/values`.
+     */
+    std::vector<std::string> labelValues(const std::string &label, std::time_t start, std::time_t end) override;
+
 protected:
     std::string base_url;
 
+    /**
+     * @brief Выполнить один запрос `query_range` без разбиения.
+     */
+    std::vector<Metric> queryRange(const std::string &query_str, std::time_t start, std::time_t end, int step);
+
+    /**
+     * @brief URL запроса `query_range`.
+     */
+    std::string queryRangeUrl(const std::string &query_str, std::time_t start, std::time_t end, int step) const;
+
+    /**
+     * @brief Число точек ряда в ответе `query_range`, 0 — неизвестно.
+     */
+    static std::size_t pointsHint(std::time_t start, std::time_t end, int step);
+
     /**
      * @brief Распарсить ответ от Prometheus.
      *
      * @param response JSON-ответ от Prometheus
+     * @param points_hint Ожидаемое число точек в каждом ряду, 0 — неизвестно
      * @return Вектор метрик
      */
-    std::vector<Metric> parse_response(const std::string &response);
+    std::vector<Metric> parse_response(const std::string &response, std::size_t points_hint = 0);
+
+private:
+    bool streaming_responses = false;
 };
 
+/**
+ * @brief URL API метаданных Prometheus.
+ *
+ * @param base_url Адрес Prometheus
+ * @param label Имя метки; пустое — список имён меток `/api/v1/labels`
+ * @param start Начало интервала рядов, 0 вместе с `end` — без ограничения
+ * @param end Конец интервала рядов
+ */
+std::string prometheusMetadataUrl(const std::string &base_url, const std::string &label, std::time_t start, std::time_t end);
+
 /** @} */
 
 #endif // TSDB_PROMETHEUS_H
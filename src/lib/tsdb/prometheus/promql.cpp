@@ -0,0 +1,859 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "promql.h"
+#include "selector.h"
+
+namespace
+{
+    using Node = std::unique_ptr<PromQLExpression>;
+
+    inline bool isNameStart(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':';
+    }
+
+    inline bool isNameChar(char c)
+    {
+        return isNameStart(c) || (c >= '0' && c <= '9');
+    }
+
+    inline bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    bool equalsIgnoreCase(const std::string &a, const char *b)
+    {
+        std::size_t i = 0;
+        for (; i < a.size() && b[i]; i++)
+        {
+            char x = a[i] >= 'A' && a[i] <= 'Z' ? static_cast<char>(a[i] - 'A' + 'a') : a[i];
+            if (x != b[i])
+                return false;
+        }
+        return i == a.size() && !b[i];
+    }
+
+    const std::pair<const char *, Aggregation> AGGREGATIONS[] = {
+        {"sum", Aggregation::Sum},     {"avg", Aggregation::Avg},     {"min", Aggregation::Min},
+        {"max", Aggregation::Max},     {"count", Aggregation::Count}, {"quantile", Aggregation::Quantile},
+    };
+
+    const char *const RANGE_FUNCTIONS[] = {"rate", "irate", "increase"};
+
+    bool isRangeFunction(const std::string &name)
+    {
+        return std::find_if(std::begin(RANGE_FUNCTIONS), std::end(RANGE_FUNCTIONS), [&](const char *f) { return name == f; }) !=
+               std::end(RANGE_FUNCTIONS);
+    }
+
+    double applyOperator(char op, double a, double b)
+    {
+        switch (op)
+        {
+        case '+':
+            return a + b;
+        case '-':
+            return a - b;
+        case '*':
+            return a * b;
+        case '/':
+            return a / b;
+        case '%':
+            return std::fmod(a, b);
+        default:
+            return std::pow(a, b);
+        }
+    }
+
+    Node makeNumber(double value)
+    {
+        auto node = std::make_unique<PromQLExpression>();
+        node->type = PromQLExpression::Type::Number;
+        node->number = value;
+        return node;
+    }
+
+    /**
+     * Рекурсивный спуск по выражению: сложение, умножение, степень (правоассоциативная), унарный знак,
+     * первичное выражение. Приоритеты операторов — как в PromQL.
+     */
+    class ExpressionParser
+    {
+    public:
+        explicit ExpressionParser(const std::string &text) : text(text) {}
+
+        Node parse()
+        {
+            Node expression = parseSum();
+            skipSpaces();
+            if (position != text.size())
+                fail("unexpected character");
+            validate(*expression, false);
+            return expression;
+        }
+
+    private:
+        Node parseSum()
+        {
+            Node left = parseProduct();
+            while (true)
+            {
+                skipSpaces();
+                char c = peek();
+                if (c != '+' && c != '-')
+                    return left;
+                position++;
+                left = makeBinary(c, std::move(left), parseProduct());
+            }
+        }
+
+        Node parseProduct()
+        {
+            Node left = parseUnary();
+            while (true)
+            {
+                skipSpaces();
+                char c = peek();
+                if (c != '*' && c != '/' && c != '%')
+                    return left;
+                position++;
+                left = makeBinary(c, std::move(left), parseUnary());
+            }
+        }
+
+        Node parseUnary()
+        {
+            skipSpaces();
+            char c = peek();
+            if (c != '-' && c != '+')
+                return parsePower();
+            position++;
+            Node operand = parseUnary();
+            if (c == '+')
+                return operand;
+            return makeBinary('*', makeNumber(-1), std::move(operand));
+        }
+
+        Node parsePower()
+        {
+            Node base = parsePrimary();
+            skipSpaces();
+            if (peek() != '^')
+                return base;
+            position++;
+            return makeBinary('^', std::move(base), parseUnary());
+        }
+
+        Node parsePrimary()
+        {
+            skipSpaces();
+            if (position == text.size())
+                fail("unexpected end of expression");
+            char c = text[position];
+            Node node;
+            if (c == '(')
+            {
+                position++;
+                node = parseSum();
+                expect(')');
+            }
+            else if (isDigit(c) || c == '.')
+                node = parseNumber();
+            else if (c == '{')
+                node = parseSelector(position);
+            else if (isNameStart(c))
+                node = parseIdentifier();
+            else
+                fail("unexpected character");
+            rejectModifiers();
+            return node;
+        }
+
+        Node parseNumber()
+        {
+            const char *begin = text.c_str() + position;
+            char *end = nullptr;
+            double value = std::strtod(begin, &end);
+            if (end == begin)
+                fail("invalid number");
+            position += static_cast<std::size_t>(end - begin);
+            return makeNumber(value);
+        }
+
+        Node parseIdentifier()
+        {
+            std::size_t start = position;
+            std::string word = readName();
+            skipSpaces();
+            bool call = peek() == '(';
+
+            for (const auto &[name, op] : AGGREGATIONS)
+            {
+                if (word == name && (call || lookingAtGrouping()))
+                    return parseAggregation(op);
+            }
+            if (call)
+            {
+                if (isRangeFunction(word) || word == "histogram_quantile")
+                    return parseCall(word);
+                fail("unsupported function");
+            }
+            if (equalsIgnoreCase(word, "inf"))
+                return makeNumber(std::numeric_limits<double>::infinity());
+            if (equalsIgnoreCase(word, "nan"))
+                return makeNumber(std::numeric_limits<double>::quiet_NaN());
+            return parseSelector(start);
+        }
+
+        Node parseAggregation(Aggregation op)
+        {
+            auto node = std::make_unique<PromQLExpression>();
+            node->type = PromQLExpression::Type::Aggregation;
+            node->aggregation = op;
+            // Группировка пишется до или после аргументов: `sum by (job) (x)` и `sum(x) by (job)`
+            bool grouped = parseGrouping(node->grouping);
+            expect('(');
+            if (op == Aggregation::Quantile)
+            {
+                node->args.push_back(parseSum());
+                expect(',');
+            }
+            node->args.push_back(parseSum());
+            expect(')');
+            if (!grouped)
+                parseGrouping(node->grouping);
+            return node;
+        }
+
+        Node parseCall(const std::string &function)
+        {
+            auto node = std::make_unique<PromQLExpression>();
+            node->type = PromQLExpression::Type::Function;
+            node->function = function;
+            expect('(');
+            node->args.push_back(parseSum());
+            skipSpaces();
+            while (peek() == ',')
+            {
+                position++;
+                node->args.push_back(parseSum());
+                skipSpaces();
+            }
+            expect(')');
+            return node;
+        }
+
+        Node parseSelector(std::size_t start)
+        {
+            position = start;
+            while (position < text.size() && isNameChar(text[position]))
+                position++;
+            skipSpaces();
+            if (peek() == '{')
+                skipBraces();
+            std::size_t end = position;
+            while (end > start && isSpace(text[end - 1]))
+                end--;
+
+            auto node = std::make_unique<PromQLExpression>();
+            node->type = PromQLExpression::Type::Selector;
+            node->selector = text.substr(start, end - start);
+            // Селектор проверяется тем же разбором, которым его потом разберёт remote read
+            parseSeriesSelector(node->selector);
+
+            skipSpaces();
+            if (peek() == '[')
+            {
+                position++;
+                std::size_t close = text.find(']', position);
+                if (close == std::string::npos)
+                    fail("unclosed '['");
+                std::string duration = text.substr(position, close - position);
+                if (duration.find(':') != std::string::npos)
+                    fail("subqueries are not supported");
+                node->range = parseDuration(duration);
+                position = close + 1;
+            }
+            return node;
+        }
+
+        /**
+         * Длительность вида `5m` или `1h30m`; дробные секунды отбрасываются.
+         */
+        std::time_t parseDuration(const std::string &duration) const
+        {
+            double seconds = 0;
+            std::size_t i = 0;
+            while (i < duration.size() && isSpace(duration[i]))
+                i++;
+            std::size_t end = duration.size();
+            while (end > i && isSpace(duration[end - 1]))
+                end--;
+            if (i == end)
+                fail("empty duration");
+            while (i < end)
+            {
+                std::size_t digits = i;
+                double value = 0;
+                while (i < end && isDigit(duration[i]))
+                    value = value * 10 + (duration[i++] - '0');
+                if (i == digits)
+                    fail("invalid duration");
+                double unit = 0;
+                if (duration.compare(i, 2, "ms") == 0)
+                {
+                    unit = 0.001;
+                    i += 2;
+                }
+                else if (i < end)
+                {
+                    switch (duration[i++])
+                    {
+                    case 's':
+                        unit = 1;
+                        break;
+                    case 'm':
+                        unit = 60;
+                        break;
+                    case 'h':
+                        unit = 3600;
+                        break;
+                    case 'd':
+                        unit = 86400;
+                        break;
+                    case 'w':
+                        unit = 7 * 86400;
+                        break;
+                    case 'y':
+                        unit = 365 * 86400;
+                        break;
+                    }
+                }
+                if (unit == 0)
+                    fail("invalid duration unit");
+                seconds += value * unit;
+            }
+            auto range = static_cast<std::time_t>(seconds);
+            if (range <= 0)
+                fail("range must be at least one second");
+            return range;
+        }
+
+        bool lookingAtGrouping()
+        {
+            std::size_t saved = position;
+            std::string word = position < text.size() && isNameStart(text[position]) ? readName() : std::string();
+            position = saved;
+            return word == "by" || word == "without";
+        }
+
+        bool parseGrouping(Grouping &grouping)
+        {
+            skipSpaces();
+            if (!lookingAtGrouping())
+                return false;
+            grouping.without = readName() == "without";
+            grouping.labels.clear();
+            expect('(');
+            skipSpaces();
+            while (peek() != ')')
+            {
+                if (!isNameStart(peek()))
+                    fail("expected label name");
+                grouping.labels.push_back(readName());
+                skipSpaces();
+                if (peek() == ',')
+                {
+                    position++;
+                    skipSpaces();
+                }
+                else if (peek() != ')')
+                    fail("expected ',' or ')'");
+            }
+            position++;
+            return true;
+        }
+
+        /**
+         * Модификаторы после выражения — вне подмножества: `offset`, `@`, подзапрос `[...]`.
+         */
+        void rejectModifiers()
+        {
+            skipSpaces();
+            if (peek() == '@')
+                fail("'@' modifier is not supported");
+            if (peek() == '[')
+                fail("subqueries are not supported");
+            std::size_t saved = position;
+            if (isNameStart(peek()) && readName() == "offset")
+                fail("'offset' modifier is not supported");
+            position = saved;
+        }
+
+        Node makeBinary(char op, Node left, Node right)
+        {
+            bool leftScalar = left->type == PromQLExpression::Type::Number;
+            bool rightScalar = right->type == PromQLExpression::Type::Number;
+            if (leftScalar && rightScalar)
+                return makeNumber(applyOperator(op, left->number, right->number));
+            if (!leftScalar && !rightScalar)
+                fail("binary operations between two vectors are not supported");
+            auto node = std::make_unique<PromQLExpression>();
+            node->type = PromQLExpression::Type::Binary;
+            node->op = op;
+            node->args.push_back(std::move(left));
+            node->args.push_back(std::move(right));
+            return node;
+        }
+
+        /**
+         * Проверить типы аргументов: диапазон — только у функций окна, уровни квантилей — скаляры.
+         */
+        void validate(const PromQLExpression &node, bool range_expected) const
+        {
+            using Type = PromQLExpression::Type;
+            switch (node.type)
+            {
+            case Type::Number:
+                if (range_expected)
+                    fail("expected a range vector");
+                return;
+            case Type::Selector:
+                if ((node.range > 0) != range_expected)
+                    fail(range_expected ? "expected a range vector" : "range vector is allowed only in rate, irate or increase");
+                return;
+            case Type::Function:
+                if (range_expected)
+                    fail("expected a range vector");
+                if (isRangeFunction(node.function))
+                {
+                    if (node.args.size() != 1)
+                        fail("function expects one argument");
+                    validate(*node.args[0], true);
+                    return;
+                }
+                if (node.args.size() != 2 || node.args[0]->type != Type::Number || node.args[1]->type == Type::Number)
+                    fail("histogram_quantile expects a scalar and a vector");
+                validate(*node.args[1], false);
+                return;
+            case Type::Aggregation:
+                if (range_expected)
+                    fail("expected a range vector");
+                if (node.aggregation == Aggregation::Quantile && node.args[0]->type != Type::Number)
+                    fail("quantile level must be a scalar");
+                if (node.args.back()->type == Type::Number)
+                    fail("aggregation expects a vector");
+                validate(*node.args.back(), false);
+                return;
+            case Type::Binary:
+                if (range_expected)
+                    fail("expected a range vector");
+                for (const auto &arg : node.args)
+                    validate(*arg, false);
+                return;
+            }
+        }
+
+        std::string readName()
+        {
+            std::size_t start = position;
+            while (position < text.size() && isNameChar(text[position]))
+                position++;
+            return text.substr(start, position - start);
+        }
+
+        void skipBraces()
+        {
+            char quote = 0;
+            for (; position < text.size(); position++)
+            {
+                char c = text[position];
+                if (quote)
+                {
+                    if (c == '\\' && quote != '`')
+                        position++;
+                    else if (c == quote)
+                        quote = 0;
+                }
+                else if (c == '"' || c == '\'' || c == '`')
+                    quote = c;
+                else if (c == '}')
+                {
+                    position++;
+                    return;
+                }
+            }
+            fail("unclosed '{'");
+        }
+
+        void expect(char c)
+        {
+            skipSpaces();
+            if (peek() != c)
+                fail(c == ')' ? "expected ')'" : c == '(' ? "expected '('" : "expected ','");
+            position++;
+        }
+
+        char peek() const { return position < text.size() ? text[position] : '\0'; }
+
+        static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+        void skipSpaces()
+        {
+            while (position < text.size() && isSpace(text[position]))
+                position++;
+        }
+
+        [[noreturn]] void fail(const char *reason) const
+        {
+            throw std::invalid_argument("Unsupported PromQL expression at position " + std::to_string(position) + ": " + reason);
+        }
+
+        const std::string &text;
+        std::size_t position = 0;
+    };
+
+    struct LabelSetHash
+    {
+        std::size_t operator()(const LabelSet &labels) const { return labels.hash(); }
+    };
+
+    /**
+     * Приращение счётчика за окно с экстраполяцией к его границам, как `extrapolatedRate` в Prometheus.
+     *
+     * @param corrected Значения с учётом сбросов счётчика
+     * @param first Первая точка окна
+     * @param last Последняя точка окна, больше `first`
+     */
+    double extrapolatedDelta(const Series &series, const std::vector<double> &corrected, std::size_t first, std::size_t last,
+                             double range_start, double range_end)
+    {
+        const double *ts = series.timestamps.data();
+        double delta = corrected[last] - corrected[first];
+        double sampled = ts[last] - ts[first];
+        double average = sampled / static_cast<double>(last - first);
+        double to_start = ts[first] - range_start;
+        double to_end = range_end - ts[last];
+
+        // Счётчик не бывает отрицательным: экстраполяция назад не уходит дальше его нуля
+        if (delta > 0 && series.values[first] >= 0)
+            to_start = std::min(to_start, sampled * (series.values[first] / delta));
+
+        double threshold = average * 1.1;
+        double extrapolated = sampled;
+        extrapolated += to_start < threshold ? to_start : average / 2;
+        extrapolated += to_end < threshold ? to_end : average / 2;
+        return delta * (extrapolated / sampled);
+    }
+
+    /**
+     * Квантиль по накопительным бакетам гистограммы, как `bucketQuantile` в Prometheus.
+     *
+     * @param buckets Пары (верхняя граница, число наблюдений), порядок после вызова не определён
+     * @return NaN, если квантиль не определён
+     */
+    double bucketQuantile(double q, std::vector<std::pair<double, double>> &buckets)
+    {
+        constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+        if (std::isnan(q))
+            return NaN;
+        if (q < 0)
+            return -std::numeric_limits<double>::infinity();
+        if (q > 1)
+            return std::numeric_limits<double>::infinity();
+        std::sort(buckets.begin(), buckets.end());
+        if (buckets.size() < 2 || !std::isinf(buckets.back().first) || buckets.back().first < 0)
+            return NaN;
+
+        // Совпадающие границы складываются, убывающие счётчики поднимаются до монотонных
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < buckets.size(); i++)
+        {
+            if (n > 0 && buckets[n - 1].first == buckets[i].first)
+                buckets[n - 1].second += buckets[i].second;
+            else
+                buckets[n++] = buckets[i];
+        }
+        buckets.resize(n);
+        for (std::size_t i = 1; i < n; i++)
+            buckets[i].second = std::max(buckets[i].second, buckets[i - 1].second);
+        if (n < 2)
+            return NaN;
+
+        double observations = buckets.back().second;
+        if (observations == 0)
+            return NaN;
+        double rank = q * observations;
+        std::size_t b = 0;
+        while (b < n - 1 && buckets[b].second < rank)
+            b++;
+        if (b == n - 1)
+            return buckets[n - 2].first;
+        if (b == 0 && buckets[0].first <= 0)
+            return buckets[0].first;
+
+        double bucket_start = 0;
+        double bucket_end = buckets[b].first;
+        double count = buckets[b].second;
+        if (b > 0)
+        {
+            bucket_start = buckets[b - 1].first;
+            count -= buckets[b - 1].second;
+            rank -= buckets[b - 1].second;
+        }
+        return bucket_start + (bucket_end - bucket_start) * (rank / count);
+    }
+
+    /**
+     * Вычисление дерева на сетке `start + k * step`. Все промежуточные ряды лежат на этой сетке.
+     */
+    class Evaluator
+    {
+    public:
+        Evaluator(const RawSeriesLoader &load, std::time_t start, std::time_t end, int step)
+            : load(load), start(start), step(step), steps(static_cast<std::size_t>((end - start) / step) + 1)
+        {
+        }
+
+        std::vector<Metric> evaluate(const PromQLExpression &node)
+        {
+            using Type = PromQLExpression::Type;
+            switch (node.type)
+            {
+            case Type::Number:
+            {
+                Metric metric;
+                metric.series.reserve(steps);
+                for (std::size_t k = 0; k < steps; k++)
+                    metric.series.push_back(at(k), node.number);
+                return {std::move(metric)};
+            }
+            case Type::Selector:
+                return instantSelector(node);
+            case Type::Function:
+                return node.function == "histogram_quantile" ? histogramQuantile(node.args[0]->number, evaluate(*node.args[1]))
+                                                             : rangeFunction(node.function, *node.args[0]);
+            case Type::Aggregation:
+            {
+                double quantile = node.aggregation == Aggregation::Quantile ? node.args[0]->number : 0.5;
+                return aggregateSeries(evaluate(*node.args.back()), node.aggregation, step, node.grouping, quantile);
+            }
+            case Type::Binary:
+                return binary(node);
+            }
+            return {};
+        }
+
+    private:
+        double at(std::size_t k) const { return static_cast<double>(start) + static_cast<double>(k) * step; }
+
+        std::shared_ptr<const std::vector<Metric>> raw(const PromQLExpression &selector)
+        {
+            std::time_t lookback = selector.range > 0 ? selector.range : PROMQL_LOOKBACK_DELTA;
+            std::time_t end = start + static_cast<std::time_t>(steps - 1) * step;
+            auto metrics = load(selector.selector, start - lookback, end);
+            return metrics ? metrics : std::make_shared<const std::vector<Metric>>();
+        }
+
+        std::vector<Metric> instantSelector(const PromQLExpression &node)
+        {
+            auto metrics = raw(node);
+            std::vector<Metric> result;
+            for (const auto &metric : *metrics)
+            {
+                const Series &series = metric.series;
+                Metric out;
+                out.name = metric.name;
+                out.labels = metric.labels;
+                std::size_t next = 0;
+                for (std::size_t k = 0; k < steps; k++)
+                {
+                    double t = at(k);
+                    while (next < series.size() && series.timestamps[next] <= t)
+                        next++;
+                    if (next > 0 && series.timestamps[next - 1] > t - PROMQL_LOOKBACK_DELTA)
+                        out.series.push_back(t, series.values[next - 1]);
+                }
+                if (!out.series.empty())
+                    result.push_back(std::move(out));
+            }
+            return result;
+        }
+
+        std::vector<Metric> rangeFunction(const std::string &function, const PromQLExpression &selector)
+        {
+            auto metrics = raw(selector);
+            double range = static_cast<double>(selector.range);
+            bool irate = function == "irate";
+            bool rate = function == "rate";
+            std::vector<Metric> result;
+            std::vector<double> corrected;
+            for (const auto &metric : *metrics)
+            {
+                const Series &series = metric.series;
+                const double *ts = series.timestamps.data();
+                const double *vs = series.values.data();
+
+                // Накопленное значение с поправкой на сбросы: приращение окна — разность двух его точек
+                corrected.resize(series.size());
+                double offset = 0;
+                for (std::size_t i = 0; i < series.size(); i++)
+                {
+                    if (i > 0 && vs[i] < vs[i - 1])
+                        offset += vs[i - 1];
+                    corrected[i] = vs[i] + offset;
+                }
+
+                Metric out;
+                out.labels = metric.labels;
+                std::size_t first = 0, next = 0;
+                for (std::size_t k = 0; k < steps; k++)
+                {
+                    double t = at(k);
+                    while (next < series.size() && ts[next] <= t)
+                        next++;
+                    while (first < next && ts[first] <= t - range)
+                        first++;
+                    if (next < first + 2)
+                        continue;
+                    std::size_t last = next - 1;
+                    if (irate)
+                    {
+                        double interval = ts[last] - ts[last - 1];
+                        if (interval <= 0)
+                            continue;
+                        double delta = vs[last] < vs[last - 1] ? vs[last] : vs[last] - vs[last - 1];
+                        out.series.push_back(t, delta / interval);
+                        continue;
+                    }
+                    double delta = extrapolatedDelta(series, corrected, first, last, t - range, t);
+                    out.series.push_back(t, rate ? delta / range : delta);
+                }
+                if (!out.series.empty())
+                    result.push_back(std::move(out));
+            }
+            return result;
+        }
+
+        std::vector<Metric> histogramQuantile(double quantile, std::vector<Metric> input)
+        {
+            // Бакеты группируются по меткам без `le`
+            std::unordered_map<LabelSet, std::size_t, LabelSetHash> groups;
+            std::vector<LabelSet> labels;
+            std::vector<std::vector<std::pair<double, const Series *>>> members;
+            for (const auto &metric : input)
+            {
+                if (!metric.labels.contains("le"))
+                    continue;
+                const char *bound = metric.labels["le"].c_str();
+                char *bound_end = nullptr;
+                double upper = std::strtod(bound, &bound_end);
+                if (bound_end == bound || *bound_end != '\0')
+                    continue;
+
+                std::vector<LabelSet::Label> rest;
+                for (const auto &label : metric.labels)
+                {
+                    if (label.first != "le")
+                        rest.push_back(label);
+                }
+                LabelSet group(std::move(rest));
+                auto [it, inserted] = groups.try_emplace(group, labels.size());
+                if (inserted)
+                {
+                    labels.push_back(std::move(group));
+                    members.emplace_back();
+                }
+                members[it->second].push_back({upper, &metric.series});
+            }
+
+            std::vector<Metric> result;
+            std::vector<std::pair<double, double>> buckets;
+            for (std::size_t g = 0; g < members.size(); g++)
+            {
+                std::vector<SeriesRef> refs;
+                for (const auto &member : members[g])
+                    refs.push_back({&labels[g], member.second});
+                SeriesGrid grid = alignSeries(refs, step);
+
+                Metric out;
+                out.labels = labels[g];
+                for (std::size_t i = 0; i < grid.steps; i++)
+                {
+                    buckets.clear();
+                    for (std::size_t r = 0; r < grid.rows; r++)
+                    {
+                        double count = grid.row(r)[i];
+                        if (count == count)
+                            buckets.push_back({members[g][r].first, count});
+                    }
+                    double value = bucketQuantile(quantile, buckets);
+                    if (value == value)
+                        out.series.push_back(grid.timestamp(i), value);
+                }
+                if (!out.series.empty())
+                    result.push_back(std::move(out));
+            }
+            return result;
+        }
+
+        std::vector<Metric> binary(const PromQLExpression &node)
+        {
+            bool scalar_left = node.args[0]->type == PromQLExpression::Type::Number;
+            double scalar = scalar_left ? node.args[0]->number : node.args[1]->number;
+            std::vector<Metric> result = evaluate(*node.args[scalar_left ? 1 : 0]);
+            for (auto &metric : result)
+            {
+                metric.name = Symbol();
+                for (double &value : metric.series.values)
+                    value = scalar_left ? applyOperator(node.op, scalar, value) : applyOperator(node.op, value, scalar);
+            }
+            return result;
+        }
+
+        const RawSeriesLoader &load;
+        std::time_t start;
+        int step;
+        std::size_t steps;
+    };
+
+    void collectSelectors(const PromQLExpression &node, std::time_t start, std::time_t end, std::vector<RangeQuery> &queries)
+    {
+        if (node.type == PromQLExpression::Type::Selector)
+        {
+            std::time_t lookback = node.range > 0 ? node.range : PROMQL_LOOKBACK_DELTA;
+            queries.push_back({node.selector, start - lookback, end, 0});
+        }
+        for (const auto &arg : node.args)
+            collectSelectors(*arg, start, end, queries);
+    }
+}
+
+std::unique_ptr<PromQLExpression> parsePromQL(const std::string &query)
+{
+    return ExpressionParser(query).parse();
+}
+
+std::vector<Metric> evaluatePromQL(const PromQLExpression &expression, const RawSeriesLoader &load, std::time_t start, std::time_t end,
+                                   int step)
+{
+    if (step <= 0)
+        throw std::invalid_argument("PromQL evaluation step must be positive");
+    if (end < start)
+        return {};
+    return Evaluator(load, start, end, step).evaluate(expression);
+}
+
+std::vector<RangeQuery> rawQueriesOf(const PromQLExpression &expression, std::time_t start, std::time_t end)
+{
+    std::vector<RangeQuery> queries;
+    collectSelectors(expression, start, end, queries);
+    return queries;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file promql.h
+ * @brief Вычисление подмножества PromQL по сырым точкам рядов.
+ *
+ * @details Разбирает и вычисляет на клиенте частые выражения дашбордов: селекторы рядов, `rate`, `irate`,
+ *          `increase`, `histogram_quantile`, агрегаты `sum`/`avg`/`min`/`max`/`count`/`quantile` с `by` и
+ *          `without` и арифметику со скалярами. Всё остальное (`offset`, подзапросы, операции между двумя
+ *          векторами, прочие функции) разбор отвергает, и такой запрос выполняет сервер.
+ *
+ *          Семантика повторяет range query Prometheus: выражение вычисляется в точках `start + k * step`,
+ *          селектор без диапазона берёт последнюю точку не старше `PROMQL_LOOKBACK_DELTA`, окно `x[r]` в точке `t`
+ *          содержит точки из `(t - r, t]`, функции и агрегаты отбрасывают имя метрики.
+ */
+
+/**
+ * @addtogroup prometheus
+ * @{
+ */
+
+#ifndef TSDB_PROMETHEUS_PROMQL_H
+#define TSDB_PROMETHEUS_PROMQL_H
+
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../aggregate.h"
+#include "../tsdb.h"
+
+/// Насколько старой может быть точка для селектора без диапазона, секунд; как у Prometheus по умолчанию
+constexpr std::time_t PROMQL_LOOKBACK_DELTA = 300;
+
+/**
+ * @brief Узел разобранного выражения PromQL.
+ */
+struct PromQLExpression
+{
+    enum class Type
+    {
+        Number,      ///< Числовой литерал, `number`
+        Selector,    ///< Селектор рядов `selector`, с диапазоном `range` внутри функции
+        Function,    ///< Функция `function` от `args`
+        Aggregation, ///< Агрегат `aggregation` по `args.back()` с группировкой `grouping`
+        Binary       ///< Арифметика `op` между `args[0]` и `args[1]`, хотя бы один из них — скаляр
+    };
+
+    Type type = Type::Number;
+    double number = 0;
+    std::string selector;   ///< Текст селектора без диапазона, ключ загрузки сырых точек
+    std::time_t range = 0;  ///< Диапазон `[r]` в секундах, 0 — селектор мгновенного вектора
+    std::string function;   ///< `rate`, `irate`, `increase` или `histogram_quantile`
+    Aggregation aggregation = Aggregation::Sum;
+    Grouping grouping;
+    char op = 0;            ///< `+`, `-`, `*`, `/`, `%` или `^`
+    std::vector<std::unique_ptr<PromQLExpression>> args; ///< Аргументы; у `quantile` и `histogram_quantile` первый — уровень
+};
+
+/**
+ * @brief Загрузчик сырых точек: ряды селектора с точками не уже `[start, end]`.
+ *
+ * @details Может вернуть больший интервал, например из кэша, поэтому результат разделяется без копирования.
+ */
+using RawSeriesLoader = std::function<std::shared_ptr<const std::vector<Metric>>(const std::string &selector, std::time_t start, std::time_t end)>;
+
+/**
+ * @brief Разобрать выражение поддерживаемого подмножества PromQL.
+ *
+ * @param query Выражение
+ * @return Корень дерева выражения
+ * @throws std::invalid_argument Если выражение некорректно или выходит за подмножество
+ */
+std::unique_ptr<PromQLExpression> parsePromQL(const std::string &query);
+
+/**
+ * @brief Вычислить выражение на сетке range query.
+ *
+ * @param expression Разобранное выражение
+ * @param load Загрузчик сырых точек селекторов
+ * @param start Первая точка сетки
+ * @param end Последняя допустимая точка сетки
+ * @param step Шаг сетки в секундах, больше нуля
+ * @return Ряды результата, точки только там, где значение определено
+ * @throws std::invalid_argument Если выражение нельзя вычислить (например, уровень квантиля — не скаляр)
+ */
+std::vector<Metric> evaluatePromQL(const PromQLExpression &expression, const RawSeriesLoader &load, std::time_t start, std::time_t end,
+                                   int step);
+
+/**
+ * @brief Все селекторы выражения с нужным им интервалом сырых точек.
+ *
+ * @details Позволяет загрузить точки заранее, например одним пакетом.
+ */
+std::vector<RangeQuery> rawQueriesOf(const PromQLExpression &expression, std::time_t start, std::time_t end);
+
+/** @} */
+
+#endif // TSDB_PROMETHEUS_PROMQL_H
@@ -0,0 +1,131 @@
+#include <memory>
+
+#include "prometheus.h"
+#include "remote_read.h"
+#include "remote_read_codec.h"
+#include "response_parser.h"
+#include "selector.h"
+#include "snappy.h"
+
+namespace
+{
+    /// Заголовки запроса remote read (см. `storage/remote/codec.go` в Prometheus)
+    const std::vector<std::string> REMOTE_READ_HEADERS = {
+        "Content-Type: application/x-protobuf",
+        "Content-Encoding: snappy",
+        "X-Prometheus-Remote-Read-Version: 0.1.0",
+    };
+
+    /// Запрос сырых точек одного селектора в формате `STREAMED_XOR_CHUNKS`.
+    RemoteReadRequest makeReadRequest(const std::string &query_str, std::time_t start, std::time_t end, int step)
+    {
+        RemoteReadQuery query;
+        query.start_ms = static_cast<std::int64_t>(start) * 1000;
+        query.end_ms = static_cast<std::int64_t>(end) * 1000;
+        query.matchers = parseSeriesSelector(query_str);
+        query.step_ms = step > 0 ? static_cast<std::int64_t>(step) * 1000 : 0;
+
+        RemoteReadRequest request;
+        request.queries.push_back(std::move(query));
+        request.accepted_response_types.push_back(RemoteReadResponseType::StreamedXorChunks);
+        return request;
+    }
+
+    /// Prometheus хранит точку примерно раз в scrape interval, шаг запроса — разумная оценка числа точек
+    std::size_t pointsHint(std::time_t start, std::time_t end, int step)
+    {
+        return step > 0 && end >= start ? static_cast<std::size_t>((end - start) / step + 1) : 0;
+    }
+}
+
+PrometheusRemoteReadClient::PrometheusRemoteReadClient(const std::string &base_url) : base_url(base_url) {}
+
+std::vector<Metric> PrometheusRemoteReadClient::query(const std::string &query_str, std::time_t start, std::time_t end)
+{
+    return query(query_str, start, end, 0);
+}
+
+std::vector<Metric> PrometheusRemoteReadClient::query(const std::string &query_str, std::time_t start, std::time_t end, int step)
+{
+    RemoteReadRequest request = makeReadRequest(query_str, start, end, step);
+    RemoteReadResponseDecoder decoder(request.queries[0].start_ms, request.queries[0].end_ms, pointsHint(start, end, step));
+    streamHttpPost(base_url + "/api/v1/read", snappyCompress(encodeReadRequest(request)), REMOTE_READ_HEADERS,
+                   [&decoder](const char *data, std::size_t size) { decoder.feed(data, size); }, REQUEST_TIMEOUT);
+    return decoder.finish();
+}
+
+std::vector<RangeQueryResult> PrometheusRemoteReadClient::queryBatch(const std::vector<RangeQuery> &queries)
+{
+    std::vector<RangeQueryResult> results(queries.size());
+    std::vector<std::unique_ptr<RemoteReadResponseDecoder>> decoders;
+    std::vector<std::size_t> owners; // Номер запроса для каждой передачи
+    std::vector<HttpStream> streams;
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        const RangeQuery &query = queries[i];
+        RemoteReadRequest request;
+        try
+        {
+            request = makeReadRequest(query.query, query.start, query.end, query.step);
+        }
+        catch (...)
+        {
+            results[i].error = std::current_exception(); // Не селектор: остальные запросы пакета выполняются
+            continue;
+        }
+
+        decoders.push_back(std::make_unique<RemoteReadResponseDecoder>(request.queries[0].start_ms, request.queries[0].end_ms,
+                                                                       pointsHint(query.start, query.end, query.step)));
+        RemoteReadResponseDecoder *decoder = decoders.back().get();
+        owners.push_back(i);
+        HttpStream stream;
+        stream.url = base_url + "/api/v1/read";
+        stream.sink = [decoder](const char *data, std::size_t size) { decoder->feed(data, size); };
+        stream.post = true;
+        stream.body = snappyCompress(encodeReadRequest(request));
+        stream.headers = REMOTE_READ_HEADERS;
+        streams.push_back(std::move(stream));
+    }
+
+    std::vector<std::exception_ptr> errors = streamHttpRequests(streams, REQUEST_TIMEOUT);
+    for (std::size_t k = 0; k < streams.size(); k++)
+    {
+        RangeQueryResult &result = results[owners[k]];
+        result.error = errors[k];
+        if (result.error)
+            continue;
+        try
+        {
+            result.metrics = std::make_shared<const std::vector<Metric>>(decoders[k]->finish());
+        }
+        catch (...)
+        {
+            result.error = std::current_exception();
+        }
+    }
+    return results;
+}
+
+bool PrometheusRemoteReadClient::isAvailable() noexcept
+{
+    try
+    {
+        std::string url = base_url + "/-/healthy";
+        std::string response = performHttpRequest(url);
+        return response == "Prometheus Server is Healthy.\n";
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+
+std::vector<std::string> PrometheusRemoteReadClient::labelNames(std::time_t start, std::time_t end)
+{
+    return parseLabelValuesResponse(performHttpRequest(prometheusMetadataUrl(base_url, "", start, end)));
+}
+
+std::vector<std::string> PrometheusRemoteReadClient::labelValues(const std::string &label, std::time_t start, std::time_t end)
+{
+    return parseLabelValuesResponse(performHttpRequest(prometheusMetadataUrl(base_url, label, start, end)));
+}
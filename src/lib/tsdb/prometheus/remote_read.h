@@ -0,0 +1,104 @@
+/**
+ * @file remote_read.h
+ * @brief Клиент к remote read API Prometheus.
+ *
+ * @details Содержит класс `PrometheusRemoteReadClient` — вторую реализацию `TSDBClient` для Prometheus.
+ *          Вместо JSON `query_range` он читает сырые точки через `/api/v1/read` в режиме
+ *          `STREAMED_XOR_CHUNKS`: сервер отдаёт XOR-чанки из своих блоков без пересчёта и
+ *          форматирования чисел, а клиент распаковывает их сразу в колонки рядов.
+ */
+
+/**
+ * @addtogroup prometheus
+ * @{
+ */
+
+#ifndef TSDB_PROMETHEUS_REMOTE_READ_H
+#define TSDB_PROMETHEUS_REMOTE_READ_H
+
+#include <ctime>
+#include <string>
+
+#include "../tsdb.h"
+
+/**
+ * @brief Клиент к Prometheus через remote read API.
+ *
+ * @details Запрос — селектор рядов (`metric{label="value"}`), а не произвольное выражение PromQL:
+ *          remote read отбирает ряды только по меткам. Возвращаются все точки ряда в `[start, end]`
+ *          с исходным разрешением, шаг передаётся серверу лишь как подсказка. Маркеры устаревания
+ *          отбрасываются.
+ */
+class PrometheusRemoteReadClient : public TSDBClient
+{
+public:
+    static constexpr int REQUEST_TIMEOUT = 60; ///< Таймаут запроса в секундах: ответы с сырыми точками длиннее JSON-ответов
+
+    /**
+     * @brief Конструктор клиента.
+     *
+     * @param base_url Базовый URL Prometheus (например, "http://localhost:9090")
+     */
+    explicit PrometheusRemoteReadClient(const std::string &base_url);
+    ~PrometheusRemoteReadClient() override = default;
+
+    /**
+     * @brief Загрузить сырые точки рядов.
+     *
+     * @param query_str Селектор рядов
+     * @param start Начало временного диапазона
+     * @param end Конец временного диапазона
+     * @return Массив метрик типа Metric
+     * @throws std::invalid_argument Если запрос не является селектором рядов
+     * @throws std::runtime_error При ошибке HTTP или повреждённом ответе
+     */
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end) override;
+
+    /**
+     * @brief Загрузить сырые точки рядов.
+     *
+     * @details Точки не прореживаются до шага: `step` уходит серверу в `ReadHints` и используется
+     *          только для резервирования памяти.
+     *
+     * @param query_str Селектор рядов
+     * @param start Начало временного диапазона
+     * @param end Конец временного диапазона
+     * @param step Интервал между точками в секундах
+     * @return Массив метрик типа Metric
+     * @throws std::invalid_argument Если запрос не является селектором рядов
+     * @throws std::runtime_error При ошибке HTTP или повреждённом ответе
+     */
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end, int step) override;
+
+    /**
+     * @brief Загрузить сырые точки для нескольких селекторов одновременно.
+     *
+     * @details Каждый селектор уходит отдельным POST-запросом, все запросы выполняются параллельно
+     *          через `streamHttpRequests`, ответы декодируются по мере получения.
+     */
+    std::vector<RangeQueryResult> queryBatch(const std::vector<RangeQuery> &queries) override;
+
+    /**
+     * @brief Проверить доступность Prometheus.
+     *
+     * @return true, если Prometheus доступен, иначе false
+     */
+    bool isAvailable() noexcept override;
+
+    /**
+     * @brief Получить имена меток через HTTP API того же Prometheus.
+     */
+    std::vector<std::string> labelNames(std::time_t start, std::time_t end) override;
+
+    /**
+     * @brief Получить значения метки через HTTP API того же Prometheus.
+     */
+    std::vector<std::string> labelValues(const std::string &label, std::time_t start, std::time_t end) override;
+
+protected:
+    std::string base_url;
+};
+
+/** @} */
+
+#endif // TSDB_PROMETHEUS_REMOTE_READ_H
@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+
+#include "../xor_chunk.h"
+#include "remote_read_codec.h"
+#include "sample_decoder.h"
+
+namespace
+{
+    /// Защита от мусора вместо кадра: Prometheus по умолчанию ограничивает кадр 1 МиБ
+    constexpr std::uint64_t MAX_FRAME_SIZE = 64 << 20;
+
+    /// `prometheus.Chunk.Encoding.XOR`
+    constexpr std::uint64_t CHUNK_ENCODING_XOR = 1;
+
+    enum WireType
+    {
+        WIRE_VARINT = 0,
+        WIRE_FIXED64 = 1,
+        WIRE_BYTES = 2,
+        WIRE_FIXED32 = 5
+    };
+
+    /// Таблица CRC-32C (полином Кастаньоли), которым Prometheus защищает кадры.
+    const std::array<std::uint32_t, 256> &crc32cTable()
+    {
+        static const std::array<std::uint32_t, 256> table = [] {
+            std::array<std::uint32_t, 256> result{};
+            for (std::uint32_t i = 0; i < 256; i++)
+            {
+                std::uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++)
+                    crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78u : crc >> 1;
+                result[i] = crc;
+            }
+            return result;
+        }();
+        return table;
+    }
+
+    std::uint32_t crc32c(const std::uint8_t *data, std::size_t size)
+    {
+        const auto &table = crc32cTable();
+        std::uint32_t crc = 0xffffffffu;
+        for (std::size_t i = 0; i < size; i++)
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return crc ^ 0xffffffffu;
+    }
+
+    [[noreturn]] void malformed()
+    {
+        throw std::runtime_error("Malformed remote read message");
+    }
+
+    /**
+     * Последовательное чтение полей protobuf-сообщения.
+     */
+    class ProtoReader
+    {
+    public:
+        ProtoReader(const std::uint8_t *data, std::size_t size) : position(data), end(data + size) {}
+
+        /// Прочитать ключ следующего поля, false — сообщение закончилось.
+        bool next(std::uint32_t &field, int &wire_type)
+        {
+            if (position == end)
+                return false;
+            std::uint64_t key = varint();
+            field = static_cast<std::uint32_t>(key >> 3);
+            wire_type = static_cast<int>(key & 7);
+            return true;
+        }
+
+        bool empty() const { return position == end; }
+
+        std::uint64_t varint()
+        {
+            std::uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (position == end)
+                    malformed();
+                std::uint8_t byte = *position++;
+                value |= std::uint64_t(byte & 0x7f) << shift;
+                if (byte < 0x80)
+                    return value;
+            }
+            malformed();
+        }
+
+        /// Поле переменной длины: вложенное сообщение, строка или упакованный массив.
+        std::pair<const std::uint8_t *, std::size_t> bytes()
+        {
+            std::uint64_t size = varint();
+            if (size > static_cast<std::uint64_t>(end - position))
+                malformed();
+            const std::uint8_t *data = position;
+            position += size;
+            return {data, static_cast<std::size_t>(size)};
+        }
+
+        std::string_view string()
+        {
+            auto [data, size] = bytes();
+            return {reinterpret_cast<const char *>(data), size};
+        }
+
+        void skip(int wire_type)
+        {
+            switch (wire_type)
+            {
+            case WIRE_VARINT:
+                varint();
+                break;
+            case WIRE_FIXED64:
+                advance(8);
+                break;
+            case WIRE_BYTES:
+                bytes();
+                break;
+            case WIRE_FIXED32:
+                advance(4);
+                break;
+            default:
+                malformed();
+            }
+        }
+
+    private:
+        void advance(std::size_t count)
+        {
+            if (count > static_cast<std::size_t>(end - position))
+                malformed();
+            position += count;
+        }
+
+        const std::uint8_t *position;
+        const std::uint8_t *end;
+    };
+
+    void putVarint(std::string &out, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += static_cast<char>(value | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    void putKey(std::string &out, std::uint32_t field, int wire_type)
+    {
+        putVarint(out, (std::uint64_t(field) << 3) | wire_type);
+    }
+
+    /// Целое поле; как и в proto3, нулевое значение не записывается.
+    void putVarintField(std::string &out, std::uint32_t field, std::uint64_t value)
+    {
+        if (value == 0)
+            return;
+        putKey(out, field, WIRE_VARINT);
+        putVarint(out, value);
+    }
+
+    void putBytesField(std::string &out, std::uint32_t field, std::string_view value)
+    {
+        putKey(out, field, WIRE_BYTES);
+        putVarint(out, value.size());
+        out.append(value.data(), value.size());
+    }
+
+    std::string encodeLabel(std::string_view name, std::string_view value)
+    {
+        std::string message;
+        putBytesField(message, 1, name);
+        putBytesField(message, 2, value);
+        return message;
+    }
+
+    std::string encodeQuery(const RemoteReadQuery &query)
+    {
+        std::string message;
+        putVarintField(message, 1, static_cast<std::uint64_t>(query.start_ms));
+        putVarintField(message, 2, static_cast<std::uint64_t>(query.end_ms));
+        for (const auto &matcher : query.matchers)
+        {
+            std::string encoded;
+            putVarintField(encoded, 1, static_cast<std::uint64_t>(matcher.type));
+            putBytesField(encoded, 2, matcher.name);
+            putBytesField(encoded, 3, matcher.value);
+            putBytesField(message, 3, encoded);
+        }
+        if (query.step_ms > 0)
+        {
+            std::string hints;
+            putVarintField(hints, 1, static_cast<std::uint64_t>(query.step_ms));
+            putVarintField(hints, 3, static_cast<std::uint64_t>(query.start_ms));
+            putVarintField(hints, 4, static_cast<std::uint64_t>(query.end_ms));
+            putBytesField(message, 4, hints);
+        }
+        return message;
+    }
+
+    RemoteReadQuery decodeQuery(const std::uint8_t *data, std::size_t size)
+    {
+        RemoteReadQuery query;
+        ProtoReader reader(data, size);
+        std::uint32_t field;
+        int wire_type;
+        while (reader.next(field, wire_type))
+        {
+            if (field == 1 && wire_type == WIRE_VARINT)
+                query.start_ms = static_cast<std::int64_t>(reader.varint());
+            else if (field == 2 && wire_type == WIRE_VARINT)
+                query.end_ms = static_cast<std::int64_t>(reader.varint());
+            else if (field == 3 && wire_type == WIRE_BYTES)
+            {
+                auto [matcher_data, matcher_size] = reader.bytes();
+                LabelMatcher matcher{LabelMatcher::Type::Equal, {}, {}};
+                ProtoReader matcher_reader(matcher_data, matcher_size);
+                while (matcher_reader.next(field, wire_type))
+                {
+                    if (field == 1 && wire_type == WIRE_VARINT)
+                        matcher.type = static_cast<LabelMatcher::Type>(matcher_reader.varint());
+                    else if (field == 2 && wire_type == WIRE_BYTES)
+                        matcher.name = matcher_reader.string();
+                    else if (field == 3 && wire_type == WIRE_BYTES)
+                        matcher.value = matcher_reader.string();
+                    else
+                        matcher_reader.skip(wire_type);
+                }
+                query.matchers.push_back(std::move(matcher));
+            }
+            else if (field == 4 && wire_type == WIRE_BYTES)
+            {
+                auto [hints_data, hints_size] = reader.bytes();
+                ProtoReader hints_reader(hints_data, hints_size);
+                while (hints_reader.next(field, wire_type))
+                {
+                    if (field == 1 && wire_type == WIRE_VARINT)
+                        query.step_ms = static_cast<std::int64_t>(hints_reader.varint());
+                    else
+                        hints_reader.skip(wire_type);
+                }
+            }
+            else
+                reader.skip(wire_type);
+        }
+        return query;
+    }
+}
+
+std::string encodeReadRequest(const RemoteReadRequest &request)
+{
+    std::string message;
+    for (const auto &query : request.queries)
+        putBytesField(message, 1, encodeQuery(query));
+    if (!request.accepted_response_types.empty())
+    {
+        // В proto3 повторяющиеся перечисления упаковываются
+        std::string packed;
+        for (auto type : request.accepted_response_types)
+            putVarint(packed, static_cast<std::uint64_t>(type));
+        putBytesField(message, 2, packed);
+    }
+    return message;
+}
+
+RemoteReadRequest decodeReadRequest(const std::string &message)
+{
+    RemoteReadRequest request;
+    ProtoReader reader(reinterpret_cast<const std::uint8_t *>(message.data()), message.size());
+    std::uint32_t field;
+    int wire_type;
+    while (reader.next(field, wire_type))
+    {
+        if (field == 1 && wire_type == WIRE_BYTES)
+        {
+            auto [data, size] = reader.bytes();
+            request.queries.push_back(decodeQuery(data, size));
+        }
+        else if (field == 2 && wire_type == WIRE_VARINT)
+            request.accepted_response_types.push_back(static_cast<RemoteReadResponseType>(reader.varint()));
+        else if (field == 2 && wire_type == WIRE_BYTES)
+        {
+            auto [data, size] = reader.bytes();
+            ProtoReader packed(data, size);
+            while (!packed.empty())
+                request.accepted_response_types.push_back(static_cast<RemoteReadResponseType>(packed.varint()));
+        }
+        else
+            reader.skip(wire_type);
+    }
+    return request;
+}
+
+std::string encodeChunkedSeriesFrame(const Metric &metric, std::int64_t query_index, std::size_t samples_per_chunk)
+{
+    // Метки ряда, как и в Prometheus, отсортированы по имени вместе с __name__
+    std::vector<std::pair<std::string_view, std::string_view>> labels;
+    labels.emplace_back("__name__", metric.name.str());
+    for (const auto &label : metric.labels)
+        labels.emplace_back(label.first.str(), label.second.str());
+    std::sort(labels.begin(), labels.end());
+
+    std::string series;
+    for (const auto &[name, value] : labels)
+        putBytesField(series, 1, encodeLabel(name, value));
+
+    samples_per_chunk = std::clamp<std::size_t>(samples_per_chunk, 1, XorChunkEncoder::MAX_SAMPLES);
+    const Series &points = metric.series;
+    for (std::size_t first = 0; first < points.size(); first += samples_per_chunk)
+    {
+        std::size_t last = std::min(points.size(), first + samples_per_chunk);
+        XorChunkEncoder encoder;
+        for (std::size_t i = first; i < last; i++)
+            encoder.append(std::llround(points.timestamps[i] * 1000), points.values[i]);
+
+        std::string chunk;
+        putVarintField(chunk, 1, static_cast<std::uint64_t>(std::llround(points.timestamps[first] * 1000)));
+        putVarintField(chunk, 2, static_cast<std::uint64_t>(std::llround(points.timestamps[last - 1] * 1000)));
+        putVarintField(chunk, 3, CHUNK_ENCODING_XOR);
+        const auto &bytes = encoder.bytes();
+        putBytesField(chunk, 4, std::string_view(reinterpret_cast<const char *>(bytes.data()), bytes.size()));
+        putBytesField(series, 2, chunk);
+    }
+
+    std::string message;
+    putBytesField(message, 1, series);
+    putVarintField(message, 2, static_cast<std::uint64_t>(query_index));
+
+    std::string frame;
+    putVarint(frame, message.size());
+    std::uint32_t checksum = crc32c(reinterpret_cast<const std::uint8_t *>(message.data()), message.size());
+    for (int shift = 24; shift >= 0; shift -= 8)
+        frame += static_cast<char>(checksum >> shift);
+    frame += message;
+    return frame;
+}
+
+RemoteReadResponseDecoder::RemoteReadResponseDecoder(std::int64_t start_ms, std::int64_t end_ms, std::size_t points_hint)
+    : start_ms(start_ms), end_ms(end_ms), points_hint(points_hint)
+{
+}
+
+void RemoteReadResponseDecoder::feed(const char *data, std::size_t size)
+{
+    pending.append(data, size);
+    auto buffer = reinterpret_cast<const std::uint8_t *>(pending.data());
+    std::size_t available = pending.size(), offset = 0;
+    while (offset < available)
+    {
+        // Длина кадра — uvarint, который тоже может оказаться разрезан между кусками
+        std::uint64_t length = 0;
+        std::size_t position = offset;
+        bool complete = false;
+        for (int shift = 0; shift < 64 && position < available; shift += 7)
+        {
+            std::uint8_t byte = buffer[position++];
+            length |= std::uint64_t(byte & 0x7f) << shift;
+            if (byte < 0x80)
+            {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete)
+        {
+            if (position - offset >= 10)
+                malformed();
+            break;
+        }
+        if (length > MAX_FRAME_SIZE)
+            throw std::runtime_error("Remote read frame is too large, the response is probably not streamed");
+        if (available - position < 4 + length)
+            break;
+
+        std::uint32_t expected = 0;
+        for (int i = 0; i < 4; i++)
+            expected = (expected << 8) | buffer[position++];
+        if (crc32c(buffer + position, length) != expected)
+            throw std::runtime_error("Remote read frame checksum mismatch");
+        decodeFrame(buffer + position, length);
+        offset = position + length;
+    }
+    pending.erase(0, offset);
+}
+
+std::vector<Metric> RemoteReadResponseDecoder::finish()
+{
+    if (!pending.empty())
+        throw std::runtime_error("Truncated remote read response");
+    // Как и query_range, не возвращаем ряды без точек в запрошенном диапазоне
+    metrics.erase(std::remove_if(metrics.begin(), metrics.end(), [](const Metric &metric) { return metric.series.empty(); }),
+                  metrics.end());
+    index.clear();
+    return std::move(metrics);
+}
+
+void RemoteReadResponseDecoder::decodeFrame(const std::uint8_t *data, std::size_t size)
+{
+    ProtoReader reader(data, size);
+    std::uint32_t field;
+    int wire_type;
+    while (reader.next(field, wire_type))
+    {
+        if (field == 1 && wire_type == WIRE_BYTES)
+        {
+            auto [series_data, series_size] = reader.bytes();
+            decodeSeries(series_data, series_size);
+        }
+        else
+            reader.skip(wire_type); // query_index: клиент посылает один запрос
+    }
+}
+
+void RemoteReadResponseDecoder::decodeSeries(const std::uint8_t *data, std::size_t size)
+{
+    Symbol name;
+    labels.clear();
+    chunks.clear();
+
+    ProtoReader reader(data, size);
+    std::uint32_t field;
+    int wire_type;
+    while (reader.next(field, wire_type))
+    {
+        if (field == 1 && wire_type == WIRE_BYTES)
+        {
+            auto [label_data, label_size] = reader.bytes();
+            ProtoReader label_reader(label_data, label_size);
+            std::string_view label_name, label_value;
+            while (label_reader.next(field, wire_type))
+            {
+                if (field == 1 && wire_type == WIRE_BYTES)
+                    label_name = label_reader.string();
+                else if (field == 2 && wire_type == WIRE_BYTES)
+                    label_value = label_reader.string();
+                else
+                    label_reader.skip(wire_type);
+            }
+            if (label_name == "__name__")
+                name = Symbol(label_value);
+            else
+                labels.emplace_back(Symbol(label_name), Symbol(label_value));
+        }
+        else if (field == 2 && wire_type == WIRE_BYTES)
+            chunks.push_back(reader.bytes());
+        else
+            reader.skip(wire_type);
+    }
+
+    SeriesKey key{name, LabelSet(labels)};
+    auto [it, inserted] = index.emplace(key, metrics.size());
+    if (inserted)
+    {
+        metrics.push_back(Metric{key.name, key.labels, {}});
+        metrics.back().series.reserve(points_hint);
+    }
+    Series &series = metrics[it->second].series;
+
+    for (auto [chunk_data, chunk_size] : chunks)
+    {
+        std::int64_t min_time = 0, max_time = 0;
+        std::uint64_t encoding = 0;
+        const std::uint8_t *payload = nullptr;
+        std::size_t payload_size = 0;
+        ProtoReader chunk_reader(chunk_data, chunk_size);
+        while (chunk_reader.next(field, wire_type))
+        {
+            if (field == 1 && wire_type == WIRE_VARINT)
+                min_time = static_cast<std::int64_t>(chunk_reader.varint());
+            else if (field == 2 && wire_type == WIRE_VARINT)
+                max_time = static_cast<std::int64_t>(chunk_reader.varint());
+            else if (field == 3 && wire_type == WIRE_VARINT)
+                encoding = chunk_reader.varint();
+            else if (field == 4 && wire_type == WIRE_BYTES)
+                std::tie(payload, payload_size) = chunk_reader.bytes();
+            else
+                chunk_reader.skip(wire_type);
+        }
+        // Гистограммы в Series не представимы; чанки целиком вне диапазона не распаковываем
+        if (encoding != CHUNK_ENCODING_XOR || !payload || max_time < start_ms || min_time > end_ms)
+            continue;
+
+        XorChunkIterator samples(payload, payload_size);
+        while (samples.next())
+        {
+            std::int64_t timestamp = samples.timestamp();
+            if (timestamp < start_ms)
+                continue;
+            if (timestamp > end_ms)
+                break;
+            double value = samples.value();
+            double seconds = timestamp / 1000.0;
+            if (isStaleMarker(value) || (!series.empty() && seconds <= series.timestamps.back()))
+                continue;
+            series.push_back(seconds, value);
+        }
+    }
+}
@@ -0,0 +1,143 @@
+/**
+ * @file remote_read_codec.h
+ * @brief Кодирование сообщений remote read API Prometheus.
+ *
+ * @details Содержит минимальную реализацию protobuf-сообщений `prometheus.ReadRequest` и
+ *          `prometheus.ChunkedReadResponse` (из `prompb/remote.proto` и `prompb/types.proto`) без
+ *          зависимости от protobuf. Ответ в режиме `STREAMED_XOR_CHUNKS` состоит из кадров
+ *          `uvarint(длина) | CRC32C big-endian | сообщение`, точки рядов лежат в XOR-чанках
+ *          (см. `XorChunkIterator`) и декодируются сразу в колонки `Metric::series`.
+ */
+
+/**
+ * @addtogroup prometheus
+ * @{
+ */
+
+#ifndef TSDB_PROMETHEUS_REMOTE_READ_CODEC_H
+#define TSDB_PROMETHEUS_REMOTE_READ_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../tsdb.h"
+#include "selector.h"
+
+/**
+ * @brief Формат ответа remote read (`prometheus.ReadRequest.ResponseType`).
+ */
+enum class RemoteReadResponseType
+{
+    Samples = 0,          ///< Один snappy-сжатый `ReadResponse` с точками
+    StreamedXorChunks = 1 ///< Поток кадров `ChunkedReadResponse` с XOR-чанками
+};
+
+/**
+ * @brief Один запрос рядов (`prometheus.Query`).
+ */
+struct RemoteReadQuery
+{
+    std::int64_t start_ms = 0;          ///< Начало диапазона в миллисекундах Unix time
+    std::int64_t end_ms = 0;            ///< Конец диапазона в миллисекундах Unix time
+    std::vector<LabelMatcher> matchers; ///< Условия отбора рядов
+    std::int64_t step_ms = 0;           ///< Подсказка о шаге (`ReadHints.step_ms`), 0 — не передаётся
+};
+
+/**
+ * @brief Запрос remote read (`prometheus.ReadRequest`).
+ */
+struct RemoteReadRequest
+{
+    std::vector<RemoteReadQuery> queries;
+    std::vector<RemoteReadResponseType> accepted_response_types;
+};
+
+/**
+ * @brief Сериализовать запрос в protobuf (без сжатия).
+ */
+std::string encodeReadRequest(const RemoteReadRequest &request);
+
+/**
+ * @brief Разобрать protobuf-запрос.
+ *
+ * @details Нужен тестовому серверу, который проверяет, что именно запросил клиент.
+ *
+ * @throws std::runtime_error Если сообщение повреждено
+ */
+RemoteReadRequest decodeReadRequest(const std::string &message);
+
+/**
+ * @brief Сериализовать ряд в один кадр потокового ответа.
+ *
+ * @details Временные метки ряда переводятся из секунд в миллисекунды, точки нарезаются на XOR-чанки
+ *          по `samples_per_chunk` (Prometheus пишет по 120 точек в чанк). Так тестовый сервер
+ *          и бенчмарки получают ответ, совпадающий по формату с ответом Prometheus.
+ *
+ * @param metric Ряд
+ * @param query_index Номер запроса в `ReadRequest`, к которому относится ряд
+ * @param samples_per_chunk Число точек в одном XOR-чанке
+ * @return Кадр вместе с длиной и контрольной суммой
+ */
+std::string encodeChunkedSeriesFrame(const Metric &metric, std::int64_t query_index = 0, std::size_t samples_per_chunk = 120);
+
+/**
+ * @brief Потоковый (push) декодер ответа в режиме `STREAMED_XOR_CHUNKS`.
+ *
+ * @details Ответ можно передавать произвольными кусками через `feed`, кадры разбираются по мере
+ *          готовности. Контрольная сумма каждого кадра проверяется. Точки вне `[start_ms, end_ms]`
+ *          (чанк может выходить за границы запроса) и маркеры устаревания отбрасываются, как это делает
+ *          `query_range`. Части одного ряда из разных кадров склеиваются.
+ *
+ *          Экземпляр одноразовый: после `finish` его нельзя переиспользовать.
+ */
+class RemoteReadResponseDecoder
+{
+public:
+    /**
+     * @brief Конструктор декодера.
+     *
+     * @param start_ms Начало диапазона запроса в миллисекундах
+     * @param end_ms Конец диапазона запроса в миллисекундах
+     * @param points_hint Ожидаемое число точек в ряду, 0 — без резервирования
+     */
+    RemoteReadResponseDecoder(std::int64_t start_ms, std::int64_t end_ms, std::size_t points_hint = 0);
+
+    /**
+     * @brief Передать очередной кусок ответа.
+     *
+     * @throws std::runtime_error Если кадр или чанк повреждён
+     */
+    void feed(const char *data, std::size_t size);
+
+    void feed(const std::string &chunk) { feed(chunk.data(), chunk.size()); }
+
+    /**
+     * @brief Завершить разбор и получить результат.
+     *
+     * @return Ряды в порядке первого появления, временные метки в секундах
+     * @throws std::runtime_error Если ответ оборван посреди кадра
+     */
+    std::vector<Metric> finish();
+
+private:
+    void decodeFrame(const std::uint8_t *data, std::size_t size);
+    void decodeSeries(const std::uint8_t *data, std::size_t size);
+
+    std::int64_t start_ms;
+    std::int64_t end_ms;
+    std::size_t points_hint;
+
+    std::string pending; ///< Начало незавершённого кадра
+    std::vector<Metric> metrics;
+    std::unordered_map<SeriesKey, std::size_t, SeriesKeyHash> index;
+    std::vector<LabelSet::Label> labels;                            ///< Буфер меток текущего ряда
+    std::vector<std::pair<const std::uint8_t *, std::size_t>> chunks; ///< Чанки текущего ряда внутри кадра
+};
+
+/** @} */
+
+#endif // TSDB_PROMETHEUS_REMOTE_READ_CODEC_H
@@ -0,0 +1,480 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+
+#include "prometheus.h"
+#include "response_parser.h"
+#include "sample_decoder.h"
+
+namespace
+{
+    inline bool isWhitespace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    inline bool isNumberChar(char c)
+    {
+        return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    }
+
+    inline int hexDigit(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+}
+
+PrometheusResponseParser::PrometheusResponseParser(std::size_t points_hint) : points_hint(points_hint), next_reserve(points_hint)
+{
+    stack.reserve(8);
+}
+
+void PrometheusResponseParser::feed(const char *data, std::size_t size)
+{
+    const char *end = data + size;
+    const char *p = data;
+    while (p < end)
+    {
+        offset = consumed + (p - data);
+        switch (lex_state)
+        {
+        case LexState::Structure:
+            processStructure(*p++);
+            break;
+
+        case LexState::String:
+        {
+            // Быстрый путь: копируем обычные символы строки одним куском
+            const char *run = p;
+            while (p < end && *p != '"' && *p != '\\' && static_cast<unsigned char>(*p) >= 0x20)
+                ++p;
+            token.append(run, p - run);
+            if (p == end)
+                break;
+            if (*p == '"')
+            {
+                ++p;
+                lex_state = LexState::Structure;
+                endString();
+            }
+            else if (*p == '\\')
+            {
+                ++p;
+                lex_state = LexState::Escape;
+            }
+            else
+            {
+                fail("control character in string");
+            }
+            break;
+        }
+
+        case LexState::Escape:
+        {
+            char c = *p++;
+            lex_state = LexState::String;
+            switch (c)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                token += c;
+                break;
+            case 'b':
+                token += '\b';
+                break;
+            case 'f':
+                token += '\f';
+                break;
+            case 'n':
+                token += '\n';
+                break;
+            case 'r':
+                token += '\r';
+                break;
+            case 't':
+                token += '\t';
+                break;
+            case 'u':
+                lex_state = LexState::Unicode;
+                unicode_value = 0;
+                unicode_digits = 0;
+                break;
+            default:
+                fail("invalid escape sequence");
+            }
+            break;
+        }
+
+        case LexState::Unicode:
+        {
+            int digit = hexDigit(*p++);
+            if (digit < 0)
+            {
+                fail("invalid \\u escape");
+            }
+            unicode_value = (unicode_value << 4) | static_cast<std::uint32_t>(digit);
+            if (++unicode_digits == 4)
+            {
+                lex_state = LexState::String;
+                appendCodepoint(unicode_value);
+            }
+            break;
+        }
+
+        case LexState::Number:
+        {
+            const char *run = p;
+            while (p < end && isNumberChar(*p))
+                ++p;
+            token.append(run, p - run);
+            if (p < end)
+            {
+                lex_state = LexState::Structure;
+                endNumber();
+            }
+            break;
+        }
+
+        case LexState::Literal:
+        {
+            const char *run = p;
+            while (p < end && *p >= 'a' && *p <= 'z')
+                ++p;
+            token.append(run, p - run);
+            if (p < end)
+            {
+                lex_state = LexState::Structure;
+                endLiteral();
+            }
+            break;
+        }
+        }
+    }
+    consumed += size;
+    offset = consumed;
+}
+
+std::vector<Metric> PrometheusResponseParser::finish()
+{
+    if (lex_state == LexState::Number)
+    {
+        lex_state = LexState::Structure;
+        endNumber();
+    }
+    else if (lex_state == LexState::Literal)
+    {
+        lex_state = LexState::Structure;
+        endLiteral();
+    }
+    if (lex_state != LexState::Structure || expect != Expect::Done)
+        fail("unexpected end of input");
+
+    if (status == "error")
+    {
+        throw InvalidPrometheusRequest(error, error_type);
+    }
+    else if (status != "success")
+    {
+        throw std::runtime_error("Unexpexted prometheus request error");
+    }
+    return std::move(metrics);
+}
+
+void PrometheusResponseParser::processStructure(char c)
+{
+    if (isWhitespace(c))
+        return;
+
+    bool value_expected = expect == Expect::Value || expect == Expect::ValueOrEnd;
+    switch (c)
+    {
+    case '{':
+    case '[':
+        if (!value_expected)
+            fail("unexpected container");
+        openContainer(c == '{');
+        return;
+    case '}':
+    case ']':
+        if (depth == 0 || stack[depth - 1].is_object != (c == '}'))
+            fail("mismatched bracket");
+        if (expect != Expect::CommaOrEnd && expect != (c == '}' ? Expect::KeyOrEnd : Expect::ValueOrEnd))
+            fail("unexpected closing bracket");
+        closeContainer(c == '}');
+        return;
+    case ':':
+        if (expect != Expect::Colon)
+            fail("unexpected ':'");
+        expect = Expect::Value;
+        return;
+    case ',':
+        if (expect != Expect::CommaOrEnd)
+            fail("unexpected ','");
+        if (stack[depth - 1].is_object)
+        {
+            expect = Expect::Key;
+        }
+        else
+        {
+            expect = Expect::Value;
+            stack[depth - 1].index++;
+        }
+        return;
+    case '"':
+        string_is_key = expect == Expect::Key || expect == Expect::KeyOrEnd;
+        if (!string_is_key && !value_expected)
+            fail("unexpected string");
+        token.clear();
+        lex_state = LexState::String;
+        return;
+    default:
+        if (!value_expected)
+            fail("unexpected token");
+        token.clear();
+        token += c;
+        if (c == '-' || (c >= '0' && c <= '9'))
+            lex_state = LexState::Number;
+        else if (c == 't' || c == 'f' || c == 'n')
+            lex_state = LexState::Literal;
+        else
+            fail("unexpected character");
+    }
+}
+
+void PrometheusResponseParser::openContainer(bool is_object)
+{
+    Role role = Role::Ignored;
+    if (depth == 0)
+    {
+        role = is_object ? Role::Root : Role::Ignored;
+    }
+    else
+    {
+        const Frame &parent = stack[depth - 1];
+        switch (parent.role)
+        {
+        case Role::Root:
+            if (is_object && parent.key == "data")
+                role = Role::Data;
+            break;
+        case Role::Data:
+            if (!is_object && parent.key == "result")
+                role = Role::Result;
+            break;
+        case Role::Result:
+            if (is_object)
+            {
+                role = Role::Series;
+                metrics.emplace_back();
+                if (next_reserve)
+                    metrics.back().series.reserve(next_reserve);
+            }
+            break;
+        case Role::Series:
+            if (is_object && parent.key == "metric")
+                role = Role::SeriesMetric;
+            else if (!is_object && parent.key == "values")
+                role = Role::SeriesValues;
+            break;
+        case Role::SeriesValues:
+            if (!is_object)
+                role = Role::SamplePair;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (depth == stack.size())
+        stack.emplace_back();
+    Frame &frame = stack[depth++];
+    frame.role = role;
+    frame.is_object = is_object;
+    frame.index = 0;
+    frame.key.clear();
+    expect = is_object ? Expect::KeyOrEnd : Expect::ValueOrEnd;
+}
+
+void PrometheusResponseParser::closeContainer(bool)
+{
+    if (stack[depth - 1].role == Role::SeriesMetric)
+    {
+        metrics.back().labels = LabelSet(std::move(pending_labels));
+        pending_labels.clear();
+    }
+    else if (stack[depth - 1].role == Role::Series && points_hint)
+    {
+        // Разреженный или короткоживущий ряд не держит резерв под весь интервал запроса, а следующий
+        // ряд резервирует столько, сколько оказалось в этом: ряды одного ответа обычно похожи
+        Series &series = metrics.back().series;
+        if (series.size() * 4 < series.timestamps.capacity() * 3)
+        {
+            series.timestamps.shrink_to_fit();
+            series.values.shrink_to_fit();
+        }
+        next_reserve = std::min(points_hint, std::max(series.size(), MIN_RESERVED_POINTS));
+    }
+    depth--;
+    afterValue();
+}
+
+void PrometheusResponseParser::afterValue()
+{
+    expect = depth == 0 ? Expect::Done : Expect::CommaOrEnd;
+}
+
+void PrometheusResponseParser::endString()
+{
+    if (high_surrogate)
+    {
+        // Одиночный старший суррогат в конце строки
+        appendCodepoint(0xFFFD);
+        high_surrogate = 0;
+    }
+    if (string_is_key)
+    {
+        stack[depth - 1].key.assign(token);
+        expect = Expect::Colon;
+        return;
+    }
+    onString(token);
+    afterValue();
+}
+
+void PrometheusResponseParser::endNumber()
+{
+    onNumber(token);
+    afterValue();
+}
+
+void PrometheusResponseParser::endLiteral()
+{
+    if (token != "true" && token != "false" && token != "null")
+        fail("invalid literal");
+    afterValue();
+}
+
+void PrometheusResponseParser::appendCodepoint(std::uint32_t codepoint)
+{
+    if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+    {
+        high_surrogate = codepoint;
+        return;
+    }
+    if (codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+    {
+        if (!high_surrogate)
+            codepoint = 0xFFFD;
+        else
+            codepoint = 0x10000 + ((high_surrogate - 0xD800) << 10) + (codepoint - 0xDC00);
+        high_surrogate = 0;
+    }
+    else if (high_surrogate)
+    {
+        // Старший суррогат без пары
+        high_surrogate = 0;
+        appendCodepoint(0xFFFD);
+    }
+
+    if (codepoint < 0x80)
+    {
+        token += static_cast<char>(codepoint);
+    }
+    else if (codepoint < 0x800)
+    {
+        token += static_cast<char>(0xC0 | (codepoint >> 6));
+        token += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else if (codepoint < 0x10000)
+    {
+        token += static_cast<char>(0xE0 | (codepoint >> 12));
+        token += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        token += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+        token += static_cast<char>(0xF0 | (codepoint >> 18));
+        token += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        token += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        token += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+}
+
+void PrometheusResponseParser::fail(const char *reason) const
+{
+    throw std::runtime_error("Malformed Prometheus response at byte " + std::to_string(offset) + ": " + reason);
+}
+
+void PrometheusResponseParser::onString(const std::string &value)
+{
+    Frame &frame = stack[depth - 1];
+    switch (frame.role)
+    {
+    case Role::Root:
+        if (frame.key == "status")
+            status = value;
+        else if (frame.key == "error")
+            error = value;
+        else if (frame.key == "errorType")
+            error_type = value;
+        break;
+    case Role::SeriesMetric:
+        if (frame.key == "__name__")
+            metrics.back().name = value;
+        else
+            pending_labels.emplace_back(frame.key, value);
+        break;
+    case Role::SamplePair:
+        if (frame.index == 1)
+        {
+            double sample;
+            if (!decodeSampleValue(value.data(), value.data() + value.size(), sample))
+                fail("invalid sample value");
+            metrics.back().series.push_back(pending_timestamp, sample);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void PrometheusResponseParser::onNumber(const std::string &value)
+{
+    const Frame &frame = stack[depth - 1];
+    if (frame.role == Role::SamplePair && frame.index == 0 &&
+        !decodeSampleTimestamp(value.data(), value.data() + value.size(), pending_timestamp))
+        fail("invalid timestamp");
+}
+
+std::vector<std::string> parseLabelValuesResponse(const std::string &response)
+{
+    // Списки метаданных невелики по сравнению с ответами `query_range`, поэтому разбираются через DOM
+    nlohmann::json document = nlohmann::json::parse(response, nullptr, false);
+    if (document.is_discarded() || !document.is_object())
+        throw std::runtime_error("Invalid Prometheus metadata response");
+    std::string status = document.value("status", "");
+    if (status == "error")
+        throw InvalidPrometheusRequest(document.value("error", ""), document.value("errorType", ""));
+    auto data = document.find("data");
+    if (status != "success" || data == document.end() || !data->is_array())
+        throw std::runtime_error("Invalid Prometheus metadata response");
+
+    std::vector<std::string> values;
+    values.reserve(data->size());
+    for (auto &value : *data)
+    {
+        if (!value.is_string())
+            throw std::runtime_error("Invalid Prometheus metadata response");
+        values.push_back(std::move(value.get_ref<std::string &>()));
+    }
+    return values;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file response_parser.h
+ * @brief Потоковый парсер ответов Prometheus HTTP API.
+ *
+ * @details Содержит класс `PrometheusResponseParser`, который разбирает JSON-ответ `query_range`
+ *          по мере поступления байт и сразу заполняет колонки `Metric::series`, не строя промежуточное
+ *          DOM-дерево документа. Имена и значения меток интернируются.
+ */
+
+/**
+ * @addtogroup prometheus
+ * @{
+ */
+
+#ifndef TSDB_PROMETHEUS_RESPONSE_PARSER_H
+#define TSDB_PROMETHEUS_RESPONSE_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../tsdb.h"
+
+/**
+ * @brief Потоковый (push) парсер ответа Prometheus.
+ *
+ * @details Ответ можно передавать произвольными кусками через `feed` — например, прямо из
+ *          write-callback'а CURL. Парсер хранит только текущий токен и стек вложенности,
+ *          поэтому пиковая память определяется размером результата, а не размером JSON.
+ *
+ *          Из документа извлекаются только поля `status`, `error`, `errorType` и
+ *          `data.result[].metric` / `data.result[].values`, остальные поля пропускаются.
+ *
+ *          Экземпляр одноразовый: после `finish` его нельзя переиспользовать.
+ */
+class PrometheusResponseParser
+{
+public:
+    /**
+     * @brief Конструктор парсера.
+     *
+     * @param points_hint Ожидаемое число точек в ряду (например, `(end - start) / step + 1`), 0 — без
+     *                    резервирования. Под первый ряд резервируется столько места, под следующие — по
+     *                    числу точек предыдущего ряда, но не больше. Ряд, занявший меньше трёх четвертей
+     *                    резерва, при закрытии ужимается до своих точек.
+     */
+    explicit PrometheusResponseParser(std::size_t points_hint = 0);
+
+    /**
+     * @brief Передать очередной кусок ответа.
+     *
+     * @param data Указатель на данные
+     * @param size Размер данных в байтах
+     * @throws std::runtime_error Если ответ не является корректным JSON
+     */
+    void feed(const char *data, std::size_t size);
+
+    /**
+     * @brief Передать очередной кусок ответа.
+     *
+     * @param chunk Данные
+     * @throws std::runtime_error Если ответ не является корректным JSON
+     */
+    void feed(const std::string &chunk) { feed(chunk.data(), chunk.size()); }
+
+    /**
+     * @brief Завершить разбор и получить результат.
+     *
+     * @return Массив метрик типа Metric
+     * @throws InvalidPrometheusRequest Если Prometheus вернул статус `error`
+     * @throws std::runtime_error Если ответ оборван или статус неизвестен
+     */
+    std::vector<Metric> finish();
+
+private:
+    /// Состояние лексера между вызовами `feed`.
+    enum class LexState
+    {
+        Structure, ///< Между токенами
+        String,    ///< Внутри строки
+        Escape,    ///< После обратного слеша внутри строки
+        Unicode,   ///< Внутри последовательности `\uXXXX`
+        Number,    ///< Внутри числа
+        Literal    ///< Внутри `true`/`false`/`null`
+    };
+
+    /// Что грамматически ожидается следующим токеном.
+    enum class Expect
+    {
+        Value,      ///< Значение
+        ValueOrEnd, ///< Значение или `]` (сразу после `[`)
+        Key,        ///< Ключ объекта
+        KeyOrEnd,   ///< Ключ или `}` (сразу после `{`)
+        Colon,      ///< `:` после ключа
+        CommaOrEnd, ///< `,` или закрывающая скобка
+        Done        ///< Документ закончился
+    };
+
+    /// Роль контейнера в структуре ответа Prometheus.
+    enum class Role
+    {
+        Root,         ///< Корневой объект
+        Data,         ///< `data`
+        Result,       ///< `data.result`
+        Series,       ///< Элемент `data.result[]`
+        SeriesMetric, ///< `data.result[].metric`
+        SeriesValues, ///< `data.result[].values`
+        SamplePair,   ///< Пара `[timestamp, "value"]`
+        Ignored       ///< Всё остальное
+    };
+
+    struct Frame
+    {
+        Role role;
+        bool is_object;
+        std::size_t index; ///< Номер текущего элемента массива
+        std::string key;   ///< Текущий ключ объекта
+    };
+
+    void processStructure(char c);
+    void openContainer(bool is_object);
+    void closeContainer(bool is_object);
+    void afterValue();
+    void endString();
+    void endNumber();
+    void endLiteral();
+    void appendCodepoint(std::uint32_t codepoint);
+    [[noreturn]] void fail(const char *reason) const;
+
+    void onString(const std::string &value);
+    void onNumber(const std::string &value);
+
+    LexState lex_state = LexState::Structure;
+    Expect expect = Expect::Value;
+    bool string_is_key = false;
+    std::uint32_t unicode_value = 0;
+    int unicode_digits = 0;
+    std::uint32_t high_surrogate = 0;
+    std::size_t consumed = 0; ///< Байт обработано в предыдущих вызовах `feed`
+    std::size_t offset = 0;   ///< Позиция текущего символа для сообщений об ошибках
+
+    std::string token;
+    std::vector<Frame> stack;
+    std::size_t depth = 0; ///< Число реально открытых фреймов в `stack`
+    /// Наименьший резерв под ряд после разреженного: от него до полного размера ряд дорастает за несколько удвоений
+    static constexpr std::size_t MIN_RESERVED_POINTS = 64;
+
+    std::size_t points_hint;
+    std::size_t next_reserve; ///< Резерв под следующий ряд
+
+    std::string status, error, error_type;
+    std::vector<Metric> metrics;
+    std::vector<LabelSet::Label> pending_labels; ///< Метки текущего `data.result[].metric` до его закрытия
+    double pending_timestamp = 0;
+};
+
+/**
+ * @brief Разобрать ответ API метаданных (`/api/v1/labels`, `/api/v1/label/<name>/values`).
+ *
+ * @param response JSON-ответ со списком строк в `data`
+ * @return Строки из `data`
+ * @throws InvalidPrometheusRequest Если Prometheus вернул статус `error`
+ * @throws std::runtime_error Если ответ не является корректным JSON или `data` — не список строк
+ */
+std::vector<std::string> parseLabelValuesResponse(const std::string &response);
+
+/** @} */
+
+#endif // TSDB_PROMETHEUS_RESPONSE_PARSER_H
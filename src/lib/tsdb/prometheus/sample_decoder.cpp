@@ -0,0 +1,160 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <string>
+
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+#include "sample_decoder.h"
+
+namespace
+{
+    // 10^0..10^22 представимы в double точно
+    constexpr double EXACT_POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                              1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    constexpr std::uint64_t MAX_EXACT_MANTISSA = 1ULL << 53;
+
+    inline bool equals(const char *first, const char *last, const char *literal)
+    {
+        std::size_t length = std::strlen(literal);
+        return static_cast<std::size_t>(last - first) == length && std::memcmp(first, literal, length) == 0;
+    }
+
+    bool decodeSpecial(const char *first, const char *last, double &value)
+    {
+        if (equals(first, last, "NaN"))
+            value = std::numeric_limits<double>::quiet_NaN();
+        else if (equals(first, last, "+Inf") || equals(first, last, "Inf"))
+            value = std::numeric_limits<double>::infinity();
+        else if (equals(first, last, "-Inf"))
+            value = -std::numeric_limits<double>::infinity();
+        else
+            return false;
+        return true;
+    }
+
+    /// Точный разбор редких длинных чисел. `std::strtod` не подходит: он берёт десятичный разделитель из локали
+    bool classicFallback(const char *first, const char *last, double &value)
+    {
+        std::istringstream stream(std::string(first, last));
+        stream.imbue(std::locale::classic());
+        stream >> value;
+        return !stream.fail() && stream.peek() == std::istringstream::traits_type::eof();
+    }
+
+    bool decodeDouble(const char *first, const char *last, double &value)
+    {
+        if (first == last)
+            return false;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        // from_chars не принимает ведущий '+', но принимает "inf" и "nan", которые Prometheus так не пишет
+        const char *begin = *first == '+' ? first + 1 : first;
+        const char *digits = begin != last && *first != '+' && *begin == '-' ? begin + 1 : begin;
+        if (digits == last || !((*digits >= '0' && *digits <= '9') || *digits == '.'))
+            return false;
+        auto [ptr, ec] = std::from_chars(begin, last, value);
+        return ec == std::errc() && ptr == last;
+#else
+        return parseDecimal(first, last, value);
+#endif
+    }
+}
+
+bool isStaleMarker(double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits == PROMETHEUS_STALE_NAN_BITS;
+}
+
+bool decodeSampleValue(const char *first, const char *last, double &value)
+{
+    if (first != last && (*first == 'N' || *first == 'I' || ((*first == '+' || *first == '-') && last - first > 1 && first[1] == 'I')))
+        return decodeSpecial(first, last, value);
+    return decodeDouble(first, last, value);
+}
+
+bool decodeSampleTimestamp(const char *first, const char *last, double &timestamp)
+{
+    return decodeDouble(first, last, timestamp) && std::isfinite(timestamp);
+}
+
+bool parseDecimal(const char *first, const char *last, double &value)
+{
+    const char *p = first;
+    bool negative = false;
+    if (p != last && (*p == '+' || *p == '-'))
+        negative = *p++ == '-';
+
+    std::uint64_t mantissa = 0;
+    int digits = 0;      // Значащих цифр в мантиссе
+    int exponent = 0;    // Десятичный порядок мантиссы
+    bool any_digit = false;
+    bool exact = true;
+    for (; p != last && *p >= '0' && *p <= '9'; ++p)
+    {
+        any_digit = true;
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        }
+        else
+        {
+            exponent++;
+            exact = false;
+        }
+    }
+    if (p != last && *p == '.')
+    {
+        for (++p; p != last && *p >= '0' && *p <= '9'; ++p)
+        {
+            any_digit = true;
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+            else
+            {
+                exact = false;
+            }
+        }
+    }
+    if (!any_digit)
+        return false;
+    if (p != last && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        bool exponent_negative = false;
+        if (p != last && (*p == '+' || *p == '-'))
+            exponent_negative = *p++ == '-';
+        if (p == last || *p < '0' || *p > '9')
+            return false;
+        int explicit_exponent = 0;
+        for (; p != last && *p >= '0' && *p <= '9'; ++p)
+        {
+            if (explicit_exponent < 100000)
+                explicit_exponent = explicit_exponent * 10 + (*p - '0');
+        }
+        exponent += exponent_negative ? -explicit_exponent : explicit_exponent;
+    }
+    if (p != last)
+        return false;
+
+    if (exact && mantissa <= MAX_EXACT_MANTISSA && exponent >= -22 && exponent <= 22)
+    {
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / EXACT_POWERS_OF_TEN[-exponent] : result * EXACT_POWERS_OF_TEN[exponent];
+        value = negative ? -result : result;
+        return true;
+    }
+    return classicFallback(first, last, value);
+}
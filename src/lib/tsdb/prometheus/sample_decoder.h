@@ -0,0 +1,73 @@
+/**
+ * @file sample_decoder.h
+ * @brief Разбор чисел из ответов Prometheus без аллокаций.
+ *
+ * @details Значения точек Prometheus передаёт строками (`"42"`, `"1.5e-3"`, `"NaN"`, `"+Inf"`, `"-Inf"`),
+ *          временные метки — JSON-числами с дробной частью (`1435781451.781`). Функции разбирают их
+ *          прямо из буфера парсера, не создавая временных строк и не завися от локали.
+ */
+
+/**
+ * @addtogroup prometheus
+ * @{
+ */
+
+#ifndef TSDB_PROMETHEUS_SAMPLE_DECODER_H
+#define TSDB_PROMETHEUS_SAMPLE_DECODER_H
+
+#include <cstdint>
+
+/**
+ * @brief Битовое представление маркера устаревания (stale marker) Prometheus.
+ *
+ * @details Prometheus помечает исчезнувший ряд особым NaN. HTTP API такие точки не возвращает, но они
+ *          встречаются в бинарных протоколах (remote read, TSDB-блоки).
+ */
+constexpr std::uint64_t PROMETHEUS_STALE_NAN_BITS = 0x7ff0000000000002ULL;
+
+/**
+ * @brief Проверить, является ли значение маркером устаревания.
+ */
+bool isStaleMarker(double value);
+
+/**
+ * @brief Разобрать значение точки.
+ *
+ * @details Кроме десятичной записи понимает специальные значения Prometheus `NaN`, `+Inf`, `-Inf` и `Inf`.
+ *          Использует `std::from_chars`, если стандартная библиотека его поддерживает для `double`,
+ *          иначе — `parseDecimal`.
+ *
+ * @param first Начало строки
+ * @param last Конец строки
+ * @param value Результат
+ * @return false, если строка не является числом целиком
+ */
+bool decodeSampleValue(const char *first, const char *last, double &value);
+
+/**
+ * @brief Разобрать временную метку точки в секундах с дробной частью.
+ *
+ * @param first Начало строки
+ * @param last Конец строки
+ * @param timestamp Результат
+ * @return false, если строка не является конечным числом целиком
+ */
+bool decodeSampleTimestamp(const char *first, const char *last, double &timestamp);
+
+/**
+ * @brief Переносимый разбор десятичного числа без учёта локали.
+ *
+ * @details Числа, мантисса которых помещается в 2^53, а десятичный порядок не больше 22 по модулю, считаются
+ *          точно одним умножением или делением (так выглядят почти все значения метрик). Остальные
+ *          разбираются потоком с локалью `std::locale::classic()`. Используется, когда `std::from_chars` для `double` недоступен.
+ *
+ * @param first Начало строки
+ * @param last Конец строки
+ * @param value Результат
+ * @return false, если строка не является числом целиком
+ */
+bool parseDecimal(const char *first, const char *last, double &value);
+
+/** @} */
+
+#endif // TSDB_PROMETHEUS_SAMPLE_DECODER_H
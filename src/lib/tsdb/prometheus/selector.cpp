@@ -0,0 +1,164 @@
+#include <stdexcept>
+
+#include "selector.h"
+
+namespace
+{
+    inline bool isNameStart(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    inline bool isNameChar(char c)
+    {
+        return isNameStart(c) || (c >= '0' && c <= '9');
+    }
+
+    /**
+     * Рекурсивный спуск по селектору с позицией внутри строки.
+     */
+    class SelectorParser
+    {
+    public:
+        explicit SelectorParser(const std::string &text) : text(text) {}
+
+        std::vector<LabelMatcher> parse()
+        {
+            std::vector<LabelMatcher> matchers;
+            skipSpaces();
+            if (position < text.size() && (isNameStart(text[position]) || text[position] == ':'))
+            {
+                // В имени метрики, в отличие от имён меток, допустимо двоеточие
+                std::size_t start = position;
+                while (position < text.size() && (isNameChar(text[position]) || text[position] == ':'))
+                    position++;
+                matchers.push_back({LabelMatcher::Type::Equal, "__name__", text.substr(start, position - start)});
+                skipSpaces();
+            }
+            if (position < text.size() && text[position] == '{')
+            {
+                position++;
+                skipSpaces();
+                while (position < text.size() && text[position] != '}')
+                {
+                    matchers.push_back(parseMatcher());
+                    skipSpaces();
+                    if (position < text.size() && text[position] == ',')
+                    {
+                        position++;
+                        skipSpaces();
+                    }
+                    else if (position < text.size() && text[position] != '}')
+                        fail("expected ',' or '}'");
+                }
+                if (position == text.size())
+                    fail("unclosed '{'");
+                position++;
+                skipSpaces();
+            }
+            if (position != text.size())
+                fail("unexpected character");
+            if (matchers.empty())
+                fail("empty selector");
+            return matchers;
+        }
+
+    private:
+        LabelMatcher parseMatcher()
+        {
+            LabelMatcher matcher;
+            if (!isNameStart(text[position]))
+                fail("expected label name");
+            std::size_t start = position;
+            while (position < text.size() && isNameChar(text[position]))
+                position++;
+            matcher.name = text.substr(start, position - start);
+            skipSpaces();
+
+            if (text.compare(position, 2, "=~") == 0)
+                matcher.type = LabelMatcher::Type::RegexMatch;
+            else if (text.compare(position, 2, "!~") == 0)
+                matcher.type = LabelMatcher::Type::RegexNoMatch;
+            else if (text.compare(position, 2, "!=") == 0)
+                matcher.type = LabelMatcher::Type::NotEqual;
+            else if (text.compare(position, 1, "=") == 0)
+                matcher.type = LabelMatcher::Type::Equal;
+            else
+                fail("expected label matching operator");
+            position += matcher.type == LabelMatcher::Type::Equal ? 1 : 2;
+            skipSpaces();
+
+            matcher.value = parseString();
+            return matcher;
+        }
+
+        std::string parseString()
+        {
+            if (position == text.size())
+                fail("expected string");
+            char quote = text[position];
+            if (quote != '"' && quote != '\'' && quote != '`')
+                fail("expected string");
+            position++;
+
+            std::string value;
+            while (position < text.size() && text[position] != quote)
+            {
+                char c = text[position++];
+                // В обратных кавычках экранирование не действует
+                if (c != '\\' || quote == '`')
+                {
+                    value += c;
+                    continue;
+                }
+                if (position == text.size())
+                    break;
+                char escaped = text[position++];
+                switch (escaped)
+                {
+                case 'n':
+                    value += '\n';
+                    break;
+                case 't':
+                    value += '\t';
+                    break;
+                case 'r':
+                    value += '\r';
+                    break;
+                case '\\':
+                case '"':
+                case '\'':
+                    value += escaped;
+                    break;
+                default:
+                    // Регулярные выражения вида "\\d" пишутся с двойным слешем, одиночный оставляем как есть
+                    value += '\\';
+                    value += escaped;
+                }
+            }
+            if (position == text.size())
+                fail("unterminated string");
+            position++;
+            return value;
+        }
+
+        void skipSpaces()
+        {
+            while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+                position++;
+        }
+
+        [[noreturn]] void fail(const char *reason) const
+        {
+            throw std::invalid_argument("Invalid series selector at position " + std::to_string(position) + ": " + reason);
+        }
+
+        const std::string &text;
+        std::size_t position = 0;
+    };
+}
+
+std::vector<LabelMatcher> parseSeriesSelector(const std::string &selector)
+{
+    return SelectorParser(selector).parse();
+}
@@ -0,0 +1,60 @@
+/**
+ * @file selector.h
+ * @brief Разбор селектора рядов PromQL.
+ *
+ * @details Remote read API принимает не выражение PromQL, а набор сопоставителей меток. Селектор вида
+ *          `http_requests_total{job="api", code=~"5.."}` переводится в такой набор.
+ */
+
+/**
+ * @addtogroup prometheus
+ * @{
+ */
+
+#ifndef TSDB_PROMETHEUS_SELECTOR_H
+#define TSDB_PROMETHEUS_SELECTOR_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Условие на значение метки.
+ *
+ * @details Значения `Type` совпадают с `prometheus.LabelMatcher.Type` из remote read API.
+ */
+struct LabelMatcher
+{
+    enum class Type
+    {
+        Equal = 0,       ///< `=`
+        NotEqual = 1,    ///< `!=`
+        RegexMatch = 2,  ///< `=~`
+        RegexNoMatch = 3 ///< `!~`
+    };
+
+    Type type;
+    std::string name;
+    std::string value;
+
+    bool operator==(const LabelMatcher &other) const
+    {
+        return type == other.type && name == other.name && value == other.value;
+    }
+};
+
+/**
+ * @brief Разобрать селектор рядов.
+ *
+ * @details Понимает необязательное имя метрики и список условий в фигурных скобках, строки в двойных,
+ *          одинарных и обратных кавычках. Имя метрики становится условием `__name__="..."`.
+ *          Функции, операторы и диапазоны (`[5m]`) не поддерживаются.
+ *
+ * @param selector Селектор
+ * @return Условия в порядке записи
+ * @throws std::invalid_argument Если строка не является селектором рядов
+ */
+std::vector<LabelMatcher> parseSeriesSelector(const std::string &selector);
+
+/** @} */
+
+#endif // TSDB_PROMETHEUS_SELECTOR_H
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#include "snappy.h"
+
+namespace
+{
+    /// Максимальная длина одного литерала, при которой длина помещается в два байта.
+    constexpr std::size_t MAX_LITERAL = 1 << 16;
+
+    [[noreturn]] void corrupted()
+    {
+        throw std::runtime_error("Corrupted snappy block");
+    }
+
+    /// Прочитать `count` байт little-endian.
+    inline std::uint32_t readLittleEndian(const unsigned char *&position, const unsigned char *end, int count)
+    {
+        if (end - position < count)
+            corrupted();
+        std::uint32_t value = 0;
+        for (int i = 0; i < count; i++)
+            value |= std::uint32_t(position[i]) << (8 * i);
+        position += count;
+        return value;
+    }
+}
+
+std::string snappyCompress(const char *data, std::size_t size)
+{
+    std::string result;
+    result.reserve(size + size / MAX_LITERAL * 3 + 16);
+
+    // Длина исходных данных — uvarint
+    std::uint64_t length = size;
+    while (length >= 0x80)
+    {
+        result += static_cast<char>(length | 0x80);
+        length >>= 7;
+    }
+    result += static_cast<char>(length);
+
+    for (std::size_t offset = 0; offset < size; offset += MAX_LITERAL)
+    {
+        std::size_t chunk = std::min(MAX_LITERAL, size - offset);
+        std::size_t n = chunk - 1;
+        if (n < 60)
+            result += static_cast<char>(n << 2);
+        else if (n < 0x100)
+        {
+            result += static_cast<char>(60 << 2);
+            result += static_cast<char>(n);
+        }
+        else
+        {
+            result += static_cast<char>(61 << 2);
+            result += static_cast<char>(n & 0xff);
+            result += static_cast<char>(n >> 8);
+        }
+        result.append(data + offset, chunk);
+    }
+    return result;
+}
+
+std::string snappyUncompress(const char *data, std::size_t size)
+{
+    auto position = reinterpret_cast<const unsigned char *>(data);
+    auto end = position + size;
+
+    std::uint64_t length = 0;
+    for (int shift = 0;; shift += 7)
+    {
+        if (position == end || shift > 28)
+            corrupted();
+        unsigned char byte = *position++;
+        length |= std::uint64_t(byte & 0x7f) << shift;
+        if (byte < 0x80)
+            break;
+    }
+    // Каждый байт сжатых данных даёт не больше 64 байт результата: защита от заведомо ложной длины
+    if (length > std::uint64_t(size) * 64)
+        corrupted();
+
+    std::string result;
+    result.reserve(length);
+    while (position != end)
+    {
+        unsigned char tag = *position++;
+        std::size_t chunk, offset;
+        switch (tag & 3)
+        {
+        case 0: // Литерал
+            chunk = tag >> 2;
+            if (chunk >= 60)
+                chunk = readLittleEndian(position, end, static_cast<int>(chunk - 59));
+            chunk++;
+            if (static_cast<std::size_t>(end - position) < chunk || result.size() + chunk > length)
+                corrupted();
+            result.append(reinterpret_cast<const char *>(position), chunk);
+            position += chunk;
+            continue;
+        case 1: // Копия с 11-битным смещением
+            chunk = 4 + ((tag >> 2) & 7);
+            offset = (std::size_t(tag >> 5) << 8) | readLittleEndian(position, end, 1);
+            break;
+        case 2: // Копия с 16-битным смещением
+            chunk = 1 + (tag >> 2);
+            offset = readLittleEndian(position, end, 2);
+            break;
+        default: // Копия с 32-битным смещением
+            chunk = 1 + (tag >> 2);
+            offset = readLittleEndian(position, end, 4);
+            break;
+        }
+        if (offset == 0 || offset > result.size() || result.size() + chunk > length)
+            corrupted();
+        // Источник и приёмник могут перекрываться (повтор короткого шаблона), копируем побайтово
+        std::size_t from = result.size() - offset;
+        for (std::size_t i = 0; i < chunk; i++)
+            result += result[from + i];
+    }
+    if (result.size() != length)
+        corrupted();
+    return result;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file snappy.h
+ * @brief Блочный формат Snappy для remote read API.
+ *
+ * @details Prometheus принимает тело запроса remote read сжатым Snappy (блочный формат, без фреймов).
+ *          Запросы состоят из нескольких сотен байт, поэтому кодировщик пишет только литералы:
+ *          результат корректен для любого декодера Snappy, хотя и не меньше исходных данных.
+ *          Декодер поддерживает формат полностью.
+ */
+
+/**
+ * @addtogroup prometheus
+ * @{
+ */
+
+#ifndef TSDB_PROMETHEUS_SNAPPY_H
+#define TSDB_PROMETHEUS_SNAPPY_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Упаковать данные в блочный формат Snappy без поиска повторов.
+ *
+ * @param data Исходные данные
+ * @param size Размер данных
+ * @return Snappy-блок
+ */
+std::string snappyCompress(const char *data, std::size_t size);
+
+inline std::string snappyCompress(const std::string &data) { return snappyCompress(data.data(), data.size()); }
+
+/**
+ * @brief Распаковать Snappy-блок.
+ *
+ * @param data Сжатые данные
+ * @param size Размер сжатых данных
+ * @return Исходные данные
+ * @throws std::runtime_error Если блок повреждён
+ */
+std::string snappyUncompress(const char *data, std::size_t size);
+
+inline std::string snappyUncompress(const std::string &data) { return snappyUncompress(data.data(), data.size()); }
+
+/** @} */
+
+#endif // TSDB_PROMETHEUS_SNAPPY_H
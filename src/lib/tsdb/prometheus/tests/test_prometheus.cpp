@@ -1,10 +1,26 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <fstream>
+#include <locale>
+#include <mutex>
+#include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 #include "doctest.h"
+#include "../../tests/http_stub_server.h"
 #include "../prometheus.h"
+#include "../response_parser.h"
+#include "../sample_decoder.h"
 
 const std::time_t TEST_START = 1732448700, TEST_END = 1732449600;
 const int TEST_STEP = 15;
@@ -79,6 +95,67 @@ private:
     bool ready;
 };
 
+/**
+ * Мок, отвечающий на любой `query_range` синтетическими точками на сетке запроса.
+ *
+ * Ряд `a` есть на всём диапазоне, ряд `b` — только начиная с `b_from`. Запросы могут идти из нескольких
+ * потоков одновременно: мок считает их число и максимальную степень параллельности.
+ */
+class MockRangeClient : public PrometheusClient
+{
+public:
+    MockRangeClient(std::time_t b_from) : PrometheusClient("http://test.host"), b_from(b_from) {};
+
+    std::atomic<int> requests{0}, active{0}, max_active{0};
+    std::time_t fail_from = 0; ///< Запросы с началом не раньше этой метки завершаются ошибкой, 0 — без ошибок
+    std::vector<std::pair<std::time_t, std::time_t>> ranges;
+
+protected:
+    std::string performHttpRequest(const std::string &url, int timeout) override
+    {
+        std::time_t start = param(url, "start"), end = param(url, "end");
+        int step = static_cast<int>(param(url, "step"));
+        requests++;
+        int now_active = ++active;
+        int seen = max_active;
+        while (now_active > seen && !max_active.compare_exchange_weak(seen, now_active))
+            ;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ranges.emplace_back(start, end);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        active--;
+
+        if (fail_from && start >= fail_from)
+            return R"({"status":"error","errorType":"timeout","error":"query timed out"})";
+
+        std::string a, b;
+        for (std::time_t t = start; t <= end; t += step)
+        {
+            std::string point = "[" + std::to_string(t) + ",\"" + std::to_string(t % 1000) + "\"]";
+            a += (a.empty() ? "" : ",") + point;
+            if (t >= b_from)
+                b += (b.empty() ? "" : ",") + point;
+        }
+        std::string response = R"({"status":"success","data":{"resultType":"matrix","result":[)";
+        if (!b.empty())
+            response += R"({"metric":{"__name__":"b"},"values":[)" + b + "]},";
+        response += R"({"metric":{"__name__":"a"},"values":[)" + a + "]}]}}";
+        return response;
+    }
+
+private:
+    static std::time_t param(const std::string &url, const std::string &name)
+    {
+        std::size_t pos = url.find("&" + name + "=");
+        return std::strtoll(url.c_str() + pos + name.size() + 2, nullptr, 10);
+    }
+
+    std::time_t b_from;
+    std::mutex mutex;
+};
+
 TEST_SUITE("Test PrometheusClient")
 {
     MockPrometheusClient client("http://test.host");
@@ -94,9 +171,9 @@ TEST_SUITE("Test PrometheusClient")
             CHECK(result.size() == 1);
             CHECK(result[0].name == "up");
             CHECK(result[0].labels.empty());
-            CHECK(result[0].values.size() == 1);
-            CHECK(result[0].values[0].timestamp == 1690);
-            CHECK(result[0].values[0].value == 1);
+            CHECK(result[0].series.size() == 1);
+            CHECK(result[0].series[0].timestamp == 1690);
+            CHECK(result[0].series[0].value == 1);
         }
 
         SUBCASE("Несколько метрик")
@@ -110,8 +187,8 @@ TEST_SUITE("Test PrometheusClient")
             CHECK(result[1].name == "test_metric");
             CHECK(result[0].labels["exported_job"] == "test_job");
             CHECK(result[1].labels["exported_job"] == "test_job_2");
-            CHECK(result[0].values.size() == 3);
-            CHECK(result[1].values.size() == 1);
+            CHECK(result[0].series.size() == 3);
+            CHECK(result[1].series.size() == 1);
         }
 
         SUBCASE("Ошибка")
@@ -134,6 +211,168 @@ TEST_SUITE("Test PrometheusClient")
         }
     }
 
+    TEST_CASE("Test queryChunked")
+    {
+        const std::time_t start = 1700000000;
+        const int step = 15;
+
+        SUBCASE("Склейка частей")
+        {
+            // 1000 точек частями по 64: 16 частей, последняя неполная
+            const std::time_t end = start + 999 * step;
+            MockRangeClient mock(start + 500 * step);
+            std::vector<Metric> result = mock.queryChunked("up", start, end, step, 4, 64);
+            CHECK(mock.requests == 16);
+            CHECK(mock.max_active <= 4);
+            CHECK(mock.max_active > 1);
+
+            // Части не пересекаются и лежат на сетке запроса
+            std::sort(mock.ranges.begin(), mock.ranges.end());
+            CHECK(mock.ranges.front().first == start);
+            CHECK(mock.ranges.back().second == end);
+            for (std::size_t i = 1; i < mock.ranges.size(); i++)
+                CHECK(mock.ranges[i].first == mock.ranges[i - 1].second + step);
+
+            // Ряд `a` первым появился в первой части, `b` — только в девятой
+            REQUIRE(result.size() == 2);
+            CHECK(result[0].name == "a");
+            CHECK(result[1].name == "b");
+            CHECK(result[0].series.size() == 1000);
+            CHECK(result[1].series.size() == 500);
+            for (std::size_t i = 0; i < result[0].series.size(); i++)
+                REQUIRE(result[0].series.timestamps[i] == start + static_cast<double>(i) * step);
+            CHECK(result[1].series.timestamps.front() == start + 500 * step);
+        }
+
+        SUBCASE("Одна часть")
+        {
+            MockRangeClient mock(start);
+            std::vector<Metric> result = mock.queryChunked("up", start, start + 63 * step, step, 4, 64);
+            CHECK(mock.requests == 1);
+            REQUIRE(result.size() == 2);
+            CHECK(result[1].series.size() == 64);
+        }
+
+        SUBCASE("query разбивает только большие диапазоны")
+        {
+            MockRangeClient mock(start);
+            mock.query("up", start, start + (PrometheusClient::MAX_POINTS_PER_REQUEST - 1) * step, step);
+            CHECK(mock.requests == 1);
+
+            std::vector<Metric> result = mock.query("up", start, start + 3 * PrometheusClient::MAX_POINTS_PER_REQUEST * step, step);
+            CHECK(mock.requests == 1 + 4);
+            REQUIRE(result.size() == 2);
+            CHECK(result[0].series.size() == 3 * PrometheusClient::MAX_POINTS_PER_REQUEST + 1);
+        }
+
+        SUBCASE("Ошибка в одной из частей")
+        {
+            MockRangeClient mock(start);
+            mock.fail_from = start + 256 * step;
+            CHECK_THROWS_AS_MESSAGE(mock.queryChunked("up", start, start + 999 * step, step, 2, 64), InvalidPrometheusRequest,
+                                    "timeout: query timed out");
+        }
+    }
+
+    TEST_CASE("Test sample decoder")
+    {
+        auto value = [](const std::string &text) -> double
+        {
+            double result = 0;
+            CHECK(decodeSampleValue(text.data(), text.data() + text.size(), result));
+            return result;
+        };
+        auto invalid = [](const std::string &text)
+        {
+            double result = 0;
+            return !decodeSampleValue(text.data(), text.data() + text.size(), result);
+        };
+
+        SUBCASE("Значения")
+        {
+            CHECK(value("42") == 42);
+            CHECK(value("-0.5") == -0.5);
+            CHECK(value("+3") == 3);
+            CHECK(value("1e3") == 1000);
+            CHECK(value("1.7976931348623157e+308") == 1.7976931348623157e+308);
+            CHECK(value("4.9e-324") == 4.9e-324);
+            CHECK(std::isnan(value("NaN")));
+            CHECK(value("+Inf") == HUGE_VAL);
+            CHECK(value("Inf") == HUGE_VAL);
+            CHECK(value("-Inf") == -HUGE_VAL);
+        }
+
+        SUBCASE("Некорректные строки")
+        {
+            CHECK(invalid(""));
+            CHECK(invalid("-"));
+            CHECK(invalid("1.2.3"));
+            CHECK(invalid("12 "));
+            CHECK(invalid("1e"));
+            CHECK(invalid("nan"));
+            CHECK(invalid("Infinity"));
+            CHECK(invalid("0x10"));
+        }
+
+        SUBCASE("Временные метки")
+        {
+            std::string text = "1435781451.781";
+            double timestamp = 0;
+            CHECK(decodeSampleTimestamp(text.data(), text.data() + text.size(), timestamp));
+            CHECK(timestamp == 1435781451.781);
+            text = "inf";
+            CHECK_FALSE(decodeSampleTimestamp(text.data(), text.data() + text.size(), timestamp));
+        }
+
+        SUBCASE("Маркер устаревания")
+        {
+            double stale;
+            std::uint64_t bits = PROMETHEUS_STALE_NAN_BITS;
+            std::memcpy(&stale, &bits, sizeof(stale));
+            CHECK(std::isnan(stale));
+            CHECK(isStaleMarker(stale));
+            CHECK_FALSE(isStaleMarker(std::nan("")));
+            CHECK_FALSE(isStaleMarker(1.0));
+        }
+
+        SUBCASE("parseDecimal совпадает с strtod")
+        {
+            // Переносимый разбор проверяется везде, даже если сборка использует std::from_chars
+            const char *samples[] = {"0", "-0", "0.1", "123456.789", "1e-7", "2.5E+10", "9007199254740993",
+                                     "0.30000000000000004", "12345678901234567890123", "1e-400", "0000.0001"};
+            for (const char *sample : samples)
+            {
+                double parsed = 0;
+                REQUIRE(parseDecimal(sample, sample + std::strlen(sample), parsed));
+                CHECK(parsed == std::strtod(sample, nullptr));
+            }
+            for (int i = 0; i < 10000; i++)
+            {
+                char buffer[32];
+                std::snprintf(buffer, sizeof(buffer), "%.*g", 1 + i % 17, (i - 5000) * 1234.5678901 / (1 + i % 13));
+                double parsed = 0;
+                REQUIRE(parseDecimal(buffer, buffer + std::strlen(buffer), parsed));
+                REQUIRE(parsed == std::strtod(buffer, nullptr));
+            }
+        }
+
+        SUBCASE("parseDecimal не зависит от глобальной локали")
+        {
+            struct CommaDecimal : std::numpunct<char>
+            {
+                char do_decimal_point() const override { return ','; }
+            };
+            std::locale previous = std::locale::global(std::locale(std::locale::classic(), new CommaDecimal));
+            // Больше 19 значащих цифр: число разбирается не быстрым путём
+            const char *sample = "1234567890.12345678901234";
+            double parsed = 0;
+            bool ok = parseDecimal(sample, sample + std::strlen(sample), parsed);
+            std::locale::global(previous);
+            REQUIRE(ok);
+            CHECK(parsed == std::strtod(sample, nullptr));
+        }
+    }
+
     TEST_CASE("Test isAvailable")
     {
         SUBCASE("Available")
@@ -154,4 +393,220 @@ TEST_SUITE("Test PrometheusClient")
             CHECK_FALSE(client.isAvailable());
         }
     }
+
+    TEST_CASE("Test metadata")
+    {
+        SUBCASE("Имена меток")
+        {
+            client.mockRequest("/api/v1/labels", R"({"status":"success","data":["__name__","instance","job"]})");
+            CHECK(client.labelNames(0, 0) == std::vector<std::string>{"__name__", "instance", "job"});
+        }
+
+        SUBCASE("Значения метки за интервал")
+        {
+            client.mockRequest("/api/v1/label/__name__/values?start=100&end=200", R"({"status":"success","data":["up","node_load1"]})");
+            CHECK(client.labelValues("__name__", 100, 200) == std::vector<std::string>{"up", "node_load1"});
+        }
+
+        SUBCASE("Экранирование имени метки")
+        {
+            CHECK(prometheusMetadataUrl("http://h", "a b", 0, 0) == "http://h/api/v1/label/a%20b/values");
+        }
+
+        SUBCASE("Ошибки")
+        {
+            CHECK_THROWS_AS(parseLabelValuesResponse(R"({"status":"error","errorType":"bad_data","error":"x"})"), InvalidPrometheusRequest);
+            CHECK_THROWS_AS(parseLabelValuesResponse(R"({"status":"success","data":[1]})"), std::runtime_error);
+            CHECK_THROWS_AS(parseLabelValuesResponse("not json"), std::runtime_error);
+        }
+    }
+
+    TEST_CASE("Test PrometheusResponseParser")
+    {
+        SUBCASE("Побайтовая подача")
+        {
+            PrometheusResponseParser parser;
+            for (char c : TEST_MULTUPLE_METRICS)
+                parser.feed(&c, 1);
+            std::vector<Metric> result = parser.finish();
+            CHECK(result.size() == 2);
+            CHECK(result[0].labels["exported_job"] == "test_job");
+            CHECK(result[0].series.size() == 3);
+            CHECK(result[0].series[1].timestamp == 1738709100);
+            CHECK(result[0].series[1].value == 442);
+            CHECK(result[1].series[0].value == 37);
+        }
+
+        SUBCASE("Лишние поля и экранирование")
+        {
+            PrometheusResponseParser parser;
+            parser.feed(R"({"data":{"resultType":"matrix","result":[{"metric":{"path":"\/a\"b\u00e9\ud83d\ude00","__name__":"m"},)"
+                        R"("values":[[1690.5,"2.5"]],"extra":[{"values":[[1,"1"]]}]}]},"warnings":["w"],"status":"success"})");
+            std::vector<Metric> result = parser.finish();
+            REQUIRE(result.size() == 1);
+            CHECK(result[0].name == "m");
+            CHECK(result[0].labels["path"] == "/a\"b\xC3\xA9\xF0\x9F\x98\x80");
+            CHECK(result[0].series.size() == 1);
+            CHECK(result[0].series[0].timestamp == 1690);
+            CHECK(result[0].series.timestamps[0] == 1690.5);
+            CHECK(result[0].series[0].value == 2.5);
+        }
+
+        SUBCASE("Специальные значения и дробные метки")
+        {
+            PrometheusResponseParser parser;
+            parser.feed(R"({"status":"success","data":{"result":[{"metric":{},"values":[)"
+                        R"([1435781451.781,"NaN"],[1435781452.5,"+Inf"],[1435781453,"-Inf"],[1.5e9,"-1.25e-3"]]}]}})");
+            std::vector<Metric> result = parser.finish();
+            REQUIRE(result.size() == 1);
+            const Series &series = result[0].series;
+            REQUIRE(series.size() == 4);
+            CHECK(series.timestamps[0] == 1435781451.781);
+            CHECK(series.timestamps[1] == 1435781452.5);
+            CHECK(series.timestamps[3] == 1.5e9);
+            CHECK(std::isnan(series.values[0]));
+            CHECK(series.values[1] == HUGE_VAL);
+            CHECK(series.values[2] == -HUGE_VAL);
+            CHECK(series.values[3] == -1.25e-3);
+        }
+
+        SUBCASE("Резерв под ряд не превышает его точек")
+        {
+            PrometheusResponseParser parser(10000);
+            parser.feed(R"({"status":"success","data":{"result":[{"metric":{"a":"1"},"values":[[1,"1"],[2,"2"]]},)"
+                        R"({"metric":{"a":"2"},"values":[[1,"1"]]}]}})");
+            std::vector<Metric> result = parser.finish();
+            REQUIRE(result.size() == 2);
+            CHECK(result[0].series.size() == 2);
+            CHECK(result[0].series.timestamps.capacity() < 100);
+            CHECK(result[1].series.values.capacity() < 100);
+        }
+
+        SUBCASE("Некорректное значение точки")
+        {
+            PrometheusResponseParser parser;
+            CHECK_THROWS_AS(parser.feed(R"({"status":"success","data":{"result":[{"metric":{},"values":[[1,"12abc"]]}]}})"),
+                            std::runtime_error);
+        }
+
+        SUBCASE("Статус error")
+        {
+            PrometheusResponseParser parser;
+            parser.feed(R"({"status":"error","errorType":"bad_data","error":"parse error"})");
+            CHECK_THROWS_AS_MESSAGE(parser.finish(), InvalidPrometheusRequest, "bad_data: parse error");
+        }
+
+        SUBCASE("Некорректный JSON")
+        {
+            PrometheusResponseParser parser;
+            CHECK_THROWS_AS(parser.feed(R"({"status":"success",])"), std::runtime_error);
+
+            PrometheusResponseParser truncated;
+            truncated.feed(R"({"status":"success","data":{"result":[)");
+            CHECK_THROWS_AS(truncated.finish(), std::runtime_error);
+        }
+    }
+
+    TEST_CASE("Test streaming responses")
+    {
+        std::ifstream file(std::string(FIXTURES_DIR) + "/query_range.json.gz", std::ios::binary);
+        REQUIRE(file.is_open());
+        std::ostringstream gzip;
+        gzip << file.rdbuf();
+        HttpStubServer server([&](const HttpStubServer::Request &) {
+            HttpStubServer::Response response;
+            response.body = gzip.str();
+            response.headers.push_back({"Content-Encoding", "gzip"});
+            return response;
+        });
+        PrometheusClient streaming(server.url());
+        streaming.setStreamingResponses(true);
+
+        auto metrics = streaming.query("node_load1", 1700000000, 1700000000 + 119 * 15, 15);
+        REQUIRE(metrics.size() == 40);
+        for (const auto &metric : metrics)
+        {
+            CHECK(metric.name == "node_load1");
+            CHECK(metric.labels["job"] == "node");
+            REQUIRE(metric.series.size() == 120);
+            CHECK(metric.series.timestamps.front() == 1700000000);
+            CHECK(metric.series.timestamps.back() == 1700000000 + 119 * 15);
+        }
+        CHECK(metrics[0].labels["instance"] == "host-0:9100");
+        CHECK(metrics[0].series.values[0] == doctest::Approx(323.833));
+    }
+
+    TEST_CASE("Test queryBatch")
+    {
+        const int DELAY_MS = 200;
+        HttpStubServer server([&](const HttpStubServer::Request &request) {
+            auto param = [&](const std::string &name) {
+                std::size_t pos = request.path.find(name + "=");
+                std::size_t end = request.path.find('&', pos);
+                return request.path.substr(pos + name.size() + 1, end == std::string::npos ? std::string::npos : end - pos - name.size() - 1);
+            };
+            std::this_thread::sleep_for(std::chrono::milliseconds(DELAY_MS));
+            HttpStubServer::Response response;
+            std::string query = param("query");
+            if (query == "bad")
+            {
+                response.status = 400;
+                response.body = R"({"status":"error","errorType":"bad_data","error":"parse error"})";
+                return response;
+            }
+            std::time_t start = std::stoll(param("start")), end = std::stoll(param("end"));
+            int step = std::stoi(param("step"));
+            std::string values;
+            for (std::time_t t = start; t <= end; t += step)
+                values += (values.empty() ? "[" : ",[") + std::to_string(t) + ",\"" + std::to_string(t % 1000) + "\"]";
+            response.body = R"({"status":"success","data":{"resultType":"matrix","result":[{"metric":{"__name__":")" + query +
+                            R"("},"values":[)" + values + "]}]}}";
+            return response;
+        });
+        PrometheusClient client(server.url());
+        client.setStreamingResponses(true);
+
+        const int STEP = 15;
+        const std::time_t LONG_END = static_cast<std::time_t>(PrometheusClient::MAX_POINTS_PER_REQUEST) * STEP * 2 + 10 * STEP;
+        std::vector<RangeQuery> queries;
+        for (int i = 0; i < 4; i++)
+            queries.push_back({"q" + std::to_string(i), 1000, 1000 + 60 * STEP, STEP});
+        queries.push_back({"bad", 1000, 2000, STEP});
+        queries.push_back({"long", 0, LONG_END, STEP}); // Делится на три части
+
+        auto started = std::chrono::steady_clock::now();
+        std::vector<RangeQueryResult> results = client.queryBatch(queries);
+        auto elapsed = std::chrono::steady_clock::now() - started;
+
+        REQUIRE(results.size() == queries.size());
+        CHECK(server.requests() == 4 + 1 + 3);
+        // По очереди восемь запросов заняли бы 8 * DELAY_MS
+        CHECK(elapsed < std::chrono::milliseconds(4 * DELAY_MS));
+        for (int i = 0; i < 4; i++)
+        {
+            CHECK_FALSE(results[i].error);
+            REQUIRE(results[i].metrics->size() == 1);
+            CHECK((*results[i].metrics)[0].name == "q" + std::to_string(i));
+            CHECK((*results[i].metrics)[0].series.size() == 61);
+        }
+        REQUIRE(results[4].error);
+        CHECK_THROWS_AS(std::rethrow_exception(results[4].error), InvalidPrometheusRequest);
+        CHECK(results[4].metrics == nullptr);
+
+        CHECK_FALSE(results[5].error);
+        REQUIRE(results[5].metrics->size() == 1);
+        const Series &series = (*results[5].metrics)[0].series;
+        REQUIRE(series.size() == static_cast<std::size_t>(LONG_END / STEP + 1));
+        bool contiguous = true;
+        for (std::size_t i = 1; i < series.size(); i++)
+            contiguous = contiguous && series.timestamps[i] - series.timestamps[i - 1] == STEP;
+        CHECK(contiguous);
+
+        // Без потокового разбора запросы идут по очереди через performHttpRequest
+        MockRangeClient sequential(0);
+        std::vector<RangeQueryResult> fallback = sequential.queryBatch({{"a", 0, 600, STEP}, {"a", 600, 1200, STEP}});
+        CHECK(sequential.max_active == 1);
+        REQUIRE(fallback.size() == 2);
+        CHECK(fallback[1].metrics->size() == 2);
+    }
 }
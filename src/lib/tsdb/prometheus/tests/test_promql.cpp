@@ -0,0 +1,342 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cmath>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "doctest.h"
+#include "../local_promql.h"
+#include "../promql.h"
+
+/**
+ * Сырые точки для тестов: два счётчика по 15 секунд (у второго сброс в 300) и гистограмма.
+ */
+static std::map<std::string, std::vector<Metric>> makeRawData()
+{
+    std::map<std::string, std::vector<Metric>> data;
+    Metric a{"requests_total", LabelSet{{"instance", "a"}, {"job", "api"}}, {}};
+    Metric b{"requests_total", LabelSet{{"instance", "b"}, {"job", "api"}}, {}};
+    for (double t = 0; t <= 1200; t += 15)
+    {
+        a.series.push_back(t, 2 * t);
+        b.series.push_back(t, std::fmod(t, 300) + 15);
+    }
+    data["requests_total"] = {a, b};
+
+    std::vector<Metric> buckets;
+    for (auto [le, count] : {std::pair<const char *, double>{"0.1", 10}, {"0.5", 20}, {"+Inf", 40}})
+    {
+        Metric bucket{"latency_bucket", LabelSet{{"job", "api"}, {"le", le}}, {}};
+        for (double t = 0; t <= 1200; t += 15)
+            bucket.series.push_back(t, count);
+        buckets.push_back(bucket);
+    }
+    data["latency_bucket"] = buckets;
+
+    Metric single{"up", LabelSet{{"job", "api"}}, {}};
+    single.series.push_back(0, 1);
+    data["up"] = {single};
+    return data;
+}
+
+/**
+ * Клиент сырых точек, который отдаёт точки селектора внутри интервала и запоминает запросы.
+ */
+class FakeRawClient : public TSDBClient
+{
+public:
+    std::map<std::string, std::vector<Metric>> data = makeRawData();
+    std::vector<RangeQuery> requests;
+    bool broken = false;
+
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end) override
+    {
+        return query(query_str, start, end, 0);
+    }
+
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end, int step) override
+    {
+        requests.push_back({query_str, start, end, step});
+        if (broken)
+            throw std::runtime_error("remote read is disabled");
+        std::vector<Metric> result;
+        for (const auto &metric : data[query_str])
+            result.push_back({metric.name, metric.labels, metric.series.slice(start, end)});
+        return result;
+    }
+
+    bool isAvailable() noexcept override { return true; }
+};
+
+/**
+ * Сервер для запросов вне подмножества: отвечает одним рядом `server` и запоминает запросы.
+ */
+class FakeServerClient : public TSDBClient
+{
+public:
+    std::vector<std::string> queries;
+    std::size_t batches = 0;
+
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end) override
+    {
+        return query(query_str, start, end, 15);
+    }
+
+    std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t, int) override
+    {
+        queries.push_back(query_str);
+        Metric metric{"server", LabelSet(), {}};
+        metric.series.push_back(static_cast<double>(start), 1);
+        return {metric};
+    }
+
+    std::vector<RangeQueryResult> queryBatch(const std::vector<RangeQuery> &queries) override
+    {
+        batches++;
+        return TSDBClient::queryBatch(queries);
+    }
+
+    bool isAvailable() noexcept override { return true; }
+};
+
+class TestLocalClient : public LocalPromQLClient
+{
+public:
+    using LocalPromQLClient::LocalPromQLClient;
+    std::time_t current_time = 100000;
+
+protected:
+    std::time_t now() const override { return current_time; }
+};
+
+static std::vector<Metric> evaluate(const std::string &query, std::time_t start, std::time_t end, int step)
+{
+    auto data = std::make_shared<std::map<std::string, std::vector<Metric>>>(makeRawData());
+    // Сопоставители меток загрузчик не проверяет: ряды выбираются по имени метрики
+    RawSeriesLoader load = [data](const std::string &selector, std::time_t, std::time_t) {
+        return std::make_shared<const std::vector<Metric>>((*data)[selector.substr(0, selector.find('{'))]);
+    };
+    return evaluatePromQL(*parsePromQL(query), load, start, end, step);
+}
+
+static void checkValues(const Metric &metric, std::size_t points, double value)
+{
+    REQUIRE(metric.series.size() == points);
+    for (double v : metric.series.values)
+        CHECK(v == doctest::Approx(value));
+}
+
+TEST_SUITE("Test PromQL")
+{
+    TEST_CASE("Test parsePromQL")
+    {
+        using Type = PromQLExpression::Type;
+
+        SUBCASE("Агрегат с группировкой")
+        {
+            auto expression = parsePromQL(R"(sum by (job, instance) (rate(requests_total{job="api"}[5m])))");
+            CHECK(expression->type == Type::Aggregation);
+            CHECK(expression->aggregation == Aggregation::Sum);
+            CHECK(expression->grouping.labels == std::vector<std::string>{"job", "instance"});
+            CHECK_FALSE(expression->grouping.without);
+            const PromQLExpression &rate = *expression->args[0];
+            CHECK(rate.type == Type::Function);
+            CHECK(rate.function == "rate");
+            CHECK(rate.args[0]->selector == R"(requests_total{job="api"})");
+            CHECK(rate.args[0]->range == 300);
+
+            auto after = parsePromQL("max(increase(requests_total[1h30m])) without (instance)");
+            CHECK(after->aggregation == Aggregation::Max);
+            CHECK(after->grouping.without);
+            CHECK(after->args[0]->args[0]->range == 5400);
+
+            auto quantile = parsePromQL("quantile(0.9, up)");
+            REQUIRE(quantile->args.size() == 2);
+            CHECK(quantile->args[0]->number == doctest::Approx(0.9));
+        }
+
+        SUBCASE("Арифметика и скаляры")
+        {
+            auto scaled = parsePromQL("rate(requests_total[1m]) * 8 / 1e3");
+            CHECK(scaled->type == Type::Binary);
+            CHECK(scaled->op == '/');
+            CHECK(scaled->args[0]->op == '*');
+
+            auto folded = parsePromQL("(1 + 2) * -2 ^ 2");
+            CHECK(folded->type == Type::Number);
+            CHECK(folded->number == -12);
+
+            CHECK(parsePromQL("{__name__=\"up\"}")->type == Type::Selector);
+            CHECK(parsePromQL("sum(up{job=~\"a|b\"})")->type == Type::Aggregation);
+        }
+
+        SUBCASE("Выражения вне подмножества")
+        {
+            for (const char *query : {"up offset 5m", "up @ 100", "rate(up[5m:1m])", "up + up", "up > 1", "up and up", "label_replace(up, \"a\", \"b\", \"c\", \"d\")",
+                                      "rate(up)", "up[5m]", "sum(1)", "quantile(up, up)", "rate(up[0s])", "sum(up", "up{job=}", ""})
+            {
+                CHECK_THROWS_AS(parsePromQL(query), std::invalid_argument);
+            }
+        }
+    }
+
+    TEST_CASE("Test evaluatePromQL")
+    {
+        SUBCASE("Селектор с окном поиска назад")
+        {
+            auto result = evaluate("up", 0, 600, 60);
+            REQUIRE(result.size() == 1);
+            CHECK(result[0].name == "up");
+            // Точка в 0 видна, пока не старше PROMQL_LOOKBACK_DELTA
+            CHECK(result[0].series.timestamps == std::vector<double>{0, 60, 120, 180, 240});
+        }
+
+        SUBCASE("rate, increase и irate")
+        {
+            auto rate = evaluate("rate(requests_total[1m])", 300, 600, 60);
+            REQUIRE(rate.size() == 2);
+            CHECK(rate[0].name.empty());
+            checkValues(rate[0], 6, 2);
+            // Сброс счётчика в 300 не даёт отрицательной скорости
+            checkValues(rate[1], 6, 1);
+
+            auto increase = evaluate("increase(requests_total{job=\"api\"}[1m])", 300, 600, 60);
+            checkValues(increase[0], 6, 120);
+            checkValues(increase[1], 6, 60);
+
+            auto irate = evaluate("irate(requests_total[5m])", 300, 600, 60);
+            checkValues(irate[0], 6, 2);
+            checkValues(irate[1], 6, 1);
+
+            // Окну нужны хотя бы две точки
+            CHECK(evaluate("rate(up[5m])", 0, 600, 60).empty());
+        }
+
+        SUBCASE("Агрегаты и арифметика")
+        {
+            auto sum = evaluate("sum by (job) (rate(requests_total[1m]))", 300, 600, 60);
+            REQUIRE(sum.size() == 1);
+            CHECK(sum[0].labels == LabelSet{{"job", "api"}});
+            checkValues(sum[0], 6, 3);
+
+            auto scaled = evaluate("10 - rate(requests_total[1m]) * 2", 300, 600, 60);
+            checkValues(scaled[0], 6, 6);
+            checkValues(scaled[1], 6, 8);
+
+            auto constant = evaluate("1 + 2", 0, 60, 15);
+            REQUIRE(constant.size() == 1);
+            checkValues(constant[0], 5, 3);
+        }
+
+        SUBCASE("histogram_quantile")
+        {
+            auto median = evaluate("histogram_quantile(0.375, latency_bucket)", 300, 600, 60);
+            REQUIRE(median.size() == 1);
+            CHECK(median[0].labels == LabelSet{{"job", "api"}});
+            checkValues(median[0], 6, 0.3);
+            // Квантиль в бакете +Inf — верхняя граница предыдущего бакета
+            checkValues(evaluate("histogram_quantile(0.9, latency_bucket)", 300, 600, 60)[0], 6, 0.5);
+            checkValues(evaluate("histogram_quantile(0.25, sum by (le) (latency_bucket))", 300, 600, 60)[0], 6, 0.1);
+        }
+
+        SUBCASE("Интервалы сырых точек")
+        {
+            auto queries = rawQueriesOf(*parsePromQL("histogram_quantile(0.9, rate(latency_bucket[10m])) * 0 + 1"), 1000, 2000);
+            REQUIRE(queries.size() == 1);
+            CHECK(queries[0].query == "latency_bucket");
+            CHECK(queries[0].start == 400);
+            CHECK(queries[0].end == 2000);
+            CHECK(rawQueriesOf(*parsePromQL("up"), 1000, 2000)[0].start == 1000 - PROMQL_LOOKBACK_DELTA);
+        }
+    }
+
+    TEST_CASE("Test LocalPromQLClient")
+    {
+        auto raw = std::make_shared<FakeRawClient>();
+        auto server = std::make_shared<FakeServerClient>();
+        TestLocalClient client(raw, server, 1 << 20);
+
+        SUBCASE("Локальное вычисление и кэш сырых точек")
+        {
+            auto result = client.query("sum(rate(requests_total[1m]))", 300, 600, 60);
+            REQUIRE(result.size() == 1);
+            checkValues(result[0], 6, 3);
+            REQUIRE(raw->requests.size() == 1);
+            CHECK(raw->requests[0].start == 240);
+            CHECK(server->queries.empty());
+
+            // Другая функция над тем же селектором не загружает точки заново
+            auto irate = client.query("max(irate(requests_total[1m]))", 300, 600, 60);
+            checkValues(irate[0], 6, 2);
+            CHECK(raw->requests.size() == 1);
+
+            // Сдвиг вправо догружает только хвост
+            client.query("sum(rate(requests_total[1m]))", 360, 900, 60);
+            REQUIRE(raw->requests.size() == 2);
+            CHECK(raw->requests[1].start == 600);
+            CHECK(raw->requests[1].end == 900);
+
+            auto stats = client.getStats();
+            CHECK(stats.local_queries == 3);
+            CHECK(stats.raw_misses == 1);
+            CHECK(stats.raw_hits == 1);
+            CHECK(stats.raw_partial_hits == 1);
+            CHECK(stats.memory_bytes > 0);
+        }
+
+        SUBCASE("Свежие точки загружаются снова")
+        {
+            client.current_time = 630;
+            client.query("rate(requests_total[1m])", 300, 600, 60);
+            client.query("rate(requests_total[1m])", 300, 600, 60);
+            REQUIRE(raw->requests.size() == 2);
+            CHECK(raw->requests[1].start == 570);
+        }
+
+        SUBCASE("Запасной клиент")
+        {
+            auto result = client.query("up > 0", 300, 600, 60);
+            REQUIRE(result.size() == 1);
+            CHECK(result[0].name == "server");
+            CHECK(raw->requests.empty());
+
+            raw->broken = true;
+            client.query("rate(requests_total[1m])", 300, 600, 60);
+            CHECK(server->queries == std::vector<std::string>{"up > 0", "rate(requests_total[1m])"});
+            CHECK(client.getStats().fallback_queries == 2);
+        }
+
+        SUBCASE("Пакет запросов")
+        {
+            auto results = client.queryBatch({{"rate(requests_total[1m])", 300, 600, 60},
+                                              {"topk(1, up)", 300, 600, 60},
+                                              {"sum(latency_bucket)", 300, 600, 60},
+                                              {"count(up)", 300, 600, 60}});
+            REQUIRE(results.size() == 4);
+            CHECK(results[0].metrics->size() == 2);
+            CHECK((*results[1].metrics)[0].name == "server");
+            checkValues((*results[2].metrics)[0], 6, 70);
+            REQUIRE(results[3].metrics);
+            CHECK(results[3].metrics->empty());
+            CHECK(server->batches == 1);
+            CHECK(server->queries == std::vector<std::string>{"topk(1, up)"});
+            // Сырые точки всех локальных запросов загружены одним пакетом, по одному запросу на селектор
+            CHECK(raw->requests.size() == 3);
+        }
+
+        SUBCASE("Лимит памяти")
+        {
+            TestLocalClient small(raw, server, 1);
+            small.query("rate(requests_total[1m])", 300, 600, 60);
+            small.query("sum(latency_bucket)", 300, 600, 60);
+            auto stats = small.getStats();
+            CHECK(stats.evictions == 1);
+            small.query("rate(requests_total[1m])", 300, 600, 60);
+            CHECK(raw->requests.size() == 3);
+        }
+    }
+}
@@ -0,0 +1,288 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "doctest.h"
+#include "../../tests/http_stub_server.h"
+#include "../remote_read.h"
+#include "../remote_read_codec.h"
+#include "../response_parser.h"
+#include "../selector.h"
+#include "../snappy.h"
+
+static std::string readFixture(const std::string &name)
+{
+    std::ifstream file(std::string(FIXTURES_DIR) + "/" + name, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Failed to open fixture " + name);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+/**
+ * Те же данные, что и в remote_read_streamed.bin, полученные через JSON `query_range`.
+ */
+static std::vector<Metric> jsonFixtureMetrics()
+{
+    PrometheusResponseParser parser;
+    parser.feed(readFixture("query_range.json"));
+    return parser.finish();
+}
+
+static Metric makeMetric(const std::vector<std::pair<double, double>> &points)
+{
+    Metric metric{"up", LabelSet{{"job", "node"}}, {}};
+    for (auto [timestamp, value] : points)
+        metric.series.push_back(timestamp, value);
+    return metric;
+}
+
+static std::vector<Metric> decodeAll(const std::string &response, std::int64_t start_ms, std::int64_t end_ms, std::size_t piece)
+{
+    RemoteReadResponseDecoder decoder(start_ms, end_ms);
+    for (std::size_t offset = 0; offset < response.size(); offset += piece)
+        decoder.feed(response.data() + offset, std::min(piece, response.size() - offset));
+    return decoder.finish();
+}
+
+TEST_SUITE("Test remote read")
+{
+    TEST_CASE("Test snappy")
+    {
+        SUBCASE("Литералы")
+        {
+            for (std::size_t size : {0, 1, 59, 60, 61, 255, 256, 257, 65536, 65537, 200000})
+            {
+                std::string data(size, '\0');
+                for (std::size_t i = 0; i < size; i++)
+                    data[i] = static_cast<char>(i * 7 + i / 3);
+                CHECK(snappyUncompress(snappyCompress(data)) == data);
+            }
+        }
+
+        SUBCASE("Копии с перекрытием")
+        {
+            // "abc", затем копия 9 байт со смещением 3
+            const char block[] = {12, 0x08, 'a', 'b', 'c', 0x15, 0x03};
+            CHECK(snappyUncompress(block, sizeof(block)) == "abcabcabcabc");
+            // Копия с двухбайтовым смещением
+            const char block2[] = {6, 0x04, 'x', 'y', static_cast<char>(0x0e), 0x02, 0x00};
+            CHECK(snappyUncompress(block2, sizeof(block2)) == "xyxyxy");
+        }
+
+        SUBCASE("Повреждённый блок")
+        {
+            const char bad_offset[] = {8, 0x08, 'a', 'b', 'c', 0x05, 0x04};
+            CHECK_THROWS_AS(snappyUncompress(bad_offset, sizeof(bad_offset)), std::runtime_error);
+            const char short_literal[] = {3, 0x08, 'a'};
+            CHECK_THROWS_AS(snappyUncompress(short_literal, sizeof(short_literal)), std::runtime_error);
+            const char wrong_length[] = {5, 0x08, 'a', 'b', 'c'};
+            CHECK_THROWS_AS(snappyUncompress(wrong_length, sizeof(wrong_length)), std::runtime_error);
+        }
+    }
+
+    TEST_CASE("Test parseSeriesSelector")
+    {
+        using Type = LabelMatcher::Type;
+
+        CHECK(parseSeriesSelector("up") == std::vector<LabelMatcher>{{Type::Equal, "__name__", "up"}});
+        CHECK(parseSeriesSelector(" node:load1:avg ") == std::vector<LabelMatcher>{{Type::Equal, "__name__", "node:load1:avg"}});
+        CHECK(parseSeriesSelector(R"(http_requests_total{job="api", code=~'5..',path!="/",env!~`dev|test`,})") ==
+              std::vector<LabelMatcher>{{Type::Equal, "__name__", "http_requests_total"},
+                                        {Type::Equal, "job", "api"},
+                                        {Type::RegexMatch, "code", "5.."},
+                                        {Type::NotEqual, "path", "/"},
+                                        {Type::RegexNoMatch, "env", "dev|test"}});
+        CHECK(parseSeriesSelector(R"({__name__=~"node_.+", instance = "a\"b"})") ==
+              std::vector<LabelMatcher>{{Type::RegexMatch, "__name__", "node_.+"}, {Type::Equal, "instance", "a\"b"}});
+
+        for (const char *invalid : {"", "{}", "rate(up[5m])", "up{job}", "up{job=\"a\"", "up{job=node}", "up{1a=\"x\"}", "up offset 5m"})
+            CHECK_THROWS_AS(parseSeriesSelector(invalid), std::invalid_argument);
+    }
+
+    TEST_CASE("Test ReadRequest")
+    {
+        RemoteReadRequest request;
+        RemoteReadQuery query;
+        query.start_ms = 1700000000000;
+        query.end_ms = 1700003600000;
+        query.step_ms = 15000;
+        query.matchers = parseSeriesSelector(R"(up{job="node"})");
+        request.queries.push_back(query);
+        request.accepted_response_types = {RemoteReadResponseType::StreamedXorChunks, RemoteReadResponseType::Samples};
+
+        RemoteReadRequest decoded = decodeReadRequest(encodeReadRequest(request));
+        REQUIRE(decoded.queries.size() == 1);
+        CHECK(decoded.queries[0].start_ms == query.start_ms);
+        CHECK(decoded.queries[0].end_ms == query.end_ms);
+        CHECK(decoded.queries[0].step_ms == query.step_ms);
+        CHECK(decoded.queries[0].matchers == query.matchers);
+        CHECK(decoded.accepted_response_types == request.accepted_response_types);
+
+        CHECK_THROWS_AS(decodeReadRequest("\x0a\x05\x08"), std::runtime_error);
+    }
+
+    TEST_CASE("Test RemoteReadResponseDecoder")
+    {
+        SUBCASE("Записанный ответ совпадает с query_range")
+        {
+            std::string response = readFixture("remote_read_streamed.bin");
+            std::vector<Metric> expected = jsonFixtureMetrics();
+            // Кусками разного размера: кадр и его длина разрезаются в разных местах
+            for (std::size_t piece : {std::size_t(1), std::size_t(7), std::size_t(4096), response.size()})
+            {
+                std::vector<Metric> metrics = decodeAll(response, 1700000000000, 1700000000000 + 119 * 15000, piece);
+                REQUIRE(metrics.size() == expected.size());
+                for (std::size_t i = 0; i < expected.size(); i++)
+                {
+                    CHECK(metrics[i].key() == expected[i].key());
+                    CHECK(metrics[i].series.timestamps == expected[i].series.timestamps);
+                    CHECK(metrics[i].series.values == expected[i].series.values);
+                }
+            }
+        }
+
+        SUBCASE("Границы диапазона и маркеры устаревания")
+        {
+            double stale;
+            std::uint64_t stale_bits = 0x7ff0000000000002ULL;
+            std::memcpy(&stale, &stale_bits, sizeof(stale));
+            Metric metric = makeMetric({{10, 1}, {20, 2}, {30, stale}, {40, 4}, {50, 5}, {60, 6}});
+            Metric empty = makeMetric({{100, 1}});
+            empty.name = "gone";
+
+            std::string response = encodeChunkedSeriesFrame(metric, 0, 2) + encodeChunkedSeriesFrame(empty);
+            std::vector<Metric> metrics = decodeAll(response, 20000, 50000, response.size());
+            REQUIRE(metrics.size() == 1);
+            CHECK(metrics[0].name == "up");
+            CHECK(metrics[0].labels["job"] == "node");
+            CHECK(metrics[0].series.timestamps == std::vector<double>{20, 40, 50});
+            CHECK(metrics[0].series.values == std::vector<double>{2, 4, 5});
+        }
+
+        SUBCASE("Ряд в нескольких кадрах")
+        {
+            std::string response = encodeChunkedSeriesFrame(makeMetric({{1, 1}, {2, 2}})) +
+                                   encodeChunkedSeriesFrame(makeMetric({{2, 2}, {3.5, 3}}));
+            std::vector<Metric> metrics = decodeAll(response, 0, 10000, 3);
+            REQUIRE(metrics.size() == 1);
+            CHECK(metrics[0].series.timestamps == std::vector<double>{1, 2, 3.5});
+        }
+
+        SUBCASE("Повреждённый ответ")
+        {
+            std::string frame = encodeChunkedSeriesFrame(makeMetric({{1, 1}, {2, 2}}));
+            std::string corrupted = frame;
+            corrupted.back() ^= 0x40;
+            RemoteReadResponseDecoder decoder(0, 10000);
+            CHECK_THROWS_AS(decoder.feed(corrupted), std::runtime_error);
+
+            RemoteReadResponseDecoder truncated(0, 10000);
+            truncated.feed(frame.substr(0, frame.size() - 1));
+            CHECK_THROWS_AS(truncated.finish(), std::runtime_error);
+
+            // Snappy-ответ старого формата вместо потока кадров
+            auto decodeSnappy = [](const std::string &body) {
+                RemoteReadResponseDecoder not_streamed(0, 10000);
+                not_streamed.feed(body);
+                return not_streamed.finish();
+            };
+            CHECK_THROWS_AS(decodeSnappy(snappyCompress(std::string(100, 'x'))), std::runtime_error);
+            CHECK_THROWS_AS(decodeSnappy(snappyCompress(std::string(1000, 'x'))), std::runtime_error);
+        }
+    }
+
+    TEST_CASE("Test PrometheusRemoteReadClient")
+    {
+        const std::string response = readFixture("remote_read_streamed.bin");
+        HttpStubServer::Request received;
+        RemoteReadRequest decoded;
+        std::mutex received_mutex; // Пакетные запросы приходят в разных потоках сервера
+        HttpStubServer server([&](const HttpStubServer::Request &request) {
+            std::lock_guard<std::mutex> lock(received_mutex);
+            received = request;
+            HttpStubServer::Response reply;
+            if (request.path == "/-/healthy")
+            {
+                reply.body = "Prometheus Server is Healthy.\n";
+                return reply;
+            }
+            decoded = decodeReadRequest(snappyUncompress(request.body));
+            if (decoded.queries.empty() || decoded.queries[0].matchers.empty() || decoded.queries[0].matchers[0].value != "node_load1")
+            {
+                reply.status = 400;
+                reply.body = "no series matched";
+                return reply;
+            }
+            reply.headers.push_back({"Content-Type", "application/x-streamed-protobuf; proto=prometheus.ChunkedReadResponse"});
+            reply.body = response;
+            return reply;
+        });
+        PrometheusRemoteReadClient client(server.url());
+
+        SUBCASE("Запрос и ответ")
+        {
+            std::vector<Metric> metrics = client.query(R"(node_load1{job="node"})", 1700000000, 1700000000 + 119 * 15, 15);
+            CHECK(received.method == "POST");
+            CHECK(received.path == "/api/v1/read");
+            CHECK(received.headers["content-encoding"] == "snappy");
+            CHECK(received.headers["content-type"] == "application/x-protobuf");
+            CHECK(received.headers["x-prometheus-remote-read-version"] == "0.1.0");
+            REQUIRE(decoded.queries.size() == 1);
+            CHECK(decoded.queries[0].start_ms == 1700000000000);
+            CHECK(decoded.queries[0].end_ms == 1700000000000 + 119 * 15000);
+            CHECK(decoded.queries[0].step_ms == 15000);
+            CHECK(decoded.queries[0].matchers.size() == 2);
+            CHECK(decoded.accepted_response_types == std::vector<RemoteReadResponseType>{RemoteReadResponseType::StreamedXorChunks});
+
+            std::vector<Metric> expected = jsonFixtureMetrics();
+            REQUIRE(metrics.size() == expected.size());
+            for (std::size_t i = 0; i < expected.size(); i++)
+            {
+                CHECK(metrics[i].key() == expected[i].key());
+                CHECK(metrics[i].series.values == expected[i].series.values);
+            }
+        }
+
+        SUBCASE("Ошибка сервера")
+        {
+            CHECK_THROWS_WITH_AS(client.query("other", 0, 60), doctest::Contains("no series matched"), std::runtime_error);
+        }
+
+        SUBCASE("Не селектор")
+        {
+            CHECK_THROWS_AS(client.query("sum(rate(node_load1[5m]))", 0, 60), std::invalid_argument);
+        }
+
+        SUBCASE("Пакет запросов")
+        {
+            std::vector<RangeQueryResult> results = client.queryBatch({
+                {R"(node_load1{job="node"})", 1700000000, 1700000000 + 119 * 15, 15},
+                {"sum(rate(node_load1[5m]))", 0, 60, 15},
+                {"other", 0, 60, 15},
+            });
+            REQUIRE(results.size() == 3);
+            CHECK_FALSE(results[0].error);
+            CHECK(results[0].metrics->size() == jsonFixtureMetrics().size());
+            REQUIRE(results[1].error);
+            CHECK_THROWS_AS(std::rethrow_exception(results[1].error), std::invalid_argument);
+            REQUIRE(results[2].error);
+            CHECK_THROWS_WITH_AS(std::rethrow_exception(results[2].error), doctest::Contains("no series matched"), std::runtime_error);
+            CHECK(server.requests() == 2);
+        }
+
+        SUBCASE("isAvailable")
+        {
+            CHECK(client.isAvailable());
+            CHECK_FALSE(PrometheusRemoteReadClient("http://127.0.0.1:1").isAvailable());
+        }
+    }
+}
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "pyramid.h"
+
+namespace
+{
+    const SeriesPyramid::Bucket EMPTY_BUCKET = {std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), 0, 0};
+
+    /// Деление с округлением вниз и для отрицательных номеров корзин.
+    inline std::int64_t floorDiv2(std::int64_t index)
+    {
+        return index >= 0 ? index / 2 : -((-index + 1) / 2);
+    }
+
+    inline void mergeInto(SeriesPyramid::Bucket &target, const SeriesPyramid::Bucket &source)
+    {
+        target.min = std::min(target.min, source.min);
+        target.max = std::max(target.max, source.max);
+        target.sum += source.sum;
+        target.count += source.count;
+    }
+}
+
+void SeriesPyramid::build(const Series &series, double base_width)
+{
+    levels.clear();
+    levels.push_back(Level{base_width, 0, {}});
+    last_timestamp = -std::numeric_limits<double>::infinity();
+    append(series);
+}
+
+void SeriesPyramid::append(const Series &series)
+{
+    if (levels.empty())
+        return;
+
+    auto begin = std::upper_bound(series.timestamps.begin(), series.timestamps.end(), last_timestamp);
+    std::size_t i = begin - series.timestamps.begin();
+    if (i == series.size())
+        return;
+
+    Level &base = levels[0];
+    std::int64_t dirty = std::numeric_limits<std::int64_t>::max();
+    for (; i < series.size(); i++)
+    {
+        std::int64_t index = static_cast<std::int64_t>(std::floor(series.timestamps[i] / base.width));
+        if (base.buckets.empty())
+            base.first = index;
+        std::size_t offset = static_cast<std::size_t>(index - base.first);
+        if (offset >= base.buckets.size())
+            base.buckets.resize(offset + 1, EMPTY_BUCKET);
+
+        double value = series.values[i];
+        Bucket &bucket = base.buckets[offset];
+        bucket.min = std::min(bucket.min, value);
+        bucket.max = std::max(bucket.max, value);
+        bucket.sum += value;
+        bucket.count++;
+        dirty = std::min(dirty, index);
+    }
+    last_timestamp = series.timestamps.back();
+    rebuildFrom(1, dirty);
+}
+
+void SeriesPyramid::rebuildFrom(std::size_t k, std::int64_t child_from)
+{
+    // Уже существующие уровни пересчитываются всегда, новые добавляются, пока на уровне больше одной корзины
+    for (; k < levels.size() || levels[k - 1].buckets.size() > 1; k++)
+    {
+        if (k == levels.size())
+        {
+            double width = levels[k - 1].width * 2;
+            std::int64_t first = levels[k - 1].first;
+            levels.push_back(Level{width, floorDiv2(first), {}});
+            child_from = first;
+        }
+        const Level &children = levels[k - 1];
+        Level &level = levels[k];
+
+        std::int64_t child_last = children.first + static_cast<std::int64_t>(children.buckets.size()) - 1;
+        std::int64_t from = std::max(floorDiv2(child_from), level.first);
+        std::int64_t to = floorDiv2(child_last);
+        level.buckets.resize(static_cast<std::size_t>(to - level.first + 1), EMPTY_BUCKET);
+        for (std::int64_t index = from; index <= to; index++)
+        {
+            Bucket bucket = EMPTY_BUCKET;
+            for (std::int64_t c = index * 2; c <= index * 2 + 1; c++)
+            {
+                if (c >= children.first && c <= child_last)
+                    mergeInto(bucket, children.buckets[static_cast<std::size_t>(c - children.first)]);
+            }
+            level.buckets[static_cast<std::size_t>(index - level.first)] = bucket;
+        }
+        child_from = from;
+    }
+}
+
+void SeriesPyramid::dropBefore(double timestamp)
+{
+    if (levels.empty())
+        return;
+
+    for (Level &level : levels)
+    {
+        std::int64_t keep = static_cast<std::int64_t>(std::floor(timestamp / level.width));
+        if (keep <= level.first)
+            continue;
+        std::size_t drop = std::min(static_cast<std::size_t>(keep - level.first), level.buckets.size());
+        level.buckets.erase(level.buckets.begin(), level.buckets.begin() + drop);
+        level.first += static_cast<std::int64_t>(drop);
+    }
+
+    // Первая корзина верхнего уровня могла ссылаться на удалённую дочернюю
+    while (levels.size() > 1 && levels.back().buckets.empty())
+        levels.pop_back();
+    if (levels[0].buckets.empty())
+        return;
+    for (std::size_t k = 1; k < levels.size(); k++)
+    {
+        Level &level = levels[k];
+        const Level &children = levels[k - 1];
+        if (level.buckets.empty() || floorDiv2(children.first) != level.first)
+            continue;
+        Bucket bucket = EMPTY_BUCKET;
+        for (std::size_t c = 0; c < 2 - static_cast<std::size_t>(children.first - level.first * 2) && c < children.buckets.size(); c++)
+            mergeInto(bucket, children.buckets[c]);
+        level.buckets[0] = bucket;
+    }
+}
+
+void SeriesPyramid::clear()
+{
+    levels.clear();
+    last_timestamp = 0;
+}
+
+int SeriesPyramid::levelFor(double from, double to, std::size_t pixels) const
+{
+    if (levels.empty() || pixels == 0 || to <= from)
+        return -1;
+    double pixel = (to - from) / pixels;
+    int result = -1;
+    for (std::size_t k = 0; k < levels.size() && levels[k].width <= pixel; k++)
+        result = static_cast<int>(k);
+    return result;
+}
+
+std::pair<std::size_t, std::size_t> SeriesPyramid::bucketRange(const Level &level, double from, double to) const
+{
+    std::int64_t first = static_cast<std::int64_t>(std::floor(from / level.width)) - 1 - level.first;
+    std::int64_t last = static_cast<std::int64_t>(std::floor(to / level.width)) + 2 - level.first;
+    std::int64_t size = static_cast<std::int64_t>(level.buckets.size());
+    first = std::clamp<std::int64_t>(first, 0, size);
+    last = std::clamp<std::int64_t>(last, first, size);
+    return {static_cast<std::size_t>(first), static_cast<std::size_t>(last)};
+}
+
+Series SeriesPyramid::envelope(std::size_t k, double from, double to) const
+{
+    const Level &level = levels[k];
+    auto [first, last] = bucketRange(level, from, to);
+    Series result;
+    result.reserve(2 * (last - first));
+    for (std::size_t i = first; i < last; i++)
+    {
+        const Bucket &bucket = level.buckets[i];
+        if (!bucket.count)
+            continue;
+        double middle = level.bucketStart(i) + level.width / 2;
+        result.push_back(middle, bucket.min);
+        if (bucket.max != bucket.min)
+            result.push_back(middle, bucket.max);
+    }
+    return result;
+}
+
+Series SeriesPyramid::averages(std::size_t k, double from, double to) const
+{
+    const Level &level = levels[k];
+    auto [first, last] = bucketRange(level, from, to);
+    Series result;
+    result.reserve(last - first);
+    for (std::size_t i = first; i < last; i++)
+    {
+        const Bucket &bucket = level.buckets[i];
+        if (bucket.count)
+            result.push_back(level.bucketStart(i) + level.width / 2, bucket.avg());
+    }
+    return result;
+}
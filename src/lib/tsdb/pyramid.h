@@ -0,0 +1,145 @@
+/**
+ * @file pyramid.h
+ * @brief Многоуровневая пирамида агрегатов временного ряда.
+ *
+ * @details Содержит класс `SeriesPyramid`, который хранит минимумы, максимумы и средние ряда по корзинам
+ *          с шириной, удваивающейся от уровня к уровню. Позволяет масштабировать и сдвигать график
+ *          за O(пикселей), не перебирая исходные точки и не запрашивая данные заново.
+ */
+
+/**
+ * @addtogroup tsdb
+ * @{
+ */
+
+#ifndef TSDB_PYRAMID_H
+#define TSDB_PYRAMID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tsdb.h"
+
+/**
+ * @brief Пирамида min/max/avg агрегатов ряда.
+ *
+ * @details Уровень `k` делит ось времени на корзины ширины `base_width * 2^k`, выровненные от нуля эпохи,
+ *          поэтому корзина уровня `k` ровно покрывает две корзины уровня `k - 1`. Уровни строятся, пока
+ *          на уровне больше одной корзины.
+ *
+ *          Пирамида строится один раз после загрузки ряда (`build`) и дополняется при дописывании
+ *          новых точек (`append`): пересчитываются только корзины, затронутые новыми точками.
+ */
+class SeriesPyramid
+{
+public:
+    /**
+     * @brief Агрегат точек одной корзины.
+     */
+    struct Bucket
+    {
+        double min;
+        double max;
+        double sum;
+        std::uint32_t count; ///< 0 — в корзине нет точек
+
+        double avg() const { return sum / count; }
+    };
+
+    /**
+     * @brief Уровень пирамиды.
+     */
+    struct Level
+    {
+        double width;                ///< Ширина корзины в секундах
+        std::int64_t first;          ///< Номер первой корзины (`floor(timestamp / width)`)
+        std::vector<Bucket> buckets; ///< Корзины подряд, начиная с `first`, включая пустые
+
+        double bucketStart(std::size_t i) const { return (first + static_cast<std::int64_t>(i)) * width; }
+    };
+
+    /**
+     * @brief Построить пирамиду заново.
+     *
+     * @param series Упорядоченный по времени ряд
+     * @param base_width Ширина корзины нижнего уровня в секундах (больше 0)
+     */
+    void build(const Series &series, double base_width);
+
+    /**
+     * @brief Дополнить пирамиду точками ряда, которые новее уже учтённых.
+     *
+     * @details Более старые точки пропускаются, как в `Series::appendNewer`. До первого `build` ничего не делает.
+     *
+     * @param series Упорядоченный по времени ряд
+     */
+    void append(const Series &series);
+
+    /**
+     * @brief Удалить корзины, целиком лежащие левее `timestamp`.
+     *
+     * @details Корзина, частично покрывающая `timestamp`, сохраняется вместе с агрегатом удалённых точек:
+     *          при обрезке по левой границе графика она всё равно находится за его краем.
+     *
+     * @param timestamp Временная метка
+     */
+    void dropBefore(double timestamp);
+
+    /**
+     * @brief Удалить все уровни.
+     */
+    void clear();
+
+    bool empty() const { return levels.empty(); }
+    std::size_t levelCount() const { return levels.size(); }
+    const Level &level(std::size_t k) const { return levels[k]; }
+
+    /**
+     * @brief Выбрать уровень для отрисовки интервала.
+     *
+     * @details Выбирается самый грубый уровень, корзина которого не шире пикселя, — тогда на пиксель
+     *          приходится одна-две корзины.
+     *
+     * @param from Левая граница интервала
+     * @param to Правая граница интервала
+     * @param pixels Ширина графика в пикселях
+     * @return Номер уровня или -1, если даже нижний уровень грубее пикселя и нужно рисовать исходные точки
+     */
+    int levelFor(double from, double to, std::size_t pixels) const;
+
+    /**
+     * @brief Огибающая ряда на уровне: минимум и максимум каждой непустой корзины.
+     *
+     * @details Обе точки корзины ставятся в её середину, поэтому линейный график по результату рисует
+     *          вертикальный отрезок от минимума до максимума — выбросы не теряются. В результат попадает
+     *          по одной корзине слева и справа от интервала.
+     *
+     * @param k Номер уровня
+     * @param from Левая граница интервала
+     * @param to Правая граница интервала
+     * @return Ряд из не более чем двух точек на корзину
+     */
+    Series envelope(std::size_t k, double from, double to) const;
+
+    /**
+     * @brief Средние значения непустых корзин уровня в интервале (точка в середине корзины).
+     *
+     * @param k Номер уровня
+     * @param from Левая граница интервала
+     * @param to Правая граница интервала
+     * @return Ряд из одной точки на корзину
+     */
+    Series averages(std::size_t k, double from, double to) const;
+
+private:
+    std::pair<std::size_t, std::size_t> bucketRange(const Level &level, double from, double to) const;
+    void rebuildFrom(std::size_t k, std::int64_t child_from);
+
+    std::vector<Level> levels;
+    double last_timestamp = 0;
+};
+
+/** @} */
+
+#endif // TSDB_PYRAMID_H
@@ -0,0 +1,240 @@
+#ifndef TSDB_TESTS_HTTP_STUB_SERVER_H
+#define TSDB_TESTS_HTTP_STUB_SERVER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+using stub_socket_t = SOCKET;
+#define STUB_INVALID_SOCKET INVALID_SOCKET
+#define stub_close_socket closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using stub_socket_t = int;
+#define STUB_INVALID_SOCKET (-1)
+#define stub_close_socket close
+#endif
+
+/**
+ * Локальный HTTP/1.1 сервер-заглушка для тестов сетевого слоя.
+ *
+ * Слушает 127.0.0.1 на случайном порту, поддерживает keep-alive и считает принятые соединения
+ * и обработанные запросы. Ответ формирует переданный обработчик.
+ */
+class HttpStubServer
+{
+public:
+    struct Request
+    {
+        std::string method;
+        std::string path;
+        std::map<std::string, std::string> headers; ///< Имена заголовков в нижнем регистре
+        std::string body;
+    };
+
+    struct Response
+    {
+        int status = 200;
+        std::string body;
+        std::vector<std::pair<std::string, std::string>> headers;
+    };
+
+    using Handler = std::function<Response(const Request &)>;
+
+    explicit HttpStubServer(Handler handler) : handler(std::move(handler))
+    {
+#ifdef _WIN32
+        WSADATA wsa;
+        WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (listener == STUB_INVALID_SOCKET)
+            throw std::runtime_error("stub server: socket() failed");
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listener, 64) != 0)
+            throw std::runtime_error("stub server: bind/listen failed");
+
+        socklen_t len = sizeof(addr);
+        getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len);
+        port = ntohs(addr.sin_port);
+
+        acceptor = std::thread([this] { acceptLoop(); });
+    }
+
+    ~HttpStubServer()
+    {
+        stopping = true;
+        acceptor.join();
+        std::vector<std::thread> to_join;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            to_join.swap(workers);
+        }
+        for (auto &worker : to_join)
+            worker.join();
+        stub_close_socket(listener);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    std::string url() const { return "http://127.0.0.1:" + std::to_string(port); }
+
+    int connections() const { return accepted.load(); }
+    int requests() const { return served.load(); }
+
+private:
+    static bool waitReadable(stub_socket_t sock, int timeout_ms)
+    {
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(sock, &set);
+        timeval tv{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+        return select(static_cast<int>(sock) + 1, &set, nullptr, nullptr, &tv) > 0;
+    }
+
+    void acceptLoop()
+    {
+        while (!stopping)
+        {
+            if (!waitReadable(listener, 20))
+                continue;
+            stub_socket_t conn = accept(listener, nullptr, nullptr);
+            if (conn == STUB_INVALID_SOCKET)
+                continue;
+            accepted++;
+            std::lock_guard<std::mutex> lock(mutex);
+            workers.emplace_back([this, conn] { serve(conn); });
+        }
+    }
+
+    void serve(stub_socket_t conn)
+    {
+        std::string buffer;
+        char chunk[4096];
+        while (!stopping)
+        {
+            std::size_t header_end = buffer.find("\r\n\r\n");
+            if (header_end == std::string::npos)
+            {
+                if (!waitReadable(conn, 20))
+                    continue;
+                int n = recv(conn, chunk, sizeof(chunk), 0);
+                if (n <= 0)
+                    break;
+                buffer.append(chunk, n);
+                continue;
+            }
+
+            Request request = parseHead(buffer.substr(0, header_end));
+            std::size_t body_size = 0;
+            auto length = request.headers.find("content-length");
+            if (length != request.headers.end())
+                body_size = std::stoul(length->second);
+            while (buffer.size() < header_end + 4 + body_size && !stopping)
+            {
+                if (!waitReadable(conn, 20))
+                    continue;
+                int n = recv(conn, chunk, sizeof(chunk), 0);
+                if (n <= 0)
+                    break;
+                buffer.append(chunk, n);
+            }
+            if (buffer.size() < header_end + 4 + body_size)
+                break;
+            request.body = buffer.substr(header_end + 4, body_size);
+            buffer.erase(0, header_end + 4 + body_size);
+
+            Response response = handler(request);
+            served++;
+            std::string raw = "HTTP/1.1 " + std::to_string(response.status) + " OK\r\n";
+            for (const auto &header : response.headers)
+                raw += header.first + ": " + header.second + "\r\n";
+            raw += "Content-Length: " + std::to_string(response.body.size()) + "\r\n\r\n";
+            raw += response.body;
+            if (!sendAll(conn, raw))
+                break;
+            auto connection = request.headers.find("connection");
+            if (connection != request.headers.end() && connection->second == "close")
+                break;
+        }
+        stub_close_socket(conn);
+    }
+
+    static bool sendAll(stub_socket_t conn, const std::string &data)
+    {
+        std::size_t sent = 0;
+        while (sent < data.size())
+        {
+            int n = send(conn, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+            if (n <= 0)
+                return false;
+            sent += n;
+        }
+        return true;
+    }
+
+    static Request parseHead(const std::string &head)
+    {
+        Request request;
+        std::size_t line_end = head.find("\r\n");
+        std::string request_line = head.substr(0, line_end);
+        std::size_t sp1 = request_line.find(' ');
+        std::size_t sp2 = request_line.find(' ', sp1 + 1);
+        request.method = request_line.substr(0, sp1);
+        request.path = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+        std::size_t pos = line_end == std::string::npos ? head.size() : line_end + 2;
+        while (pos < head.size())
+        {
+            std::size_t end = head.find("\r\n", pos);
+            if (end == std::string::npos)
+                end = head.size();
+            std::string line = head.substr(pos, end - pos);
+            std::size_t colon = line.find(':');
+            if (colon != std::string::npos)
+            {
+                std::string name = line.substr(0, colon);
+                std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                std::size_t value_start = line.find_first_not_of(' ', colon + 1);
+                request.headers[name] = value_start == std::string::npos ? "" : line.substr(value_start);
+            }
+            pos = end + 2;
+        }
+        return request;
+    }
+
+    Handler handler;
+    stub_socket_t listener;
+    int port = 0;
+    std::atomic<bool> stopping{false};
+    std::atomic<int> accepted{0};
+    std::atomic<int> served{0};
+    std::thread acceptor;
+    std::mutex mutex;
+    std::vector<std::thread> workers;
+};
+
+#endif // TSDB_TESTS_HTTP_STUB_SERVER_H
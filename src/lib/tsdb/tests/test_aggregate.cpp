@@ -0,0 +1,188 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "doctest.h"
+#include "../aggregate.h"
+
+static Metric makeMetric(LabelSet labels, std::initializer_list<std::pair<double, double>> points)
+{
+    Metric metric;
+    metric.name = "requests";
+    metric.labels = std::move(labels);
+    for (auto [timestamp, value] : points)
+        metric.series.push_back(timestamp, value);
+    return metric;
+}
+
+static const Metric *findGroup(const std::vector<Metric> &metrics, const LabelSet &labels)
+{
+    auto it = std::find_if(metrics.begin(), metrics.end(), [&](const Metric &m) { return m.labels == labels; });
+    return it == metrics.end() ? nullptr : &*it;
+}
+
+TEST_SUITE("Test aggregation")
+{
+    TEST_CASE("Test alignSeries")
+    {
+        std::vector<Metric> metrics = {
+            makeMetric({{"instance", "a"}}, {{100, 1}, {115, 2}, {130, 3}}),
+            makeMetric({{"instance", "b"}}, {{114, 10}, {146, 20}}),
+        };
+        std::vector<SeriesRef> refs;
+        for (const auto &m : metrics)
+            refs.push_back({&m.labels, &m.series});
+
+        SeriesGrid grid = alignSeries(refs, 15);
+        CHECK(grid.start == 100);
+        CHECK(grid.steps == 4);
+        CHECK(grid.rows == 2);
+        CHECK(grid.timestamp(3) == 145);
+        CHECK(grid.row(0)[2] == 3);
+        CHECK(std::isnan(grid.row(0)[3]));
+        // Точки вне сетки округляются до ближайшего шага
+        CHECK(grid.row(1)[1] == 10);
+        CHECK(std::isnan(grid.row(1)[0]));
+        CHECK(grid.row(1)[3] == 20);
+
+        CHECK(alignSeries({}, 15).steps == 0);
+    }
+
+    TEST_CASE("Test aggregateSeries")
+    {
+        std::vector<Metric> metrics = {
+            makeMetric({{"instance", "a"}, {"job", "api"}}, {{0, 1}, {15, 2}, {30, 3}}),
+            makeMetric({{"instance", "b"}, {"job", "api"}}, {{0, 10}, {15, 20}}),
+            makeMetric({{"instance", "c"}, {"job", "db"}}, {{15, 100}, {30, 200}}),
+        };
+
+        SUBCASE("Все ряды в одной группе")
+        {
+            auto sum = aggregateSeries(metrics, Aggregation::Sum, 15);
+            REQUIRE(sum.size() == 1);
+            CHECK(sum[0].labels.empty());
+            CHECK(sum[0].name.empty());
+            CHECK(sum[0].series.timestamps == std::vector<double>{0, 15, 30});
+            CHECK(sum[0].series.values == std::vector<double>{11, 122, 203});
+
+            auto avg = aggregateSeries(metrics, Aggregation::Avg, 15);
+            CHECK(avg[0].series.values == std::vector<double>{5.5, 122.0 / 3, 101.5});
+            auto min = aggregateSeries(metrics, Aggregation::Min, 15);
+            CHECK(min[0].series.values == std::vector<double>{1, 2, 3});
+            auto max = aggregateSeries(metrics, Aggregation::Max, 15);
+            CHECK(max[0].series.values == std::vector<double>{10, 100, 200});
+            auto count = aggregateSeries(metrics, Aggregation::Count, 15);
+            CHECK(count[0].series.values == std::vector<double>{2, 3, 2});
+        }
+
+        SUBCASE("Группировка by и without")
+        {
+            auto byJob = aggregateSeries(metrics, Aggregation::Sum, 15, {{"job"}, false});
+            REQUIRE(byJob.size() == 2);
+            const Metric *api = findGroup(byJob, {{"job", "api"}});
+            const Metric *db = findGroup(byJob, {{"job", "db"}});
+            REQUIRE(api);
+            REQUIRE(db);
+            CHECK(api->series.values == std::vector<double>{11, 22, 3});
+            CHECK(db->series.timestamps == std::vector<double>{15, 30});
+
+            auto withoutInstance = aggregateSeries(metrics, Aggregation::Max, 15, {{"instance"}, true});
+            CHECK(withoutInstance.size() == 2);
+            CHECK(findGroup(withoutInstance, {{"job", "api"}}));
+
+            auto byInstance = aggregateSeries(metrics, Aggregation::Sum, 15, {{"instance"}, false});
+            CHECK(byInstance.size() == 3);
+        }
+
+        SUBCASE("Квантиль")
+        {
+            std::vector<Metric> many;
+            for (int i = 1; i <= 5; i++)
+                many.push_back(makeMetric({{"instance", std::to_string(i)}}, {{0, static_cast<double>(i * 10)}}));
+            CHECK(aggregateSeries(many, Aggregation::Quantile, 15, {}, 0.5)[0].series.values[0] == 30);
+            CHECK(aggregateSeries(many, Aggregation::Quantile, 15, {}, 0.9)[0].series.values[0] == doctest::Approx(46));
+            CHECK(aggregateSeries(many, Aggregation::Quantile, 15, {}, 1)[0].series.values[0] == 50);
+            CHECK(std::isinf(aggregateSeries(many, Aggregation::Quantile, 15, {}, 2)[0].series.values[0]));
+        }
+
+        SUBCASE("Пустой вход")
+        {
+            CHECK(aggregateSeries(std::vector<Metric>{}, Aggregation::Sum, 15).empty());
+            CHECK(aggregateSeries(metrics, Aggregation::Sum, 0).empty());
+        }
+    }
+
+    TEST_CASE("Test aggregateOverTime")
+    {
+        Series series;
+        unsigned state = 7;
+        for (int i = 0; i < 500; i++)
+        {
+            state = state * 1103515245u + 12345u;
+            // Неравномерные метки, как у сырых точек
+            series.push_back(i * 10.0 + (state >> 16) % 5, static_cast<double>((state >> 8) % 1000));
+        }
+        const double window = 60;
+
+        for (Aggregation op : {Aggregation::Sum, Aggregation::Avg, Aggregation::Min, Aggregation::Max, Aggregation::Count, Aggregation::Quantile})
+        {
+            Series result = aggregateOverTime(series, op, window, 0.75);
+            REQUIRE(result.size() == series.size());
+            CHECK(result.timestamps == series.timestamps);
+            for (std::size_t i = 0; i < series.size(); i++)
+            {
+                // Перебор окна `(t - window, t]` напрямую
+                std::vector<double> values;
+                for (std::size_t j = 0; j <= i; j++)
+                {
+                    if (series.timestamps[j] > series.timestamps[i] - window)
+                        values.push_back(series.values[j]);
+                }
+                double sum = 0;
+                for (double v : values)
+                    sum += v;
+                double expected = 0;
+                switch (op)
+                {
+                case Aggregation::Sum:
+                    expected = sum;
+                    break;
+                case Aggregation::Avg:
+                    expected = sum / values.size();
+                    break;
+                case Aggregation::Min:
+                    expected = *std::min_element(values.begin(), values.end());
+                    break;
+                case Aggregation::Max:
+                    expected = *std::max_element(values.begin(), values.end());
+                    break;
+                case Aggregation::Count:
+                    expected = static_cast<double>(values.size());
+                    break;
+                case Aggregation::Quantile:
+                    expected = quantileOf(values, 0.75);
+                    break;
+                }
+                REQUIRE(result.values[i] == doctest::Approx(expected));
+            }
+        }
+
+        CHECK(aggregateOverTime(Series(), Aggregation::Sum, window).empty());
+    }
+
+    TEST_CASE("Test quantileOf")
+    {
+        std::vector<double> values = {4, 1, 3, 2};
+        CHECK(quantileOf(values, 0) == 1);
+        values = {4, 1, 3, 2};
+        CHECK(quantileOf(values, 0.5) == doctest::Approx(2.5));
+        values = {4, 1, 3, 2};
+        CHECK(quantileOf(values, 1) == 4);
+        values = {4, 1, 3, 2};
+        CHECK(quantileOf(values, -1) == -std::numeric_limits<double>::infinity());
+        std::vector<double> empty;
+        CHECK(std::isnan(quantileOf(empty, 0.5)));
+    }
+}
@@ -0,0 +1,94 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <algorithm>
+#include <cmath>
+
+#include "doctest.h"
+#include "../downsample.h"
+
+static Series makeSine(std::size_t n)
+{
+    Series series;
+    for (std::size_t i = 0; i < n; i++)
+        series.push_back(1000.0 + i, std::sin(i * 0.01));
+    return series;
+}
+
+static bool isSorted(const Series &series)
+{
+    return std::is_sorted(series.timestamps.begin(), series.timestamps.end()) && series.timestamps.size() == series.values.size();
+}
+
+TEST_SUITE("Test downsampling")
+{
+    TEST_CASE("Test visibleRange")
+    {
+        Series series = makeSine(100);
+
+        SUBCASE("Внутри ряда")
+        {
+            auto [first, last] = visibleRange(series, 1010, 1020);
+            CHECK(first == 9);
+            CHECK(last == 22);
+        }
+
+        SUBCASE("Вне ряда")
+        {
+            auto left = visibleRange(series, 0, 10);
+            CHECK(left.first == 0);
+            CHECK(left.second == 1);
+            auto right = visibleRange(series, 5000, 6000);
+            CHECK(right.first == 99);
+            CHECK(right.second == 100);
+        }
+    }
+
+    TEST_CASE("Test downsampleM4")
+    {
+        Series series = makeSine(100'000);
+        series.values[54'321] = 100;  // выброс вверх
+        series.values[77'777] = -100; // выброс вниз
+
+        SUBCASE("Сохраняет экстремумы и границы")
+        {
+            Series reduced = downsampleM4(series, 1000, 1000 + 99'999, 500);
+            CHECK(reduced.size() <= 4 * 500 + 2);
+            CHECK(reduced.size() >= 500);
+            CHECK(isSorted(reduced));
+            CHECK(reduced.timestamps.front() == 1000);
+            CHECK(reduced.timestamps.back() == 1000 + 99'999);
+            CHECK(*std::max_element(reduced.values.begin(), reduced.values.end()) == 100);
+            CHECK(*std::min_element(reduced.values.begin(), reduced.values.end()) == -100);
+        }
+
+        SUBCASE("Видимый интервал и соседние точки")
+        {
+            Series reduced = downsampleM4(series, 20'000, 30'000, 100);
+            CHECK(isSorted(reduced));
+            CHECK(reduced.timestamps.front() == 19'999);
+            CHECK(reduced.timestamps.back() == 30'001);
+        }
+
+        SUBCASE("Мало точек — без изменений")
+        {
+            Series small = makeSine(50);
+            Series reduced = downsampleM4(small, 0, 1e9, 100);
+            CHECK(reduced.timestamps == small.timestamps);
+        }
+    }
+
+    TEST_CASE("Test downsampleLTTB")
+    {
+        Series series = makeSine(10'000);
+        series.values[4'242] = 50;
+
+        Series reduced = downsampleLTTB(series, 300);
+        CHECK(reduced.size() == 300);
+        CHECK(isSorted(reduced));
+        CHECK(reduced.timestamps.front() == series.timestamps.front());
+        CHECK(reduced.timestamps.back() == series.timestamps.back());
+        CHECK(*std::max_element(reduced.values.begin(), reduced.values.end()) == 50);
+
+        CHECK(downsampleLTTB(series, 20'000).size() == series.size());
+    }
+}
@@ -0,0 +1,116 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "doctest.h"
+#include "../labels.h"
+
+TEST_SUITE("Test labels")
+{
+    TEST_CASE("Test Symbol")
+    {
+        SUBCASE("Интернирование")
+        {
+            std::string text = "instance";
+            Symbol a(text), b("instance"), c("job");
+            CHECK(a == b);
+            CHECK(&a.str() == &b.str());
+            CHECK(a != c);
+            CHECK(a == "instance");
+            CHECK(a == text);
+            CHECK(a.hash() == b.hash());
+        }
+
+        SUBCASE("Пустая строка")
+        {
+            Symbol empty, also_empty("");
+            CHECK(empty == also_empty);
+            CHECK(empty.empty());
+        }
+
+        SUBCASE("Повторное интернирование не растит таблицу")
+        {
+            Symbol first("test_symbol_unique_value");
+            std::size_t size = Symbol::tableSize();
+            Symbol second(std::string("test_symbol_unique_") + "value");
+            CHECK(Symbol::tableSize() == size);
+            CHECK(first == second);
+        }
+
+        SUBCASE("Несколько потоков")
+        {
+            std::vector<std::vector<Symbol>> symbols(4);
+            std::vector<std::thread> threads;
+            for (auto &out : symbols)
+            {
+                threads.emplace_back([&out]
+                                     {
+                                         for (int i = 0; i < 1000; i++)
+                                             out.emplace_back("thread-value-" + std::to_string(i));
+                                     });
+            }
+            for (auto &thread : threads)
+                thread.join();
+            for (int i = 0; i < 1000; i++)
+            {
+                REQUIRE(symbols[0][i] == symbols[1][i]);
+                REQUIRE(symbols[0][i] == symbols[2][i]);
+                REQUIRE(symbols[0][i] == symbols[3][i]);
+                REQUIRE(symbols[0][i] == "thread-value-" + std::to_string(i));
+            }
+        }
+    }
+
+    TEST_CASE("Test LabelSet")
+    {
+        SUBCASE("Сортировка и поиск")
+        {
+            LabelSet labels{{"job", "node"}, {"instance", "a:9100"}, {"cpu", "0"}};
+            REQUIRE(labels.size() == 3);
+            std::vector<std::string> names;
+            for (const auto &label : labels)
+                names.push_back(label.first);
+            CHECK(names == std::vector<std::string>{"cpu", "instance", "job"});
+            CHECK(labels["job"] == "node");
+            CHECK(labels["missing"].empty());
+            CHECK(labels.at("instance") == "a:9100");
+            CHECK_THROWS_AS(labels.at("missing"), std::out_of_range);
+            CHECK(labels.contains("cpu"));
+            CHECK_FALSE(labels.contains("mode"));
+        }
+
+        SUBCASE("Повтор имени")
+        {
+            LabelSet labels{{"job", "a"}, {"instance", "x"}, {"job", "b"}};
+            CHECK(labels.size() == 2);
+            CHECK(labels["job"] == "b");
+        }
+
+        SUBCASE("Равенство не зависит от порядка")
+        {
+            LabelSet a{{"job", "node"}, {"instance", "a:9100"}};
+            LabelSet b{{"instance", "a:9100"}, {"job", "node"}};
+            LabelSet c{{"instance", "b:9100"}, {"job", "node"}};
+            CHECK(a == b);
+            CHECK(a.hash() == b.hash());
+            CHECK(a != c);
+            CHECK(LabelSet() == LabelSet());
+            CHECK(LabelSet() != a);
+        }
+
+        SUBCASE("SeriesKey в хэш-таблице")
+        {
+            std::unordered_map<SeriesKey, int, SeriesKeyHash> index;
+            index[{"up", LabelSet{{"job", "a"}}}] = 1;
+            index[{"up", LabelSet{{"job", "b"}}}] = 2;
+            index[{"down", LabelSet{{"job", "a"}}}] = 3;
+            CHECK(index.size() == 3);
+            CHECK(index.at({"up", LabelSet{{"job", "b"}}}) == 2);
+            CHECK(index.count({"up", LabelSet{}}) == 0);
+        }
+    }
+}
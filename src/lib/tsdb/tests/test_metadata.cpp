@@ -0,0 +1,199 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "doctest.h"
+#include "../metadata.h"
+#include "../prefix_index.h"
+
+static std::vector<std::string> strings(const std::vector<std::string_view> &views)
+{
+    return {views.begin(), views.end()};
+}
+
+/**
+ * Клиент с метаданными без точек. Запоминает запросы; `values[label]` — значения для запросов без
+ * ограничения интервала, `recent[label]` — для запросов за интервал.
+ */
+class MetadataClient : public TSDBClient
+{
+public:
+    std::vector<Metric> query(const std::string &, std::time_t, std::time_t) override { return {}; }
+    std::vector<Metric> query(const std::string &, std::time_t, std::time_t, int) override { return {}; }
+    bool isAvailable() noexcept override { return true; }
+
+    std::vector<std::string> labelNames(std::time_t start, std::time_t end) override { return labelValues("", start, end); }
+
+    std::vector<std::string> labelValues(const std::string &label, std::time_t start, std::time_t end) override
+    {
+        requests.emplace_back(label, start, end);
+        if (fail)
+            throw std::runtime_error("unavailable");
+        return start == 0 && end == 0 ? values[label] : recent[label];
+    }
+
+    std::map<std::string, std::vector<std::string>> values, recent;
+    std::vector<std::tuple<std::string, std::time_t, std::time_t>> requests;
+    bool fail = false;
+};
+
+class TestMetadataIndex : public MetadataIndex
+{
+public:
+    using MetadataIndex::MetadataIndex;
+
+    std::time_t current = 10000;
+
+protected:
+    std::time_t now() const override { return current; }
+};
+
+TEST_SUITE("Test metadata")
+{
+    TEST_CASE("Test PrefixIndex")
+    {
+        PrefixIndex index({"node_load1", "up", "http_requests_total", "node_cpu_seconds_total", "http_server_errors", "up"});
+        REQUIRE(index.size() == 5);
+        CHECK(index[0] == "http_requests_total");
+        CHECK(index.contains("up"));
+        CHECK_FALSE(index.contains("u"));
+
+        SUBCASE("Поиск по префиксу")
+        {
+            CHECK(strings(index.findPrefix("node_", 10)) == std::vector<std::string>{"node_cpu_seconds_total", "node_load1"});
+            CHECK(strings(index.findPrefix("node_", 1)) == std::vector<std::string>{"node_cpu_seconds_total"});
+            CHECK(index.findPrefix("zzz", 10).empty());
+            CHECK(index.findPrefix("", 10).size() == 5);
+        }
+
+        SUBCASE("Нечёткий поиск")
+        {
+            auto found = strings(index.findFuzzy("HTTPreq", 10));
+            REQUIRE(!found.empty());
+            CHECK(found[0] == "http_requests_total");
+            CHECK(strings(index.findFuzzy("ncst", 10)) == std::vector<std::string>{"node_cpu_seconds_total"});
+            CHECK(index.findFuzzy("xyz", 10).empty());
+            CHECK(index.findFuzzy("", 10).empty());
+        }
+
+        SUBCASE("Слияние")
+        {
+            PrefixIndex merged = index.merged({"a_metric", "up", "zz", "a_metric"});
+            CHECK(merged.size() == 7);
+            CHECK(merged[0] == "a_metric");
+            CHECK(merged[6] == "zz");
+            CHECK(merged.contains("node_load1"));
+            CHECK(index.size() == 5);
+        }
+    }
+
+    TEST_CASE("Test completionContext")
+    {
+        using Kind = CompletionContext::Kind;
+
+        auto metric = completionContext("rate(http_re");
+        CHECK(metric.kind == Kind::MetricName);
+        CHECK(metric.prefix == "http_re");
+        CHECK(metric.start == 5);
+
+        auto label = completionContext("up{job=\"a\", ins");
+        CHECK(label.kind == Kind::LabelName);
+        CHECK(label.prefix == "ins");
+
+        auto value = completionContext("up{job!=\"a\", instance=~\"host");
+        CHECK(value.kind == Kind::LabelValue);
+        CHECK(value.label == "instance");
+        CHECK(value.prefix == "host");
+        CHECK(value.start == 24);
+
+        auto grouping = completionContext("sum by (job, ");
+        CHECK(grouping.kind == Kind::LabelName);
+        CHECK(grouping.prefix.empty());
+
+        CHECK(completionContext("rate(up[5").kind == Kind::None);
+        CHECK(completionContext("up > 10").kind == Kind::None);
+        CHECK(completionContext("up{job=").kind == Kind::None);
+        CHECK(completionContext("up{job=\"a\"} + node").kind == Kind::MetricName);
+        CHECK(completionContext("sum by (job) (rate(no").kind == Kind::MetricName);
+    }
+
+    TEST_CASE("Test MetadataIndex")
+    {
+        auto client = std::make_shared<MetadataClient>();
+        client->values["__name__"] = {"up", "node_load1", "http_requests_total"};
+        client->values[""] = {"__name__", "job", "instance"};
+        client->values["job"] = {"node", "prometheus"};
+        TestMetadataIndex index(client);
+
+        index.refresh(false);
+        REQUIRE(client->requests.size() == 2);
+        CHECK(client->requests[0] == std::make_tuple(std::string("__name__"), std::time_t(0), std::time_t(0)));
+        CHECK(index.metricNames()->size() == 3);
+        CHECK(index.labelNames()->contains("job"));
+        CHECK(index.getStats().full_refreshes == 1);
+
+        SUBCASE("Подсказки: сначала префикс, затем нечёткие совпадения")
+        {
+            CompletionContext context = completionContext("u");
+            CHECK(index.suggest(context, 10) == std::vector<std::string>{"up", "http_requests_total"});
+            CHECK(index.suggest(context, 1) == std::vector<std::string>{"up"});
+            CHECK(index.suggest(completionContext("up > 1"), 10).empty());
+        }
+
+        SUBCASE("Значения метки загружаются при первом обращении")
+        {
+            CHECK(index.labelValues("job") == nullptr);
+            CHECK(index.suggest(completionContext("up{job=\"pro"), 10).empty());
+            client->requests.clear();
+            index.refresh(false);
+            CHECK(client->requests[0] == std::make_tuple(std::string("job"), std::time_t(0), std::time_t(0)));
+            REQUIRE(index.labelValues("job") != nullptr);
+            CHECK(index.suggest(completionContext("up{job=\"pro"), 10) == std::vector<std::string>{"prometheus"});
+        }
+
+        SUBCASE("Инкрементальное обновление запрашивает только недавние ряды и сливает их")
+        {
+            index.labelValues("job");
+            index.refresh(false);
+            client->recent["__name__"] = {"new_metric", "up"};
+            client->recent["job"] = {"worker"};
+            client->requests.clear();
+            auto before = index.metricNames();
+            index.current = 10060;
+
+            index.refresh(false);
+            REQUIRE(client->requests.size() == 3);
+            for (const auto &[label, start, end] : client->requests)
+            {
+                CHECK(start == 10000 - MetadataIndex::REFRESH_OVERLAP);
+                CHECK(end == 10060);
+            }
+            CHECK(index.metricNames()->size() == 4);
+            CHECK(index.metricNames()->contains("new_metric"));
+            CHECK(index.labelValues("job")->size() == 3);
+            CHECK(index.labelNames()->size() == 3);
+            CHECK(before->size() == 3); // Выданный ранее индекс не меняется
+            CHECK(index.getStats().incremental_refreshes == 2);
+        }
+
+        SUBCASE("Полное обновление убирает пропавшие имена")
+        {
+            client->values["__name__"] = {"up"};
+            index.refresh(true);
+            CHECK(index.metricNames()->size() == 1);
+            CHECK(index.getStats().full_refreshes == 2);
+        }
+
+        SUBCASE("Ошибка обновления сохраняет индекс")
+        {
+            client->fail = true;
+            index.refresh(false);
+            CHECK(index.metricNames()->size() == 3);
+            CHECK(index.getStats().errors == 1);
+        }
+    }
+}
@@ -0,0 +1,175 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <algorithm>
+#include <cmath>
+
+#include "doctest.h"
+#include "../pyramid.h"
+
+static Series makeSeries(double start, std::size_t n, double step)
+{
+    Series series;
+    for (std::size_t i = 0; i < n; i++)
+        series.push_back(start + i * step, std::sin(i * 0.1) + (i % 37 == 0 ? 10 : 0));
+    return series;
+}
+
+/**
+ * Проверить каждую корзину каждого уровня перебором исходных точек.
+ */
+static void checkAgainstSeries(const SeriesPyramid &pyramid, const Series &series)
+{
+    for (std::size_t k = 0; k < pyramid.levelCount(); k++)
+    {
+        const SeriesPyramid::Level &level = pyramid.level(k);
+        for (std::size_t i = 0; i < level.buckets.size(); i++)
+        {
+            double start = level.bucketStart(i), end = start + level.width;
+            SeriesPyramid::Bucket expected = {HUGE_VAL, -HUGE_VAL, 0, 0};
+            for (std::size_t p = 0; p < series.size(); p++)
+            {
+                if (series.timestamps[p] < start || series.timestamps[p] >= end)
+                    continue;
+                expected.min = std::min(expected.min, series.values[p]);
+                expected.max = std::max(expected.max, series.values[p]);
+                expected.sum += series.values[p];
+                expected.count++;
+            }
+            const SeriesPyramid::Bucket &bucket = level.buckets[i];
+            REQUIRE(bucket.count == expected.count);
+            if (expected.count)
+            {
+                CHECK(bucket.min == expected.min);
+                CHECK(bucket.max == expected.max);
+                CHECK(bucket.sum == doctest::Approx(expected.sum));
+            }
+        }
+    }
+}
+
+TEST_SUITE("Test SeriesPyramid")
+{
+    TEST_CASE("Test build")
+    {
+        SUBCASE("Уровни")
+        {
+            Series series = makeSeries(1000, 100, 15);
+            SeriesPyramid pyramid;
+            pyramid.build(series, 60);
+            REQUIRE(pyramid.levelCount() > 1);
+            CHECK(pyramid.level(0).width == 60);
+            CHECK(pyramid.level(1).width == 120);
+            CHECK(pyramid.level(pyramid.levelCount() - 1).buckets.size() == 1);
+            CHECK(pyramid.level(pyramid.levelCount() - 2).buckets.size() > 1);
+            checkAgainstSeries(pyramid, series);
+        }
+
+        SUBCASE("Пустой ряд и одна точка")
+        {
+            SeriesPyramid pyramid;
+            pyramid.build(Series(), 60);
+            CHECK(pyramid.levelCount() == 1);
+            CHECK(pyramid.level(0).buckets.empty());
+
+            Series single;
+            single.push_back(1000, 5);
+            pyramid.build(single, 60);
+            CHECK(pyramid.levelCount() == 1);
+            CHECK(pyramid.level(0).buckets.size() == 1);
+            CHECK(pyramid.level(0).buckets[0].avg() == 5);
+        }
+
+        SUBCASE("Пропуски в данных")
+        {
+            Series series = makeSeries(1000, 10, 15);
+            series.appendNewer(makeSeries(100000, 10, 15));
+            SeriesPyramid pyramid;
+            pyramid.build(series, 30);
+            checkAgainstSeries(pyramid, series);
+        }
+    }
+
+    TEST_CASE("Test append")
+    {
+        Series series = makeSeries(1000, 500, 15);
+        SeriesPyramid incremental;
+        incremental.build(series.slice(0, 1000 + 99 * 15), 60);
+        for (std::size_t start = 100; start < series.size(); start += 73)
+        {
+            // Хвост с перекрытием: уже учтённые точки пропускаются
+            incremental.append(series.slice(series.timestamps[start - 5], series.timestamps[std::min(start + 72, series.size() - 1)]));
+        }
+
+        SeriesPyramid full;
+        full.build(series, 60);
+        REQUIRE(incremental.levelCount() == full.levelCount());
+        checkAgainstSeries(incremental, series);
+    }
+
+    TEST_CASE("Test dropBefore")
+    {
+        Series series = makeSeries(1000, 500, 15);
+        SeriesPyramid pyramid;
+        pyramid.build(series, 60);
+
+        SUBCASE("По границе корзины нижнего уровня")
+        {
+            pyramid.dropBefore(3000);
+            series.dropBefore(3000);
+            CHECK(pyramid.level(0).bucketStart(0) == 3000);
+            checkAgainstSeries(pyramid, series);
+
+            pyramid.append(makeSeries(1000 + 500 * 15, 100, 15));
+            series.appendNewer(makeSeries(1000 + 500 * 15, 100, 15));
+            checkAgainstSeries(pyramid, series);
+        }
+
+        SUBCASE("Всё")
+        {
+            pyramid.dropBefore(1e9);
+            CHECK(pyramid.level(0).buckets.empty());
+            pyramid.append(makeSeries(2e9, 10, 15));
+            checkAgainstSeries(pyramid, makeSeries(2e9, 10, 15));
+        }
+    }
+
+    TEST_CASE("Test levelFor and envelope")
+    {
+        Series series = makeSeries(0, 10000, 15);
+        SeriesPyramid pyramid;
+        pyramid.build(series, 60);
+
+        SUBCASE("Выбор уровня")
+        {
+            // 150000 секунд на 1000 пикселей: пиксель 150 секунд, подходит корзина 120 секунд
+            CHECK(pyramid.levelFor(0, 150000, 1000) == 1);
+            // Пиксель 15 секунд — уже мельче нижнего уровня
+            CHECK(pyramid.levelFor(0, 15000, 1000) == -1);
+            CHECK(pyramid.levelFor(0, 150000, 0) == -1);
+        }
+
+        SUBCASE("Огибающая сохраняет выбросы")
+        {
+            int k = pyramid.levelFor(0, 150000, 100);
+            REQUIRE(k > 0);
+            Series envelope = pyramid.envelope(k, 0, 150000);
+            CHECK(envelope.size() <= 2 * (pyramid.level(k).buckets.size()));
+            CHECK(*std::max_element(envelope.values.begin(), envelope.values.end()) == *std::max_element(series.values.begin(), series.values.end()));
+            CHECK(*std::min_element(envelope.values.begin(), envelope.values.end()) == *std::min_element(series.values.begin(), series.values.end()));
+            CHECK(std::is_sorted(envelope.timestamps.begin(), envelope.timestamps.end()));
+
+            Series averages = pyramid.averages(k, 0, 150000);
+            CHECK(averages.size() == pyramid.level(k).buckets.size());
+        }
+
+        SUBCASE("Часть интервала")
+        {
+            const SeriesPyramid::Level &level = pyramid.level(2);
+            Series averages = pyramid.averages(2, 24000, 48000);
+            // Корзины по 240 секунд: 101 пересекает интервал (последняя начинается на его правой границе)
+            // и по одной соседней с каждой стороны
+            CHECK(averages.size() == 103);
+            CHECK(averages.timestamps.front() == 24000 - level.width / 2);
+        }
+    }
+}
@@ -0,0 +1,360 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+#include "http_stub_server.h"
+#include "../tsdb.h"
+
+/**
+ * Клиент без собственной логики запросов: открывает доступ к HTTP-слою `TSDBClient`.
+ */
+class HttpTestClient : public TSDBClient
+{
+public:
+    std::vector<Metric> query(const std::string &, std::time_t, std::time_t) override { return {}; }
+    std::vector<Metric> query(const std::string &, std::time_t, std::time_t, int) override { return {}; }
+    bool isAvailable() noexcept override { return true; }
+
+    std::string get(const std::string &url, int timeout = 5) { return performHttpRequest(url, timeout); }
+
+    void stream(const std::string &url, const std::function<void(const char *, std::size_t)> &sink) { streamHttpRequest(url, sink); }
+
+    using TSDBClient::HttpStream;
+
+    std::vector<std::exception_ptr> batch(const std::vector<HttpStream> &requests, int timeout = 5)
+    {
+        return streamHttpRequests(requests, timeout);
+    }
+};
+
+/**
+ * Прочитать файл из каталога фикстур целиком.
+ */
+static std::string readFixture(const std::string &name)
+{
+    std::ifstream file(std::string(FIXTURES_DIR) + "/" + name, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Failed to open fixture " + name);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+TEST_SUITE("Test TSDBClient")
+{
+    TEST_CASE("Test format_line_name")
+    {
+        SUBCASE("Без меток")
+        {
+            CHECK(TSDBClient::format_line_name("up", {}) == "up");
+        }
+
+        SUBCASE("С метками")
+        {
+            CHECK(TSDBClient::format_line_name("up", {{"job", "node"}, {"instance", "a:9100"}}) == "up[instance=a:9100;job=node]");
+        }
+    }
+
+    TEST_CASE("Test Series")
+    {
+        Series series;
+        for (int t = 0; t < 5; t++)
+            series.push_back(100 + t * 15, t);
+
+        SUBCASE("appendNewer пропускает пересечение")
+        {
+            Series tail;
+            tail.push_back(160, 40);
+            tail.push_back(175, 5);
+            tail.push_back(190, 6);
+            series.appendNewer(tail);
+            CHECK(series.size() == 7);
+            CHECK(series.timestamps.back() == 190);
+            CHECK(series.values[4] == 4);
+            CHECK(series.values[5] == 5);
+            CHECK(series.values.size() == series.timestamps.size());
+        }
+
+        SUBCASE("appendNewer в пустой ряд")
+        {
+            Series empty;
+            empty.appendNewer(series);
+            CHECK(empty.size() == 5);
+        }
+
+        SUBCASE("merge")
+        {
+            Series other;
+            other.push_back(90, -1);
+            other.push_back(115, 10);
+            other.push_back(120, 11);
+            other.push_back(200, 12);
+            series.merge(other);
+            std::vector<double> expected_ts = {90, 100, 115, 120, 130, 145, 160, 200};
+            std::vector<double> expected_values = {-1, 0, 10, 11, 2, 3, 4, 12};
+            CHECK(series.timestamps == expected_ts);
+            CHECK(series.values == expected_values);
+
+            Series tail;
+            tail.push_back(300, 1);
+            series.merge(tail);
+            CHECK(series.timestamps.back() == 300);
+            CHECK(series.size() == 9);
+        }
+
+        SUBCASE("slice")
+        {
+            Series part = series.slice(110, 145);
+            CHECK(part.size() == 3);
+            CHECK(part.timestamps.front() == 115);
+            CHECK(part.values.back() == 3);
+            CHECK(series.slice(0, 50).empty());
+        }
+
+        SUBCASE("dropBefore")
+        {
+            series.dropBefore(130);
+            CHECK(series.size() == 3);
+            CHECK(series.timestamps.front() == 130);
+            CHECK(series.values.front() == 2);
+            series.dropBefore(1000);
+            CHECK(series.empty());
+        }
+    }
+
+    TEST_CASE("Test performHttpRequest")
+    {
+        HttpStubServer server([](const HttpStubServer::Request &request) {
+            HttpStubServer::Response response;
+            response.body = "echo " + request.path;
+            return response;
+        });
+        HttpTestClient client;
+
+        SUBCASE("Переиспользование соединения")
+        {
+            for (int i = 0; i < 5; i++)
+                CHECK(client.get(server.url() + "/r" + std::to_string(i)) == "echo /r" + std::to_string(i));
+            CHECK(server.requests() == 5);
+            CHECK(server.connections() == 1);
+        }
+
+        SUBCASE("Параллельные запросы")
+        {
+            const int THREADS = 4, REQUESTS = 10;
+            std::vector<std::thread> threads;
+            std::vector<int> ok(THREADS, 0);
+            for (int t = 0; t < THREADS; t++)
+            {
+                threads.emplace_back([&, t] {
+                    for (int i = 0; i < REQUESTS; i++)
+                        ok[t] += client.get(server.url() + "/p") == "echo /p";
+                });
+            }
+            for (auto &thread : threads)
+                thread.join();
+            for (int t = 0; t < THREADS; t++)
+                CHECK(ok[t] == REQUESTS);
+            CHECK(server.requests() == THREADS * REQUESTS);
+            // Каждый поток держит не больше одного соединения одновременно
+            CHECK(server.connections() <= THREADS);
+        }
+
+        SUBCASE("Ошибка соединения")
+        {
+            HttpTestClient other;
+            CHECK_THROWS_AS(other.get("http://127.0.0.1:1/", 1), std::runtime_error);
+        }
+    }
+
+    TEST_CASE("Test compressed responses")
+    {
+        const std::string plain = readFixture("query_range.json");
+        const std::string gzip = readFixture("query_range.json.gz");
+        const std::string deflate = readFixture("query_range.json.deflate");
+        std::string accept_encoding;
+        HttpStubServer server([&](const HttpStubServer::Request &request) {
+            auto header = request.headers.find("accept-encoding");
+            accept_encoding = header == request.headers.end() ? "" : header->second;
+            HttpStubServer::Response response;
+            if (request.path == "/gzip")
+            {
+                response.body = gzip;
+                response.headers.push_back({"Content-Encoding", "gzip"});
+            }
+            else if (request.path == "/deflate")
+            {
+                response.body = deflate;
+                response.headers.push_back({"Content-Encoding", "deflate"});
+            }
+            else
+                response.body = plain;
+            return response;
+        });
+        HttpTestClient client;
+
+        SUBCASE("Клиент предлагает сжатие")
+        {
+            // Сборка libcurl без zlib должна проваливать тест, а не молча отключать сжатие
+            REQUIRE(TSDBClient::compressionSupported());
+            client.get(server.url() + "/plain");
+            CHECK(accept_encoding.find("gzip") != std::string::npos);
+            CHECK(accept_encoding.find("deflate") != std::string::npos);
+        }
+
+        SUBCASE("gzip распаковывается")
+        {
+            CHECK(client.get(server.url() + "/gzip") == plain);
+        }
+
+        SUBCASE("deflate распаковывается")
+        {
+            CHECK(client.get(server.url() + "/deflate") == plain);
+        }
+
+        SUBCASE("Потоковая передача")
+        {
+            std::string received;
+            int chunks = 0;
+            client.stream(server.url() + "/gzip", [&](const char *data, std::size_t size) {
+                received.append(data, size);
+                chunks++;
+            });
+            CHECK(received == plain);
+            CHECK(chunks > 1);
+        }
+
+        SUBCASE("Исключение получателя прерывает передачу")
+        {
+            CHECK_THROWS_AS(client.stream(server.url() + "/gzip", [](const char *, std::size_t) { throw std::logic_error("stop"); }),
+                            std::logic_error);
+            // Соединение после прерванной передачи остаётся рабочим
+            CHECK(client.get(server.url() + "/plain") == plain);
+        }
+
+        SUBCASE("Счётчики передачи")
+        {
+            CHECK(client.getTransferStats().requests == 0);
+            client.get(server.url() + "/plain");
+            client.stream(server.url() + "/gzip", [](const char *, std::size_t) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+
+            TSDBClient::TransferStats stats = client.getTransferStats();
+            CHECK(stats.requests == 2);
+            CHECK(stats.bytes == 2 * plain.size()); // Считаются распакованные байты
+            CHECK(stats.sink_seconds >= 0.001);
+        }
+    }
+
+    TEST_CASE("Test streamHttpRequests")
+    {
+        const int DELAY_MS = 600, REQUESTS = 6;
+        HttpStubServer server([&](const HttpStubServer::Request &request) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(DELAY_MS));
+            HttpStubServer::Response response;
+            if (request.path == "/fail")
+            {
+                response.status = 500;
+                response.body = "internal error";
+            }
+            else
+                response.body = request.method + " " + request.path + " " + request.body;
+            return response;
+        });
+        HttpTestClient client;
+
+        std::vector<std::string> bodies(REQUESTS);
+        std::vector<HttpTestClient::HttpStream> requests(REQUESTS);
+        for (int i = 0; i < REQUESTS; i++)
+        {
+            requests[i].url = server.url() + "/b" + std::to_string(i);
+            requests[i].sink = [&bodies, i](const char *data, std::size_t size) { bodies[i].append(data, size); };
+        }
+
+        SUBCASE("Запросы выполняются одновременно")
+        {
+            auto started = std::chrono::steady_clock::now();
+            std::vector<std::exception_ptr> errors = client.batch(requests);
+            auto elapsed = std::chrono::steady_clock::now() - started;
+
+            REQUIRE(errors.size() == REQUESTS);
+            for (int i = 0; i < REQUESTS; i++)
+            {
+                CHECK_FALSE(errors[i]);
+                CHECK(bodies[i] == "GET /b" + std::to_string(i) + " ");
+            }
+            // По очереди запросы заняли бы REQUESTS * DELAY_MS
+            CHECK(elapsed < std::chrono::milliseconds(REQUESTS * DELAY_MS / 2));
+
+            // Соединения мульти-хэндла переиспользуются следующим пакетом
+            int connections = server.connections();
+            for (auto &body : bodies)
+                body.clear();
+            client.batch(requests);
+            CHECK(bodies[REQUESTS - 1] == "GET /b" + std::to_string(REQUESTS - 1) + " ");
+            CHECK(server.connections() == connections);
+        }
+
+        SUBCASE("POST и ошибки отдельных запросов")
+        {
+            requests[0].post = true;
+            requests[0].body = "payload";
+            requests[0].headers.push_back("Content-Type: text/plain");
+            requests[1].post = true;
+            requests[1].url = server.url() + "/fail";
+            requests[2].url = "http://127.0.0.1:1/";
+            requests[3].sink = [](const char *, std::size_t) { throw std::logic_error("stop"); };
+
+            std::vector<std::exception_ptr> errors = client.batch(requests, 2);
+            CHECK_FALSE(errors[0]);
+            CHECK(bodies[0] == "POST /b0 payload");
+            // POST с HTTP-статусом ошибки ведёт себя как streamHttpPost
+            REQUIRE(errors[1]);
+            CHECK_THROWS_WITH_AS(std::rethrow_exception(errors[1]), doctest::Contains("status 500"), std::runtime_error);
+            CHECK(bodies[1].empty());
+            REQUIRE(errors[2]);
+            CHECK_THROWS_AS(std::rethrow_exception(errors[2]), std::runtime_error);
+            REQUIRE(errors[3]);
+            CHECK_THROWS_AS(std::rethrow_exception(errors[3]), std::logic_error);
+            for (int i = 4; i < REQUESTS; i++)
+            {
+                CHECK_FALSE(errors[i]);
+                CHECK(bodies[i] == "GET /b" + std::to_string(i) + " ");
+            }
+        }
+
+        SUBCASE("Передачи сверх одновременных не тратят таймаут в очереди")
+        {
+            // Больше, чем 32 одновременные передачи: последние начинаются через DELAY_MS и без ограничения
+            // завершились бы после таймаута в 1 с
+            const int MANY = 40;
+            std::vector<std::string> many_bodies(MANY);
+            std::vector<HttpTestClient::HttpStream> many(MANY);
+            for (int i = 0; i < MANY; i++)
+            {
+                many[i].url = server.url() + "/m" + std::to_string(i);
+                many[i].sink = [&many_bodies, i](const char *data, std::size_t size) { many_bodies[i].append(data, size); };
+            }
+            std::vector<std::exception_ptr> errors = client.batch(many, 1);
+            REQUIRE(errors.size() == MANY);
+            for (int i = 0; i < MANY; i++)
+            {
+                CHECK_FALSE(errors[i]);
+                CHECK(many_bodies[i] == "GET /m" + std::to_string(i) + " ");
+            }
+        }
+
+        SUBCASE("Пустой пакет")
+        {
+            CHECK(client.batch({}).empty());
+            CHECK(server.requests() == 0);
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "doctest.h"
+#include "../xor_chunk.h"
+
+using Sample = std::pair<std::int64_t, double>;
+
+static std::vector<std::uint8_t> encode(const std::vector<Sample> &samples)
+{
+    XorChunkEncoder encoder;
+    for (auto [timestamp, value] : samples)
+        encoder.append(timestamp, value);
+    CHECK(encoder.size() == samples.size());
+    return encoder.bytes();
+}
+
+static std::vector<Sample> decode(const std::vector<std::uint8_t> &bytes)
+{
+    std::vector<Sample> samples;
+    XorChunkIterator it(bytes.data(), bytes.size());
+    while (it.next())
+        samples.emplace_back(it.timestamp(), it.value());
+    CHECK(samples.size() == it.size());
+    return samples;
+}
+
+/**
+ * Сравнить значения побитово: так совпадают и NaN с разной полезной нагрузкой.
+ */
+static void checkSame(const std::vector<Sample> &actual, const std::vector<Sample> &expected)
+{
+    REQUIRE(actual.size() == expected.size());
+    for (std::size_t i = 0; i < expected.size(); i++)
+    {
+        CHECK(actual[i].first == expected[i].first);
+        CHECK(std::memcmp(&actual[i].second, &expected[i].second, sizeof(double)) == 0);
+    }
+}
+
+TEST_SUITE("Test XOR chunk")
+{
+    TEST_CASE("Пустой чанк")
+    {
+        XorChunkEncoder encoder;
+        CHECK(encoder.bytes() == std::vector<std::uint8_t>{0, 0});
+        CHECK(decode(encoder.bytes()).empty());
+    }
+
+    TEST_CASE("Одна и две точки")
+    {
+        checkSame(decode(encode({{1700000000000, 42.5}})), {{1700000000000, 42.5}});
+        checkSame(decode(encode({{-5000, 1}, {-4000, 1}})), {{-5000, 1}, {-4000, 1}});
+    }
+
+    TEST_CASE("Регулярный шаг и постоянное значение")
+    {
+        std::vector<Sample> samples;
+        for (int i = 0; i < 120; i++)
+            samples.emplace_back(1700000000000 + i * 15000, 7.0);
+        auto bytes = encode(samples);
+        checkSame(decode(bytes), samples);
+        // Каждая следующая точка — по биту на метку и на значение
+        CHECK(bytes.size() < 2 + 10 + 8 + 3 + 1 + 120 / 4 + 1);
+    }
+
+    TEST_CASE("Все ширины разности второго порядка")
+    {
+        // Разности: 0, ±2^13, ±2^16, ±2^19 и больше — по одной на каждую ветку кодирования
+        const std::int64_t jumps[] = {0, 1, -1, 8192, -8191, 8193, 65536, -65535, 65537, 524288, -524287, 524289,
+                                      std::int64_t(1) << 40, -(std::int64_t(1) << 40)};
+        std::vector<Sample> samples = {{0, 0}, {1000, 0}};
+        std::int64_t delta = 1000;
+        for (std::int64_t jump : jumps)
+        {
+            delta += jump;
+            samples.emplace_back(samples.back().first + delta, 0);
+        }
+        checkSame(decode(encode(samples)), samples);
+    }
+
+    TEST_CASE("Значения")
+    {
+        std::vector<double> values = {0, 1, 1, 2, 1e300, -1e-300, 0.1, 0.2, 0.30000000000000004, 123456.789,
+                                      std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                                      std::numeric_limits<double>::quiet_NaN(), 5e-324, -0.0, 0.0};
+        double stale;
+        std::uint64_t stale_bits = 0x7ff0000000000002ULL;
+        std::memcpy(&stale, &stale_bits, sizeof(stale));
+        values.push_back(stale);
+        for (int i = 0; i < 200; i++)
+            values.push_back(std::sin(i) * 1000);
+
+        std::vector<Sample> samples;
+        for (std::size_t i = 0; i < values.size(); i++)
+            samples.emplace_back(static_cast<std::int64_t>(i) * 15000 + (i % 3), values[i]);
+        checkSame(decode(encode(samples)), samples);
+    }
+
+    TEST_CASE("Переполнение чанка")
+    {
+        XorChunkEncoder encoder;
+        for (std::size_t i = 0; i < XorChunkEncoder::MAX_SAMPLES; i++)
+            encoder.append(static_cast<std::int64_t>(i), static_cast<double>(i % 10));
+        CHECK_THROWS_AS(encoder.append(-1, 0), std::length_error);
+        CHECK(decode(encoder.bytes()).size() == XorChunkEncoder::MAX_SAMPLES);
+    }
+
+    TEST_CASE("Повреждённые данные")
+    {
+        std::vector<std::uint8_t> tiny = {0};
+        CHECK_THROWS_AS(XorChunkIterator(tiny.data(), tiny.size()), std::runtime_error);
+
+        std::vector<Sample> samples;
+        for (int i = 0; i < 50; i++)
+            samples.emplace_back(i * 1000, i * 0.5);
+        auto bytes = encode(samples);
+        bytes.resize(bytes.size() / 2);
+        XorChunkIterator it(bytes.data(), bytes.size());
+        auto readAll = [&] {
+            while (it.next())
+                ;
+        };
+        CHECK_THROWS_AS(readAll(), std::runtime_error);
+    }
+}
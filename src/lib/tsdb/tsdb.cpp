@@ -1,20 +1,256 @@
 #include "tsdb.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <curl/curl.h>
+#include <exception>
+#include <mutex>
 #include <stdexcept>
 
+#include "../trace/trace.h"
+
+namespace
+{
+    /// Сколько простаивающих CURL-хэндлов (и их соединений) держит пул
+    constexpr std::size_t MAX_IDLE_HANDLES = 8;
+    /// Наибольшее время ожидания событий сокетов в `curl_multi_poll`, мс
+    constexpr int MULTI_POLL_TIMEOUT_MS = 1000;
+    /// Сколько передач пакетного запроса выполняется одновременно; остальные начинаются по мере их завершения
+    constexpr long MAX_BATCH_TRANSFERS = 32;
+
+    std::once_flag curl_global_init_flag;
+
+    /// Счётчики для `TSDBClient::TransferStats`
+    struct TransferCounters
+    {
+        std::atomic<std::size_t> requests{0};
+        std::atomic<std::size_t> bytes{0};
+        std::atomic<std::int64_t> sink_nanoseconds{0};
+    };
+}
+
+/**
+ * @brief Пул переиспользуемых CURL-хэндлов.
+ *
+ * @details Каждый хэндл хранит собственный кэш keep-alive соединений, поэтому возврат хэндла в пул
+ *          сохраняет открытые соединения для следующего запроса. Кэши DNS и TLS-сессий вынесены в общий
+ *          `CURLSH` и доступны всем хэндлам. Кэш соединений между хэндлами не разделяется: libcurl
+ *          не поддерживает его одновременное использование из нескольких потоков.
+ *
+ *          Для пакетных запросов пул хранит один мульти-хэндл со своим кэшем соединений; им пользуется
+ *          один поток за раз под `multi_mutex`.
+ */
+class TSDBClient::ConnectionPool
+{
+public:
+    ConnectionPool()
+    {
+        std::call_once(curl_global_init_flag, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+        share = curl_share_init();
+        if (!share)
+            throw std::runtime_error("Failed to initialize CURL share");
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShared);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShared);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+
+    ~ConnectionPool()
+    {
+        if (multi)
+            curl_multi_cleanup(multi);
+        for (CURL *handle : idle)
+            curl_easy_cleanup(handle);
+        curl_share_cleanup(share);
+    }
+
+    /**
+     * @brief Взять хэндл из пула с выставленными общими опциями.
+     */
+    CURL *acquire()
+    {
+        CURL *handle = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            if (!idle.empty())
+            {
+                handle = idle.back();
+                idle.pop_back();
+            }
+        }
+        if (!handle)
+        {
+            handle = curl_easy_init();
+            if (!handle)
+                throw std::runtime_error("Failed to initialize CURL");
+        }
+
+        // reset сбрасывает опции, но сохраняет открытые соединения и кэши хэндла
+        curl_easy_reset(handle);
+        curl_easy_setopt(handle, CURLOPT_SHARE, share);
+        curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+        // Пустая строка — предложить все поддерживаемые сборкой libcurl кодировки (gzip, deflate, ...)
+        // и распаковывать ответ прозрачно для write-callback'а
+        curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, "");
+        return handle;
+    }
+
+    /**
+     * @brief Вернуть хэндл в пул.
+     */
+    void release(CURL *handle)
+    {
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            if (idle.size() < MAX_IDLE_HANDLES)
+            {
+                idle.push_back(handle);
+                return;
+            }
+        }
+        curl_easy_cleanup(handle);
+    }
+
+    /**
+     * @brief Мульти-хэндл для пакетных запросов, создаётся при первом вызове. Вызывающий держит `multi_mutex`.
+     */
+    CURLM *multiHandle()
+    {
+        if (!multi)
+        {
+            multi = curl_multi_init();
+            if (!multi)
+                throw std::runtime_error("Failed to initialize CURL multi");
+            curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+            curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, MAX_BATCH_TRANSFERS);
+            // Иначе размер кэша зависит от числа добавленных хэндлов, и соединения прошлого пакета закрываются
+            curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, MAX_BATCH_TRANSFERS);
+        }
+        return multi;
+    }
+
+    std::mutex multi_mutex;
+    TransferCounters counters;
+
+private:
+    static void lockShared(CURL *, curl_lock_data data, curl_lock_access, void *userptr)
+    {
+        static_cast<ConnectionPool *>(userptr)->share_locks[data].lock();
+    }
+
+    static void unlockShared(CURL *, curl_lock_data data, void *userptr)
+    {
+        static_cast<ConnectionPool *>(userptr)->share_locks[data].unlock();
+    }
+
+    CURLSH *share;
+    std::mutex share_locks[CURL_LOCK_DATA_LAST];
+    std::mutex idle_mutex;
+    std::vector<CURL *> idle;
+    CURLM *multi = nullptr;
+};
+
+bool TSDBClient::compressionSupported()
+{
+    return (curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_LIBZ) != 0;
+}
+
+TSDBClient::TSDBClient() : connections(std::make_unique<ConnectionPool>()) {}
+
+TSDBClient::~TSDBClient() = default;
+
 const char *InvalidTSDBRequest::what() const noexcept
 {
     return message.c_str();
 }
 
-std::string TSDBClient::format_line_name(const std::string &name, const std::map<std::string, std::string> &labels)
+void Series::appendNewer(const Series &tail)
+{
+    auto first = tail.timestamps.begin();
+    if (!timestamps.empty())
+        first = std::upper_bound(tail.timestamps.begin(), tail.timestamps.end(), timestamps.back());
+    std::size_t offset = first - tail.timestamps.begin();
+    timestamps.insert(timestamps.end(), first, tail.timestamps.end());
+    values.insert(values.end(), tail.values.begin() + offset, tail.values.end());
+}
+
+void Series::dropBefore(double timestamp)
+{
+    auto first = std::lower_bound(timestamps.begin(), timestamps.end(), timestamp);
+    std::size_t count = first - timestamps.begin();
+    timestamps.erase(timestamps.begin(), first);
+    values.erase(values.begin(), values.begin() + count);
+}
+
+void Series::merge(const Series &other)
+{
+    if (other.empty())
+        return;
+    if (empty() || other.timestamps.front() > timestamps.back())
+    {
+        timestamps.insert(timestamps.end(), other.timestamps.begin(), other.timestamps.end());
+        values.insert(values.end(), other.values.begin(), other.values.end());
+        return;
+    }
+    if (other.timestamps.back() < timestamps.front())
+    {
+        timestamps.insert(timestamps.begin(), other.timestamps.begin(), other.timestamps.end());
+        values.insert(values.begin(), other.values.begin(), other.values.end());
+        return;
+    }
+
+    Series merged;
+    merged.reserve(size() + other.size());
+    std::size_t i = 0, j = 0;
+    while (i < size() || j < other.size())
+    {
+        if (j == other.size() || (i < size() && timestamps[i] < other.timestamps[j]))
+        {
+            merged.push_back(timestamps[i], values[i]);
+            i++;
+        }
+        else
+        {
+            if (i < size() && timestamps[i] == other.timestamps[j])
+                i++;
+            merged.push_back(other.timestamps[j], other.values[j]);
+            j++;
+        }
+    }
+    *this = std::move(merged);
+}
+
+Series Series::slice(double from, double to) const
+{
+    auto first = std::lower_bound(timestamps.begin(), timestamps.end(), from);
+    auto last = std::upper_bound(first, timestamps.end(), to);
+    std::size_t offset = first - timestamps.begin(), count = last - first;
+
+    Series result;
+    result.timestamps.assign(first, last);
+    result.values.assign(values.begin() + offset, values.begin() + offset + count);
+    return result;
+}
+
+std::string TSDBClient::format_line_name(const std::string &name, const LabelSet &labels)
 {
     std::string res = name;
     if (labels.empty())
         return res;
+    std::size_t length = res.size() + 1;
+    for (const auto &label : labels)
+        length += label.first.str().size() + label.second.str().size() + 2;
+    res.reserve(length);
     res += '[';
-    for (auto it = labels.begin(); it != labels.end(); it++) {
-        res += it->first + '=' + it->second + ';';
+    for (const auto &label : labels) {
+        res += label.first.str();
+        res += '=';
+        res += label.second.str();
+        res += ';';
     }
     res[res.length() - 1] = ']';
     return res;
@@ -22,19 +258,19 @@ std::string TSDBClient::format_line_name(const std::string &name, const std::map
 
 std::string TSDBClient::performHttpRequest(const std::string &url, int timeout)
 {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        throw std::runtime_error("Failed to initialize CURL");
-    }
+    trace::Span span("http", "tsdb");
+    CURL* curl = connections->acquire();
 
     std::string response_data;
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(timeout));
 
     CURLcode res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
+    connections->release(curl);
+    connections->counters.requests++;
+    connections->counters.bytes += response_data.size();
     if (res != CURLE_OK) {
         throw std::runtime_error("CURL request failed: " + std::string(curl_easy_strerror(res)));
     }
@@ -42,6 +278,266 @@ std::string TSDBClient::performHttpRequest(const std::string &url, int timeout)
     return response_data;
 }
 
+namespace
+{
+    /// Сколько байт тела ответа с ошибкой попадает в текст исключения
+    constexpr std::size_t MAX_ERROR_BODY = 512;
+
+    /// Состояние потоковой передачи ответа в `sink`.
+    struct StreamContext
+    {
+        const std::function<void(const char *, std::size_t)> *sink;
+        TransferCounters *counters;
+        CURL *handle;
+        bool reject_errors;     ///< Не передавать в `sink` ответ с HTTP-статусом ошибки
+        long status = 0;
+        std::string error_body;
+        std::exception_ptr error;
+    };
+
+    size_t streamCallback(void *contents, size_t size, size_t nmemb, void *userp)
+    {
+        auto *context = static_cast<StreamContext *>(userp);
+        size_t total_size = size * nmemb;
+        if (context->reject_errors)
+        {
+            if (context->status == 0)
+                curl_easy_getinfo(context->handle, CURLINFO_RESPONSE_CODE, &context->status);
+            if (context->status >= 400)
+            {
+                std::size_t keep = std::min(total_size, MAX_ERROR_BODY - std::min(MAX_ERROR_BODY, context->error_body.size()));
+                context->error_body.append(static_cast<const char *>(contents), keep);
+                return total_size;
+            }
+        }
+        // Исключение не должно пройти через C-код libcurl: сохраняем его и прерываем передачу
+        trace::Span span("parse chunk", "tsdb");
+        auto started = std::chrono::steady_clock::now();
+        try
+        {
+            (*context->sink)(static_cast<const char *>(contents), total_size);
+        }
+        catch (...)
+        {
+            context->error = std::current_exception();
+            return 0;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started);
+        context->counters->sink_nanoseconds += elapsed.count();
+        context->counters->bytes += total_size;
+        return total_size;
+    }
+
+    /// Ошибка завершённой передачи: исключение из `sink`, ошибка CURL или HTTP-статус ошибки; nullptr при успехе.
+    std::exception_ptr streamError(CURL *curl, CURLcode res, StreamContext &context)
+    {
+        context.counters->requests++;
+        if (context.reject_errors && context.status == 0)
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &context.status);
+        if (context.error)
+            return context.error;
+        if (res != CURLE_OK)
+            return std::make_exception_ptr(std::runtime_error("CURL request failed: " + std::string(curl_easy_strerror(res))));
+        if (context.reject_errors && context.status >= 400)
+            return std::make_exception_ptr(
+                std::runtime_error("HTTP request failed with status " + std::to_string(context.status) + ": " + context.error_body));
+        return nullptr;
+    }
+
+    /// Выполнить подготовленный запрос с потоковой передачей ответа и вернуть хэндл в пул.
+    template <typename Release>
+    void performStream(CURL *curl, StreamContext &context, Release release)
+    {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, streamCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &context);
+
+        trace::Span span("http stream", "tsdb");
+        CURLcode res = curl_easy_perform(curl);
+        std::exception_ptr error = streamError(curl, res, context);
+        release(curl);
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+void TSDBClient::streamHttpRequest(const std::string &url, const std::function<void(const char *, std::size_t)> &sink, int timeout)
+{
+    CURL *curl = connections->acquire();
+
+    StreamContext context{&sink, &connections->counters, curl, false, 0, {}, nullptr};
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(timeout));
+    performStream(curl, context, [this](CURL *handle) { connections->release(handle); });
+}
+
+void TSDBClient::streamHttpPost(const std::string &url, const std::string &body, const std::vector<std::string> &headers,
+                                const std::function<void(const char *, std::size_t)> &sink, int timeout)
+{
+    CURL *curl = connections->acquire();
+
+    curl_slist *header_list = nullptr;
+    for (const auto &header : headers)
+        header_list = curl_slist_append(header_list, header.c_str());
+
+    StreamContext context{&sink, &connections->counters, curl, true, 0, {}, nullptr};
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.data());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.size()));
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(timeout));
+    try
+    {
+        performStream(curl, context, [this](CURL *handle) { connections->release(handle); });
+    }
+    catch (...)
+    {
+        curl_slist_free_all(header_list);
+        throw;
+    }
+    curl_slist_free_all(header_list);
+}
+
+std::vector<std::exception_ptr> TSDBClient::streamHttpRequests(const std::vector<HttpStream> &requests, int timeout)
+{
+    std::vector<std::exception_ptr> errors(requests.size());
+    if (requests.empty())
+        return errors;
+
+    trace::Span span("http batch", "tsdb");
+    std::lock_guard<std::mutex> lock(connections->multi_mutex);
+    CURLM *multi = connections->multiHandle();
+
+    // Контексты передаются в callback по указателю, поэтому вектор не должен перераспределяться
+    std::vector<StreamContext> contexts;
+    contexts.reserve(requests.size());
+    std::vector<CURL *> handles;
+    handles.reserve(requests.size());
+    std::vector<curl_slist *> header_lists(requests.size(), nullptr);
+    std::vector<CURLcode> results(requests.size(), CURLE_OK);
+    auto cleanup = [&]
+    {
+        for (std::size_t i = 0; i < handles.size(); i++)
+        {
+            curl_multi_remove_handle(multi, handles[i]);
+            connections->release(handles[i]);
+            curl_slist_free_all(header_lists[i]);
+        }
+    };
+
+    // Передачи добавляются не больше MAX_BATCH_TRANSFERS сразу: CURLOPT_TIMEOUT отсчитывается от добавления
+    // хэндла, и передача, ждущая свободного соединения внутри curl, тратила бы свой таймаут в очереди
+    std::size_t active = 0;
+    auto startTransfers = [&]
+    {
+        while (handles.size() < requests.size() && active < static_cast<std::size_t>(MAX_BATCH_TRANSFERS))
+        {
+            std::size_t i = handles.size();
+            const HttpStream &request = requests[i];
+            CURL *curl = connections->acquire();
+            handles.push_back(curl);
+            contexts.push_back({&request.sink, &connections->counters, curl, request.post, 0, {}, nullptr});
+
+            curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(timeout));
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, streamCallback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &contexts.back());
+            if (request.post)
+            {
+                curl_easy_setopt(curl, CURLOPT_POST, 1L);
+                curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body.data());
+                curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(request.body.size()));
+            }
+            for (const auto &header : request.headers)
+                header_lists[i] = curl_slist_append(header_lists[i], header.c_str());
+            if (header_lists[i])
+                curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_lists[i]);
+            // По HTTPS запросы ждут согласования HTTP/2 и идут в одном соединении вместо открытия новых
+            if (request.url.compare(0, 8, "https://") == 0)
+                curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+            curl_multi_add_handle(multi, curl);
+            active++;
+        }
+    };
+
+    try
+    {
+        startTransfers();
+        int running = 0;
+        do
+        {
+            CURLMcode code = curl_multi_perform(multi, &running);
+            if (code != CURLM_OK)
+                throw std::runtime_error("CURL multi request failed: " + std::string(curl_multi_strerror(code)));
+
+            int queued = 0;
+            while (CURLMsg *message = curl_multi_info_read(multi, &queued))
+            {
+                if (message->msg != CURLMSG_DONE)
+                    continue;
+                auto it = std::find(handles.begin(), handles.end(), message->easy_handle);
+                if (it == handles.end())
+                    continue;
+                results[it - handles.begin()] = message->data.result;
+                curl_multi_remove_handle(multi, *it);
+                active--;
+            }
+            // Освободившиеся места занимаются до ожидания, иначе новые передачи ждали бы событий старых
+            startTransfers();
+            if (active > 0)
+                code = curl_multi_poll(multi, nullptr, 0, MULTI_POLL_TIMEOUT_MS, nullptr);
+            if (code != CURLM_OK)
+                throw std::runtime_error("CURL multi request failed: " + std::string(curl_multi_strerror(code)));
+        } while (active > 0);
+
+        for (std::size_t i = 0; i < handles.size(); i++)
+            errors[i] = streamError(handles[i], results[i], contexts[i]);
+    }
+    catch (...)
+    {
+        cleanup();
+        throw;
+    }
+    cleanup();
+    return errors;
+}
+
+std::vector<RangeQueryResult> TSDBClient::queryBatch(const std::vector<RangeQuery> &queries)
+{
+    std::vector<RangeQueryResult> results(queries.size());
+    for (std::size_t i = 0; i < queries.size(); i++)
+    {
+        try
+        {
+            results[i].metrics = std::make_shared<const std::vector<Metric>>(query(queries[i].query, queries[i].start, queries[i].end, queries[i].step));
+        }
+        catch (...)
+        {
+            results[i].error = std::current_exception();
+        }
+    }
+    return results;
+}
+
+std::vector<std::string> TSDBClient::labelNames(std::time_t, std::time_t)
+{
+    return {};
+}
+
+std::vector<std::string> TSDBClient::labelValues(const std::string &, std::time_t, std::time_t)
+{
+    return {};
+}
+
+TSDBClient::TransferStats TSDBClient::getTransferStats() const
+{
+    TransferStats stats;
+    stats.requests = connections->counters.requests.load(std::memory_order_relaxed);
+    stats.bytes = connections->counters.bytes.load(std::memory_order_relaxed);
+    stats.sink_seconds = connections->counters.sink_nanoseconds.load(std::memory_order_relaxed) * 1e-9;
+    return stats;
+}
+
 size_t TSDBClient::writeCallback(void* contents, size_t size, size_t nmemb, void* userp) {
     size_t total_size = size * nmemb;
     std::string* response_data = static_cast<std::string*>(userp);
@@ -5,7 +5,7 @@
  * Этот заголовочный файл содержит абстрактный класс `TSDBClient`, который определяет интерфейс
  * для взаимодействия с базами данных временных рядов (TSDB), такими как Prometheus, InfluxDB и другие.
  *
- * Также в файле определены структуры `Metric` и `Point`, используемые для хранения и обработки данных временных рядов.
+ * Также в файле определены структуры `Metric`, `Series` и `Point`, используемые для хранения и обработки данных временных рядов.
  */
 
 /**
@@ -20,11 +20,16 @@
 #ifndef TSDB_ABC_H
 #define TSDB_ABC_H
 
+#include <cstddef>
 #include <ctime>
-#include <map>
+#include <exception>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "labels.h"
+
 /**
  * @brief Исключение, возникающее при ошибке запроса к TSDB.
  */
@@ -55,25 +60,151 @@ struct Point
     std::time_t timestamp;
 };
 
+/**
+ * @brief Колоночное хранилище точек временного ряда.
+ *
+ * Временные метки и значения лежат в двух непрерывных массивах одинаковой длины. В таком виде
+ * их можно напрямую передавать в ImPlot (`PlotLine(name, timestamps.data(), values.data(), size())`)
+ * без промежуточного копирования.
+ */
+struct Series
+{
+    std::vector<double> timestamps; ///< Временные метки в секундах Unix time, по возрастанию
+    std::vector<double> values;     ///< Значения, `values[i]` соответствует `timestamps[i]`
+
+    std::size_t size() const { return timestamps.size(); }
+    bool empty() const { return timestamps.empty(); }
+
+    void reserve(std::size_t n)
+    {
+        timestamps.reserve(n);
+        values.reserve(n);
+    }
+
+    void clear()
+    {
+        timestamps.clear();
+        values.clear();
+    }
+
+    /**
+     * @brief Добавить точку в конец ряда.
+     *
+     * @param timestamp Временная метка
+     * @param value Значение
+     */
+    void push_back(double timestamp, double value)
+    {
+        timestamps.push_back(timestamp);
+        values.push_back(value);
+    }
+
+    void push_back(const Point &point) { push_back(static_cast<double>(point.timestamp), point.value); }
+
+    /**
+     * @brief Дописать в конец точки `tail`, которые новее последней точки ряда.
+     *
+     * @details Точки `tail`, попадающие на уже загруженный интервал, пропускаются, поэтому
+     *          повторно запрошенный хвост не создаёт дубликатов.
+     *
+     * @param tail Ряд с более свежими точками, упорядоченный по времени
+     */
+    void appendNewer(const Series &tail);
+
+    /**
+     * @brief Удалить точки с временной меткой меньше `timestamp`.
+     *
+     * @param timestamp Новая левая граница ряда
+     */
+    void dropBefore(double timestamp);
+
+    /**
+     * @brief Слить с рядом точки `other`, сохраняя порядок по времени.
+     *
+     * @details При совпадении временных меток остаётся точка из `other`. Если `other` целиком
+     *          левее или правее ряда, точки просто дописываются с нужной стороны.
+     *
+     * @param other Упорядоченный по времени ряд
+     */
+    void merge(const Series &other);
+
+    /**
+     * @brief Скопировать точки из интервала `[from, to]`.
+     *
+     * @param from Левая граница (включительно)
+     * @param to Правая граница (включительно)
+     * @return Новый ряд с точками интервала
+     */
+    Series slice(double from, double to) const;
+
+    /**
+     * @brief Получить точку по индексу.
+     *
+     * @param i Индекс точки
+     * @return Копия точки
+     */
+    Point operator[](std::size_t i) const { return {values[i], static_cast<std::time_t>(timestamps[i])}; }
+};
+
 /**
  * @brief Описывает метрику, содержащую временной ряд данных.
  *
- * Метрика включает имя, набор меток и значения, представленные точками временного ряда.
+ * Метрика включает имя, набор меток и точки временного ряда в колоночном виде.
+ * Имя и метки интернированы, см. `Symbol` и `LabelSet`.
  */
 struct Metric
 {
-    std::string name;
-    std::map<std::string, std::string> labels;
-    std::vector<Point> values;
+    Symbol name;
+    LabelSet labels;
+    Series series;
+
+    /**
+     * @brief Идентичность ряда для сопоставления метрик из разных ответов.
+     */
+    SeriesKey key() const { return {name, labels}; }
+};
+
+/**
+ * @brief Неизменяемые ряды, которые разделяют несколько владельцев без копирования.
+ */
+using SharedMetrics = std::shared_ptr<const std::vector<Metric>>;
+
+/**
+ * @brief Один запрос пакета `TSDBClient::queryBatch`.
+ */
+struct RangeQuery
+{
+    std::string query;     ///< Строка запроса
+    std::time_t start = 0; ///< Начало временного диапазона
+    std::time_t end = 0;   ///< Конец временного диапазона
+    int step = 0;          ///< Интервал между точками в секундах
+};
+
+/**
+ * @brief Результат одного запроса пакета.
+ */
+struct RangeQueryResult
+{
+    SharedMetrics metrics;              ///< Ряды ответа, nullptr при ошибке; могут быть общими с другими результатами
+    std::exception_ptr error = nullptr; ///< Исключение, которым завершился запрос, nullptr при успехе
 };
 
 /**
  * @brief Интерфейс клиента к TSDB
+ *
+ * @details Клиент владеет пулом HTTP-соединений: CURL-хэндлы переиспользуются между запросами вместе
+ *          со своими keep-alive соединениями, а кэши DNS и TLS-сессий разделяются между всеми хэндлами пула.
+ *          Поэтому повторные запросы (автообновление, проверки доступности) не платят за
+ *          установку TCP/TLS-соединения. `performHttpRequest` можно вызывать из нескольких потоков.
  */
 class TSDBClient
 {
 public:
-    virtual ~TSDBClient() = default;
+    TSDBClient();
+    virtual ~TSDBClient();
+
+    TSDBClient(const TSDBClient &) = delete;
+    TSDBClient &operator=(const TSDBClient &) = delete;
 
     /**
      * @brief Выполнить запрос к TSDB для получения точек.
@@ -86,6 +217,57 @@ public:
      */
     virtual std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end) = 0;
 
+    /**
+     * @brief Выполнить запрос к TSDB с заданным шагом между точками.
+     *
+     * @param query_str Строка запроса
+     * @param start Начало временного диапазона
+     * @param end Конец временного диапазона
+     * @param step Интервал между точками в секундах
+     * @return Массив метрик типа Metric
+     * @throws InvalidTSDBRequest В случае неуспешного статуса ответа от TSDB
+     */
+    virtual std::vector<Metric> query(const std::string &query_str, std::time_t start, std::time_t end, int step) = 0;
+
+    /**
+     * @brief Выполнить несколько запросов с шагом.
+     *
+     * @details Ошибка одного запроса не прерывает остальные: она сохраняется в его результате.
+     *          Реализация по умолчанию выполняет запросы по очереди через `query`; клиенты с HTTP API
+     *          отправляют их одновременно, так что пакет занимает время самого долгого запроса.
+     *          Ряды результата неизменяемы: обёртки над клиентом передают их дальше и раздают
+     *          нескольким запросам без копирования, копирует только тот, кому нужно ими владеть.
+     *
+     * @param queries Запросы
+     * @return Результаты в порядке запросов
+     */
+    virtual std::vector<RangeQueryResult> queryBatch(const std::vector<RangeQuery> &queries);
+
+    /**
+     * @brief Получить имена меток рядов.
+     *
+     * @details Реализация по умолчанию возвращает пустой список: TSDB без метаданных.
+     *
+     * @param start Начало интервала: только ряды с точками в `[start, end]`; 0 вместе с `end` — без ограничения
+     * @param end Конец интервала
+     * @return Имена меток без повторов
+     * @throws InvalidTSDBRequest В случае неуспешного статуса ответа от TSDB
+     */
+    virtual std::vector<std::string> labelNames(std::time_t start, std::time_t end);
+
+    /**
+     * @brief Получить значения метки рядов; для `__name__` — имена метрик.
+     *
+     * @details Реализация по умолчанию возвращает пустой список: TSDB без метаданных.
+     *
+     * @param label Имя метки
+     * @param start Начало интервала: только ряды с точками в `[start, end]`; 0 вместе с `end` — без ограничения
+     * @param end Конец интервала
+     * @return Значения без повторов
+     * @throws InvalidTSDBRequest В случае неуспешного статуса ответа от TSDB
+     */
+    virtual std::vector<std::string> labelValues(const std::string &label, std::time_t start, std::time_t end);
+
     /**
      * @brief Проверить доступность TSDB.
      *
@@ -93,6 +275,25 @@ public:
      */
     virtual bool isAvailable() noexcept = 0;
 
+    /**
+     * @brief Счётчики HTTP-запросов клиента с момента создания.
+     */
+    struct TransferStats
+    {
+        std::size_t requests = 0;  ///< Завершённые HTTP-запросы
+        std::size_t bytes = 0;     ///< Байты тел ответов после распаковки
+        double sink_seconds = 0;   ///< Время в получателях частей ответа, то есть разбор при потоковой передаче
+    };
+
+    /**
+     * @brief Получить счётчики HTTP-запросов.
+     *
+     * @details Разность двух снимков вокруг запроса делит его время на сеть и разбор ответа. Счётчики
+     *          ведутся всегда: на часть ответа приходится пара атомарных сложений и два чтения часов.
+     *          Обёртки над другим клиентом возвращают его счётчики.
+     */
+    virtual TransferStats getTransferStats() const;
+
     /**
      * @brief Форматирует имя линии графика на основе метрики.
      *
@@ -105,20 +306,91 @@ public:
      * @brief Форматирует имя линии графика на основе имени и меток.
      *
      * @param name Имя метрики.
-     * @param labels Словарь меток метрики, где ключ — имя метки, а значение — её значение.
+     * @param labels Набор меток метрики.
      * @return Отформатированное имя линии графика с метками.
      */
-    static std::string format_line_name(const std::string &name, const std::map<std::string, std::string> &labels);
+    static std::string format_line_name(const std::string &name, const LabelSet &labels);
+
+    /**
+     * @brief Собран ли libcurl с zlib, то есть предлагают ли запросы сжатие ответов.
+     *
+     * @details Без zlib `Accept-Encoding` не отправляется и ответы передаются несжатыми.
+     */
+    static bool compressionSupported();
 
 protected:
     /**
      * @brief Выполнить HTTP-запрос и получить результат.
      *
+     * @details Использует свободное соединение из пула клиента (keep-alive), при необходимости
+     *          открывая новое. Запрос предлагает серверу сжатие (`Accept-Encoding`), ответ
+     *          возвращается распакованным. Потокобезопасен.
+     *
      * @param url URL для запроса
+     * @param timeout Таймаут запроса в секундах
      * @return Ответ от сервера
+     * @throws std::runtime_error При ошибке CURL
      */
     virtual std::string performHttpRequest(const std::string &url, int timeout = 5);
 
+    /**
+     * @brief Выполнить HTTP-запрос, передавая тело ответа по частям.
+     *
+     * @details Части передаются в `sink` по мере получения, уже распакованными, если сервер сжал ответ.
+     *          Тело целиком в памяти не собирается. Исключение из `sink` прерывает передачу и
+     *          пробрасывается вызывающему. Потокобезопасен.
+     *
+     * @param url URL для запроса
+     * @param sink Получатель частей тела ответа
+     * @param timeout Таймаут запроса в секундах
+     * @throws std::runtime_error При ошибке CURL
+     */
+    virtual void streamHttpRequest(const std::string &url, const std::function<void(const char *, std::size_t)> &sink, int timeout = 5);
+
+    /**
+     * @brief Выполнить POST-запрос, передавая тело ответа по частям.
+     *
+     * @details В отличие от `streamHttpRequest`, ответ с HTTP-статусом ошибки (>= 400) в `sink` не передаётся:
+     *          начало его тела попадает в текст исключения. Потокобезопасен.
+     *
+     * @param url URL для запроса
+     * @param body Тело запроса
+     * @param headers Дополнительные заголовки в виде `"Имя: значение"`
+     * @param sink Получатель частей тела ответа
+     * @param timeout Таймаут запроса в секундах
+     * @throws std::runtime_error При ошибке CURL или HTTP-статусе ошибки
+     */
+    virtual void streamHttpPost(const std::string &url, const std::string &body, const std::vector<std::string> &headers,
+                                const std::function<void(const char *, std::size_t)> &sink, int timeout = 5);
+
+    /**
+     * @brief Один запрос для `streamHttpRequests`.
+     */
+    struct HttpStream
+    {
+        std::string url;
+        std::function<void(const char *, std::size_t)> sink; ///< Получатель частей тела ответа
+        bool post = false;                                   ///< POST с телом `body` вместо GET
+        std::string body;                                    ///< Тело POST-запроса
+        std::vector<std::string> headers;                    ///< Дополнительные заголовки `"Имя: значение"`
+    };
+
+    /**
+     * @brief Выполнить несколько запросов одновременно, передавая тела ответов по частям.
+     *
+     * @details Запросы выполняются в вызывающем потоке через `curl_multi`: до 32 передач идут параллельно,
+     *          следующие начинаются по мере их завершения, к HTTPS-серверу с HTTP/2 — мультиплексированием
+     *          в одном соединении. Таймаут отсчитывается от начала передачи, а не от вызова. Соединения
+     *          мульти-хэндла переживают вызов, поэтому следующий пакет их переиспользует. GET-запросы
+     *          ведут себя как `streamHttpRequest`, POST — как `streamHttpPost`. Вызовы пакетов
+     *          из разных потоков выполняются по очереди.
+     *
+     * @param requests Запросы
+     * @param timeout Таймаут каждого запроса в секундах
+     * @return Для каждого запроса исключение, которым он завершился, или nullptr
+     */
+    virtual std::vector<std::exception_ptr> streamHttpRequests(const std::vector<HttpStream> &requests, int timeout = 5);
+
     /**
      * @brief Callback для записи данных из CURL.
      *
@@ -129,6 +401,10 @@ protected:
      * @return Количество байт, записанных в userp
      */
     static size_t writeCallback(void *contents, size_t size, size_t nmemb, void *userp);
+
+private:
+    class ConnectionPool;
+    std::unique_ptr<ConnectionPool> connections;
 };
 
 /** @} */
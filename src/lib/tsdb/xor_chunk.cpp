@@ -0,0 +1,292 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "xor_chunk.h"
+
+namespace
+{
+    inline std::uint64_t doubleBits(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    inline int leadingZeros(std::uint64_t x)
+    {
+        int n = 0;
+        for (int shift = 32; shift > 0; shift >>= 1)
+        {
+            if (x >> (64 - shift) == 0)
+            {
+                n += shift;
+                x <<= shift;
+            }
+        }
+        return n;
+    }
+
+    inline int trailingZeros(std::uint64_t x)
+    {
+        int n = 0;
+        for (int shift = 32; shift > 0; shift >>= 1)
+        {
+            if ((x & ((std::uint64_t(1) << shift) - 1)) == 0)
+            {
+                n += shift;
+                x >>= shift;
+            }
+        }
+        return n;
+    }
+
+    /// Помещается ли разность второго порядка в `bits` битов (диапазон как в Prometheus).
+    inline bool fitsBits(std::int64_t x, int bits)
+    {
+        return -((std::int64_t(1) << (bits - 1)) - 1) <= x && x <= (std::int64_t(1) << (bits - 1));
+    }
+}
+
+XorChunkEncoder::XorChunkEncoder() : stream(2, 0) {}
+
+void XorChunkEncoder::append(std::int64_t timestamp, double value)
+{
+    if (count == MAX_SAMPLES)
+        throw std::length_error("XOR chunk is full");
+
+    std::uint64_t value_bits = doubleBits(value);
+    if (count == 0)
+    {
+        // Первая точка целиком: zigzag-varint метки и 64 бита значения
+        writeVarint((static_cast<std::uint64_t>(timestamp) << 1) ^ static_cast<std::uint64_t>(timestamp >> 63));
+        writeBits(value_bits, 64);
+    }
+    else if (count == 1)
+    {
+        last_delta = timestamp - last_timestamp;
+        writeVarint(static_cast<std::uint64_t>(last_delta));
+    }
+    else
+    {
+        std::int64_t delta = timestamp - last_timestamp;
+        std::int64_t dod = delta - last_delta;
+        if (dod == 0)
+            writeBit(false);
+        else if (fitsBits(dod, 14))
+        {
+            writeBits(0b10, 2);
+            writeBits(static_cast<std::uint64_t>(dod), 14);
+        }
+        else if (fitsBits(dod, 17))
+        {
+            writeBits(0b110, 3);
+            writeBits(static_cast<std::uint64_t>(dod), 17);
+        }
+        else if (fitsBits(dod, 20))
+        {
+            writeBits(0b1110, 4);
+            writeBits(static_cast<std::uint64_t>(dod), 20);
+        }
+        else
+        {
+            writeBits(0b1111, 4);
+            writeBits(static_cast<std::uint64_t>(dod), 64);
+        }
+        last_delta = delta;
+    }
+
+    if (count > 0)
+    {
+        std::uint64_t xored = value_bits ^ last_value_bits;
+        if (xored == 0)
+            writeBit(false);
+        else
+        {
+            writeBit(true);
+            auto new_leading = static_cast<std::uint8_t>(leadingZeros(xored));
+            auto new_trailing = static_cast<std::uint8_t>(trailingZeros(xored));
+            // На длину префикса нулей отведено 5 битов
+            if (new_leading >= 32)
+                new_leading = 31;
+            if (leading != 0xff && new_leading >= leading && new_trailing >= trailing)
+            {
+                // Значащие биты помещаются в прежнее окно
+                writeBit(false);
+                writeBits(xored >> trailing, 64 - leading - trailing);
+            }
+            else
+            {
+                leading = new_leading;
+                trailing = new_trailing;
+                int significant = 64 - leading - trailing;
+                writeBit(true);
+                writeBits(leading, 5);
+                writeBits(static_cast<std::uint64_t>(significant), 6); // 64 записывается как 0
+                writeBits(xored >> trailing, significant);
+            }
+        }
+    }
+
+    last_timestamp = timestamp;
+    last_value_bits = value_bits;
+    count++;
+    stream[0] = static_cast<std::uint8_t>(count >> 8);
+    stream[1] = static_cast<std::uint8_t>(count);
+}
+
+void XorChunkEncoder::writeBit(bool bit)
+{
+    if (free_bits == 0)
+    {
+        stream.push_back(0);
+        free_bits = 8;
+    }
+    free_bits--;
+    if (bit)
+        stream.back() |= static_cast<std::uint8_t>(1u << free_bits);
+}
+
+void XorChunkEncoder::writeBits(std::uint64_t bits, int count)
+{
+    while (count > 0)
+    {
+        if (free_bits == 0)
+        {
+            stream.push_back(0);
+            free_bits = 8;
+        }
+        int take = count < free_bits ? count : free_bits;
+        auto chunk = static_cast<std::uint8_t>((bits >> (count - take)) & ((1u << take) - 1));
+        free_bits -= take;
+        stream.back() |= static_cast<std::uint8_t>(chunk << free_bits);
+        count -= take;
+    }
+}
+
+void XorChunkEncoder::writeVarint(std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        writeByte(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    writeByte(static_cast<std::uint8_t>(value));
+}
+
+XorChunkIterator::XorChunkIterator(const std::uint8_t *data, std::size_t size) : position(data), end(data + size)
+{
+    if (size < 2)
+        throw std::runtime_error("XOR chunk is too short");
+    total = (std::size_t(data[0]) << 8) | data[1];
+    position += 2;
+}
+
+bool XorChunkIterator::next()
+{
+    if (read == total)
+        return false;
+
+    if (read == 0)
+    {
+        std::uint64_t zigzag = readVarint();
+        current_timestamp = static_cast<std::int64_t>(zigzag >> 1) ^ -static_cast<std::int64_t>(zigzag & 1);
+        value_bits = readBits(64);
+    }
+    else if (read == 1)
+    {
+        delta = static_cast<std::int64_t>(readVarint());
+        current_timestamp += delta;
+        readValue();
+    }
+    else
+    {
+        // Префикс из единиц (не больше четырёх) задаёт ширину разности второго порядка
+        int prefix = 0;
+        while (prefix < 4 && readBit())
+            prefix++;
+
+        std::int64_t dod = 0;
+        if (prefix == 4)
+            dod = static_cast<std::int64_t>(readBits(64));
+        else if (prefix > 0)
+        {
+            static const int WIDTHS[] = {0, 14, 17, 20};
+            int width = WIDTHS[prefix];
+            std::uint64_t bits = readBits(width);
+            if (bits > (std::uint64_t(1) << (width - 1)))
+                bits -= std::uint64_t(1) << width;
+            dod = static_cast<std::int64_t>(bits);
+        }
+        delta += dod;
+        current_timestamp += delta;
+        readValue();
+    }
+
+    read++;
+    return true;
+}
+
+double XorChunkIterator::value() const
+{
+    double result;
+    std::memcpy(&result, &value_bits, sizeof(result));
+    return result;
+}
+
+void XorChunkIterator::readValue()
+{
+    if (!readBit())
+        return; // Значение не изменилось
+
+    if (readBit())
+    {
+        leading = static_cast<std::uint8_t>(readBits(5));
+        int significant = static_cast<int>(readBits(6));
+        if (significant == 0)
+            significant = 64;
+        if (leading + significant > 64)
+            throw std::runtime_error("Corrupted XOR chunk");
+        trailing = static_cast<std::uint8_t>(64 - leading - significant);
+    }
+    int significant = 64 - leading - trailing;
+    value_bits ^= readBits(significant) << trailing;
+}
+
+std::uint64_t XorChunkIterator::readBits(int count)
+{
+    std::uint64_t result = 0;
+    while (count > 0)
+    {
+        if (buffered == 0)
+        {
+            if (position == end)
+                throw std::runtime_error("Unexpected end of XOR chunk");
+            // Дозагружаем буфер побайтово, старшие биты читаются первыми
+            while (buffered <= 56 && position != end)
+            {
+                buffer |= std::uint64_t(*position++) << (56 - buffered);
+                buffered += 8;
+            }
+        }
+        int take = count < buffered ? count : buffered;
+        std::uint64_t bits = buffer >> (64 - take);
+        buffer = take == 64 ? 0 : buffer << take;
+        buffered -= take;
+        result = take == 64 ? bits : (result << take) | bits;
+        count -= take;
+    }
+    return result;
+}
+
+std::uint64_t XorChunkIterator::readVarint()
+{
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        std::uint64_t byte = readBits(8);
+        value |= (byte & 0x7f) << shift;
+        if (byte < 0x80)
+            return value;
+    }
+    throw std::runtime_error("Corrupted XOR chunk");
+}
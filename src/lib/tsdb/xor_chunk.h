@@ -0,0 +1,133 @@
+/**
+ * @file xor_chunk.h
+ * @brief XOR-чанки Prometheus (сжатие Gorilla).
+ *
+ * @details Формат совпадает с `chunkenc.XORChunk` из Prometheus: два байта big-endian с числом точек,
+ *          затем битовый поток. Временные метки кодируются разностью второго порядка (delta-of-delta),
+ *          значения — XOR с предыдущим значением, от которого хранятся только значащие биты.
+ *          В таком виде точки приходят из remote read API и лежат в блоках TSDB Prometheus.
+ */
+
+/**
+ * @addtogroup tsdb
+ * @{
+ */
+
+#ifndef TSDB_XOR_CHUNK_H
+#define TSDB_XOR_CHUNK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Кодировщик XOR-чанка.
+ *
+ * @details Точки дописываются по одной в порядке возрастания времени. Чанк вмещает не больше
+ *          `MAX_SAMPLES` точек (счётчик в заголовке двухбайтовый).
+ */
+class XorChunkEncoder
+{
+public:
+    static constexpr std::size_t MAX_SAMPLES = 0xffff; ///< Предел числа точек в одном чанке
+
+    XorChunkEncoder();
+
+    /**
+     * @brief Дописать точку.
+     *
+     * @param timestamp Временная метка (в Prometheus — миллисекунды)
+     * @param value Значение
+     * @throws std::length_error Если чанк уже содержит `MAX_SAMPLES` точек
+     */
+    void append(std::int64_t timestamp, double value);
+
+    /**
+     * @brief Число точек в чанке.
+     */
+    std::size_t size() const { return count; }
+
+    /**
+     * @brief Байты чанка вместе с заголовком.
+     */
+    const std::vector<std::uint8_t> &bytes() const { return stream; }
+
+private:
+    void writeBit(bool bit);
+    void writeBits(std::uint64_t bits, int count);
+    void writeByte(std::uint8_t byte) { writeBits(byte, 8); }
+    void writeVarint(std::uint64_t value);
+
+    std::vector<std::uint8_t> stream;
+    int free_bits = 0; ///< Сколько младших битов последнего байта ещё не занято
+
+    std::size_t count = 0;
+    std::int64_t last_timestamp = 0;
+    std::int64_t last_delta = 0;
+    std::uint64_t last_value_bits = 0;
+    std::uint8_t leading = 0xff; ///< 0xff — окно значащих битов ещё не задано
+    std::uint8_t trailing = 0;
+};
+
+/**
+ * @brief Последовательное чтение точек XOR-чанка.
+ *
+ * @details Итератор не копирует данные: буфер должен жить, пока итератор используется.
+ *
+ * @code
+ * XorChunkIterator it(data, size);
+ * while (it.next())
+ *     use(it.timestamp(), it.value());
+ * @endcode
+ */
+class XorChunkIterator
+{
+public:
+    /**
+     * @brief Начать чтение чанка.
+     *
+     * @param data Байты чанка вместе с заголовком
+     * @param size Размер чанка
+     * @throws std::runtime_error Если чанк короче заголовка
+     */
+    XorChunkIterator(const std::uint8_t *data, std::size_t size);
+
+    /**
+     * @brief Число точек, записанное в заголовке чанка.
+     */
+    std::size_t size() const { return total; }
+
+    /**
+     * @brief Перейти к следующей точке.
+     *
+     * @return false, если точки закончились
+     * @throws std::runtime_error Если битовый поток оборван или повреждён
+     */
+    bool next();
+
+    std::int64_t timestamp() const { return current_timestamp; }
+    double value() const;
+
+private:
+    bool readBit() { return readBits(1) != 0; }
+    std::uint64_t readBits(int count);
+    std::uint64_t readVarint();
+    void readValue();
+
+    const std::uint8_t *position;
+    const std::uint8_t *end;
+    std::uint64_t buffer = 0; ///< Непрочитанные биты, выровненные по старшему разряду
+    int buffered = 0;
+
+    std::size_t total;
+    std::size_t read = 0;
+    std::int64_t current_timestamp = 0;
+    std::int64_t delta = 0;
+    std::uint64_t value_bits = 0;
+    std::uint8_t leading = 0;
+    std::uint8_t trailing = 0;
+};
+
+/** @} */
+
+#endif // TSDB_XOR_CHUNK_H